@@ -28,8 +28,7 @@ public:
           m_offset{0},
           m_size{0},
           m_total{0},
-          m_more{false},
-          m_littleEndian{is_little_endian_byte_order()}
+          m_more{false}
     {}
 
     virtual ~Blockwise() = default;
@@ -75,6 +74,7 @@ public:
 
 protected:
     bool decode_block_option(const Option &opt);
+    void decode_block_value(std::uint32_t value);
 
 protected:
     std::uint32_t m_number;  // block number
@@ -82,7 +82,6 @@ protected:
     std::uint16_t m_size;    // block size
     std::uint32_t m_total;   // total file size
     bool m_more;             // more bit
-    const bool m_littleEndian;// little endian byte order
 };
 
 class Block1 : public Blockwise
@@ -99,7 +98,7 @@ public:
     bool set_header (std::uint16_t port, const UriPath &uri, Packet &pack) override;
 
 private:
-    bool get_block1_option(Packet &pack, std::vector<Option *> &rOptions);
+    bool get_block1_option(const Packet &pack, OptionList::const_range &rOptions);
 };
 
 class Block2 : public Blockwise
@@ -116,7 +115,7 @@ public:
     bool set_header (std::uint16_t port, const UriPath &uri, Packet &pack) override;
 
 private:
-    bool get_block2_option(Packet &pack, std::vector<Option *> &rOptions);
+    bool get_block2_option(const Packet &pack, OptionList::const_range &rOptions);
 };
 
 Blocksize size_to_sizeoption(size_t size);
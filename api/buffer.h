@@ -2,17 +2,23 @@
 #define _BUFFER_H
 #include <memory>
 #include <cstring>
+#include <cstdint>
 
 #define BUFFER_SIZE 1600UL
 
 class Buffer
 {
 public:
-    Buffer(const size_t length)
+    // zeroed is false for the buffers which are going to be overwritten anyway
+    Buffer(const size_t length, bool zeroed = true)
     : m_length{length},
       m_offset{0},
+      m_timestamp{0},
       m_data{new uint8_t [length]}
-    { memset(m_data, 0, length); }
+    {
+        if (zeroed)
+            memset(m_data, 0, length);
+    }
 
     ~Buffer()
     { delete [] m_data; }
@@ -23,6 +29,7 @@ public:
         {
             m_length = other.m_length;
             m_offset = other.m_offset;
+            m_timestamp = other.m_timestamp;
             if (m_data)
                 delete [] m_data;
             m_data = new uint8_t [m_length];
@@ -39,9 +46,11 @@ public:
             m_offset = 0;
             std::swap(m_length, other.m_length);
             std::swap(m_offset, other.m_offset);
+            m_timestamp = other.m_timestamp;
             if (m_data) 
                 delete [] m_data;
-            m_data = std::move(other.m_data);
+            m_data = other.m_data;
+            other.m_data = nullptr;
         }
         return *this;        
     }
@@ -49,12 +58,14 @@ public:
     Buffer(const Buffer& other)
     : m_length{0},
       m_offset{0},
+      m_timestamp{0},
       m_data{nullptr}
     { operator=(other); }
 
     Buffer(Buffer&& other)
     : m_length{0},
       m_offset{0},
+      m_timestamp{0},
       m_data{nullptr}
     { operator=(std::move(other)); }
 
@@ -70,15 +81,31 @@ public:
     void offset(size_t value)
     { m_offset = value; }
 
+    // kernel receive time of the content in nanoseconds since the epoch, zero if unknown
+    uint64_t timestamp() const
+    { return m_timestamp; }
+
+    void timestamp(uint64_t value)
+    { m_timestamp = value; }
+
     void clear()
     {
         m_offset = 0;
+        m_timestamp = 0;
         memset(m_data, 0, m_length);
     }
 
+    // like clear() but keeps the content, the next user overwrites it
+    void reset()
+    {
+        m_offset = 0;
+        m_timestamp = 0;
+    }
+
 private:
     size_t      m_length;
     size_t      m_offset;
+    uint64_t    m_timestamp;
     uint8_t     *m_data;
 };
 
@@ -0,0 +1,167 @@
+#ifndef _BUFFER_POOL_H
+#define _BUFFER_POOL_H
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include "buffer.h"
+
+// Buffers of three size classes reused instead of being allocated per message.
+// A buffer is allocated at the first use of its slot and never freed until the pool is destroyed,
+// so once the pool has grown to the working set the traffic does not touch the allocator.
+// acquire() and the release of the last handle are lock-free, any thread may take and return buffers.
+// The returned buffers are not zeroed, the next user overwrites them.
+// The pool must outlive all its handles.
+class BufferPool
+{
+public:
+    enum SizeClass
+    {
+        SMALL_BUFFER,   // ACKs, resets and short requests
+        MTU_BUFFER,     // one datagram of a usual network
+        LARGE_BUFFER,   // loopback datagrams and TCP messages
+        SIZE_CLASSES
+    };
+
+    static const std::size_t SMALL_BUFFER_SIZE = 256;
+    static const std::size_t MTU_BUFFER_SIZE = BUFFER_SIZE;
+    static const std::size_t LARGE_BUFFER_SIZE = 65536;
+
+    struct Statistics
+    {
+        std::size_t capacity;   // maximal quantity of the buffers
+        std::size_t allocated;  // buffers allocated so far
+        std::size_t inUse;      // buffers held by the handles now
+        std::size_t highWater;  // maximal inUse seen
+        std::size_t exhausted;  // acquire() calls that found no free buffer of this class
+    };
+
+private:
+    struct SizeClassPool;
+
+    struct Slot
+    {
+        std::atomic<std::uint32_t>  references;
+        std::unique_ptr<Buffer>     buffer;     // nullptr until the slot is used at the first time
+        SizeClassPool               *owner;
+        std::uint16_t               index;
+    };
+
+public:
+    // Shares one buffer of the pool, the last handle returns it back
+    class Handle
+    {
+    public:
+        Handle()
+            : m_slot{nullptr}
+        {}
+
+        ~Handle()
+        { reset(); }
+
+        Handle(const Handle &other) noexcept
+            : m_slot{other.m_slot}
+        {
+            if (m_slot)
+                m_slot->references.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        Handle(Handle &&other) noexcept
+            : m_slot{other.m_slot}
+        { other.m_slot = nullptr; }
+
+        Handle & operator=(const Handle &other) noexcept
+        {
+            Handle copy(other);
+            std::swap(m_slot, copy.m_slot);
+            return *this;
+        }
+
+        Handle & operator=(Handle &&other) noexcept
+        {
+            if (&other != this)
+            {
+                reset();
+                m_slot = other.m_slot;
+                other.m_slot = nullptr;
+            }
+            return *this;
+        }
+
+        explicit operator bool() const
+        { return m_slot != nullptr; }
+
+        Buffer * get() const
+        { return m_slot ? m_slot->buffer.get() : nullptr; }
+
+        Buffer & operator*() const
+        { return *get(); }
+
+        Buffer * operator->() const
+        { return get(); }
+
+        std::uint32_t use_count() const
+        { return m_slot ? m_slot->references.load(std::memory_order_relaxed) : 0; }
+
+        // drops the reference before the handle is destroyed
+        void reset()
+        {
+            if (m_slot)
+            {
+                if (m_slot->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    BufferPool::release(*m_slot);
+                m_slot = nullptr;
+            }
+        }
+
+    private:
+        friend class BufferPool;
+
+        explicit Handle(Slot * slot)
+            : m_slot{slot}
+        {}
+
+    private:
+        Slot    *m_slot;    // nullptr if the handle is empty
+    };
+
+public:
+    // The capacities are the maximal quantities of the buffers of every class, less than 65535
+    BufferPool(std::size_t smallCapacity, std::size_t mtuCapacity, std::size_t largeCapacity);
+    ~BufferPool() = default;
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool & operator=(const BufferPool &) = delete;
+
+public:
+    // Takes a buffer of the smallest class that holds length bytes, a larger class if that one is exhausted.
+    // Returns an empty handle if length is larger than LARGE_BUFFER_SIZE or no buffer is free
+    Handle acquire(std::size_t length);
+    // Returns an empty handle if the class is exhausted
+    Handle acquire(SizeClass sizeClass);
+
+    Statistics statistics(SizeClass sizeClass) const;
+
+    static std::size_t buffer_size(SizeClass sizeClass);
+
+private:
+    struct SizeClassPool
+    {
+        std::size_t                                     bufferSize;
+        std::size_t                                     capacity;
+        std::unique_ptr<Slot[]>                         slots;
+        std::unique_ptr<std::atomic<std::uint16_t>[]>   next;       // free list links
+        std::atomic<std::uint32_t>                      head;       // free list head: version << 16 | index
+        std::atomic<std::size_t>                        allocated;
+        std::atomic<std::size_t>                        inUse;
+        std::atomic<std::size_t>                        highWater;
+        std::atomic<std::size_t>                        exhausted;
+    };
+
+    static void release(Slot &slot);
+
+private:
+    SizeClassPool   m_classes[SIZE_CLASSES];
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef _BYTE_ORDER_H
+#define _BYTE_ORDER_H
+#include <cstdint>
+#include <cstddef>
+
+namespace coap
+{
+
+// CoAP puts every multi-byte field on the wire in the network (big endian) byte order.
+// The functions below assemble the values byte by byte, so they give the same result
+// on any host and need no knowledge of the host byte order.
+
+constexpr std::uint16_t load_be16(const std::uint8_t * buf)
+{ return static_cast<std::uint16_t>((buf[0] << 8) | buf[1]); }
+
+constexpr std::uint32_t load_be32(const std::uint8_t * buf)
+{
+    return (static_cast<std::uint32_t>(buf[0]) << 24) | (static_cast<std::uint32_t>(buf[1]) << 16)
+            | (static_cast<std::uint32_t>(buf[2]) << 8) | buf[3];
+}
+
+inline std::uint8_t * store_be16(std::uint8_t * buf, std::uint16_t value)
+{
+    buf[0] = static_cast<std::uint8_t>(value >> 8);
+    buf[1] = static_cast<std::uint8_t>(value);
+    return buf + sizeof(value);
+}
+
+inline std::uint8_t * store_be32(std::uint8_t * buf, std::uint32_t value)
+{
+    buf[0] = static_cast<std::uint8_t>(value >> 24);
+    buf[1] = static_cast<std::uint8_t>(value >> 16);
+    buf[2] = static_cast<std::uint8_t>(value >> 8);
+    buf[3] = static_cast<std::uint8_t>(value);
+    return buf + sizeof(value);
+}
+
+// Length of a uint option value: the shortest big endian form, zero is empty (RFC7252 3.2)
+constexpr std::size_t uint_encoded_size(std::uint32_t value)
+{
+    return value == 0 ? 0
+            : value <= 0xFF ? 1
+            : value <= 0xFFFF ? 2
+            : value <= 0xFFFFFF ? 3 : 4;
+}
+
+// Writes uint_encoded_size(value) bytes, returns the quantity of the written bytes
+inline std::size_t encode_uint(std::uint32_t value, std::uint8_t * buf)
+{
+    const std::size_t length = uint_encoded_size(value);
+    for (std::size_t i = length; i > 0; --i)
+    {
+        buf[i - 1] = static_cast<std::uint8_t>(value);
+        value >>= 8;
+    }
+    return length;
+}
+
+// Accepts the values with leading zeros too, false if the value does not fit 32 bits
+inline bool decode_uint(const std::uint8_t * buf, std::size_t length, std::uint32_t &value)
+{
+    if (length > sizeof(std::uint32_t))
+        return false;
+
+    value = 0;
+    for (std::size_t i = 0; i < length; ++i)
+        value = (value << 8) | buf[i];
+    return true;
+}
+
+} // namespace coap
+
+#endif
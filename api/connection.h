@@ -38,6 +38,11 @@ struct Connection
     virtual void receive(void * buffer, size_t &length, SocketAddress * srcAddr, std::error_code &ec, size_t seconds = 0) = 0;
     virtual void close(std::error_code &ec) = 0;
 
+    // Sends the parts as one datagram.
+    // This implementation gathers them into bufferPtr(), so its content is overwritten;
+    // the connections whose socket supports Socket::sendmsg() send the parts directly
+    virtual void sendmsg(const IoBuffer * buffers, size_t count, const SocketAddress *destAddr, std::error_code &ec);
+
     ConnectionType type() const
     { return m_type; }
 
@@ -144,6 +149,13 @@ protected:
     bool            m_version4;
 };
 
+namespace coap
+{
+class Packet;
+}
+
+// Serializes the header and the options on the stack and sends the payload from the packet itself
+void send_packet(Connection &connection, const coap::Packet &packet, const SocketAddress *destAddr, std::error_code &ec);
 
 Socket * create_socket(ConnectionType type, DnsResolver *dns, std::error_code &ec);
 ClientConnection * create_client_connection(ConnectionType type, const char * hostname, int port, std::error_code &ec);
@@ -13,6 +13,23 @@ const uint8_t MINUS_THIRTEEN_OPT_VALUE = 13;
 const uint16_t MINUS_TWO_HUNDRED_SIXTY_NINE_OPT_VALUE = 269;
 const uint16_t OPTION_MAX_LENGTH = 256;
 const uint8_t PAYLOAD_MARKER = 0xFF;
+const uint16_t COAP_DEFAULT_PORT = 5683;
+
+// Transmission parameters (RFC7252 4.8), the times are in milliseconds
+const uint32_t ACK_TIMEOUT = 2000;
+const uint32_t ACK_RANDOM_FACTOR_PERCENT = 150;   // ACK_RANDOM_FACTOR 1.5
+const uint8_t MAX_RETRANSMIT = 4;
+const uint8_t NSTART = 1;
+const uint32_t DEFAULT_LEISURE = 5000;
+
+// Derived time values (RFC7252 4.8.2)
+const uint32_t MAX_TRANSMIT_SPAN = ACK_TIMEOUT * ((1 << MAX_RETRANSMIT) - 1) * ACK_RANDOM_FACTOR_PERCENT / 100;
+const uint32_t MAX_TRANSMIT_WAIT = ACK_TIMEOUT * ((1 << (MAX_RETRANSMIT + 1)) - 1) * ACK_RANDOM_FACTOR_PERCENT / 100;
+const uint32_t MAX_LATENCY = 100000;
+const uint32_t PROCESSING_DELAY = ACK_TIMEOUT;
+const uint32_t MAX_RTT = 2 * MAX_LATENCY + PROCESSING_DELAY;
+const uint32_t EXCHANGE_LIFETIME = MAX_TRANSMIT_SPAN + 2 * MAX_LATENCY + PROCESSING_DELAY;
+const uint32_t NON_LIFETIME = MAX_TRANSMIT_SPAN + MAX_LATENCY;
 
 enum MessageOffset
 {
@@ -93,10 +110,11 @@ enum OptionDelta
 
 enum OptionNumber
 {
-    IF_MATCH        = 0,
+    IF_MATCH        = 1,
     URI_HOST        = 3,
     ETAG            = 4,
     IF_NONE_MATCH   = 5,
+    OBSERVE         = 6,
     URI_PORT        = 7,
     LOCATION_PATH   = 8,
     URI_PATH        = 11,
@@ -42,6 +42,7 @@ enum class CoapStatus
     COAP_ERR_NO_JSON_FIELD,
     COAP_ERR_CREATE_CORE_LINK,
     COAP_ERR_PARSE_CORE_LINK,
+    COAP_ERR_BAD_OPTION,
 };
 
 namespace std
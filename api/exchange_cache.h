@@ -0,0 +1,156 @@
+#ifndef _EXCHANGE_CACHE_H
+#define _EXCHANGE_CACHE_H
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "buffer_pool.h"
+#include "consts.h"
+#include "peer_key.h"
+#include "timer_wheel.h"
+
+namespace coap
+{
+
+class Packet;
+
+// Message deduplication (RFC7252 4.5): the exchanges seen during EXCHANGE_LIFETIME are remembered
+// by the peer and the message ID together with the serialized response, so a duplicate is answered
+// by the same bytes again without being parsed and dispatched.
+// The memory is bounded at the construction: the exchanges live in a ring in the order of their arrival,
+// which is the order of their expiry, and are found through an open addressing index;
+// the responses are copied into buffers of the cache's own pool.
+// Like the timer wheel, the cache is not thread-safe
+class ExchangeCache
+{
+public:
+    typedef TimerWheel::Clock Clock;
+
+    enum Eviction
+    {
+        EVICT_OLDEST,   // a full cache forgets its oldest exchanges before their lifetime is over
+        REJECT_NEW      // a full cache does not remember the new exchanges until the old ones expire
+    };
+
+    enum Lookup
+    {
+        FIRST,          // a new message, now remembered, dispatch it
+        IN_PROGRESS,    // a duplicate without a response so far, drop it
+        REPLAY          // a duplicate, send the cached response again
+    };
+
+    struct Statistics
+    {
+        std::uint64_t hits;         // duplicates found
+        std::uint64_t misses;       // new messages
+        std::uint64_t replays;      // duplicates answered from the cache
+        std::uint64_t expired;      // exchanges forgotten at the end of their lifetime
+        std::uint64_t evicted;      // exchanges forgotten earlier to make room
+        std::uint64_t rejected;     // exchanges or responses the full cache has not taken
+    };
+
+    static const std::size_t RESPONSE_SIZE_MAX = BufferPool::MTU_BUFFER_SIZE;
+
+public:
+    // capacity is the quantity of the exchanges, responses is the quantity of the responses of every size class,
+    // less than 65535; a NON or a message answered separately does not take a response buffer
+    ExchangeCache(
+            std::size_t capacity,
+            std::size_t responses,
+            Clock::duration lifetime = std::chrono::milliseconds(EXCHANGE_LIFETIME),
+            Eviction eviction = EVICT_OLDEST
+        );
+    ~ExchangeCache() = default;
+
+    ExchangeCache(const ExchangeCache &) = delete;
+    ExchangeCache & operator=(const ExchangeCache &) = delete;
+
+public:
+    // Looks for the exchange of the received message and remembers it if it is new.
+    // response is set to the cached bytes, the first offset() of them, for REPLAY only
+    Lookup check(
+            const PeerKey &peer,
+            std::uint16_t messageId,
+            BufferPool::Handle &response,
+            Clock::time_point now = TimerWheel::coarse_now()
+        );
+
+    // Keeps the response to the exchange for its duplicates.
+    // Returns false if the exchange is forgotten, the response is larger than RESPONSE_SIZE_MAX
+    // or there is no buffer for it
+    bool respond(const PeerKey &peer, std::uint16_t messageId, const void *data, std::size_t length);
+    // the response is serialized straight into the buffer of the cache
+    bool respond(const PeerKey &peer, std::uint16_t messageId, const Packet &response);
+
+    // Forgets the exchange of a message dropped after check() has returned FIRST,
+    // so its retransmissions are dispatched again instead of being dropped as duplicates.
+    // Returns false if the exchange is unknown
+    bool forget(const PeerKey &peer, std::uint16_t messageId);
+
+    // forgets everything, the statistics are kept
+    void clear();
+
+    std::size_t size() const
+    { return m_size; }
+
+    std::size_t capacity() const
+    { return m_capacity; }
+
+    const Statistics & statistics() const
+    { return static_cast<const Statistics &>(m_statistics); }
+
+private:
+    static const std::uint32_t EMPTY_INDEX = 0;
+
+    struct Entry
+    {
+        Entry()
+            : peer{},
+              hash{0},
+              expires{},
+              response{},
+              messageId{0},
+              indexed{false}
+        {}
+
+        PeerKey             peer;
+        std::uint64_t       hash;
+        Clock::time_point   expires;
+        BufferPool::Handle  response;
+        std::uint16_t       messageId;
+        bool                indexed;    // false for a forgotten exchange waiting in the ring for its expiry
+    };
+
+    std::uint64_t hash(const PeerKey &peer, std::uint16_t messageId) const
+    { return peer.hash(m_seed ^ (messageId * 0x9E3779B97F4A7C15ULL)); }
+
+    std::size_t mask() const
+    { return m_index.size() - 1; }
+
+    // position of the exchange in the index, mask() + 1 if it is unknown
+    std::size_t lookup(const PeerKey &peer, std::uint16_t messageId, std::uint64_t h) const;
+    // removes the position from the index
+    void unlink(std::size_t position);
+    // a buffer for the response to the exchange, empty if respond() has to return false
+    BufferPool::Handle response_buffer(const PeerKey &peer, std::uint16_t messageId, std::size_t length, std::size_t &slot);
+    // forgets the oldest exchange
+    void pop();
+    void expire(Clock::time_point now);
+
+private:
+    const std::size_t               m_capacity;
+    const Clock::duration           m_lifetime;
+    const Eviction                  m_eviction;
+    const std::uint64_t             m_seed;
+    BufferPool                      m_responses;    // declared before the entries, which hold its buffers
+    std::unique_ptr<Entry[]>        m_entries;      // ring of the exchanges from the oldest one
+    std::vector<std::uint32_t>      m_index;        // entry number + 1, EMPTY_INDEX for a free position
+    std::size_t                     m_head;         // the oldest exchange
+    std::size_t                     m_size;
+    Statistics                      m_statistics;
+};
+
+} // namespace coap
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef _LATENCY_HISTOGRAM_H
+#define _LATENCY_HISTOGRAM_H
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace coap
+{
+
+// Distribution of durations in nanoseconds with a bounded relative error.
+// Every power of two is split into SUB_BUCKETS linear buckets, so a reported percentile is above
+// the real one by 1/SUB_BUCKETS of its value at most, and the memory does not grow with the samples.
+// record() is lock-free and may be called by any thread; the readers see the samples recorded
+// before them, those being recorded meanwhile may be partially counted
+class LatencyHistogram
+{
+public:
+    static const std::size_t SUB_BUCKET_BITS = 3;
+    static const std::size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    // the values below SUB_BUCKETS are exact, then SUB_BUCKETS per power of two up to 2^64
+    static const std::size_t BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+public:
+    LatencyHistogram()
+    { reset(); }
+
+    LatencyHistogram(const LatencyHistogram &) = delete;
+    LatencyHistogram & operator=(const LatencyHistogram &) = delete;
+
+public:
+    void record(std::uint64_t nanoseconds);
+    // adds the samples of the other histogram, e.g. the one of another shard
+    void merge(const LatencyHistogram &other);
+    void reset();
+
+    std::uint64_t count() const
+    { return m_count.load(std::memory_order_relaxed); }
+
+    // zero without samples
+    std::uint64_t min() const;
+    std::uint64_t max() const
+    { return m_max.load(std::memory_order_relaxed); }
+    std::uint64_t mean() const;
+
+    // the upper bound of the bucket holding the percentile, p is in [0, 100], zero without samples
+    std::uint64_t percentile(double p) const;
+
+public:
+    static std::size_t bucket(std::uint64_t value);
+    // the greatest value counted by the bucket
+    static std::uint64_t upper_bound(std::size_t index);
+
+private:
+    void update_min(std::uint64_t value);
+    void update_max(std::uint64_t value);
+
+private:
+    std::atomic<std::uint64_t>  m_buckets[BUCKETS];
+    std::atomic<std::uint64_t>  m_count;
+    std::atomic<std::uint64_t>  m_sum;
+    std::atomic<std::uint64_t>  m_min;
+    std::atomic<std::uint64_t>  m_max;
+};
+
+// Where the time of a request goes in a server
+struct RequestLatency
+{
+    LatencyHistogram    queueing;   // from the kernel receive time stamp to the receive call taking the datagram
+    LatencyHistogram    parse;      // the request is decoded
+    LatencyHistogram    handler;    // the response is made
+    LatencyHistogram    send;       // the response is handed over to the socket
+};
+
+} // namespace coap
+
+#endif // _LATENCY_HISTOGRAM_H
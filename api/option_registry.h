@@ -0,0 +1,149 @@
+#ifndef _OPTION_REGISTRY_H
+#define _OPTION_REGISTRY_H
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include "consts.h"
+#include "span.h"
+#include "byte_order.h"
+
+namespace coap
+{
+
+enum class OptionFormat : std::uint8_t
+{
+    EMPTY,
+    OPAQUE,
+    UINT,
+    STRING
+};
+
+// RFC7252 5.10, RFC7641 2, RFC7959 2.1
+struct OptionProperties
+{
+    std::uint16_t   number;
+    OptionFormat    format;
+    bool            repeatable;
+    std::uint16_t   minLength;
+    std::uint16_t   maxLength;
+};
+
+// Sorted by the option number, all the numbers are less than 64
+constexpr OptionProperties OPTION_PROPERTIES[] = {
+    { IF_MATCH,         OptionFormat::OPAQUE,   true,   0,  8 },
+    { URI_HOST,         OptionFormat::STRING,   false,  1,  255 },
+    { ETAG,             OptionFormat::OPAQUE,   true,   1,  8 },
+    { IF_NONE_MATCH,    OptionFormat::EMPTY,    false,  0,  0 },
+    { OBSERVE,          OptionFormat::UINT,     false,  0,  3 },
+    { URI_PORT,         OptionFormat::UINT,     false,  0,  2 },
+    { LOCATION_PATH,    OptionFormat::STRING,   true,   0,  255 },
+    { URI_PATH,         OptionFormat::STRING,   true,   0,  255 },
+    { CONTENT_FORMAT,   OptionFormat::UINT,     false,  0,  2 },
+    { MAX_AGE,          OptionFormat::UINT,     false,  0,  4 },
+    { URI_QUERY,        OptionFormat::STRING,   true,   0,  255 },
+    { ACCEPT,           OptionFormat::UINT,     false,  0,  2 },
+    { LOCATION_QUERY,   OptionFormat::STRING,   true,   0,  255 },
+    { BLOCK_2,          OptionFormat::UINT,     false,  0,  3 },
+    { BLOCK_1,          OptionFormat::UINT,     false,  0,  3 },
+    { SIZE_2,           OptionFormat::UINT,     false,  0,  4 },
+    { PROXY_URI,        OptionFormat::STRING,   false,  1,  1034 },
+    { PROXY_SCHEME,     OptionFormat::STRING,   false,  1,  255 },
+    { SIZE_1,           OptionFormat::UINT,     false,  0,  4 },
+};
+
+constexpr std::size_t OPTION_PROPERTIES_COUNT = sizeof(OPTION_PROPERTIES) / sizeof(OPTION_PROPERTIES[0]);
+
+// Odd option numbers are critical (RFC7252 5.4.6)
+constexpr bool is_critical_option(std::uint16_t number)
+{ return (number & 0x1) != 0; }
+
+constexpr bool is_unsafe_option(std::uint16_t number)
+{ return (number & 0x2) != 0; }
+
+constexpr bool is_no_cache_key_option(std::uint16_t number)
+{ return (number & 0x1E) == 0x1C; }
+
+constexpr std::uint64_t registered_options_mask(std::size_t index = 0)
+{
+    return index == OPTION_PROPERTIES_COUNT ? 0
+            : (1ULL << OPTION_PROPERTIES[index].number) | registered_options_mask(index + 1);
+}
+
+// bit N is set if the option N is registered
+constexpr std::uint64_t REGISTERED_OPTIONS = registered_options_mask();
+
+constexpr bool is_option_table_sorted(std::size_t index = 1)
+{
+    return index >= OPTION_PROPERTIES_COUNT
+            || (OPTION_PROPERTIES[index - 1].number < OPTION_PROPERTIES[index].number && is_option_table_sorted(index + 1));
+}
+
+static_assert(is_option_table_sorted(), "The option table must be sorted by the option number");
+
+constexpr bool is_registered_option(std::uint16_t number)
+{ return number < 64 && (REGISTERED_OPTIONS & (1ULL << number)) != 0; }
+
+// The table is sorted, so the position of an option is the quantity of the registered options below it
+constexpr std::size_t option_properties_index(std::uint16_t number)
+{
+    return number < 64 ? static_cast<std::size_t>(__builtin_popcountll(REGISTERED_OPTIONS & ((1ULL << number) - 1)))
+            : OPTION_PROPERTIES_COUNT;
+}
+
+// Runtime lookup in O(1), nullptr for an unregistered option
+inline const OptionProperties * find_option_properties(std::uint16_t number)
+{ return is_registered_option(number) ? &OPTION_PROPERTIES[option_properties_index(number)] : nullptr; }
+
+// Checks a received option, an option that fails it is treated as unrecognized (RFC7252 5.4.1, 5.4.3, 5.4.5)
+inline bool is_option_acceptable(const OptionProperties * properties, std::size_t length, bool repeated)
+{
+    return properties != nullptr
+            && length >= properties->minLength
+            && length <= properties->maxLength
+            && (properties->repeatable || !repeated);
+}
+
+// Compile-time properties of a registered option
+template <std::uint16_t N>
+struct OptionTraits
+{
+    static_assert(is_registered_option(N), "The option is not registered");
+
+    static constexpr OptionFormat   format      = OPTION_PROPERTIES[option_properties_index(N)].format;
+    static constexpr bool           repeatable  = OPTION_PROPERTIES[option_properties_index(N)].repeatable;
+    static constexpr std::uint16_t  minLength   = OPTION_PROPERTIES[option_properties_index(N)].minLength;
+    static constexpr std::uint16_t  maxLength   = OPTION_PROPERTIES[option_properties_index(N)].maxLength;
+    static constexpr bool           critical    = is_critical_option(N);
+
+    // uint options are decoded to an integer, the others are returned as they are
+    using value_type = typename std::conditional<format == OptionFormat::UINT, std::uint32_t, ConstByteSpan>::type;
+};
+
+template <std::uint16_t N> constexpr OptionFormat OptionTraits<N>::format;
+template <std::uint16_t N> constexpr bool OptionTraits<N>::repeatable;
+template <std::uint16_t N> constexpr std::uint16_t OptionTraits<N>::minLength;
+template <std::uint16_t N> constexpr std::uint16_t OptionTraits<N>::maxLength;
+template <std::uint16_t N> constexpr bool OptionTraits<N>::critical;
+
+// uint option value: big endian without leading zeros, up to 4 bytes (RFC7252 3.2)
+inline bool decode_option_value(ConstByteSpan raw, std::uint32_t &value)
+{ return decode_uint(raw.data(), raw.size(), value); }
+
+inline bool decode_option_value(ConstByteSpan raw, ConstByteSpan &value)
+{
+    value = raw;
+    return true;
+}
+
+// Decodes the option value according to the registry, false if its length is out of range
+template <std::uint16_t N>
+bool decode_option(ConstByteSpan raw, typename OptionTraits<N>::value_type &value)
+{
+    if (raw.size() < OptionTraits<N>::minLength || raw.size() > OptionTraits<N>::maxLength)
+        return false;
+    return decode_option_value(raw, value);
+}
+
+} // namespace coap
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef _OPTION_VALUE_H
+#define _OPTION_VALUE_H
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+// Option values up to this length are stored inside the option without any heap allocation
+#ifndef COAP_OPTION_INLINE_LENGTH
+#define COAP_OPTION_INLINE_LENGTH 12
+#endif
+
+namespace coap
+{
+
+const std::size_t OPTION_INLINE_LENGTH = COAP_OPTION_INLINE_LENGTH;
+
+// Storage of an option value.
+// Short values (almost all of them) are kept inline, only long values like Proxy-Uri or Uri-Host
+// spill to the heap. Moving never allocates.
+class OptionValue
+{
+public:
+    using value_type = std::uint8_t;
+    using iterator = std::uint8_t *;
+    using const_iterator = const std::uint8_t *;
+
+    OptionValue()
+        : m_size{0}, m_capacity{OPTION_INLINE_LENGTH}, m_heap{nullptr}
+    {}
+
+    OptionValue(const std::uint8_t * value, std::size_t length)
+        : OptionValue()
+    { assign(value, length); }
+
+    ~OptionValue()
+    { delete [] m_heap; }
+
+    OptionValue(const OptionValue &other)
+        : OptionValue()
+    { assign(other.data(), other.size()); }
+
+    OptionValue(OptionValue &&other) noexcept
+        : OptionValue()
+    { steal(other); }
+
+    OptionValue & operator=(const OptionValue &other)
+    {
+        if (&other != this)
+            assign(other.data(), other.size());
+        return *this;
+    }
+
+    OptionValue & operator=(OptionValue &&other) noexcept
+    {
+        if (&other != this)
+        {
+            delete [] m_heap;
+            m_heap = nullptr;
+            m_capacity = OPTION_INLINE_LENGTH;
+            steal(other);
+        }
+        return *this;
+    }
+
+    std::size_t size() const
+    { return m_size; }
+
+    bool empty() const
+    { return m_size == 0; }
+
+    std::size_t capacity() const
+    { return m_capacity; }
+
+    bool inlined() const
+    { return m_heap == nullptr; }
+
+    std::uint8_t * data()
+    { return m_heap ? m_heap : m_inline; }
+
+    const std::uint8_t * data() const
+    { return m_heap ? m_heap : m_inline; }
+
+    iterator begin()
+    { return data(); }
+
+    iterator end()
+    { return data() + m_size; }
+
+    const_iterator begin() const
+    { return data(); }
+
+    const_iterator end() const
+    { return data() + m_size; }
+
+    std::uint8_t & operator[](std::size_t index)
+    { return data()[index]; }
+
+    const std::uint8_t & operator[](std::size_t index) const
+    { return data()[index]; }
+
+    void reserve(std::size_t capacity)
+    {
+        if (capacity <= m_capacity)
+            return;
+        std::uint8_t * heap = new std::uint8_t [capacity];
+        if (m_size)
+            memcpy(heap, data(), m_size);
+        delete [] m_heap;
+        m_heap = heap;
+        m_capacity = capacity;
+    }
+
+    void resize(std::size_t size)
+    {
+        reserve(size);
+        m_size = size;
+    }
+
+    void push_back(std::uint8_t value)
+    {
+        if (m_size == m_capacity)
+            reserve(m_capacity * 2);
+        data()[m_size++] = value;
+    }
+
+    void assign(const std::uint8_t * value, std::size_t length)
+    {
+        resize(length);
+        if (length)
+            memmove(data(), value, length);
+    }
+
+    void assign(const std::uint8_t * first, const std::uint8_t * last)
+    { assign(first, static_cast<std::size_t>(last - first)); }
+
+    // keeps the heap storage, if any, to be reused
+    void clear()
+    { m_size = 0; }
+
+    bool operator==(const OptionValue &other) const
+    { return m_size == other.m_size && (!m_size || memcmp(data(), other.data(), m_size) == 0); }
+
+    bool operator!=(const OptionValue &other) const
+    { return !(*this == other); }
+
+private:
+    void steal(OptionValue &other)
+    {
+        m_size = other.m_size;
+        if (other.m_heap)
+        {
+            m_heap = other.m_heap;
+            m_capacity = other.m_capacity;
+            other.m_heap = nullptr;
+            other.m_capacity = OPTION_INLINE_LENGTH;
+        }
+        else if (m_size)
+        {
+            memcpy(m_inline, other.m_inline, m_size);
+        }
+        other.m_size = 0;
+    }
+
+private:
+    std::size_t     m_size;                           // value length
+    std::size_t     m_capacity;                       // available storage
+    std::uint8_t    *m_heap;                          // heap storage for long values, nullptr if inline
+    std::uint8_t    m_inline[OPTION_INLINE_LENGTH];   // inline storage for short values
+};
+
+} // namespace coap
+
+#endif
@@ -7,6 +7,10 @@
 #include <array>
 #include "consts.h"
 #include "error.h"
+#include "option_value.h"
+#include "span.h"
+#include "option_registry.h"
+#include "buffer.h"
 #include "core_link.h"
 #include "senml_json.h"
 
@@ -33,6 +37,11 @@ struct Option
     ~Option()
     {}
 
+    Option(const Option &) = default;
+    Option(Option &&) = default;
+    Option & operator=(const Option &) = default;
+    Option & operator=(Option &&) = default;
+
     std::uint8_t length() const
     { return m_header.asBitField.length; }
 
@@ -51,10 +60,10 @@ struct Option
     void number(std::uint16_t value)
     { m_number = value; }
 
-    const std::vector<std::uint8_t> &value() const
-    { return static_cast<const std::vector<std::uint8_t> &>(m_value); }
+    const OptionValue &value() const
+    { return static_cast<const OptionValue &>(m_value); }
 
-    std::vector<std::uint8_t> &value()
+    OptionValue &value()
     { return m_value; }
 
     void clear()
@@ -72,10 +81,118 @@ struct Option
 private:
     Header                      m_header;
     std::uint16_t               m_number;
-    std::vector<std::uint8_t>   m_value;
+    OptionValue                 m_value;
 };
 
-using OptionList = std::vector<Option>;
+// Options ordered by their numbers.
+// Repeatable options keep the order they were inserted in.
+// Presence of the options with numbers below OPTION_BITMAP_SIZE is tracked by a bitmap,
+// so contains() is O(1) for them and lookups of absent options do not touch the list.
+// Like in std::set the options in the list are constant, an option is changed by erasing
+// and inserting it again, so the cached encoded size is always up to date.
+class OptionList
+{
+public:
+    using container_type = std::vector<Option>;
+    using value_type = Option;
+    using iterator = container_type::const_iterator;
+    using const_iterator = container_type::const_iterator;
+    using range = std::pair<iterator, iterator>;
+    using const_range = std::pair<const_iterator, const_iterator>;
+
+    static const std::uint16_t OPTION_BITMAP_SIZE = 64;
+
+    OptionList()
+        : m_options{}, m_present{0}, m_encodedSize{0}, m_encodedSizeValid{true}
+    {}
+
+    iterator insert(const Option &opt)
+    { return insert(Option(opt)); }
+
+    iterator insert(Option &&opt);
+
+    void push_back(const Option &opt)
+    { insert(opt); }
+
+    void push_back(Option &&opt)
+    { insert(std::move(opt)); }
+
+    bool contains(std::uint16_t number) const;
+
+    const_range equal_range(std::uint16_t number) const;
+
+    const_iterator find(std::uint16_t number) const
+    {
+        const_range r = equal_range(number);
+        return r.first == r.second ? end() : r.first;
+    }
+
+    std::size_t count(std::uint16_t number) const
+    {
+        const_range r = equal_range(number);
+        return static_cast<std::size_t>(r.second - r.first);
+    }
+
+    iterator erase(const_iterator pos)
+    { return erase(pos, pos + 1); }
+
+    iterator erase(const_iterator first, const_iterator last);
+
+    std::size_t erase(std::uint16_t number);
+
+    void clear()
+    {
+        m_options.clear();
+        m_present = 0;
+        m_encodedSize = 0;
+        m_encodedSizeValid = true;
+    }
+
+    void reserve(std::size_t capacity)
+    { m_options.reserve(capacity); }
+
+    std::size_t capacity() const
+    { return m_options.capacity(); }
+
+    std::size_t size() const
+    { return m_options.size(); }
+
+    bool empty() const
+    { return m_options.empty(); }
+
+    const_iterator begin() const
+    { return m_options.begin(); }
+
+    const_iterator end() const
+    { return m_options.end(); }
+
+    const Option & operator[](std::size_t index) const
+    { return m_options[index]; }
+
+    const Option & front() const
+    { return m_options.front(); }
+
+    const Option & back() const
+    { return m_options.back(); }
+
+    // size of all the options in the wire format, cached until the list is changed
+    std::size_t encoded_size() const;
+
+private:
+    static bool in_bitmap(std::uint16_t number)
+    { return number < OPTION_BITMAP_SIZE; }
+
+    static std::uint64_t bit(std::uint16_t number)
+    { return static_cast<std::uint64_t>(1) << number; }
+
+    void rebuild_bitmap();
+
+private:
+    container_type          m_options;          // options sorted by number
+    std::uint64_t           m_present;          // bit N is set if there is an option with number N
+    mutable std::size_t     m_encodedSize;      // cached encoded size of the options
+    mutable bool            m_encodedSizeValid; // the cached size is up to date
+};
 
 using PayloadType = std::vector<std::uint8_t>;
 
@@ -176,10 +293,34 @@ struct Message
     const PayloadType &payload() const
     { return static_cast<const PayloadType &>(m_payload); }
 
-    void sort_options()
-    { std::sort(m_options.begin(), m_options.end()); }
+    bool has_option(std::uint16_t number) const
+    { return m_options.contains(number); }
+
+    OptionList::const_range find_options(std::uint16_t number) const
+    { return m_options.equal_range(number); }
+
+    // Decodes the first option N without any copy, false if there is no such option
+    // or its length is out of the registered range. For example:
+    //   std::uint32_t format;
+    //   if (packet.get<CONTENT_FORMAT>(format)) ...
+    template <std::uint16_t N>
+    bool get(typename OptionTraits<N>::value_type &value) const
+    {
+        OptionList::const_iterator it = m_options.find(N);
+        if (it == m_options.end())
+            return false;
+        return decode_option<N>(ConstByteSpan(it->value().data(), it->value().size()), value);
+    }
+
+    // secure takes the token from the CSPRNG, otherwise the per-thread fast generator is used
+    bool generate_token(const std::size_t len = TOKEN_MAX_LENGTH, bool secure = false);
+
+    // Makes the message empty like a new one but keeps the storage of the options and the payload
+    void reset();
 
-    bool generate_token(const std::size_t len = TOKEN_MAX_LENGTH);
+    // size of all the options in the wire format
+    std::size_t options_encoded_size() const
+    { return m_options.encoded_size(); }
 
 private:
     Header          m_header;
@@ -191,13 +332,13 @@ private:
     PayloadType     m_payload;
 };
 
+// The codec does not depend on it (see byte_order.h), it is kept for the applications
 bool is_little_endian_byte_order();
 
 class Packet : public Message
 {
 public:
     Packet()
-        : m_littleEndian{is_little_endian_byte_order()}
     {}
     ~Packet()
     {}
@@ -207,14 +348,6 @@ public:
     Packet & operator=(const Packet &) = delete;
     Packet & operator=(Packet &&) = delete;
 
-private:
-    void parse_header(const void * buffer, std::size_t size, std::error_code &ec);
-    void parse_token(const void * buffer, std::size_t size, std::error_code &ec);
-    void parse_options(const void * buffer, std::size_t size, std::error_code &ec);
-    void parse_payload(const void * buffer, std::size_t size, std::error_code &ec);
-
-    std::size_t get_option_nibble(std::size_t value);
-
 public:
     void add_option(
             OptionNumber number,    // option number
@@ -223,10 +356,11 @@ public:
             std::error_code &ec
         );
 
+    // Prefer has_option() and find_options(), they neither copy nor allocate
     std::size_t
         find_option(
             const std::uint16_t number,
-            std::vector<Option *> &rOptions
+            std::vector<const Option *> &rOptions
         );
 
     void parse(
@@ -235,12 +369,37 @@ public:
             std::error_code &ec
         );
 
+    // exact size of the serialized message
+    std::size_t encoded_size() const;
+
+    // size of the serialized message without the payload (the marker is included)
+    std::size_t header_encoded_size() const;
+
+    // writes the header, the token, the options and the payload marker but not the payload,
+    // so the payload can be sent from its own storage by a gathering write, see send_packet()
+    std::size_t serialize_header(
+            ByteSpan buffer,
+            std::error_code &ec
+        ) const;
+
+    // writes the message in one pass, returns the serialized size
+    std::size_t serialize(
+            ByteSpan buffer,
+            std::error_code &ec
+        ) const;
+
+    // appends the message to the buffer starting from its offset and advances the offset
+    void serialize(
+            Buffer &buffer,
+            std::error_code &ec
+        ) const;
+
     void serialize(
             std::error_code &ec,
             void * buffer,
             std::size_t &size,
             bool checkBufferSizeOnly = false
-        );
+        ) const;
 
     void make_request(
             std::error_code &ec,
@@ -260,14 +419,9 @@ public:
             const void * payload,
             std::size_t payloadSize
         );
-
-    bool little_endian() const
-    { return m_littleEndian; }
-
-private:
-    const bool  m_littleEndian;
 };
 
+// Random message ID, thread-safe. Prefer MessageIdGenerator (random.h) to number the messages to one peer
 std::uint16_t generate_identity();
 
 struct DataType
@@ -0,0 +1,117 @@
+#ifndef _PACKET_POOL_H
+#define _PACKET_POOL_H
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include "packet.h"
+
+namespace coap
+{
+
+// Fixed set of packets allocated once and reused.
+// acquire() and the release of a handle are lock-free, so any thread may take and return packets.
+// A returned packet is reset but keeps the storage of its options and payload,
+// the next user fills it without touching the allocator.
+class PacketPool
+{
+public:
+    // Owns one packet of the pool and returns it back on destruction
+    class Handle
+    {
+    public:
+        Handle()
+            : m_pool{nullptr}, m_index{0}
+        {}
+
+        ~Handle()
+        { release(); }
+
+        Handle(const Handle &) = delete;
+        Handle & operator=(const Handle &) = delete;
+
+        Handle(Handle &&other) noexcept
+            : m_pool{other.m_pool}, m_index{other.m_index}
+        { other.m_pool = nullptr; }
+
+        Handle & operator=(Handle &&other) noexcept
+        {
+            if (&other != this)
+            {
+                release();
+                m_pool = other.m_pool;
+                m_index = other.m_index;
+                other.m_pool = nullptr;
+            }
+            return *this;
+        }
+
+        explicit operator bool() const
+        { return m_pool != nullptr; }
+
+        Packet * get() const
+        { return m_pool ? m_pool->packet(m_index) : nullptr; }
+
+        Packet & operator*() const
+        { return *get(); }
+
+        Packet * operator->() const
+        { return get(); }
+
+        // returns the packet to the pool before the handle is destroyed
+        void release()
+        {
+            if (m_pool)
+            {
+                m_pool->release(m_index);
+                m_pool = nullptr;
+            }
+        }
+
+    private:
+        friend class PacketPool;
+
+        Handle(PacketPool * pool, std::uint32_t index)
+            : m_pool{pool}, m_index{index}
+        {}
+
+    private:
+        PacketPool      *m_pool;    // owner of the packet, nullptr if the handle is empty
+        std::uint32_t   m_index;    // index of the packet in the pool
+    };
+
+public:
+    // options and payloadSize are the storage reserved in every packet beforehand
+    PacketPool(std::size_t capacity, std::size_t options = 0, std::size_t payloadSize = 0);
+    ~PacketPool() = default;
+
+    PacketPool(const PacketPool &) = delete;
+    PacketPool & operator=(const PacketPool &) = delete;
+
+public:
+    // returns an empty handle if all the packets are in use
+    Handle acquire();
+
+    std::size_t capacity() const
+    { return m_capacity; }
+
+    std::size_t available() const
+    { return m_available.load(std::memory_order_relaxed); }
+
+private:
+    Packet * packet(std::uint32_t index) const
+    { return &m_packets[index]; }
+
+    void release(std::uint32_t index);
+
+private:
+    std::size_t                                 m_capacity;
+    std::unique_ptr<Packet[]>                   m_packets;      // the packets themselves
+    std::unique_ptr<std::atomic<std::uint16_t>[]> m_next;       // free list links
+    std::atomic<std::uint32_t>                  m_head;         // free list head: version << 16 | index
+    std::atomic<std::size_t>                    m_available;    // quantity of the free packets
+};
+
+} // namespace coap
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef _PACKET_VIEW_H
+#define _PACKET_VIEW_H
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include "consts.h"
+#include "error.h"
+#include "span.h"
+#include "option_registry.h"
+#include "byte_order.h"
+
+namespace coap
+{
+
+// Option as it is found in the received datagram, the value points into the datagram
+class OptionView
+{
+public:
+    OptionView()
+        : m_header{0}, m_number{0}, m_value{}
+    {}
+
+    OptionView(std::uint8_t header, std::uint16_t number, const std::uint8_t * value, std::size_t length)
+        : m_header{header}, m_number{number}, m_value{value, length}
+    {}
+
+    std::uint8_t header_as_byte() const
+    { return m_header; }
+
+    std::uint16_t number() const
+    { return m_number; }
+
+    ConstByteSpan value() const
+    { return m_value; }
+
+    std::size_t length() const
+    { return m_value.size(); }
+
+private:
+    std::uint8_t    m_header;
+    std::uint16_t   m_number;
+    ConstByteSpan   m_value;
+};
+
+// Non-owning view of a CoAP message.
+// parse() validates the header, the token and all the options in one pass over the caller's buffer
+// and allocates nothing, so the buffer must outlive the view.
+// Use Packet if the message has to be changed.
+class PacketView
+{
+public:
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = OptionView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const OptionView *;
+        using reference = const OptionView &;
+
+        const_iterator()
+            : m_buffer{nullptr}, m_offset{0}, m_end{0}, m_number{0}, m_current{}
+        {}
+
+        const_iterator(const std::uint8_t * buffer, std::size_t offset, std::size_t end)
+            : m_buffer{buffer}, m_offset{offset}, m_end{end}, m_number{0}, m_current{}
+        { decode(); }
+
+        reference operator*() const
+        { return m_current; }
+
+        pointer operator->() const
+        { return &m_current; }
+
+        const_iterator & operator++()
+        {
+            decode();
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator tmp = *this;
+            decode();
+            return tmp;
+        }
+
+        bool operator==(const const_iterator &other) const
+        { return m_buffer == other.m_buffer && m_offset == other.m_offset; }
+
+        bool operator!=(const const_iterator &other) const
+        { return !(*this == other); }
+
+    private:
+        void decode();
+
+    private:
+        const std::uint8_t  *m_buffer;  // points to the beginning of the message
+        std::size_t         m_offset;   // offset of the next option to decode
+        std::size_t         m_end;      // offset where the options end
+        std::uint16_t       m_number;   // number of the last decoded option
+        OptionView          m_current;  // last decoded option
+    };
+
+public:
+    PacketView()
+        : m_data{nullptr},
+          m_size{0},
+          m_optionsOffset{0},
+          m_optionsEnd{0},
+          m_optionsCount{0},
+          m_payloadOffset{0}
+    {}
+
+    PacketView(const void * buffer, std::size_t size, std::error_code &ec)
+        : PacketView()
+    { parse(buffer, size, ec); }
+
+    ~PacketView() = default;
+
+public:
+    void parse(
+            const void * buffer,
+            std::size_t size,
+            std::error_code &ec
+        );
+
+    bool valid() const
+    { return m_data != nullptr; }
+
+    const std::uint8_t * data() const
+    { return m_data; }
+
+    std::size_t size() const
+    { return m_size; }
+
+    std::uint8_t header_as_byte() const
+    { return m_data[HEADER_OFFSET]; }
+
+    std::uint8_t version() const
+    { return m_data[HEADER_OFFSET] >> 6; }
+
+    std::uint8_t type() const
+    { return (m_data[HEADER_OFFSET] >> 4) & 0x3; }
+
+    std::size_t token_length() const
+    { return m_data[HEADER_OFFSET] & 0xF; }
+
+    std::uint8_t code_as_byte() const
+    { return m_data[CODE_OFFSET]; }
+
+    std::uint8_t code_class() const
+    { return m_data[CODE_OFFSET] >> 5; }
+
+    std::uint8_t code_detail() const
+    { return m_data[CODE_OFFSET] & 0x1F; }
+
+    std::uint16_t identity() const
+    { return load_be16(&m_data[MESSAGE_ID_OFFSET]); }
+
+    ConstByteSpan token() const
+    { return ConstByteSpan(m_data + TOKEN_OFFSET, token_length()); }
+
+    const_iterator begin() const
+    { return const_iterator(m_data, m_optionsOffset, m_optionsEnd); }
+
+    const_iterator end() const
+    { return const_iterator(m_data, m_optionsEnd + 1, m_optionsEnd); }
+
+    std::size_t options_count() const
+    { return m_optionsCount; }
+
+    std::size_t payload_offset() const
+    { return m_payloadOffset; }
+
+    // Decodes the first option N, false if there is no such option
+    template <std::uint16_t N>
+    bool get(typename OptionTraits<N>::value_type &value) const
+    {
+        for (const OptionView &opt : *this)
+        {
+            if (opt.number() == N)
+                return decode_option<N>(opt.value(), value);
+            if (opt.number() > N)
+                break;
+        }
+        return false;
+    }
+
+    ConstByteSpan payload() const
+    { return ConstByteSpan(m_data + m_payloadOffset, m_size - m_payloadOffset); }
+
+private:
+    const std::uint8_t  *m_data;            // the parsed message, nullptr until parse() succeeds
+    std::size_t         m_size;             // size of the parsed message
+    std::size_t         m_optionsOffset;    // offset of the first option
+    std::size_t         m_optionsEnd;       // offset of the payload marker or the end of the message
+    std::size_t         m_optionsCount;     // quantity of the options
+    std::size_t         m_payloadOffset;    // offset of the payload, equals to size if there is no payload
+};
+
+// Decodes the option header placed at the offset.
+// On success the offset points to the option value.
+CoapStatus decode_option_header(
+        const std::uint8_t * buffer,
+        std::size_t size,
+        std::size_t &offset,
+        std::uint16_t &delta,
+        std::uint16_t &length
+    );
+
+} // namespace coap
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef _PEER_KEY_H
+#define _PEER_KEY_H
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "socket.h"
+
+// Identity of a remote endpoint: the address family, the address and the port.
+// Two peers behind one NAT address differ by their ports, so all three take part in the comparison
+class PeerKey
+{
+public:
+    static const std::size_t ADDRESS_SIZE_MAX = 16;
+
+    PeerKey()
+        : m_address{},
+          m_port{0},
+          m_family{SOCKET_TYPE_UNSPEC}
+    {}
+
+    // length is 4 for IPv4 and 16 for IPv6, the port is in the host byte order
+    PeerKey(SocketType family, const void *address, std::size_t length, std::uint16_t port)
+        : m_address{},
+          m_port{port},
+          m_family{family}
+    { std::memcpy(m_address, address, length < ADDRESS_SIZE_MAX ? length : ADDRESS_SIZE_MAX); }
+
+    bool operator==(const PeerKey &other) const
+    {
+        return m_family == other.m_family
+                && m_port == other.m_port
+                && std::memcmp(m_address, other.m_address, ADDRESS_SIZE_MAX) == 0;
+    }
+
+    bool operator!=(const PeerKey &other) const
+    { return !(*this == other); }
+
+    // The seed makes the hash unpredictable for a remote side choosing its addresses
+    std::uint64_t hash(std::uint64_t seed = 0) const
+    {
+        std::uint64_t high;
+        std::uint64_t low;
+        std::memcpy(&high, m_address, sizeof(high));
+        std::memcpy(&low, m_address + sizeof(high), sizeof(low));
+
+        std::uint64_t h = seed ^ (static_cast<std::uint64_t>(m_port) << 8) ^ static_cast<std::uint64_t>(m_family);
+        h = mix(h ^ high);
+        h = mix(h ^ low);
+        return h;
+    }
+
+    SocketType family() const
+    { return m_family; }
+
+    std::uint16_t port() const
+    { return m_port; }
+
+    const std::uint8_t * address() const
+    { return m_address; }
+
+private:
+    // the finalizer of MurmurHash3, every input bit changes about a half of the output ones
+    static std::uint64_t mix(std::uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+private:
+    std::uint8_t    m_address[ADDRESS_SIZE_MAX];
+    std::uint16_t   m_port;
+    SocketType      m_family;
+};
+
+struct PeerKeyHash
+{
+    std::size_t operator()(const PeerKey &key) const
+    { return static_cast<std::size_t>(key.hash()); }
+};
+
+#endif
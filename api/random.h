@@ -0,0 +1,60 @@
+#ifndef _COAP_RANDOM_H
+#define _COAP_RANDOM_H
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include "error.h"
+
+namespace coap
+{
+
+// Fast non-cryptographic generator (splitmix64). Every thread has its own state seeded once,
+// so the calls neither lock nor share a cache line. Good for message IDs and tokens
+// which only have to be unpredictable enough to avoid collisions.
+std::uint64_t fast_random();
+
+void fast_random_bytes(void * buffer, std::size_t length);
+
+// Cryptographically secure bytes from the operating system (getrandom(2) or std::random_device).
+// Use it for the tokens that protect against off-path spoofing (RFC7252 5.3.1).
+void secure_random_bytes(void * buffer, std::size_t length, std::error_code &ec);
+
+// Sequential message ID allocator, one per peer (RFC7252 4.4).
+// It starts from a random value and wraps around, next() may be called from any thread.
+class MessageIdGenerator
+{
+public:
+    MessageIdGenerator()
+        : m_next{static_cast<std::uint16_t>(fast_random())}
+    {}
+
+    explicit MessageIdGenerator(std::uint16_t initial)
+        : m_next{initial}
+    {}
+
+    MessageIdGenerator(const MessageIdGenerator &other)
+        : m_next{other.peek()}
+    {}
+
+    MessageIdGenerator & operator=(const MessageIdGenerator &other)
+    {
+        m_next.store(other.peek(), std::memory_order_relaxed);
+        return *this;
+    }
+
+    ~MessageIdGenerator() = default;
+
+    std::uint16_t next()
+    { return m_next.fetch_add(1, std::memory_order_relaxed); }
+
+    // the ID that next() is going to return
+    std::uint16_t peek() const
+    { return m_next.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::uint16_t> m_next;
+};
+
+} // namespace coap
+
+#endif
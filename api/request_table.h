@@ -0,0 +1,166 @@
+#ifndef _REQUEST_TABLE_H
+#define _REQUEST_TABLE_H
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include "buffer_pool.h"
+#include "consts.h"
+#include "packet.h"
+#include "packet_view.h"
+#include "timer_wheel.h"
+
+namespace coap
+{
+
+// Client side requests in flight to one server, matched with their responses by the token (RFC7252 5.3.2).
+// At most nstart of them are outstanding at a time (NSTART, RFC7252 4.7), the following ones wait
+// in the order of their submission and are sent as the outstanding ones end.
+// A request is over with its response, at the end of its lifetime or by a failure of its transmission.
+// The requests are preallocated and found through a hash of the token, so the matching costs O(1)
+// however many requests are in flight. Like the timer wheel, the table is not thread-safe
+class RequestTable
+{
+public:
+    // the token is put into the message already, the sender transmits it (through a Retransmitter for a CON)
+    typedef std::function<void(const TokenType &token, BufferPool::Handle message)> Sender;
+    // response is nullptr if ec is set: COAP_ERR_TIMEOUT at the end of the lifetime,
+    // ECANCELED if the table is destroyed, or the error given to fail()
+    typedef std::function<void(const std::error_code &ec, const PacketView *response)> ResponseHandler;
+
+    struct Statistics
+    {
+        std::uint64_t submitted;
+        std::uint64_t completed;    // responses matched
+        std::uint64_t failed;       // timed out and failed requests
+        std::uint64_t unmatched;    // responses of unknown tokens
+        std::uint64_t waited;       // requests which have waited for NSTART
+    };
+
+public:
+    // capacity is the maximal quantity of the requests, outstanding and waiting;
+    // lifetime is counted from the transmission of a request to its response
+    RequestTable(
+            TimerWheel &wheel,
+            std::size_t capacity,
+            Sender sender,
+            std::size_t nstart = NSTART,
+            TimerWheel::Clock::duration lifetime = std::chrono::milliseconds(EXCHANGE_LIFETIME)
+        );
+    // the requests left get ECANCELED
+    ~RequestTable();
+
+    RequestTable(const RequestTable &) = delete;
+    RequestTable & operator=(const RequestTable &) = delete;
+
+public:
+    // A random token which no request in flight has
+    TokenType make_token() const;
+
+    // Sends the serialized request at once or after the outstanding ones.
+    // ec is EEXIST if the token is in use and ENOBUFS if the table is full
+    void submit(const TokenType &token, BufferPool::Handle message, ResponseHandler handler, std::error_code &ec);
+
+    // Passes the response to the handler of its request, returns false if no request has its token.
+    // A separate response with the same token may follow an empty ACK, so the caller acknowledges the CON
+    // whatever the result
+    bool complete(const PacketView &response);
+
+    // The request is no longer outstanding, as its empty ACK has come, but the response is still expected;
+    // a waiting request may go. Returns false if the request is unknown or released already
+    bool release(const TokenType &token);
+
+    // Ends the request with the error, as the retransmitter has given it up; returns false if it is unknown
+    bool fail(const TokenType &token, const std::error_code &ec);
+
+    // Forgets the request without calling its handler, returns false if it is unknown
+    bool cancel(const TokenType &token);
+
+    std::size_t size() const
+    { return m_index.size(); }
+
+    // the requests sent and not released
+    std::size_t outstanding() const
+    { return m_outstanding; }
+
+    // the requests waiting for NSTART
+    std::size_t waiting() const
+    { return m_waiting; }
+
+    std::size_t capacity() const
+    { return m_capacity; }
+
+    std::size_t nstart() const
+    { return m_nstart; }
+
+    const Statistics & statistics() const
+    { return static_cast<const Statistics &>(m_statistics); }
+
+private:
+    static const std::uint32_t NO_REQUEST = UINT32_MAX;
+
+    enum State
+    {
+        FREE,
+        WAITING,        // in the queue
+        OUTSTANDING,    // sent, counted against nstart
+        RELEASED        // sent and acknowledged, waiting for the separate response
+    };
+
+    struct Request
+    {
+        Request()
+            : timer{},
+              token{},
+              message{},
+              handler{},
+              prev{NO_REQUEST},
+              next{NO_REQUEST},
+              state{FREE}
+        {}
+
+        TimerWheel::Timer   timer;
+        TokenType           token;
+        BufferPool::Handle  message;    // kept until it is sent
+        ResponseHandler     handler;
+        std::uint32_t       prev;       // the waiting queue
+        std::uint32_t       next;
+        State               state;
+    };
+
+    static std::uint64_t key(const TokenType &token);
+
+    void send(std::uint32_t slot);
+    // frees the slot and lets the waiting requests go, returns the handler of the request
+    ResponseHandler remove(std::uint32_t slot);
+    void dequeue(std::uint32_t slot);
+    void start_waiting();
+    void expire(std::uint32_t slot);
+
+private:
+    typedef std::unordered_map<std::uint64_t, std::uint32_t> Index;
+
+    TimerWheel                      &m_wheel;
+    const std::size_t               m_capacity;
+    Sender                          m_sender;
+    const std::size_t               m_nstart;
+    const TimerWheel::Clock::duration
+                                    m_lifetime;
+    std::unique_ptr<Request[]>      m_requests;
+    std::vector<std::uint32_t>      m_free;
+    Index                           m_index;        // token to the slot
+    std::uint32_t                   m_head;         // the first waiting request
+    std::uint32_t                   m_tail;
+    std::size_t                     m_outstanding;
+    std::size_t                     m_waiting;
+    bool                            m_starting;     // start_waiting() is running
+    Statistics                      m_statistics;
+};
+
+} // namespace coap
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef _RETRANSMITTER_H
+#define _RETRANSMITTER_H
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include "buffer_pool.h"
+#include "peer_key.h"
+#include "timer_wheel.h"
+
+namespace coap
+{
+
+// Reliable transmission of the confirmable messages (RFC7252 4.2).
+// A CON is sent again after a random timeout between ACK_TIMEOUT and ACK_TIMEOUT * ACK_RANDOM_FACTOR,
+// the timeout doubles at every retransmission, after MAX_RETRANSMIT of them the exchange times out.
+// The exchanges are preallocated and time out on the shared timer wheel, so a send, an acknowledgement
+// and a cancel cost O(1) whatever the quantity of the outstanding messages.
+// Like the wheel, the retransmitter is used in one thread, the one which advances the wheel
+class Retransmitter
+{
+public:
+    enum Outcome
+    {
+        ACKNOWLEDGED,   // an ACK or a piggybacked response has come
+        REJECTED,       // the peer has answered with a RST
+        TIMED_OUT       // MAX_RETRANSMIT retransmissions have gone unanswered
+    };
+
+    // writes the message to the peer, called for the first transmission and every retransmission
+    typedef std::function<void(const PeerKey &peer, const std::uint8_t *data, std::size_t length)> Sender;
+    // called once when the exchange is over, it may send new messages
+    typedef std::function<void(Outcome outcome)> Completion;
+
+    struct Statistics
+    {
+        std::uint64_t transmitted;      // first transmissions
+        std::uint64_t retransmitted;
+        std::uint64_t acknowledged;
+        std::uint64_t rejected;
+        std::uint64_t timedOut;
+    };
+
+public:
+    // capacity is the maximal quantity of the outstanding messages
+    Retransmitter(TimerWheel &wheel, std::size_t capacity, Sender sender);
+    // the outstanding exchanges are dropped without their completions
+    ~Retransmitter() = default;
+
+    Retransmitter(const Retransmitter &) = delete;
+    Retransmitter & operator=(const Retransmitter &) = delete;
+
+public:
+    // Transmits the serialized CON, the first offset() bytes of the buffer, and keeps it until the exchange is over.
+    // The message ID is read from the message, ec is EEXIST if the peer has an outstanding one with the same ID,
+    // ENOBUFS if the retransmitter is full and EINVAL if the message is not a confirmable one
+    void send(const PeerKey &peer, BufferPool::Handle message, Completion completion, std::error_code &ec);
+
+    // An ACK from the peer, returns false if no exchange waits for it
+    bool acknowledge(const PeerKey &peer, std::uint16_t messageId)
+    { return complete(peer, messageId, ACKNOWLEDGED); }
+
+    // A RST from the peer, returns false if no exchange waits for it
+    bool reject(const PeerKey &peer, std::uint16_t messageId)
+    { return complete(peer, messageId, REJECTED); }
+
+    // Stops the retransmissions without calling the completion, returns false if there is no such exchange
+    bool cancel(const PeerKey &peer, std::uint16_t messageId);
+
+    bool outstanding(const PeerKey &peer, std::uint16_t messageId) const;
+
+    std::size_t size() const
+    { return m_index.size(); }
+
+    std::size_t capacity() const
+    { return m_capacity; }
+
+    const Statistics & statistics() const
+    { return static_cast<const Statistics &>(m_statistics); }
+
+    // random timeout before the first retransmission
+    static std::chrono::milliseconds initial_timeout();
+
+private:
+    struct Exchange
+    {
+        Exchange()
+            : timer{},
+              peer{},
+              message{},
+              completion{},
+              timeout{0},
+              messageId{0},
+              retransmissions{0}
+        {}
+
+        TimerWheel::Timer   timer;
+        PeerKey             peer;
+        BufferPool::Handle  message;
+        Completion          completion;
+        std::uint32_t       timeout;            // milliseconds before the next retransmission
+        std::uint16_t       messageId;
+        std::uint8_t        retransmissions;
+    };
+
+    struct Key
+    {
+        PeerKey         peer;
+        std::uint16_t   messageId;
+
+        bool operator==(const Key &other) const
+        { return messageId == other.messageId && peer == other.peer; }
+    };
+
+    struct KeyHash
+    {
+        std::uint64_t seed;
+
+        std::size_t operator()(const Key &key) const
+        { return static_cast<std::size_t>(key.peer.hash(seed ^ (key.messageId * 0x9E3779B97F4A7C15ULL))); }
+    };
+
+    typedef std::unordered_map<Key, std::uint32_t, KeyHash> Index;
+
+    bool complete(const PeerKey &peer, std::uint16_t messageId, Outcome outcome);
+    void finish(std::uint32_t slot, Outcome outcome);
+    void expire(std::uint32_t slot);
+    void transmit(Exchange &exchange);
+
+private:
+    TimerWheel                      &m_wheel;
+    const std::size_t               m_capacity;
+    Sender                          m_sender;
+    std::unique_ptr<Exchange[]>     m_exchanges;
+    std::vector<std::uint32_t>      m_free;         // free exchange slots
+    Index                           m_index;        // (peer, message ID) to the slot
+    Statistics                      m_statistics;
+};
+
+} // namespace coap
+
+#endif
@@ -2,6 +2,7 @@
 #define _SOCKET_H
 #include "error.h"
 #include <cstddef>
+#include <cstdint>
 
 enum SocketType
 {
@@ -35,6 +36,29 @@ protected:
     SocketType m_type;
 };
 
+// One part of a datagram sent by Socket::sendmsg()
+struct IoBuffer
+{
+    const void      *data;
+    std::size_t     length;
+};
+
+// Maximal quantity of the parts of one datagram
+const std::size_t IO_BUFFERS_MAX = 16;
+
+// One datagram of a batch sent or received with a single system call
+struct Datagram
+{
+    void            *data;
+    std::size_t     length;     // size of the buffer on receiving, then the quantity of the received bytes
+    SocketAddress   *address;   // source address on receiving (may be nullptr), destination one on sending
+    std::uint64_t   timestamp;  // kernel receive time in nanoseconds since the epoch if the socket stamps them, zero otherwise
+    bool            truncated;  // set on receiving if the datagram did not fit into the buffer, the data is cut then
+};
+
+// Maximal quantity of the datagrams in one batch
+const std::size_t DATAGRAM_BATCH_MAX = 64;
+
 struct Socket
 {
     virtual ~Socket() = default;
@@ -42,6 +66,8 @@ struct Socket
     virtual void connect(const SocketAddress * addr, std::error_code &ec) = 0;
     virtual ssize_t sendto(const void * buf, std::size_t len, const SocketAddress * addr, std::error_code &ec) = 0;
     virtual ssize_t recvfrom(std::error_code &ec, void * buf, std::size_t len, SocketAddress * addr = nullptr) = 0;
+    // Gathers the buffers into one datagram without copying them
+    virtual ssize_t sendmsg(const IoBuffer * buffers, std::size_t count, const SocketAddress * addr, std::error_code &ec) = 0;
     virtual void bind(const SocketAddress * addr, std::error_code &ec) = 0;
     virtual Socket * accept(std::error_code * ec = nullptr) = 0;
     virtual void listen(std::error_code &ec, int max_connections_in_queue = 1) = 0;
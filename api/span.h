@@ -0,0 +1,68 @@
+#ifndef _SPAN_H
+#define _SPAN_H
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace coap
+{
+
+// Non-owning view of a contiguous sequence of T (a C++11 stand-in for std::span)
+template <typename T>
+class Span
+{
+public:
+    Span()
+        : m_data{nullptr}, m_size{0}
+    {}
+
+    Span(T * data, std::size_t size)
+        : m_data{data}, m_size{size}
+    {}
+
+    template <std::size_t N>
+    Span(T (&array)[N])
+        : m_data{array}, m_size{N}
+    {}
+
+    template <typename U,
+              typename = typename std::enable_if<std::is_convertible<U (*)[], T (*)[]>::value>::type>
+    Span(const Span<U> &other)
+        : m_data{other.data()}, m_size{other.size()}
+    {}
+
+    T * data() const
+    { return m_data; }
+
+    std::size_t size() const
+    { return m_size; }
+
+    bool empty() const
+    { return m_size == 0; }
+
+    T & operator[](std::size_t index) const
+    { return m_data[index]; }
+
+    T * begin() const
+    { return m_data; }
+
+    T * end() const
+    { return m_data + m_size; }
+
+    Span subspan(std::size_t offset, std::size_t count) const
+    { return Span(m_data + offset, count); }
+
+    Span subspan(std::size_t offset) const
+    { return Span(m_data + offset, m_size - offset); }
+
+private:
+    T           *m_data;
+    std::size_t m_size;
+};
+
+using ByteSpan = Span<std::uint8_t>;
+using ConstByteSpan = Span<const std::uint8_t>;
+
+} // namespace coap
+
+#endif
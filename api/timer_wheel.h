@@ -0,0 +1,105 @@
+#ifndef _TIMER_WHEEL_H
+#define _TIMER_WHEEL_H
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+// Hierarchical timing wheel (Varghese and Lauck): arming and cancelling a timer cost O(1)
+// whatever the quantity of the armed timers, so every peer and every exchange may have its own one.
+// The time goes in ticks of a fixed duration, a timer fires at the first advance() past its deadline
+// rounded up to a tick. Four levels of 64 slots cover 2^24 ticks, a longer delay is cut down to that.
+// The wheel is not thread-safe, its timers are armed, cancelled and fired in one thread, such as a reactor one
+class TimerWheel
+{
+    struct Link
+    {
+        Link    *prev;
+        Link    *next;
+    };
+
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static const std::size_t LEVELS = 4;
+    static const std::size_t SLOT_BITS = 6;
+    static const std::size_t SLOTS = 1 << SLOT_BITS;
+
+    // Embedded into the object it times, so arming it does not allocate
+    class Timer : private Link
+    {
+    public:
+        typedef std::function<void()> Handler;
+
+        explicit Timer(Handler handler = Handler())
+            : Link{nullptr, nullptr},
+              m_wheel{nullptr},
+              m_expires{0},
+              m_handler{std::move(handler)}
+        {}
+
+        // cancels the timer
+        ~Timer();
+
+        Timer(const Timer &) = delete;
+        Timer & operator=(const Timer &) = delete;
+
+        void handler(Handler value)
+        { m_handler = std::move(value); }
+
+        bool armed() const
+        { return m_wheel != nullptr; }
+
+    private:
+        friend class TimerWheel;
+
+        TimerWheel      *m_wheel;   // nullptr while the timer is not armed
+        std::uint64_t   m_expires;  // tick
+        Handler         m_handler;
+    };
+
+public:
+    explicit TimerWheel(Clock::duration tick, Clock::time_point start = coarse_now());
+    // disarms the timers left
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel & operator=(const TimerWheel &) = delete;
+
+public:
+    // Arms the timer to fire after the delay, an armed one is moved
+    void schedule(Timer &timer, Clock::duration delay);
+    // Returns false if the timer is not armed
+    bool cancel(Timer &timer);
+    // Fires the timers due by now, returns their quantity.
+    // A handler may arm and cancel any timer but must not destroy its own one
+    std::size_t advance(Clock::time_point now = coarse_now());
+
+    std::size_t size() const
+    { return m_size; }
+
+    Clock::duration tick() const
+    { return m_tick; }
+
+    // Monotonic time of the last scheduler tick (CLOCK_MONOTONIC_COARSE on Linux), cheaper than Clock::now()
+    // and precise enough for the wheel
+    static Clock::time_point coarse_now();
+
+private:
+    void insert(Timer &timer);
+    void cascade(std::size_t level, std::size_t index);
+
+    static void link(Link &head, Link &node);
+    static void unlink(Link &node);
+    // moves the nodes of the list from into the empty list to
+    static void splice(Link &from, Link &to);
+
+private:
+    Clock::duration     m_tick;
+    Clock::time_point   m_start;
+    std::uint64_t       m_next;     // the next tick to process
+    std::size_t         m_size;
+    Link                m_slots[LEVELS][SLOTS];
+};
+
+#endif
@@ -0,0 +1,36 @@
+#include "bench_common.h"
+#include <cstdlib>
+#include <atomic>
+#include <new>
+
+using namespace std;
+
+static atomic<size_t> g_allocationCount{0};
+
+void * operator new(size_t size)
+{
+    g_allocationCount.fetch_add(1, memory_order_relaxed);
+    void * ptr = malloc(size ? size : 1);
+    if (ptr == nullptr)
+        throw bad_alloc();
+    return ptr;
+}
+
+void operator delete(void * ptr) noexcept
+{ free(ptr); }
+
+void operator delete(void * ptr, size_t) noexcept
+{ free(ptr); }
+
+size_t allocation_count()
+{ return g_allocationCount.load(memory_order_relaxed); }
+
+void report_allocations(benchmark::State &state, size_t start)
+{
+    state.counters["allocs/op"] = benchmark::Counter(
+                                    static_cast<double>(allocation_count() - start),
+                                    benchmark::Counter::kAvgIterations
+                                );
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,12 @@
+#ifndef _BENCH_COMMON_H
+#define _BENCH_COMMON_H
+#include <cstddef>
+#include <benchmark/benchmark.h>
+
+// quantity of the heap allocations made by the benchmark executable so far
+std::size_t allocation_count();
+
+// Adds the "allocs/op" counter: allocations made since the start value divided by the iterations
+void report_allocations(benchmark::State &state, std::size_t start);
+
+#endif
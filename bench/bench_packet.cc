@@ -0,0 +1,221 @@
+#include "packet.h"
+#include "packet_view.h"
+#include "blockwise.h"
+#include "byte_order.h"
+#include "bench_common.h"
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+using namespace coap;
+
+// Message shapes seen in real traffic
+enum MessageShape
+{
+    EMPTY_ACK,          // empty acknowledgement, header only
+    GET_URI_PATH,       // GET with 4 Uri-Path segments
+    BLOCK2_RESPONSE,    // 2.05 Content with Block2 and a 1024 byte payload
+    MANY_OPTIONS,       // request with 20 options
+};
+
+static const char * const URI_PATH_SEGMENTS[] = { "sensors", "room-12", "temperature", "current" };
+static uint8_t s_payload[1024];
+
+static void add_string_option(Packet &packet, OptionNumber number, const char * value)
+{
+    error_code ec;
+    packet.add_option(number, value, strlen(value), ec);
+}
+
+static void add_uint_option(Packet &packet, OptionNumber number, uint32_t value)
+{
+    error_code ec;
+    uint8_t buf[sizeof(uint32_t)];
+    packet.add_option(number, buf, encode_uint(value, buf), ec);
+}
+
+static void add_options(Packet &packet, MessageShape shape)
+{
+    switch (shape)
+    {
+        case EMPTY_ACK:
+            break;
+
+        case GET_URI_PATH:
+            for (const char * segment : URI_PATH_SEGMENTS)
+                add_string_option(packet, URI_PATH, segment);
+            break;
+
+        case BLOCK2_RESPONSE:
+            add_uint_option(packet, CONTENT_FORMAT, OCTET_STREAM);
+            add_uint_option(packet, BLOCK_2, (7 << 4) | (1 << 3) | BLOCK_SIZE_1024);
+            add_uint_option(packet, SIZE_2, 65536);
+            break;
+
+        case MANY_OPTIONS:
+            add_string_option(packet, URI_HOST, "coap.example.org");
+            add_uint_option(packet, URI_PORT, 5683);
+            for (const char * segment : URI_PATH_SEGMENTS)
+                add_string_option(packet, URI_PATH, segment);
+            add_string_option(packet, URI_PATH, "history");
+            add_string_option(packet, URI_PATH, "2024");
+            add_string_option(packet, URI_PATH, "06");
+            add_uint_option(packet, CONTENT_FORMAT, COAP_JSON);
+            add_uint_option(packet, MAX_AGE, 60);
+            add_string_option(packet, URI_QUERY, "from=1700000000");
+            add_string_option(packet, URI_QUERY, "to=1700086400");
+            add_string_option(packet, URI_QUERY, "step=60");
+            add_string_option(packet, URI_QUERY, "unit=C");
+            add_string_option(packet, URI_QUERY, "fmt=senml");
+            add_string_option(packet, URI_QUERY, "limit=100");
+            add_uint_option(packet, ACCEPT, SENML_JSON);
+            add_uint_option(packet, BLOCK_2, BLOCK_SIZE_1024);
+            add_uint_option(packet, SIZE_2, 0);
+            break;
+    }
+}
+
+static void build_message(Packet &packet, MessageShape shape)
+{
+    error_code ec;
+
+    add_options(packet, shape);
+
+    switch (shape)
+    {
+        case EMPTY_ACK:
+            packet.prepare_answer(ec, ACKNOWLEDGEMENT, EMPTY, 0x1234, nullptr, 0);
+            break;
+
+        case BLOCK2_RESPONSE:
+            packet.prepare_answer(ec, ACKNOWLEDGEMENT, CONTENT, 0x1234, s_payload, sizeof(s_payload));
+            break;
+
+        case GET_URI_PATH:
+        case MANY_OPTIONS:
+            packet.make_request(ec, CONFIRMABLE, GET, 0x1234, nullptr, 0, 4);
+            break;
+    }
+}
+
+static vector<uint8_t> serialized_message(MessageShape shape)
+{
+    Packet packet;
+    build_message(packet, shape);
+
+    error_code ec;
+    vector<uint8_t> wire(packet.encoded_size());
+    packet.serialize(ByteSpan(wire.data(), wire.size()), ec);
+    return wire;
+}
+
+static void BM_Parse(benchmark::State &state)
+{
+    const vector<uint8_t> wire = serialized_message(static_cast<MessageShape>(state.range(0)));
+    Packet packet;
+    error_code ec;
+
+    packet.parse(wire.data(), wire.size(), ec); // warm up the storage of the packet
+    const size_t start = allocation_count();
+    for (auto _ : state)
+    {
+        packet.parse(wire.data(), wire.size(), ec);
+        benchmark::DoNotOptimize(packet.options().size());
+    }
+    report_allocations(state, start);
+    state.SetBytesProcessed(state.iterations() * wire.size());
+}
+
+static void BM_ParseView(benchmark::State &state)
+{
+    const vector<uint8_t> wire = serialized_message(static_cast<MessageShape>(state.range(0)));
+    error_code ec;
+
+    const size_t start = allocation_count();
+    for (auto _ : state)
+    {
+        PacketView view(wire.data(), wire.size(), ec);
+        benchmark::DoNotOptimize(view.options_count());
+    }
+    report_allocations(state, start);
+    state.SetBytesProcessed(state.iterations() * wire.size());
+}
+
+static void BM_Serialize(benchmark::State &state)
+{
+    Packet packet;
+    build_message(packet, static_cast<MessageShape>(state.range(0)));
+    vector<uint8_t> wire(packet.encoded_size());
+    error_code ec;
+    size_t size = 0;
+
+    const size_t start = allocation_count();
+    for (auto _ : state)
+    {
+        size = packet.serialize(ByteSpan(wire.data(), wire.size()), ec);
+        benchmark::DoNotOptimize(wire.data());
+    }
+    report_allocations(state, start);
+    state.SetBytesProcessed(state.iterations() * size);
+}
+
+static void BM_AddFindOption(benchmark::State &state)
+{
+    const MessageShape shape = static_cast<MessageShape>(state.range(0));
+    Packet packet;
+
+    const size_t start = allocation_count();
+    for (auto _ : state)
+    {
+        packet.reset();
+        add_options(packet, shape);
+        benchmark::DoNotOptimize(packet.find_options(URI_PATH));
+        benchmark::DoNotOptimize(packet.has_option(BLOCK_2));
+    }
+    report_allocations(state, start);
+}
+
+static void BM_MakeRequest(benchmark::State &state)
+{
+    Packet packet;
+    error_code ec;
+    add_options(packet, static_cast<MessageShape>(state.range(0)));
+
+    const size_t start = allocation_count();
+    for (auto _ : state)
+    {
+        packet.make_request(ec, CONFIRMABLE, GET, 0x1234, nullptr, 0, 4);
+        benchmark::DoNotOptimize(packet.token().data());
+    }
+    report_allocations(state, start);
+}
+
+static void BM_PrepareAnswer(benchmark::State &state)
+{
+    const MessageShape shape = static_cast<MessageShape>(state.range(0));
+    const size_t payloadSize = shape == BLOCK2_RESPONSE ? sizeof(s_payload) : 0;
+    Packet packet;
+    error_code ec;
+    add_options(packet, shape);
+
+    const size_t start = allocation_count();
+    for (auto _ : state)
+    {
+        packet.prepare_answer(ec, ACKNOWLEDGEMENT, CONTENT, 0x1234, payloadSize ? s_payload : nullptr, payloadSize);
+        benchmark::DoNotOptimize(packet.payload().data());
+    }
+    report_allocations(state, start);
+    state.SetBytesProcessed(state.iterations() * payloadSize);
+}
+
+#define MESSAGE_SHAPES \
+    ArgName("shape")->Arg(EMPTY_ACK)->Arg(GET_URI_PATH)->Arg(BLOCK2_RESPONSE)->Arg(MANY_OPTIONS)
+
+BENCHMARK(BM_Parse)->MESSAGE_SHAPES;
+BENCHMARK(BM_ParseView)->MESSAGE_SHAPES;
+BENCHMARK(BM_Serialize)->MESSAGE_SHAPES;
+BENCHMARK(BM_AddFindOption)->MESSAGE_SHAPES;
+BENCHMARK(BM_MakeRequest)->MESSAGE_SHAPES;
+BENCHMARK(BM_PrepareAnswer)->MESSAGE_SHAPES;
@@ -0,0 +1,119 @@
+#include "unix_peer_table.h"
+#include "timer_wheel.h"
+#include "retransmitter.h"
+#include "bench_common.h"
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <arpa/inet.h>
+
+using namespace std;
+using namespace Unix;
+
+static PeerKey bench_key(size_t i)
+{
+    const uint32_t address = htonl(static_cast<uint32_t>(0x0A000000 + i / 4));
+    return PeerKey(SOCKET_TYPE_IP_V4, &address, sizeof(address), static_cast<uint16_t>(5683 + i % 4));
+}
+
+// lookup of a known peer, as for every received datagram
+static void BM_PeerTableFind(benchmark::State &state)
+{
+    const size_t peers = static_cast<size_t>(state.range(0));
+    PeerTable<shared_ptr<int>> table;
+    vector<PeerKey> keys;
+
+    for (size_t i = 0; i < peers; ++i)
+    {
+        keys.push_back(bench_key(i));
+        table.insert(keys.back(), make_shared<int>(0));
+    }
+
+    shared_ptr<int> value;
+    size_t i = 0;
+    const size_t start = allocation_count();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(table.find(keys[i], value));
+        i = (i + 7919) % peers;
+    }
+    report_allocations(state, start);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PeerTableFind)->Arg(1000)->Arg(100000)->Arg(1000000);
+
+// a peer comes and goes
+static void BM_PeerTableInsertErase(benchmark::State &state)
+{
+    const size_t peers = static_cast<size_t>(state.range(0));
+    PeerTable<int> table;
+
+    for (size_t i = 0; i < peers; ++i)
+        table.insert(bench_key(i), 0);
+
+    const PeerKey key = bench_key(peers);
+    const size_t start = allocation_count();
+    for (auto _ : state)
+    {
+        table.insert(key, 1);
+        table.erase(key);
+    }
+    report_allocations(state, start);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PeerTableInsertErase)->Arg(1000)->Arg(100000);
+
+// rearming the lifetime of a peer on every message while the others wait
+static void BM_TimerWheelReschedule(benchmark::State &state)
+{
+    const size_t timers = static_cast<size_t>(state.range(0));
+    TimerWheel wheel(chrono::milliseconds(100));
+    vector<unique_ptr<TimerWheel::Timer>> armed;
+
+    for (size_t i = 0; i < timers; ++i)
+    {
+        armed.emplace_back(new TimerWheel::Timer);
+        wheel.schedule(*armed.back(), chrono::milliseconds(100 * (1 + i % 600)));
+    }
+
+    size_t i = 0;
+    const size_t start = allocation_count();
+    for (auto _ : state)
+    {
+        wheel.schedule(*armed[i], chrono::seconds(60));
+        i = (i + 7919) % timers;
+    }
+    report_allocations(state, start);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TimerWheelReschedule)->Arg(1000)->Arg(100000)->Arg(1000000);
+
+// a CON sent and acknowledged while the others wait for their ACKs
+static void BM_RetransmitterSendAcknowledge(benchmark::State &state)
+{
+    const size_t outstanding = static_cast<size_t>(state.range(0));
+    TimerWheel wheel(chrono::milliseconds(100));
+    BufferPool pool(1, 0, 0);
+    coap::Retransmitter retransmitter(wheel, outstanding + 1, [](const PeerKey &, const uint8_t *, size_t){});
+
+    BufferPool::Handle message = pool.acquire(BufferPool::SMALL_BUFFER);
+    const uint8_t header[] = { 0x40, 0x01, 0x00, 0x2A }; // CON GET, message ID 42
+    memcpy(message->data(), header, sizeof(header));
+    message->offset(sizeof(header));
+
+    error_code ec;
+    for (size_t i = 0; i < outstanding; ++i)
+        retransmitter.send(bench_key(i), message, nullptr, ec);
+
+    const PeerKey key = bench_key(outstanding);
+    const size_t start = allocation_count();
+    for (auto _ : state)
+    {
+        retransmitter.send(key, message, nullptr, ec);
+        retransmitter.acknowledge(key, 42);
+    }
+    report_allocations(state, start);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RetransmitterSendAcknowledge)->Arg(1000)->Arg(100000);
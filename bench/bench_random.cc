@@ -0,0 +1,36 @@
+#include "random.h"
+#include "packet.h"
+#include <benchmark/benchmark.h>
+
+using namespace coap;
+
+static void BM_GenerateIdentity(benchmark::State &state)
+{
+    for (auto _ : state)
+        benchmark::DoNotOptimize(generate_identity());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GenerateIdentity)->ThreadRange(1, 8);
+
+static void BM_MessageIdGenerator(benchmark::State &state)
+{
+    // one generator per peer, so every thread has its own
+    MessageIdGenerator generator;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(generator.next());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MessageIdGenerator)->ThreadRange(1, 8);
+
+static void BM_GenerateToken(benchmark::State &state)
+{
+    Packet packet;
+    const bool secure = state.range(0) != 0;
+    for (auto _ : state)
+    {
+        packet.generate_token(TOKEN_MAX_LENGTH, secure);
+        benchmark::DoNotOptimize(packet.token().data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GenerateToken)->Arg(0)->Arg(1)->ThreadRange(1, 8);
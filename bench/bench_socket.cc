@@ -0,0 +1,134 @@
+#include "unix_uring_socket.h"
+#include "buffer.h"
+#include "bench_common.h"
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+// A batch of CoAP sized datagrams over the loopback interface: the sender puts it out
+// with one call, the receiver takes it with as few calls as it needs.
+// The first argument picks the backend of both sockets: 0 is UnixSocket, 1 is UringSocket
+static void BM_LoopbackBatch(benchmark::State &state)
+{
+    const SocketBackend backend = state.range(0) ? SocketBackend::URING : SocketBackend::POLL;
+    const size_t batch = static_cast<size_t>(state.range(1));
+    const size_t length = 64;
+
+    error_code ec;
+    unique_ptr<UnixSocket> receiver = open_datagram_socket(AF_INET, backend, ec);
+    unique_ptr<UnixSocket> sender = open_datagram_socket(AF_INET, backend, ec);
+    if (ec.value())
+    {
+        state.SkipWithError(ec.message().c_str());
+        return;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    UnixSocketAddress local(addr);
+    receiver->bind(&local, ec);
+    socklen_t addrLen = sizeof(addr);
+    getsockname(receiver->descriptor(), reinterpret_cast<struct sockaddr *>(&addr), &addrLen);
+    UnixSocketAddress destination(addr);
+
+    vector<uint8_t> payload(length, 0x42);
+    vector<uint8_t> buffers(batch * BUFFER_SIZE);
+    vector<UnixSocketAddress> sources(batch);
+    vector<Datagram> outgoing(batch);
+    vector<Datagram> incoming(batch);
+    for (size_t i = 0; i < batch; ++i)
+        outgoing[i] = Datagram{ payload.data(), length, &destination };
+
+    for (auto _ : state)
+    {
+        sender->sendmmsg(outgoing.data(), batch, ec);
+
+        size_t received = 0;
+        while (received < batch && !ec.value())
+        {
+            for (size_t i = received; i < batch; ++i)
+                incoming[i] = Datagram{ &buffers[i * BUFFER_SIZE], BUFFER_SIZE, &sources[i] };
+            const ssize_t count = receiver->recvmmsg(&incoming[received], batch - received, ec);
+            if (count > 0)
+                received += static_cast<size_t>(count);
+        }
+        if (ec.value())
+        {
+            state.SkipWithError(ec.message().c_str());
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_LoopbackBatch)->ArgNames({"uring", "batch"})
+    ->Args({0, 1})->Args({1, 1})->Args({0, 32})->Args({1, 32});
+
+// A burst of 1024-byte blocks to one peer, as a Block2 transfer sends them.
+// The first argument turns on the UDP segmentation offload of the sender and the receive
+// offload of the receiver: 0 sends and receives every datagram on its own
+static void BM_LoopbackBlocks(benchmark::State &state)
+{
+    const bool offload = state.range(0) != 0;
+    const size_t batch = 32;
+    const size_t length = 1024;
+
+    error_code ec;
+    UnixSocket receiver(AF_INET, SOCK_DGRAM, 0, ec);
+    UnixSocket sender(AF_INET, SOCK_DGRAM, 0, ec);
+    if (offload && !ec.value())
+        sender.send_offload(true, ec);
+    if (offload && !ec.value())
+        receiver.receive_offload(true, ec);
+    if (ec.value())
+    {
+        state.SkipWithError(ec.message().c_str());
+        return;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    UnixSocketAddress local(addr);
+    receiver.bind(&local, ec);
+    socklen_t addrLen = sizeof(addr);
+    getsockname(receiver.descriptor(), reinterpret_cast<struct sockaddr *>(&addr), &addrLen);
+    UnixSocketAddress destination(addr);
+
+    vector<uint8_t> payload(batch * length, 0x42);
+    vector<uint8_t> buffers(batch * BUFFER_SIZE);
+    vector<UnixSocketAddress> sources(batch);
+    vector<Datagram> outgoing(batch);
+    vector<Datagram> incoming(batch);
+    for (size_t i = 0; i < batch; ++i)
+        outgoing[i] = Datagram{ &payload[i * length], length, &destination };
+
+    for (auto _ : state)
+    {
+        sender.sendmmsg(outgoing.data(), batch, ec);
+
+        size_t received = 0;
+        while (received < batch && !ec.value())
+        {
+            for (size_t i = received; i < batch; ++i)
+                incoming[i] = Datagram{ &buffers[i * BUFFER_SIZE], BUFFER_SIZE, &sources[i] };
+            const ssize_t count = receiver.recvmmsg(&incoming[received], batch - received, ec);
+            if (count > 0)
+                received += static_cast<size_t>(count);
+        }
+        if (ec.value())
+        {
+            state.SkipWithError(ec.message().c_str());
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+    state.SetBytesProcessed(state.iterations() * batch * length);
+}
+BENCHMARK(BM_LoopbackBlocks)->ArgName("offload")->Arg(0)->Arg(1);
@@ -2,6 +2,8 @@
 #include "error.h"
 #include "unix_udp_server.h"
 #include "unix_endpoint.h"
+#include "unix_sharded_server.h"
+#include "byte_order.h"
 
 #include <iostream>
 #include <string>
@@ -24,12 +26,35 @@ struct CommandLineOptions
 {
     bool useIPv4;
     int port;
+    size_t shards;
+    bool timestamps;
+    bool offload;
+    SocketBackend backend;
 };
 
-static bool g_terminate = false;
+static Reactor * g_reactor = nullptr;
+static ShardedUdpServer * g_shardedServer = nullptr;
 
 static const char * g_contentPath = "data/well-known_core.wlnk";
 
+// the clients no longer cost a thread each, so many sensors can be served at once
+static const size_t MAX_CLIENTS = 16384;
+
+// resolution of the client lifetimes
+static const chrono::milliseconds TIMER_TICK(100);
+
+// a kernel receive time stamp may be a little ahead of the clock read afterwards, or missing
+static void record_since(LatencyHistogram &histogram, uint64_t timestamp, uint64_t now)
+{
+    if (timestamp)
+        histogram.record(now > timestamp ? now - timestamp : 0);
+}
+
+static uint64_t nanoseconds_since(chrono::steady_clock::time_point started)
+{
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - started).count());
+}
+
 static void usage()
 {
     std::cerr << "Usage: coap-server [OPTIONS]\n";
@@ -40,6 +65,10 @@ static void usage()
     std::cerr << "-p,--port\t<PORT_NUMBER>\tset the port number to listen to incomming connections. Default: 5683\n";
     std::cerr << "-4,--ipv4\tListen to only IPv4 addresses\n";
     std::cerr << "-6,--ipv6\tListen to only IPv6 addresses. Default\n";
+    std::cerr << "-s,--shards\t<SHARDS>\tserve the port with SHARDS SO_REUSEPORT sockets, one thread per CPU core each. Default: one socket\n";
+    std::cerr << "-t,--timestamps\ttake the kernel receive time stamps to measure how long the requests wait in the socket\n";
+    std::cerr << "-o,--offload\tlet the kernel coalesce the datagrams of a peer (UDP_GRO)\n";
+    std::cerr << "-b,--backend\t<poll|uring|auto>\treceive with epoll or io_uring, auto takes io_uring where the kernel supports it. Default: poll\n";
 }
 
 static bool parse_arguments(int argc, char ** argv, CommandLineOptions &options)
@@ -49,6 +78,10 @@ static bool parse_arguments(int argc, char ** argv, CommandLineOptions &options)
 
     options.port = 5683;
     options.useIPv4 = false;
+    options.shards = 0;
+    options.timestamps = false;
+    options.offload = false;
+    options.backend = SocketBackend::POLL;
     set_level(level::debug);
     while(true)
     {
@@ -58,9 +91,13 @@ static bool parse_arguments(int argc, char ** argv, CommandLineOptions &options)
                 {"port", required_argument, 0, 'p'},
                 {"ipv4", no_argument, 0, '4'},
                 {"ipv6", no_argument, 0, '6'},
+                {"shards", required_argument, 0, 's'},
+                {"timestamps", no_argument, 0, 't'},
+                {"offload", no_argument, 0, 'o'},
+                {"backend", required_argument, 0, 'b'},
                 {0, 0, 0, 0}
         };
-        opt = getopt_long (argc, argv, "hp:46", long_options, &option_index);
+        opt = getopt_long (argc, argv, "hp:46s:tob:", long_options, &option_index);
         if (opt == -1) break;
 
         switch (opt)
@@ -82,6 +119,31 @@ static bool parse_arguments(int argc, char ** argv, CommandLineOptions &options)
             case '6':
                 options.useIPv4 = false;
                 break;
+            case 's':
+                options.shards = (size_t)strtoul(optarg, &endptr, 10);
+                if (options.shards == 0) {
+                    debug("Error: Unable to convert --shards {} option value to the quantity of shards", optarg);
+                    return false;
+                }
+                break;
+            case 't':
+                options.timestamps = true;
+                break;
+            case 'o':
+                options.offload = true;
+                break;
+            case 'b':
+                if (!strcmp(optarg, "poll"))
+                    options.backend = SocketBackend::POLL;
+                else if (!strcmp(optarg, "uring"))
+                    options.backend = SocketBackend::URING;
+                else if (!strcmp(optarg, "auto"))
+                    options.backend = SocketBackend::AUTO;
+                else {
+                    debug("Error: Unknown --backend {} option value, poll, uring or auto is expected", optarg);
+                    return false;
+                }
+                break;
             default:
                 return false;
         }
@@ -97,7 +159,7 @@ static bool read_core_link_content(const char * filePath, string &content)
     {
         ifs.seekg(0, std::ios::end);
         size_t size = ifs.tellg();
-        content.reserve(size);
+        content.resize(size);
         ifs.seekg(0);
         ifs.read(&content[0], size);
         ifs.close();
@@ -111,8 +173,105 @@ static void signal_handler(int signo)
     if (signo == SIGINT)
     {
         debug("SIGINT cought");
-        g_terminate = true;
+        if (g_reactor)
+            g_reactor->stop();
+        if (g_shardedServer)
+            g_shardedServer->stop();
+    }
+}
+
+static bool set_socket_options(const CommandLineOptions &options, UdpServerConnection &connection)
+{
+    error_code ec;
+
+    if (options.timestamps)
+    {
+        connection.receive_timestamps(ec);
+        if (ec.value())
+        {
+            debug("receive_timestamps() failed: {}", ec.message());
+            return false;
+        }
+    }
+    // only the receive offload: every request gets one response here, the server sends no
+    // batches which the segmentation offload of send_batch() could coalesce
+    if (options.offload)
+    {
+        connection.receive_offload(ec);
+        if (ec.value())
+        {
+            debug("the UDP offload can not be turned on: {}", ec.message());
+            return false;
+        }
+    }
+    return true;
+}
+
+static int run_sharded(const CommandLineOptions &options, const string &coreLinkContent)
+{
+    error_code ec;
+
+    debug("creating {0:d} shards...", options.shards);
+
+    ShardedUdpServer sharded(options.port, options.useIPv4, options.shards, true, options.backend);
+    sharded.bind(ec);
+    if (ec.value())
+    {
+        debug("FAILED\nerror occured : {}", ec.message());
+        return EXIT_FAILURE;
+    }
+    debug("OK");
+
+    for (size_t i = 0; i < sharded.shards(); ++i)
+    {
+        if (!set_socket_options(options, sharded.shard(i).connection()))
+            return EXIT_FAILURE;
+    }
+
+    // every shard has its own CoAP server which handles the requests inline on the pinned thread of the shard,
+    // so neither the clients nor the exchange cache are shared between the threads
+    vector<unique_ptr<CoapServer>> servers;
+    for (size_t i = 0; i < sharded.shards(); ++i)
+    {
+        UdpServerShard &shard = sharded.shard(i);
+        servers.emplace_back(new CoapServer("CoAP Server", coreLinkContent.c_str(), &shard.connection(), &shard.reactor(), nullptr, 60, MAX_CLIENTS));
+        servers.back()->start();
+    }
+
+    debug("server is launching...");
+    g_shardedServer = &sharded;
+    sharded.start([&servers](UdpServerShard &shard, size_t count)
+        {
+            servers[shard.index()]->receive(shard, count);
+        }, ec);
+    if (ec.value())
+    {
+        debug("FAILED\nerror occured : {}", ec.message());
+        g_shardedServer = nullptr;
+        return EXIT_FAILURE;
     }
+    debug("OK");
+
+    sharded.join(); // returns on SIGINT
+    g_shardedServer = nullptr;
+
+    for (size_t i = 0; i < sharded.shards(); ++i)
+    {
+        if (sharded.shard(i).dropped())
+            debug("shard {0:d}: {1:d} datagram(s) dropped for the lack of a free buffer", i, sharded.shard(i).dropped());
+    }
+
+    for (auto &server : servers)
+    {
+        server->stop();
+        server->report_latency();
+        server->shutdown(ec);
+        if (ec.value())
+        {
+            debug("shutdown() failed: {}", ec.message());
+        }
+    }
+    return EXIT_SUCCESS;
 }
 
 int main(int argc, char **argv)
@@ -144,10 +303,14 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
+    if (options.shards)
+    {
+        int status = run_sharded(options, coreLinkContent);
+        debug("{} has been finished", argv[0]);
+        return status;
+    }
+
     error_code ec;
-    int status;
-    fd_set rd;
-    struct timeval tv;
     const UnixSocket *sock;
     shared_ptr<Buffer> bufferPtr;
 
@@ -155,7 +318,7 @@ int main(int argc, char **argv)
 
     debug("creating a new connection...");
 
-    UdpServerConnection connection(options.port, options.useIPv4, move(bufferPtr), ec);
+    UdpServerConnection connection(options.port, options.useIPv4, move(bufferPtr), ec, options.backend);
     if (ec.value())
     {
         debug("FAILED\nerror occured : {}", ec.message());
@@ -172,11 +335,30 @@ int main(int argc, char **argv)
     }
     debug("OK");
 
+    if (!set_socket_options(options, connection))
+        return EXIT_FAILURE;
+
     sock = static_cast<const UnixSocket *>(connection.socket());
 
+    debug("creating an event reactor...");
+
+    Reactor reactor(ec);
+    if (ec.value())
+    {
+        debug("FAILED\nerror occured : {}", ec.message());
+        return EXIT_FAILURE;
+    }
+    g_reactor = &reactor;
+    debug("OK");
+
+    debug("creating a worker pool...");
+
+    Executor executor;
+    debug("OK, {0:d} workers", executor.workers());
+
     debug("creating a new CoAP server...");
 
-    CoapServer server("CoAP Server", coreLinkContent.c_str(), &connection, 60, 8);
+    CoapServer server("CoAP Server", coreLinkContent.c_str(), &connection, &reactor, &executor, 60, MAX_CLIENTS);
     if (ec.value())
     {
         debug("FAILED\nerror occured : {}", ec.message());
@@ -188,46 +370,54 @@ int main(int argc, char **argv)
     server.start();
     debug("OK");
 
-    while(!g_terminate && server.is_started())
-    {
-        FD_ZERO (&rd);
-        FD_SET (sock->descriptor(), &rd);
-
-        tv.tv_sec = server.timeout();
-        tv.tv_usec = 0;
-
-        status = select(FD_SETSIZE, &rd, NULL, NULL, &tv);
-
-        if (status == 0)
-        {
-            debug("select() timeout {0:d} sec expired", server.timeout());
-        }
-        else if (status < 0)
+    // the ring descriptor with an io_uring socket, its multishot receive leaves the socket empty
+    reactor.add(sock->event_descriptor(), Reactor::READABLE, [&](uint32_t events)
         {
-            debug("select() error, errno = {0:d}", errno);
-            server.stop();
-            continue;
-        }
+            error_code rec;
 
-        if (FD_ISSET(sock->descriptor(), &rd))
-        {
-            server.receive(ec);
-            if (ec.value())
+            if (events & Reactor::FAILED)
             {
-                debug("server.receive() failed: {}", ec.message());    
+                debug("socket error, the server is stopping");
+                server.stop();
+                reactor.stop();
+                return;
             }
-            else
+
+            do // the segments left of a coalesced read do not make the socket readable again
             {
-                debug("server.receive() <-- ({0:d})", server.connection()->bufferPtr().get()->offset()); 
+                server.receive(rec);
+                if (rec.value())
+                {
+                    debug("server.receive() failed: {}", rec.message());
+                }
+                else
+                {
+                    debug("server.receive() completed");
+                }
             }
-        }
+            while (!rec.value() && connection.receive_pending());
+        }, ec);
+    if (ec.value())
+    {
+        debug("reactor.add() failed: {}", ec.message());
+        return EXIT_FAILURE;
     }
 
+    reactor.run(ec); // returns on SIGINT
+    if (ec.value())
+    {
+        debug("reactor.run() failed: {}", ec.message());
+    }
+    server.stop();
+    server.report_latency();
+    g_reactor = nullptr;
+
     server.shutdown(ec);
     if (ec.value())
     {
         debug("shutdown() failed: {}", ec.message());        
     }
+    executor.shutdown(); // the queued tasks refer to the server
 
     debug("{} has been finished", argv[0]);
 
@@ -244,34 +434,41 @@ CoapServer::CoapServer(
         const char *name,
         const char *coreLink,
         ServerConnection *connection,
+        Reactor *reactor,
+        Executor *executor,
         time_t lifetime,
         size_t maxClients
     )
     : m_name{name},
       m_coreLink{coreLink},
       m_connection{connection},
+      m_reactor{reactor},
+      m_executor{executor},
       m_lifetime{lifetime},
-      m_timeout{1}, // 1 sec
       m_maxClients{maxClients},
       m_clients{},
-      m_threads{},
+      m_wheel{TIMER_TICK},
+      m_expired{},
+      m_exchanges{EXCHANGE_CACHE_CAPACITY, RESPONSE_CACHE_CAPACITY},
+      m_exchangesMutex{},
       m_running{false},
-      m_mutex{}  
+      m_pool{0, POOL_CAPACITY, 0},
+      m_packets{2 * (executor ? executor->workers() : 1), PACKET_OPTIONS},
+      m_batchBuffers(RECEIVE_BATCH_SIZE),
+      m_batchAddresses(RECEIVE_BATCH_SIZE),
+      m_batch(RECEIVE_BATCH_SIZE),
+      m_latency{},
+      m_dropped{0}
+{}
+
+void CoapServer::start()
 {
-    // start remover thread
-    thread newThread(expired_clients_remover_thread, this);
-    m_removerThread = move(newThread);
-}
-
-CoapServer::~CoapServer()
-{
-    if (m_removerThread.joinable()) {
-        m_removerThread.join();
-    }
+    m_running = true;
+    // the first tick of the timer wheel, it reschedules itself
+    m_reactor->schedule(TIMER_TICK, [this]{ advance_timers(); });
 }
 
-// WARNING: This function allocates the memory that should be free
-ConnectedClient* 
+shared_ptr<ConnectedClient>
 CoapServer::new_connected_client(
                 const SocketAddress * clientAddr,
                 error_code &ec
@@ -283,18 +480,14 @@ CoapServer::new_connected_client(
         return nullptr;
     }
 
-    time_t futuretime = chrono::system_clock::to_time_t(
-                                    chrono::system_clock::now()
-                                ) + m_lifetime;
-
-    ConnectedClient *client = new ConnectedClient(
+    shared_ptr<ConnectedClient> client(new ConnectedClient(
                                     m_name,
                                     m_coreLink,
                                     m_connection,
                                     clientAddr,
-                                    futuretime,
+                                    m_executor,
                                     ec
-                                );
+                                ));
     if (client == nullptr)
     {
         ec = make_error_code(CoapStatus::COAP_ERR_MEMORY_ALLOCATE);
@@ -303,7 +496,9 @@ CoapServer::new_connected_client(
 
     if (ec.value()) return nullptr;
 
-    client->m_processing = true;
+    // the handler runs inside advance() which must not destroy the timer, so the removal waits for its end
+    const PeerKey key = client->m_key;
+    client->m_expiry.handler([this, key]{ m_expired.push_back(key); });
 
     return client;
 }
@@ -312,109 +507,171 @@ bool CoapServer::remove_connected_client(ConnectedClient * client)
 {
     if (client == nullptr) { return false; }
 
-    for(vector<thread>::iterator
-        iter = m_threads.begin(), last = m_threads.end(); iter != last; ++iter)
+    m_wheel.cancel(client->m_expiry); // here, the last owner of the client may be a worker thread
+
+    client->m_processing = false;   // the queued tasks of the client return at once
+    client->receiveQueue().close(); // and the following messages are rejected
+
+    if (!m_clients.erase(client->m_key)) // the last task releases the client, nothing waits for it here
+        return false;
+
+    debug("the client has been removed, {0:d} client(s) left", m_clients.size());
+    return true;
+}
+
+shared_ptr<ConnectedClient> CoapServer::find_connected_client(const SocketAddress * clientAddr)
+{
+    shared_ptr<ConnectedClient> client;
+
+    if (clientAddr != nullptr)
+        m_clients.find(static_cast<const UnixSocketAddress *>(clientAddr)->peer_key(), client);
+
+    return client;
+}
+
+void CoapServer::receive(error_code &ec)
+{
+    set_level(level::debug);
+
+    if (m_connection->type() != UDP) { // Only UDP connection is supported
+        ec = make_error_code(CoapStatus::COAP_ERR_NOT_IMPLEMENTED);
+        return;
+    }
+
+    UdpServerConnection *connection = reinterpret_cast<UdpServerConnection*>(m_connection);
+    size_t count = RECEIVE_BATCH_SIZE;
+
+    for (size_t i = 0; i < count; ++i)
     {
-        if (iter->get_id() == client->m_threadId)
+        if (!m_batchBuffers[i]) // the previous buffer has been handed over to a client
+            m_batchBuffers[i] = m_pool.acquire(m_connection->bufferPtr()->length());
+
+        if (!m_batchBuffers[i])
         {
-            client->m_processing = false; // flag to stop client processing 
+            count = i;
+            break;
+        }
+        m_batch[i].data = m_batchBuffers[i]->data();
+        m_batch[i].length = m_batchBuffers[i]->length();
+        m_batch[i].address = &m_batchAddresses[i];
+    }
 
-            // give a chance to switch the context
-            std::this_thread::sleep_for (std::chrono::milliseconds(100));
+    if (count == 0)
+    {
+        // the clients hold all the buffers, the queued datagrams are dropped instead of keeping
+        // the socket readable, the clients retransmit the confirmable ones
+        count = RECEIVE_BATCH_SIZE;
+        connection->drop_batch(count, ec);
+        m_dropped += count;
+        return;
+    }
 
-            if (iter->joinable())
-                iter->join();                   // join the client handle thread
-            m_threads.erase(iter);              // remove the thread from the thread pool
-            
-            hash<thread::id> hasher;
-            debug("[THREAD] [{0:d}] : The thread has been finished", hasher(client->m_threadId));
+    connection->receive_batch(m_batch.data(), count, ec); // Receive all the queued messages from the clients
+    if (ec.value())
+    {
+        debug("receive_batch() : error : {}", ec.message());
+        return;
+    }
+    debug("received {0:d} datagram(s)", count);
 
-            for (vector<ConnectedClient*>::iterator
-                iter2 = m_clients.begin(), last2 = m_clients.end(); iter2 != last2; ++iter2)
-            {
-                if (*iter2 == client)
-                { m_clients.erase(iter2); break; } // remove the client from the client pool
-            }
+    const uint64_t now = UnixSocket::timestamp_now();
 
-            delete client;
-            return true;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (m_batch[i].truncated) // the message is cut, the buffer stays for the next batch
+        {
+            debug("truncated datagram of {0:d} bytes dropped", m_batch[i].length);
+            continue;
         }
+        m_batchBuffers[i]->offset(m_batch[i].length); // set the received message length
+        m_batchBuffers[i]->timestamp(m_batch[i].timestamp);
+        record_since(m_latency.queueing, m_batch[i].timestamp, now);
+
+        dispatch(m_batchBuffers[i], &m_batchAddresses[i], ec);
     }
-    return false;
 }
 
-static bool is_client_connection_timed_out(const ConnectedClient * client)
+void CoapServer::receive(UdpServerShard &shard, size_t count)
 {
-    if (client == nullptr) { return false; }
-    time_t currentTime = chrono::system_clock::to_time_t(chrono::system_clock::now());
-    return (currentTime >= client->m_endtime);
+    error_code ec;
+    const uint64_t now = UnixSocket::timestamp_now();
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        record_since(m_latency.queueing, shard.buffer(i)->timestamp(), now);
+        dispatch(shard.buffer(i), shard.datagrams()[i].address, ec);
+        ec.clear();
+    }
 }
 
-static void update_client_connection_endtime(ConnectedClient * client, const time_t lifetime)
+// only the requests are deduplicated, an ACK or a RST belongs to an exchange of the server
+static bool is_deduplicated(Buffer &message)
 {
-    if (client == nullptr) { return; }
-    client->m_endtime = chrono::system_clock::to_time_t(
-                                    chrono::system_clock::now()
-                                ) + lifetime;
+    return message.offset() >= PACKET_HEADER_SIZE && ((message.data()[HEADER_OFFSET] >> 4) & 0x3) <= NON_CONFIRMABLE;
 }
 
-ConnectedClient* CoapServer::find_connected_client(const SocketAddress * clientAddr)
+bool CoapServer::deduplicate(Buffer &message, const SocketAddress * clientAddr, const PeerKey &key)
 {
-    if (clientAddr == nullptr)
-    { return nullptr; }
-
-    error_code ec;
-
-    const UnixSocketAddress *addr = reinterpret_cast<const UnixSocketAddress *>(clientAddr);
+    if (!is_deduplicated(message))
+        return true;
 
-    lock_guard<std::mutex> lg(m_mutex);
+    BufferPool::Handle response;
+    ExchangeCache::Lookup lookup;
+    {
+        unique_lock<mutex> lock = lock_exchanges();
+        lookup = m_exchanges.check(key, load_be16(message.data() + MESSAGE_ID_OFFSET), response);
+    }
 
-    for(auto client : m_clients)
+    switch (lookup)
     {
-        const UnixSocketAddress * ca = reinterpret_cast<const UnixSocketAddress *>(client->m_clientAddress);
+        case ExchangeCache::FIRST:
+            return true;
 
-        if ( (ca->type() == SOCKET_TYPE_IP_V4
-            && (ca->address4().sin_addr.s_addr == addr->address4().sin_addr.s_addr) )
-            || (ca->type() != SOCKET_TYPE_IP_V4
-            && (ca->address6().sin6_addr.s6_addr == addr->address6().sin6_addr.s6_addr) ) )
+        case ExchangeCache::REPLAY:
         {
-            // if the client connection is timed out remove it
-            if (is_client_connection_timed_out(client))
-            {
-                remove_connected_client(client);
-                return nullptr;
-            }
-            else
-            { return client; }
+            error_code ec;
+            static_cast<Connection *>(m_connection)->send(response->data(), response->offset(), clientAddr, ec);
+            debug("a duplicate has been answered from the cache: {}", ec.message());
+            break;
         }
+
+        case ExchangeCache::IN_PROGRESS:
+            debug("a duplicate of a request in progress is dropped");
+            break;
     }
-    return nullptr;
+    return false;
 }
 
-void CoapServer::receive(error_code &ec)
+unique_lock<mutex> CoapServer::lock_exchanges()
 {
-    set_level(level::debug);
+    return m_executor ? unique_lock<mutex>(m_exchangesMutex) : unique_lock<mutex>();
+}
 
-    if (m_connection->type() != UDP) { // Only UDP connection is supported
-        ec = make_error_code(CoapStatus::COAP_ERR_NOT_IMPLEMENTED);
+void CoapServer::forget(const PeerKey &key, uint16_t messageId)
+{
+    unique_lock<mutex> lock = lock_exchanges();
+    m_exchanges.forget(key, messageId);
+}
+
+void CoapServer::dispatch(BufferPool::Handle &message, const SocketAddress * clientAddr, error_code &ec)
+{
+    if (clientAddr == nullptr)
+    {
+        ec = make_system_error(EFAULT);
         return;
     }
 
-    UdpServerConnection *connection = reinterpret_cast<UdpServerConnection*>(m_connection);
-    uint8_t *buffer = connection->bufferPtr().get()->data();
-    size_t length = connection->bufferPtr().get()->length();
-    UnixSocketAddress clientAddress;
+    const PeerKey key = static_cast<const UnixSocketAddress *>(clientAddr)->peer_key();
 
-    connection->receive(buffer, length, &clientAddress, ec); // Receive a message from a client 
-    if (ec.value())
-    {
-        debug("receive() : error : {}", ec.message());
+    // a duplicate goes no further, neither parsed nor queued to the client
+    if (!deduplicate(*message, clientAddr, key))
         return;
-    }
 
-    connection->bufferPtr().get()->offset(length); // set the received message length
+    // a request dropped below is forgotten, so its retransmissions are not taken for duplicates
+    const bool remembered = is_deduplicated(*message);
+    const uint16_t messageId = remembered ? load_be16(message->data() + MESSAGE_ID_OFFSET) : 0;
 
-    ConnectedClient * client = find_connected_client(&clientAddress);// looking for a client among the known ones
+    shared_ptr<ConnectedClient> client = find_connected_client(clientAddr);// looking for a client among the known ones
 
     if (client == nullptr) // it is a new client
     {
@@ -422,30 +679,32 @@ void CoapServer::receive(error_code &ec)
         {
             ec = make_error_code(CoapStatus::COAP_ERR_CONNECTIONS_EXCEEDED);
             debug("processing() error: {}", ec.message());
+            if (remembered) forget(key, messageId);
             return;
         }
 
-        client = new_connected_client(&clientAddress, ec);
+        client = new_connected_client(clientAddr, ec);
         if (ec.value())
         {
             debug("new_connected_client() error: {}", ec.message());
+            if (remembered) forget(key, messageId);
             return;
         }
 
-        m_clients.push_back(client); // add a new client to the client pool
-
-        thread newThread(processing_thread, client, this); // create a new thread to process the client request
-
-        client->m_threadId = newThread.get_id(); // map the client and the thread
+        m_clients.insert(client->m_key, client); // add a new client to the client pool
 
-        m_threads.push_back(move(newThread)); // add a new thread to the thread pool
-
-        hash<thread::id> hasher;
+        debug("a new client has been added, {0:d} client(s)", m_clients.size());
+    }
+    m_wheel.schedule(client->m_expiry, chrono::seconds(m_lifetime)); // the lifetime starts over
 
-        debug("[THREAD] [{0:d}] : A new thread has been started", hasher(client->m_threadId));
+    // hand the buffer over to the apropriate client, the receive slot gets a new one from the pool
+    if (!client->receiveQueue().push(move(message)))
+    {
+        ec = make_system_error(ENOBUFS);
+        debug("the queue of the client is full, the message is dropped");
+        if (remembered) forget(key, messageId);
+        return;
     }
-    // copy recived data to the incomming queue of the apropriate client
-    client->receiveQueue().push(*connection->bufferPtr());
 
     const UnixSocketAddress * addr = reinterpret_cast<const UnixSocketAddress *>(client->m_clientAddress);
 
@@ -455,6 +714,20 @@ void CoapServer::receive(error_code &ec)
     debug("Client IP address: {}", ip);
 
     client->received(true);
+
+    if (!m_executor) // the receiving thread handles the request itself
+    {
+        processing(client.get());
+        return;
+    }
+
+    // one task per message: the serial queue keeps the order of the client, the workers serve the clients in parallel
+    if (!client->m_serial->post([this, client]{ processing(client.get()); }))
+    {
+        ec = make_system_error(ECANCELED);
+        debug("the workers have been stopped, the message is dropped");
+        if (remembered) forget(key, messageId);
+    }
 }
 
 void CoapServer::processing(ConnectedClient* client)
@@ -469,56 +742,71 @@ void CoapServer::processing(ConnectedClient* client)
         return;
     }
 
-    while (client->m_processing)
-    {
-        if (client->m_processing == false               // processing is finished
-            || is_client_connection_timed_out(client))  // or connection is timed out
-        {
-            client->m_processing = false;
-            continue;
-        }
+    BufferPool::Handle message;
 
-        if (client->received()) {
-            client->received(false);
-            update_client_connection_endtime(client, m_lifetime);
-            client->start();
-        }
+    // the client has been removed, its queued buffers go back to the pool with it
+    if (!client->m_processing || !client->receiveQueue().pop(message))
+        return;
 
+    const uint16_t messageId = message->offset() >= PACKET_HEADER_SIZE ? load_be16(message->data() + MESSAGE_ID_OFFSET) : 0;
+    client->bufferPtr() = move(message); // the endpoint works on the received buffer
+    client->requestPtr() = m_packets.acquire(); // and on the packets of the worker, the FSA returns them
+    client->responsePtr() = m_packets.acquire();
+
+    client->received(false);
+    client->start();
+
+    do // run the request through the FSA until it is idle again
+    {
+        chrono::steady_clock::time_point started = chrono::steady_clock::now();
         client->transaction_step(ec);
 
         if (ec.value()) {
             debug("transaction_step error : {}", ec.message());
         }
 
-        if (client->receiving()) // it is require to receive a message from the client
+        switch (client->currentState()) // the state the step has run
         {
-            //TODO : read from queue
+            case ServerEndpoint::RECEIVE_REQUEST:
+                m_latency.parse.record(nanoseconds_since(started));
+                break;
+            case ServerEndpoint::HANDLE_REQUEST:
+                m_latency.handler.record(nanoseconds_since(started));
+                break;
+            default:
+                break;
         }
 
         if (client->sending()) // it is require to send a message to the client
         {
-            //TODO send a message from the internal buffer
-        }
-
-#if 1
-        client->timeout(10);// to debug
+            const Packet &answer = client->response();
+            started = chrono::steady_clock::now();
+            send_packet(*m_connection, answer, client->m_clientAddress, ec);
+            m_latency.send.record(nanoseconds_since(started));
+            if (ec.value()) {
+                debug("send error : {}", ec.message());
+            }
 
-        if (client->timeout())
-            std::this_thread::sleep_for(std::chrono::seconds(client->timeout()));
-#endif
+            // the duplicates of the request get the same answer
+            unique_lock<mutex> lock = lock_exchanges();
+            m_exchanges.respond(client->m_key, messageId, answer);
+        }
     }
-}
-
-void CoapServer::processing_thread(ConnectedClient* client, void *context)
-{
-    ((CoapServer *)context)->processing(client);
+    while (client->nextState() != ServerEndpoint::IDLE);
 }
 
 void CoapServer::shutdown(error_code &ec)
 {
-    for (auto client : m_clients)
+    vector<shared_ptr<ConnectedClient>> clients;
+    clients.reserve(m_clients.size());
+    m_clients.for_each([&clients](const PeerKey &, const shared_ptr<ConnectedClient> &client)
+        {
+            clients.push_back(client);
+        });
+
+    for (auto &client : clients)
     {
-        if (!remove_connected_client(client))
+        if (!remove_connected_client(client.get()))
         {
             ec = make_error_code(CoapStatus::COAP_ERR_REMOVE_CONNECTION);
             debug("client can not be removed");
@@ -526,23 +814,45 @@ void CoapServer::shutdown(error_code &ec)
     }
 }
 
-void CoapServer::expired_clients_remover()
+void CoapServer::report_latency() const
 {
-    while(m_running)
+    const pair<const char *, const LatencyHistogram *> stages[] = {
+        { "queueing", &m_latency.queueing },
+        { "parse", &m_latency.parse },
+        { "handler", &m_latency.handler },
+        { "send", &m_latency.send }
+    };
+
+    for (const auto &stage : stages)
     {
-        for(vector<ConnectedClient*>::iterator iter = m_clients.begin(),
-                last = m_clients.end(); iter != last; ++iter)
-        {
-            if (is_client_connection_timed_out(static_cast<const ConnectedClient*>(*iter)))
-            {
-                remove_connected_client(*iter);
-            }
-        }
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        const LatencyHistogram &histogram = *stage.second;
+        if (!histogram.count())
+            continue;
+        debug("{0} latency of {1:d} request(s), ns: mean {2:d}, p50 {3:d}, p99 {4:d}, p99.9 {5:d}, max {6:d}",
+            stage.first, histogram.count(), histogram.mean(), histogram.percentile(50),
+            histogram.percentile(99), histogram.percentile(99.9), histogram.max());
     }
+    if (m_dropped)
+        debug("{0:d} datagram(s) dropped for the lack of a free buffer", m_dropped);
 }
 
-void CoapServer::expired_clients_remover_thread(void *context)
+void CoapServer::advance_timers()
 {
-    ((CoapServer *)context)->expired_clients_remover();
+    m_wheel.advance();
+
+    for (const PeerKey &key : m_expired)
+    {
+        shared_ptr<ConnectedClient> client;
+        if (m_clients.find(key, client))
+        {
+            debug("the client lifetime has expired");
+            remove_connected_client(client.get());
+        }
+    }
+    m_expired.clear();
+
+    if (m_running)
+    {
+        m_reactor->schedule(TIMER_TICK, [this]{ advance_timers(); });
+    }
 }
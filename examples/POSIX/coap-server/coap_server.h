@@ -3,6 +3,14 @@
 #include "error.h"
 #include "unix_udp_server.h"
 #include "unix_endpoint.h"
+#include "unix_reactor.h"
+#include "unix_sharded_server.h"
+#include "unix_executor.h"
+#include "unix_peer_table.h"
+#include "timer_wheel.h"
+#include "exchange_cache.h"
+#include "packet_pool.h"
+#include "latency_histogram.h"
 
 #include <iostream>
 #include <string>
@@ -11,6 +19,7 @@
 #include <array>
 #include <fstream>
 #include <cstddef>
+#include <cstdint>
 #include <thread>
 #include <mutex>
 #include <atomic>
@@ -24,64 +33,85 @@ struct ConnectedClient : public Unix::ServerEndpoint {
     		const char *coreLink,
     		ServerConnection *connection,
             const SocketAddress *clientAddress,
-            time_t endtime,
+            Unix::Executor *executor,
             std::error_code &ec
         )
         : ServerEndpoint(name, coreLink, connection, ec),
-        m_clientAddress{clientAddress},
-        m_endtime{endtime},
-        m_threadId{}
+        m_address{*static_cast<const UnixSocketAddress *>(clientAddress)},
+        m_clientAddress{&m_address},
+        m_key{m_address.peer_key()},
+        m_expiry{},
+        m_processing{true},
+        m_serial{executor ? std::make_shared<Unix::SerialQueue>(*executor) : nullptr}
     {}
     ~ConnectedClient() = default;
 
+    UnixSocketAddress       m_address;      // the source addresses of a batch are reused, so keep a copy
     const SocketAddress     *m_clientAddress;
-    std::atomic<time_t>     m_endtime;
+    PeerKey                 m_key;
+    TimerWheel::Timer       m_expiry;       // lifetime of the client, touched in the reactor thread only
     std::atomic<bool>       m_processing;
-    std::thread::id         m_threadId;
+    std::shared_ptr<Unix::SerialQueue>
+                            m_serial;       // runs the requests of the client one by one on the executor, if any
 };
 
 class CoapServer
 {
 public:
+    // Without an executor the requests are handled inline by the receiving thread,
+    // which owns the clients and the exchange cache then
     CoapServer(
             const char *name,
             const char *coreLink,
             ServerConnection *connection,
+            Unix::Reactor *reactor,
+            Unix::Executor *executor,
             time_t lifetime,
             size_t maxClients
         );
-    ~CoapServer();
+    ~CoapServer() = default;
+
+public:
+    // maximal quantity of the datagrams taken by one receive() call
+    static const size_t RECEIVE_BATCH_SIZE = 32;
+    // maximal quantity of the receive buffers, including the ones queued to the clients
+    static const size_t POOL_CAPACITY = 1024;
+    // exchanges remembered for the deduplication and the responses kept for their duplicates
+    static const size_t EXCHANGE_CACHE_CAPACITY = 65536;
+    static const size_t RESPONSE_CACHE_CAPACITY = 4096;
+    // options reserved in every pooled packet
+    static const size_t PACKET_OPTIONS = 8;
 
 public:
     void receive(std::error_code &ec);
+    // dispatches a batch received by a shard of ShardedUdpServer
+    void receive(Unix::UdpServerShard &shard, size_t count);
+    // handles one queued message of the client, runs on a worker of the executor or inline
     void processing(ConnectedClient* client);
     void shutdown(std::error_code &ec);
-    void expired_clients_remover();
-
-    static void processing_thread(ConnectedClient* client, void *context);
-    static void expired_clients_remover_thread(void *context);
+    // fires the due timers of the wheel, reschedules itself every tick
+    void advance_timers();
+    // logs the percentiles of the request latencies and the dropped datagrams
+    void report_latency() const;
 
 public:
+    void start();
+
     void stop()
     { m_running = false; }
 
-    void start()
-    { m_running = true; }
-
     bool is_started() const
     { return m_running;}
 
-    void timeout(time_t value)
-    { m_timeout = value; }
-
-    time_t timeout() const
-    { return m_timeout; }
-
     ServerConnection *connection()
     { return m_connection; }
 
+    // the queueing is recorded only if the connection takes the receive time stamps
+    const coap::RequestLatency & latency() const
+    { return m_latency; }
+
 private:
-    ConnectedClient* 
+    std::shared_ptr<ConnectedClient>
     new_connected_client(
             const SocketAddress * clientAddr,
             std::error_code &ec
@@ -91,24 +121,57 @@ private:
                 ConnectedClient * client
             );
 
-    ConnectedClient*
+    std::shared_ptr<ConnectedClient>
     find_connected_client(
             const SocketAddress * clientAddr
         );
 
+    void dispatch(
+            BufferPool::Handle &message,
+            const SocketAddress * clientAddr,
+            std::error_code &ec
+        );
+
+    // false if the message is a duplicate, it has been answered from the cache or dropped then
+    bool deduplicate(
+            Buffer &message,
+            const SocketAddress * clientAddr,
+            const PeerKey &key
+        );
+
+    // locks the exchange cache if the workers of the executor share it, an empty lock otherwise
+    std::unique_lock<std::mutex> lock_exchanges();
+
+    // forgets the exchange of a request dropped after deduplicate()
+    void forget(
+            const PeerKey &key,
+            std::uint16_t messageId
+        );
+
 private:
     const char                  *m_name;
     const char                  *m_coreLink;
     ServerConnection            *m_connection;
+    Unix::Reactor               *m_reactor;
+    Unix::Executor              *m_executor;
     time_t                      m_lifetime;
-    time_t                      m_timeout;
     size_t                      m_maxClients;
-    std::vector<ConnectedClient*>
-                                m_clients;
-    std::vector<std::thread>    m_threads;
-    std::thread                 m_removerThread;
+    Unix::PeerTable<std::shared_ptr<ConnectedClient>>
+                                m_clients;          // a queued task keeps a removed client alive until it runs
+    TimerWheel                  m_wheel;            // lifetimes of the clients
+    std::vector<PeerKey>        m_expired;          // clients expired by the last advance of the wheel
+    coap::ExchangeCache         m_exchanges;        // checked by the receiving thread, filled by the workers or inline
+    std::mutex                  m_exchangesMutex;
     std::atomic<bool>           m_running;
-    std::mutex                  m_mutex;
+    BufferPool                  m_pool;
+    coap::PacketPool            m_packets;          // a request and its answer for every worker
+    std::vector<BufferPool::Handle>
+                                m_batchBuffers;     // receive buffers, handed over to the clients
+    std::vector<UnixSocketAddress>
+                                m_batchAddresses;
+    std::vector<Datagram>       m_batch;
+    coap::RequestLatency        m_latency;          // recorded by the receiving thread and the workers
+    std::uint64_t               m_dropped;          // datagrams dropped for the lack of a free buffer, by the receiving thread
 };
 
 #endif
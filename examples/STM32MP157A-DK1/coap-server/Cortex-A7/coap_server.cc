@@ -256,7 +256,8 @@ CoapServer::CoapServer(
       m_clients{},
       m_threads{},
       m_running{false},
-      m_mutex{}  
+      m_mutex{},
+      m_pool{0, POOL_CAPACITY, 0}
 {
     // start remover thread
     thread newThread(expired_clients_remover_thread, this);
@@ -445,7 +446,22 @@ void CoapServer::receive(error_code &ec)
         debug("[THREAD] [{0:d}] : A new thread has been started", hasher(client->m_threadId));
     }
     // copy recived data to the incomming queue of the apropriate client
-    client->receiveQueue().push(*connection->bufferPtr());
+    BufferPool::Handle message = m_pool.acquire(length);
+    if (!message)
+    {
+        ec = make_system_error(ENOBUFS);
+        debug("no free buffer, the message is dropped");
+        return;
+    }
+    memcpy(message->data(), connection->bufferPtr().get()->data(), length);
+    message->offset(length);
+
+    if (!client->receiveQueue().push(move(message)))
+    {
+        ec = make_system_error(ENOBUFS);
+        debug("the queue of the client is full, the message is dropped");
+        return;
+    }
 
     const sockaddr_in * addr = &((reinterpret_cast<const UnixSocketAddress *>(client->m_clientAddress))->address4());
     const struct in_addr  * sin_addr = &addr->sin_addr;
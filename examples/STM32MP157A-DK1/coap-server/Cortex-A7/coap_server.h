@@ -52,6 +52,10 @@ public:
         );
     ~CoapServer();
 
+public:
+    // maximal quantity of the buffers queued to the clients
+    static const size_t POOL_CAPACITY = 256;
+
 public:
     void receive(std::error_code &ec);
     void processing(ConnectedClient* client);
@@ -109,6 +113,7 @@ private:
     std::thread                 m_removerThread;
     std::atomic<bool>           m_running;
     std::mutex                  m_mutex;
+    BufferPool                  m_pool;             // buffers queued to the clients
 };
 
 #endif
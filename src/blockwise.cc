@@ -1,4 +1,3 @@
-#include <cmath>
 #include <cassert>
 #include <cstdint>
 #ifdef USE_SPDLOG
@@ -6,11 +5,7 @@
 #endif
 #include "blockwise.h"
 #include "consts.h"
-#if defined(__linux__) || defined(__unix__) || defined(__APPLE__)
-#include <arpa/inet.h>
-#else
-#include "lwip/def.h"
-#endif
+#include "byte_order.h"
 
 #ifndef USE_SPDLOG
 #define set_level(level)
@@ -33,106 +28,65 @@ const uint16_t BLOCK_MAX_SIZE  = 1024;
 const uint16_t BLOCK_SIZE_DEFAULT = BLOCK_MAX_SIZE;
 const uint32_t MAX_BLOCKS = 1048576;
 
-const uint8_t BLOCK_OPT_MIN_LEN = 1;
-const uint8_t BLOCK_OPT_MAX_LEN = 3;
-const uint8_t SIZE_OPT_MIN_LEN = 1;
-const uint8_t SIZE_OPT_MAX_LEN = 4;
-
-static inline bool is_block_option_length_correct(uint8_t length)
-{ return !(length < BLOCK_OPT_MIN_LEN || length > BLOCK_OPT_MAX_LEN); }
-
-static inline bool is_size_option_length_correct(uint8_t length)
-{ return !(length < SIZE_OPT_MIN_LEN || length > SIZE_OPT_MAX_LEN); }
-
 bool Blockwise::decode_block_option(const Option &opt)
 {
     set_level(level::debug);
 
-    if (opt.number() != BLOCK_1
-        && opt.number() != BLOCK_2)
+    const ConstByteSpan raw(opt.value().data(), opt.value().size());
+    uint32_t value = 0;
+    bool decoded;
+
+    if (opt.number() == BLOCK_1)
+        decoded = decode_option<BLOCK_1>(raw, value);
+    else if (opt.number() == BLOCK_2)
+        decoded = decode_option<BLOCK_2>(raw, value);
+    else
     {
         debug("There are no any BLOCK options");
         return false;
     }
 
-    const size_t optLen = opt.value().size();
-
-    if(!is_block_option_length_correct(optLen))
+    if (!decoded)
     {
         debug("Wrong size of option");
         return false;
     }
 
-    {
-        uint8_t szx = opt.value()[optLen - 1] & BLOCK_SZX_MASK;
-        m_size = static_cast<uint16_t>(pow(2, szx + 4));
-        m_more = opt.value()[optLen - 1] & (1 << BLOCK_M_BIT);
-    }
-
-    if (optLen == 1)
-    {
-        m_number = static_cast<uint32_t>(opt.value()[0] >> BLOCK_NUM_SHIFT);
-    }
-    else
-    {
-        if (m_littleEndian) //Little endian
-        {
-            m_number = static_cast<uint32_t>(opt.value()[optLen - 1] >> BLOCK_NUM_SHIFT);
-            m_number |= static_cast<uint32_t>(opt.value()[optLen - 2] << BLOCK_NUM_SHIFT);
-            m_number |= (optLen == 3) ? static_cast<uint32_t>(opt.value()[0] << (BLOCK_NUM_SHIFT + 8)) : 0;
-        }
-        else //Big endian
-        {
-            m_number = static_cast<uint32_t>(opt.value()[optLen - 1] << BLOCK_NUM_SHIFT);
-            m_number |= static_cast<uint32_t>(opt.value()[optLen - 2] >> BLOCK_NUM_SHIFT);
-            m_number |= (optLen == 3) ? static_cast<uint32_t>(opt.value()[0] >> (BLOCK_NUM_SHIFT + 8)) : 0;
-        }
-    }
-
+    decode_block_value(value);
     return true;
 }
 
+void Blockwise::decode_block_value(uint32_t value)
+{
+    // RFC7959 2.2 NUM (up to 20 bits) | M (1 bit) | SZX (3 bits)
+    m_size = static_cast<uint16_t>(1 << ((value & BLOCK_SZX_MASK) + 4));
+    m_more = (value & (1 << BLOCK_M_BIT)) != 0;
+    m_number = value >> BLOCK_NUM_SHIFT;
+}
+
 bool Blockwise::decode_size_option(const Option &opt)
 {
     set_level(level::debug);
 
-    if (opt.number() != SIZE_1
-        && opt.number() != SIZE_2)
+    const ConstByteSpan raw(opt.value().data(), opt.value().size());
+    bool decoded;
+
+    if (opt.number() == SIZE_1)
+        decoded = decode_option<SIZE_1>(raw, m_total);
+    else if (opt.number() == SIZE_2)
+        decoded = decode_option<SIZE_2>(raw, m_total);
+    else
     {
         debug("There are no any SIZE options");
         return false;
     }
 
-    const size_t optLen = opt.value().size();
-
-    if(!is_block_option_length_correct(optLen))
+    if (!decoded)
     {
         debug("Wrong size of option");
         return false;
     }
 
-    if (optLen == 1)
-    {
-        m_total = static_cast<uint32_t>(opt.value()[0]);
-    }
-    else
-    {
-        if (m_littleEndian) //Little endian
-        {
-            m_total = static_cast<uint32_t>(opt.value()[optLen - 2] << 8);
-            m_total |= static_cast<uint32_t>(opt.value()[optLen - 1]);
-            m_total |= (optLen >= 3) ? static_cast<uint32_t>(opt.value()[optLen - 3] << 16) : 0;
-            m_total |= (optLen == 4) ? static_cast<uint32_t>(opt.value()[0] << 24) : 0;
-        }
-        else //Big endian
-        {
-            m_total = static_cast<uint32_t>(opt.value()[optLen - 2] >> 8);
-            m_total |= static_cast<uint32_t>(opt.value()[optLen - 1]);
-            m_total |= (optLen >= 3) ? static_cast<uint32_t>(opt.value()[optLen - 3] >> 16) : 0;
-            m_total |= (optLen == 4) ? static_cast<uint32_t>(opt.value()[0] >> 24) : 0;
-        }
-    }
-
     return true;
 }
 
@@ -152,108 +106,65 @@ bool Blockwise::encode_block_option(Option &opt)
         return false;
     }
 
-    Blocksize sizeOpt = size_to_sizeoption(m_size);
-    uint8_t tmp = 0;
-
-    if (m_number < 16) // 2**4 (4 bits)
-    {
-        tmp = static_cast<uint8_t>(m_number << BLOCK_NUM_SHIFT);
-    }
-    else if (m_number < 4096) // 2**12 (12 bits)
-    {
-        if (m_littleEndian)
-        {
-            tmp = static_cast<uint8_t>(m_number & 0xFF) >> BLOCK_NUM_SHIFT;
-            tmp |= static_cast<uint8_t>((m_number >> 8) & 0xFF) << BLOCK_NUM_SHIFT;//Little endian
-            opt.value().push_back(tmp);
-            tmp = static_cast<uint8_t>(m_number & 0xF) << BLOCK_NUM_SHIFT;
-        }
-        else
-        {
-            tmp = static_cast<uint8_t>((m_number >> 24) & 0xFF) >> BLOCK_NUM_SHIFT;
-            tmp |= static_cast<uint8_t>((m_number >> 16) & 0xFF) << BLOCK_NUM_SHIFT;//Big endian
-            opt.value().push_back(tmp);
-            tmp = static_cast<uint8_t>((m_number >> 24) & 0xF) << BLOCK_NUM_SHIFT;
-        }
-    }
-    else if (m_number < MAX_BLOCKS) // 2**20 (20 bits)
-    {
-        if (m_littleEndian)
-        {
-            tmp = static_cast<uint8_t>(m_number & 0xFF);
-            opt.value().push_back(tmp);
-            tmp = static_cast<uint8_t>((m_number >> 8) & 0xFF) >> BLOCK_NUM_SHIFT;
-            tmp |= static_cast<uint8_t>((m_number >> 16) & 0xFF) << BLOCK_NUM_SHIFT;//Little endian
-            opt.value().push_back(tmp);
-            tmp = static_cast<uint8_t>((m_number >> 8) & 0xF) << BLOCK_NUM_SHIFT;
-        }
-        else
-        {
-            tmp = static_cast<uint8_t>((m_number >> 24) & 0xFF);
-            opt.value().push_back(tmp);
-            tmp = static_cast<uint8_t>((m_number >> 16) & 0xFF) >> BLOCK_NUM_SHIFT;
-            tmp |= static_cast<uint8_t>((m_number >> 8) & 0xFF) << BLOCK_NUM_SHIFT;//Big endian
-            opt.value().push_back(tmp);
-            tmp = static_cast<uint8_t>((m_number >> 16) & 0xF) << BLOCK_NUM_SHIFT;
-        }
-    }
-    else
+    if (m_number >= MAX_BLOCKS) // 2**20 (20 bits)
     {
         debug("Invalid block number value");
         return false;
     }
 
-    tmp |= static_cast<uint8_t>(sizeOpt) & BLOCK_SZX_MASK;
-    if (m_more)
-    { tmp |= static_cast<uint8_t>(1 << BLOCK_M_BIT); }
-    else
-    { tmp &= ~(static_cast<uint8_t>(1 << BLOCK_M_BIT)); }
-    opt.value().push_back(tmp);
+    // RFC7959 2.2 NUM | M | SZX as a uint value
+    const uint32_t value = (m_number << BLOCK_NUM_SHIFT)
+                            | (m_more ? (1U << BLOCK_M_BIT) : 0)
+                            | (static_cast<uint32_t>(size_to_sizeoption(m_size)) & BLOCK_SZX_MASK);
+    uint8_t buf[sizeof(uint32_t)];
+    opt.value().assign(buf, encode_uint(value, buf));
 
     return true;
 }
 
 bool Block1::get_header (Packet & pack)
 {
-    vector<Option *> options;
+    OptionList::const_range options;
     if (!get_block1_option(pack, options))
     {
         debug("There is no BLOCK 1 option in the packet");
         return false;
     }
-    if (options.size() > 1)
+    if (options.second - options.first > 1)
     {
         debug("There is more than one BLOCK 1 option in the packet");
         return false;
     }
-    const Option opt = static_cast<const Option>(*options[0]);
-    if (!decode_block_option(opt))
+    uint32_t value;
+    if (!pack.get<BLOCK_1>(value))
     {
         debug("Unable to decode BLOCK1 option");
         return false;
     }
+    decode_block_value(value);
     return true;
 }
 
 bool Block2::get_header (Packet & pack)
 {
-    vector<Option *> options;
+    OptionList::const_range options;
     if (!get_block2_option(pack, options))
     {
         debug("There is no BLOCK 2 option in the packet");
         return false;
     }
-    if (options.size() > 1)
+    if (options.second - options.first > 1)
     {
         debug("There is more than one BLOCK 2 option in the packet");
         return false;
     }
-    const Option opt = static_cast<const Option>(*options[0]);
-    if (!decode_block_option(opt))
+    uint32_t value;
+    if (!pack.get<BLOCK_2>(value))
     {
         debug("Unable to decode BLOCK2 option");
         return false;
     }
+    decode_block_value(value);
     return true;
 }
 
@@ -269,12 +180,12 @@ static bool set_header(
     // clean all options
     pack.options().clear();
     // add option URI_PORT
-    port = htons(port);
+    uint8_t portValue[sizeof(uint16_t)];
     error_code ec;
     pack.add_option(
                 URI_PORT,
-                (const uint8_t *)&port,
-                sizeof(uint16_t),
+                portValue,
+                encode_uint(port, portValue),
                 ec
             );
     if (ec.value())
@@ -331,11 +242,17 @@ bool Block1::set_header (uint16_t port, const UriPath &uri, Packet &pack)
 bool Block2::set_header (std::uint16_t port, const UriPath &uri, Packet &pack)
 { return coap::set_header(this, false, port, uri, pack); }
 
-bool Block1::get_block1_option(Packet &pack, vector<Option *> &rOptions)
-{ return (pack.find_option(BLOCK_1, rOptions) != 0); }
+bool Block1::get_block1_option(const Packet &pack, OptionList::const_range &rOptions)
+{
+    rOptions = pack.find_options(BLOCK_1);
+    return rOptions.first != rOptions.second;
+}
 
-bool Block2::get_block2_option(Packet &pack, std::vector<Option *> &rOptions)
-{ return (pack.find_option(BLOCK_2, rOptions) != 0); }
+bool Block2::get_block2_option(const Packet &pack, OptionList::const_range &rOptions)
+{
+    rOptions = pack.find_options(BLOCK_2);
+    return rOptions.first != rOptions.second;
+}
 
 Blocksize size_to_sizeoption(size_t size)
 {
@@ -0,0 +1,125 @@
+#include "buffer_pool.h"
+#include "free_list.h"
+#include <cassert>
+
+using namespace std;
+using namespace coap;
+
+const size_t BufferPool::SMALL_BUFFER_SIZE;
+const size_t BufferPool::MTU_BUFFER_SIZE;
+const size_t BufferPool::LARGE_BUFFER_SIZE;
+
+BufferPool::BufferPool(size_t smallCapacity, size_t mtuCapacity, size_t largeCapacity)
+{
+    const size_t capacities[SIZE_CLASSES] = { smallCapacity, mtuCapacity, largeCapacity };
+
+    for (size_t c = 0; c < SIZE_CLASSES; ++c)
+    {
+        SizeClassPool &pool = m_classes[c];
+        const size_t capacity = capacities[c];
+
+        assert(capacity < FREE_LIST_END);
+
+        pool.bufferSize = buffer_size(static_cast<SizeClass>(c));
+        pool.capacity = capacity;
+        pool.slots.reset(new Slot [capacity]);
+        pool.next.reset(new atomic<uint16_t> [capacity]);
+        free_list_init(pool.head, pool.next.get(), capacity);
+        pool.allocated.store(0, memory_order_relaxed);
+        pool.inUse.store(0, memory_order_relaxed);
+        pool.highWater.store(0, memory_order_relaxed);
+        pool.exhausted.store(0, memory_order_relaxed);
+
+        for (size_t i = 0; i < capacity; ++i)
+        {
+            pool.slots[i].references.store(0, memory_order_relaxed);
+            pool.slots[i].owner = &pool;
+            pool.slots[i].index = static_cast<uint16_t>(i);
+        }
+    }
+    atomic_thread_fence(memory_order_release);
+}
+
+size_t BufferPool::buffer_size(SizeClass sizeClass)
+{
+    switch (sizeClass)
+    {
+        case SMALL_BUFFER:
+            return SMALL_BUFFER_SIZE;
+        case MTU_BUFFER:
+            return MTU_BUFFER_SIZE;
+        case LARGE_BUFFER:
+            return LARGE_BUFFER_SIZE;
+        default:
+            break;
+    }
+    return 0;
+}
+
+BufferPool::Handle BufferPool::acquire(size_t length)
+{
+    for (size_t c = 0; c < SIZE_CLASSES; ++c)
+    {
+        if (length > m_classes[c].bufferSize)
+            continue;
+
+        Handle handle = acquire(static_cast<SizeClass>(c));
+        if (handle)
+            return handle;
+    }
+    return Handle();
+}
+
+BufferPool::Handle BufferPool::acquire(SizeClass sizeClass)
+{
+    assert(sizeClass < SIZE_CLASSES);
+
+    SizeClassPool &pool = m_classes[sizeClass];
+    const uint32_t index = free_list_pop(pool.head, pool.next.get());
+    if (index == FREE_LIST_END)
+    {
+        pool.exhausted.fetch_add(1, memory_order_relaxed);
+        return Handle();
+    }
+
+    Slot &slot = pool.slots[index];
+
+    // the slot belongs to this thread now, nobody else touches its buffer
+    if (!slot.buffer)
+    {
+        slot.buffer.reset(new Buffer(pool.bufferSize, false));
+        pool.allocated.fetch_add(1, memory_order_relaxed);
+    }
+    slot.references.store(1, memory_order_relaxed);
+
+    const size_t inUse = pool.inUse.fetch_add(1, memory_order_relaxed) + 1;
+    size_t highWater = pool.highWater.load(memory_order_relaxed);
+    while (inUse > highWater
+            && !pool.highWater.compare_exchange_weak(highWater, inUse, memory_order_relaxed))
+        ;
+
+    return Handle(&slot);
+}
+
+void BufferPool::release(Slot &slot)
+{
+    SizeClassPool &pool = *slot.owner;
+
+    slot.buffer->reset();
+    free_list_push(pool.head, pool.next.get(), slot.index);
+    pool.inUse.fetch_sub(1, memory_order_relaxed);
+}
+
+BufferPool::Statistics BufferPool::statistics(SizeClass sizeClass) const
+{
+    assert(sizeClass < SIZE_CLASSES);
+
+    const SizeClassPool &pool = m_classes[sizeClass];
+    Statistics stats;
+    stats.capacity = pool.capacity;
+    stats.allocated = pool.allocated.load(memory_order_relaxed);
+    stats.inUse = pool.inUse.load(memory_order_relaxed);
+    stats.highWater = pool.highWater.load(memory_order_relaxed);
+    stats.exhausted = pool.exhausted.load(memory_order_relaxed);
+    return stats;
+}
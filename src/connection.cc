@@ -0,0 +1,74 @@
+#include "connection.h"
+#include "packet.h"
+#include <cassert>
+#include <vector>
+
+using namespace std;
+using namespace coap;
+
+// The header, the token and the options of almost every message fit here
+static const size_t PACKET_HEADER_BUFFER_SIZE = 256;
+
+void Connection::sendmsg(const IoBuffer * buffers, size_t count, const SocketAddress *destAddr, error_code &ec)
+{
+    assert(buffers != nullptr);
+
+    if (buffers == nullptr)
+    {
+        ec = make_system_error(EFAULT);
+        return;
+    }
+
+    uint8_t * data = m_bufferPtr->data();
+    size_t length = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (length + buffers[i].length > m_bufferPtr->length())
+        {
+            ec = make_error_code(CoapStatus::COAP_ERR_BUFFER_SIZE);
+            return;
+        }
+        if (buffers[i].length)
+            memcpy(data + length, buffers[i].data, buffers[i].length);
+        length += buffers[i].length;
+    }
+
+    send(data, length, destAddr, ec);
+}
+
+void send_packet(Connection &connection, const Packet &packet, const SocketAddress *destAddr, error_code &ec)
+{
+    ec.clear();
+
+    uint8_t buffer[PACKET_HEADER_BUFFER_SIZE];
+    vector<uint8_t> largeBuffer; // too many options, the connection buffer is shared by the senders
+    uint8_t * header = buffer;
+    const size_t headerSize = packet.header_encoded_size();
+
+    if (headerSize > sizeof(buffer))
+    {
+        largeBuffer.resize(headerSize);
+        header = largeBuffer.data();
+    }
+
+    packet.serialize_header(ByteSpan(header, headerSize), ec);
+    if (ec)
+        return;
+
+    IoBuffer parts[2];
+    size_t count = 0;
+
+    parts[count].data = header;
+    parts[count].length = headerSize;
+    ++count;
+
+    if (packet.payload().size())
+    {
+        parts[count].data = packet.payload().data();
+        parts[count].length = packet.payload().size();
+        ++count;
+    }
+
+    connection.sendmsg(parts, count, destAddr, ec);
+}
@@ -82,14 +82,14 @@ void CoreLink::parse_core_link(const char *coreLink, std::error_code &ec)
 
 	size_t length = strlen(coreLink);
 
-	char *buffer = new char [length];
+	char *buffer = new char [length + 1];
 	if (buffer == nullptr)
 	{
 		ec = make_error_code(CoapStatus::COAP_ERR_MEMORY_ALLOCATE);
 		return;
 	}
 
-	memcpy(buffer, coreLink, length);
+	memcpy(buffer, coreLink, length + 1); // strtok() needs the terminator
 
 	char *token = strtok(buffer, recordSeparator);
 	while(token != NULL)
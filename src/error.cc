@@ -130,6 +130,9 @@ std::string CoapErrorCategory::message(int ev) const
 
         case CoapStatus::COAP_ERR_PARSE_CORE_LINK:
             return "Failed to parse CoRe-Link content";
+
+        case CoapStatus::COAP_ERR_BAD_OPTION:
+            return "Unrecognized or malformed critical option";
     }
     return "Unknown error";
 }
@@ -0,0 +1,231 @@
+#include "exchange_cache.h"
+#include "packet.h"
+#include "random.h"
+#include <cassert>
+#include <cstring>
+
+using namespace std;
+
+namespace coap
+{
+
+const size_t ExchangeCache::RESPONSE_SIZE_MAX;
+const uint32_t ExchangeCache::EMPTY_INDEX;
+
+static const size_t INDEX_SIZE_MIN = 16;
+
+ExchangeCache::ExchangeCache(size_t capacity, size_t responses, Clock::duration lifetime, Eviction eviction)
+    : m_capacity{capacity},
+      m_lifetime{lifetime},
+      m_eviction{eviction},
+      m_seed{fast_random()},
+      m_responses{responses, responses, 0},
+      m_entries{new Entry[capacity]},
+      m_index{},
+      m_head{0},
+      m_size{0},
+      m_statistics{0, 0, 0, 0, 0, 0}
+{
+    assert(capacity > 0 && capacity < UINT32_MAX);
+
+    // the load factor stays at a half at most, so the probe chains are short
+    size_t indexSize = INDEX_SIZE_MIN;
+    while (indexSize < capacity * 2)
+        indexSize <<= 1;
+    m_index.assign(indexSize, EMPTY_INDEX);
+}
+
+size_t ExchangeCache::lookup(const PeerKey &peer, uint16_t messageId, uint64_t h) const
+{
+    for (size_t i = h & mask(); m_index[i] != EMPTY_INDEX; i = (i + 1) & mask())
+    {
+        const Entry &entry = m_entries[m_index[i] - 1];
+        if (entry.hash == h && entry.messageId == messageId && entry.peer == peer)
+            return i;
+    }
+    return mask() + 1;
+}
+
+void ExchangeCache::unlink(size_t hole)
+{
+    // backward shift deletion, as in the peer table
+    m_index[hole] = EMPTY_INDEX;
+    for (size_t i = (hole + 1) & mask(); m_index[i] != EMPTY_INDEX; i = (i + 1) & mask())
+    {
+        const size_t home = m_entries[m_index[i] - 1].hash & mask();
+        const bool movable = hole <= i
+                            ? (home <= hole || home > i)
+                            : (home <= hole && home > i);
+        if (!movable)
+            continue;
+
+        m_index[hole] = m_index[i];
+        m_index[i] = EMPTY_INDEX;
+        hole = i;
+    }
+}
+
+void ExchangeCache::pop()
+{
+    assert(m_size > 0);
+
+    Entry &oldest = m_entries[m_head];
+    if (oldest.indexed)
+    {
+        size_t position = oldest.hash & mask();
+        while (m_index[position] != m_head + 1)
+            position = (position + 1) & mask();
+        unlink(position);
+        oldest.indexed = false;
+    }
+
+    oldest.response.reset();
+    m_head = (m_head + 1) % m_capacity;
+    --m_size;
+}
+
+void ExchangeCache::expire(Clock::time_point now)
+{
+    // the exchanges share one lifetime, the oldest one expires first
+    while (m_size > 0 && m_entries[m_head].expires <= now)
+    {
+        pop();
+        ++m_statistics.expired;
+    }
+}
+
+ExchangeCache::Lookup ExchangeCache::check(
+                        const PeerKey &peer,
+                        uint16_t messageId,
+                        BufferPool::Handle &response,
+                        Clock::time_point now
+                    )
+{
+    expire(now);
+
+    const uint64_t h = hash(peer, messageId);
+    const size_t position = lookup(peer, messageId, h);
+    if (position <= mask())
+    {
+        ++m_statistics.hits;
+        const Entry &entry = m_entries[m_index[position] - 1];
+        if (!entry.response)
+            return IN_PROGRESS;
+
+        ++m_statistics.replays;
+        response = entry.response;
+        return REPLAY;
+    }
+
+    ++m_statistics.misses;
+    if (m_size == m_capacity)
+    {
+        if (m_eviction == REJECT_NEW)
+        {
+            ++m_statistics.rejected;
+            return FIRST;
+        }
+        pop();
+        ++m_statistics.evicted;
+    }
+
+    const size_t slot = (m_head + m_size) % m_capacity;
+    Entry &entry = m_entries[slot];
+    entry.peer = peer;
+    entry.hash = h;
+    entry.expires = now + m_lifetime;
+    entry.messageId = messageId;
+    entry.indexed = true;
+
+    size_t i = h & mask();
+    while (m_index[i] != EMPTY_INDEX)
+        i = (i + 1) & mask();
+    m_index[i] = static_cast<uint32_t>(slot + 1);
+    ++m_size;
+    return FIRST;
+}
+
+BufferPool::Handle ExchangeCache::response_buffer(const PeerKey &peer, uint16_t messageId, size_t length, size_t &slot)
+{
+    const size_t position = lookup(peer, messageId, hash(peer, messageId));
+    if (position > mask())
+        return BufferPool::Handle();
+
+    if (length > RESPONSE_SIZE_MAX)
+    {
+        ++m_statistics.rejected;
+        return BufferPool::Handle();
+    }
+
+    slot = m_index[position] - 1;
+    BufferPool::Handle buffer = m_responses.acquire(length);
+
+    // the older exchanges give their buffers up, the responded one stays
+    while (!buffer && m_eviction == EVICT_OLDEST && m_head != slot)
+    {
+        pop();
+        ++m_statistics.evicted;
+        buffer = m_responses.acquire(length);
+    }
+
+    if (!buffer)
+        ++m_statistics.rejected;
+    return buffer;
+}
+
+bool ExchangeCache::respond(const PeerKey &peer, uint16_t messageId, const void *data, size_t length)
+{
+    size_t slot;
+    BufferPool::Handle buffer = response_buffer(peer, messageId, length, slot);
+    if (!buffer)
+        return false;
+
+    memcpy(buffer->data(), data, length);
+    buffer->offset(length);
+    m_entries[slot].response = std::move(buffer);
+    return true;
+}
+
+bool ExchangeCache::respond(const PeerKey &peer, uint16_t messageId, const Packet &response)
+{
+    size_t slot;
+    BufferPool::Handle buffer = response_buffer(peer, messageId, response.encoded_size(), slot);
+    if (!buffer)
+        return false;
+
+    std::error_code ec;
+    buffer->offset(response.serialize(ByteSpan(buffer->data(), buffer->length()), ec));
+    if (ec)
+        return false;
+
+    m_entries[slot].response = std::move(buffer);
+    return true;
+}
+
+bool ExchangeCache::forget(const PeerKey &peer, uint16_t messageId)
+{
+    const size_t position = lookup(peer, messageId, hash(peer, messageId));
+    if (position > mask())
+        return false;
+
+    const size_t slot = m_index[position] - 1;
+    unlink(position);
+
+    Entry &entry = m_entries[slot];
+    entry.indexed = false;
+    entry.response.reset();
+
+    // the message is usually dropped right after its check, so the exchange is the newest one
+    // and gives its place back; an older one stays in the ring until it expires
+    if (slot == (m_head + m_size - 1) % m_capacity)
+        --m_size;
+    return true;
+}
+
+void ExchangeCache::clear()
+{
+    while (m_size > 0)
+        pop();
+}
+
+} // namespace coap
@@ -0,0 +1,61 @@
+#ifndef _FREE_LIST_H
+#define _FREE_LIST_H
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace coap
+{
+
+// Lock-free stack of the free slots of a pool (Treiber stack), shared by PacketPool and BufferPool.
+// next[i] links the free slot i to the following one, the head holds the first free slot.
+// The upper half of the head is a version counter bumped on every change,
+// it prevents a stale compare-and-swap from succeeding (ABA problem).
+
+// Index of the list end, so a pool holds less than 65535 slots
+static const std::uint32_t FREE_LIST_END = 0xFFFF;
+
+inline std::uint32_t free_list_index(std::uint32_t head)
+{ return head & 0xFFFF; }
+
+inline std::uint32_t free_list_head(std::uint32_t head, std::uint32_t index)
+{ return (((head >> 16) + 1) << 16) | index; }
+
+// links all the slots in the order of their indices, not thread-safe
+inline void free_list_init(std::atomic<std::uint32_t> &head, std::atomic<std::uint16_t> *next, std::size_t capacity)
+{
+    for (std::size_t i = 0; i < capacity; ++i)
+        next[i].store(static_cast<std::uint16_t>(i + 1 < capacity ? i + 1 : FREE_LIST_END), std::memory_order_relaxed);
+    head.store(capacity ? 0 : FREE_LIST_END, std::memory_order_release);
+}
+
+// takes a free slot, FREE_LIST_END if there is none
+inline std::uint32_t free_list_pop(std::atomic<std::uint32_t> &head, const std::atomic<std::uint16_t> *next)
+{
+    std::uint32_t current = head.load(std::memory_order_acquire);
+
+    while (free_list_index(current) != FREE_LIST_END)
+    {
+        const std::uint32_t following = next[free_list_index(current)].load(std::memory_order_relaxed);
+        if (head.compare_exchange_weak(current, free_list_head(current, following),
+                                       std::memory_order_acq_rel, std::memory_order_acquire))
+            return free_list_index(current);
+    }
+    return FREE_LIST_END;
+}
+
+// returns the slot, the writes to it are visible to the next thread taking it
+inline void free_list_push(std::atomic<std::uint32_t> &head, std::atomic<std::uint16_t> *next, std::uint32_t index)
+{
+    std::uint32_t current = head.load(std::memory_order_relaxed);
+    do
+    {
+        next[index].store(static_cast<std::uint16_t>(free_list_index(current)), std::memory_order_relaxed);
+    }
+    while (!head.compare_exchange_weak(current, free_list_head(current, index),
+                                       std::memory_order_release, std::memory_order_relaxed));
+}
+
+} // namespace coap
+
+#endif
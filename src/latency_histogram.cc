@@ -0,0 +1,140 @@
+#include "latency_histogram.h"
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+namespace coap
+{
+
+const size_t LatencyHistogram::SUB_BUCKET_BITS;
+const size_t LatencyHistogram::SUB_BUCKETS;
+const size_t LatencyHistogram::BUCKETS;
+
+// position of the highest set bit, value is not zero
+static unsigned highest_bit(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - static_cast<unsigned>(__builtin_clzll(value));
+#else
+    unsigned bit = 0;
+    while (value >>= 1)
+        ++bit;
+    return bit;
+#endif
+}
+
+size_t LatencyHistogram::bucket(uint64_t value)
+{
+    if (value < SUB_BUCKETS)
+        return static_cast<size_t>(value);
+
+    // the highest bit picks the power of two, the next SUB_BUCKET_BITS ones the sub-bucket
+    const unsigned exponent = highest_bit(value);
+    const size_t sub = static_cast<size_t>(value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::upper_bound(size_t index)
+{
+    if (index < SUB_BUCKETS)
+        return index;
+
+    const unsigned shift = static_cast<unsigned>(index / SUB_BUCKETS - 1);
+    const uint64_t lower = static_cast<uint64_t>(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    return lower + ((static_cast<uint64_t>(1) << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+    m_buckets[bucket(nanoseconds)].fetch_add(1, memory_order_relaxed);
+    m_sum.fetch_add(nanoseconds, memory_order_relaxed);
+    update_min(nanoseconds);
+    update_max(nanoseconds);
+    m_count.fetch_add(1, memory_order_relaxed);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    if (!other.count())
+        return;
+
+    for (size_t i = 0; i < BUCKETS; ++i)
+    {
+        const uint64_t samples = other.m_buckets[i].load(memory_order_relaxed);
+        if (samples)
+            m_buckets[i].fetch_add(samples, memory_order_relaxed);
+    }
+    m_sum.fetch_add(other.m_sum.load(memory_order_relaxed), memory_order_relaxed);
+    update_min(other.m_min.load(memory_order_relaxed));
+    update_max(other.m_max.load(memory_order_relaxed));
+    m_count.fetch_add(other.count(), memory_order_relaxed);
+}
+
+void LatencyHistogram::reset()
+{
+    for (size_t i = 0; i < BUCKETS; ++i)
+        m_buckets[i].store(0, memory_order_relaxed);
+    m_count.store(0, memory_order_relaxed);
+    m_sum.store(0, memory_order_relaxed);
+    m_min.store(numeric_limits<uint64_t>::max(), memory_order_relaxed);
+    m_max.store(0, memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::min() const
+{
+    const uint64_t value = m_min.load(memory_order_relaxed);
+    return value == numeric_limits<uint64_t>::max() && !count() ? 0 : value;
+}
+
+uint64_t LatencyHistogram::mean() const
+{
+    const uint64_t samples = count();
+    return samples ? m_sum.load(memory_order_relaxed) / samples : 0;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+    // the buckets are read one by one, their sum is the quantity of the samples seen here
+    uint64_t total = 0;
+    for (size_t i = 0; i < BUCKETS; ++i)
+        total += m_buckets[i].load(memory_order_relaxed);
+    if (!total)
+        return 0;
+
+    if (p < 0) p = 0;
+    if (p > 100) p = 100;
+    uint64_t rank = static_cast<uint64_t>(ceil(p / 100 * static_cast<double>(total)));
+    if (rank == 0) rank = 1;
+    if (rank > total) rank = total;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i)
+    {
+        seen += m_buckets[i].load(memory_order_relaxed);
+        if (seen >= rank)
+        {
+            // the bucket may reach beyond the greatest sample
+            const uint64_t bound = upper_bound(i);
+            const uint64_t greatest = max();
+            return greatest && greatest < bound ? greatest : bound;
+        }
+    }
+    return max();
+}
+
+void LatencyHistogram::update_min(uint64_t value)
+{
+    uint64_t current = m_min.load(memory_order_relaxed);
+    while (value < current && !m_min.compare_exchange_weak(current, value, memory_order_relaxed))
+        ;
+}
+
+void LatencyHistogram::update_max(uint64_t value)
+{
+    uint64_t current = m_max.load(memory_order_relaxed);
+    while (value > current && !m_max.compare_exchange_weak(current, value, memory_order_relaxed))
+        ;
+}
+
+} // namespace coap
@@ -162,6 +162,50 @@ ssize_t LwipSocket::sendto(
     return sent;
 }
 
+ssize_t LwipSocket::sendmsg(
+            const IoBuffer * buffers,
+            size_t count,
+            const SocketAddress * addr,
+            error_code &ec
+        )
+{
+    if (buffers == nullptr || addr == nullptr)
+    {
+        ec = make_system_error(EFAULT);
+        return -1;
+    }
+    if (!count || count > IO_BUFFERS_MAX || !is_socket_type(addr->type()))
+    {
+        ec = make_system_error(EINVAL);
+        return -1;
+    }
+
+    struct iovec iov[IO_BUFFERS_MAX];
+    for (size_t i = 0; i < count; ++i)
+    {
+        iov[i].iov_base = const_cast<void *>(buffers[i].data);
+        iov[i].iov_len = buffers[i].length;
+    }
+
+    size_t sz;
+    const struct sockaddr * sap = extract_sockaddr(addr, sz);
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = const_cast<struct sockaddr *>(sap);
+    msg.msg_namelen = static_cast<socklen_t>(sz);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+
+    ssize_t sent = ::lwip_sendmsg (m_descriptor, &msg, MSG_CONFIRM);
+    if (sent < 0)
+    {
+        ec = make_system_error(errno);
+        return -1;
+    }
+    return sent;
+}
+
 ssize_t LwipSocket::recvfrom(
             error_code &ec,
             void * buf,
@@ -13,6 +13,7 @@
 #undef accept 
 #undef sendto
 #undef recvfrom 
+#undef sendmsg
 #undef bind
 #undef listen
 #undef setsockoption
@@ -91,6 +92,7 @@ public:
     void connect(const SocketAddress * addr, std::error_code &ec) override;
     ssize_t sendto(const void * buf, std::size_t len, const SocketAddress * addr, std::error_code &ec) override;
     ssize_t recvfrom(std::error_code &ec, void * buf, std::size_t len, SocketAddress * addr = nullptr) override;
+    ssize_t sendmsg(const IoBuffer * buffers, std::size_t count, const SocketAddress * addr, std::error_code &ec) override;
     void bind(const SocketAddress * addr, std::error_code &ec) override;
     Socket * accept(std::error_code * ec = nullptr) override;
     void listen(std::error_code &ec, int max_connections_in_queue = 1) override;
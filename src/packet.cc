@@ -1,4 +1,7 @@
 #include "packet.h"
+#include "packet_view.h"
+#include "random.h"
+#include "byte_order.h"
 //#include "spdlog/spdlog.h"
 #include <cstdlib>
 #include <climits>
@@ -12,221 +15,107 @@ using namespace std;
 namespace coap
 {
 
-bool Message::generate_token(const std::size_t len)
+struct OptionNumberLess
 {
-    if (len > TOKEN_MAX_LENGTH)
-        return false;
-
-    static bool initialized = false;
-
-    if (!initialized )
-    {
-        std::srand(time(nullptr));
-        initialized  = true;
-    }
-
-    for (std::size_t i = 0; i < len; i++)
-    {
-        m_token[i] = static_cast<uint8_t>(rand() % (UCHAR_MAX + 1));
-    }
-
-    token_length(len);
+    bool operator()(const Option &opt, uint16_t number) const
+    { return opt.number() < number; }
 
-    return true;
-}
+    bool operator()(uint16_t number, const Option &opt) const
+    { return number < opt.number(); }
+};
 
-void Packet::parse_header(const void * buffer, size_t size, error_code &ec)
+OptionList::iterator OptionList::insert(Option &&opt)
 {
-    assert(buffer != nullptr);
-    assert(size >= PACKET_MIN_LENGTH);
-
-    ec.clear();
+    const uint16_t number = opt.number();
 
-    if (buffer == nullptr)
-    {
-        ec = make_system_error(EFAULT);
-        return;
-    }
-
-    if (size < PACKET_MIN_LENGTH)
-    {
-        ec = make_system_error(EINVAL);
-        return;
-    }
+    if (in_bitmap(number))
+        m_present |= bit(number);
 
-    const uint8_t * buf = static_cast<const uint8_t *>(buffer);
+    m_encodedSizeValid = false;
 
-    header_as_byte(buf[0]);
-
-    if (COAP_VERSION != version())
+    if (m_options.empty() || m_options.back().number() <= number)
     {
-        ec = make_error_code(CoapStatus::COAP_ERR_PROTOCOL_VERSION);
-        return;
+        m_options.push_back(std::move(opt));
+        return m_options.end() - 1;
     }
 
-    code_as_byte(buf[1]);
-
-    if (m_littleEndian)
-        identity(static_cast<std::uint16_t>(buf[3] | (buf[2] << 8)));
-    else
-        identity(static_cast<std::uint16_t>(buf[2] | (buf[3] << 8)));
+    // after the last option with the same number to keep repeatable options in order
+    container_type::iterator pos = std::upper_bound(m_options.begin(), m_options.end(), number, OptionNumberLess());
+    return m_options.insert(pos, std::move(opt));
 }
 
-void Packet::parse_token(const void * buffer, size_t size, std::error_code &ec)
+bool OptionList::contains(uint16_t number) const
 {
-    assert(buffer != nullptr);
-
-    ec.clear();
-
-    if (buffer == nullptr)
-    {
-        ec = make_system_error(EFAULT);
-        return;
-    }
-
-    if (token_length() > TOKEN_MAX_LENGTH)
-    {
-        ec = make_error_code(CoapStatus::COAP_ERR_TOKEN_LENGTH);
-        return;
-    }
-
-    if (size < PACKET_HEADER_SIZE + token_length())
-    {
-        ec = make_system_error(EINVAL);
-        return;
-    }
-
-    const uint8_t * buf = static_cast<const uint8_t *>(buffer);
-
-    memcpy(token().data(), &buf[PACKET_HEADER_SIZE], token_length());
+    if (in_bitmap(number))
+        return (m_present & bit(number)) != 0;
+    return std::binary_search(m_options.begin(), m_options.end(), number, OptionNumberLess());
 }
 
-static bool parse_option(
-        const uint8_t * buffer,
-        size_t size,
-        uint8_t parsing,
-        uint16_t &modifying,
-        size_t &offset,
-        bool littleEndian
-    )
+OptionList::const_range OptionList::equal_range(uint16_t number) const
 {
-    assert(buffer != nullptr);
-
-    if (buffer == nullptr)
-        return false;
-
-    if (parsing == MINUS_THIRTEEN)
-    {
-        if (offset + 1 > size)
-            return false;
-        modifying = buffer[offset + 1] + MINUS_THIRTEEN_OPT_VALUE;
-        offset += sizeof(uint8_t);
-    }
-    else if (parsing == MINUS_TWO_HUNDRED_SIXTY_NINE)
-    {
-        if (offset + 2 > size)
-            return false;
-        if (littleEndian)
-            modifying = buffer[offset + 1] | (buffer[offset + 2] << 8);
-        else
-            modifying = buffer[offset + 2] | (buffer[offset + 1] << 8);
-        modifying += MINUS_TWO_HUNDRED_SIXTY_NINE_OPT_VALUE;
-        offset += sizeof(uint16_t);
-    }
-    else if (parsing == RESERVED_FOR_FUTURE)
-        return false;
-
-    return true;
+    if (in_bitmap(number) && !(m_present & bit(number)))
+        return const_range(m_options.end(), m_options.end());
+    return std::equal_range(m_options.begin(), m_options.end(), number, OptionNumberLess());
 }
 
-void Packet::parse_options(const void * buffer, size_t size, std::error_code &ec)
+OptionList::iterator OptionList::erase(const_iterator first, const_iterator last)
 {
-    assert(buffer != nullptr);
-
-    ec.clear();
-
-    if (buffer == nullptr)
-    {
-        ec = make_system_error(EFAULT);
-        return;
-    }
-
-    const uint8_t * buf = static_cast<const uint8_t *>(buffer);
-    const size_t start_offset = PACKET_HEADER_SIZE + token_length();
-
-    options().clear();
+    iterator pos = m_options.erase(first, last);
+    rebuild_bitmap();
+    m_encodedSizeValid = false;
+    return pos;
+}
 
-    uint16_t optDelta = 0;
-    uint16_t optLength = 0;
-    uint16_t optNumber = 0;
-    Option opt;
+size_t OptionList::erase(uint16_t number)
+{
+    range r = equal_range(number);
+    size_t quantity = static_cast<size_t>(r.second - r.first);
+    if (quantity)
+        erase(r.first, r.second);
+    return quantity;
+}
 
-    size_t offset = start_offset;
-    for (; buf[offset] !=  PAYLOAD_MARKER && offset < size; offset += optLength)
+void OptionList::rebuild_bitmap()
+{
+    m_present = 0;
+    for (const Option &opt : m_options)
     {
-        opt.header_as_byte(buf[offset]);
-        optDelta = opt.delta();
-        optLength = opt.length();
-
-        if ( !parse_option(buf, size, opt.delta(), optDelta, offset, m_littleEndian) )
-        {
-            ec = make_error_code(CoapStatus::COAP_ERR_OPTION_DELTA);
-            return;
-        }
-
-        if ( !parse_option(buf, size, opt.length(), optLength, offset, m_littleEndian) )
-        {
-            ec = make_error_code(CoapStatus::COAP_ERR_OPTION_LENGTH);
-            return;
-        }
-
-        ++offset;
-
-        if (offset + optLength > size)
-        {
-            ec = make_error_code(CoapStatus::COAP_ERR_OPTION_LENGTH);
-            return;
-        }
-
-        optNumber += optDelta;
-        opt.number(optNumber);
-
-        for (int i = 0; i < optLength; i++)
-        {
-            opt.value().push_back(buf[offset + i]);
-        }
-
-        options().push_back(opt);
-        opt.clear();
+        if (in_bitmap(opt.number()))
+            m_present |= bit(opt.number());
     }
-
-    payload_offset(offset + sizeof(PAYLOAD_MARKER));
 }
 
-void Packet::parse_payload(const void * buffer, size_t size, std::error_code &ec)
+void Message::reset()
 {
-    assert(buffer != nullptr);
-    assert(size >= payload_offset());
+    m_header.asByte = 0;
+    m_code.asByte = 0;
+    m_identity = 0;
+    m_token.fill(0);
+    m_options.clear();
+    m_payloadOffset = 0;
+    m_payload.clear();
+}
 
-    ec.clear();
+bool Message::generate_token(const std::size_t len, bool secure)
+{
+    if (len > TOKEN_MAX_LENGTH)
+        return false;
 
-    if (buffer == nullptr)
+    if (secure)
     {
-        ec = make_system_error(EFAULT);
-        return;
+        error_code ec;
+        secure_random_bytes(m_token.data(), len, ec);
+        if (ec)
+            return false;
     }
-
-    if (size < payload_offset())
+    else
     {
-        ec = make_system_error(EINVAL);
-        return;
+        fast_random_bytes(m_token.data(), len);
     }
 
-    const uint8_t * buf = static_cast<const uint8_t *>(buffer);
-    const size_t maxPayloadOffset = size - payload_offset();
+    token_length(len);
 
-    for (size_t i = 0; i < maxPayloadOffset; i++)
-        payload().push_back(buf[payload_offset() + i]);
+    return true;
 }
 
 void Packet::parse(const void * buffer, size_t size, std::error_code &ec)
@@ -248,16 +137,32 @@ void Packet::parse(const void * buffer, size_t size, std::error_code &ec)
         return;
     }
 
-    parse_header(buffer, size, ec);
-    if (ec) return;
+    PacketView view;
 
-    parse_token(buffer, size, ec);
+    view.parse(buffer, size, ec);
     if (ec) return;
 
-    parse_options(buffer, size, ec);
-    if (ec) return;
+    header_as_byte(view.header_as_byte());
+    code_as_byte(view.code_as_byte());
+    identity(view.identity());
+
+    memcpy(token().data(), view.token().data(), view.token_length());
+
+    options().clear();
+    options().reserve(view.options_count());
+
+    for (const OptionView &optView : view)
+    {
+        Option opt;
+        opt.header_as_byte(optView.header_as_byte());
+        opt.number(optView.number());
+        opt.value().assign(optView.value().begin(), optView.value().end());
+        // the options of a valid message are ordered, so each one is appended to the end
+        options().insert(std::move(opt));
+    }
 
-    parse_payload(buffer, size, ec);
+    payload_offset(view.payload_offset());
+    payload().assign(view.payload().begin(), view.payload().end());
 }
 
 void Packet::add_option(
@@ -267,9 +172,14 @@ void Packet::add_option(
         error_code &ec
     )
 {
+    const OptionProperties * properties = find_option_properties(number);
+    // the registered limit only raises the generic one, for example for Proxy-Uri
+    const size_t maxLength = (properties && properties->maxLength > OPTION_MAX_LENGTH)
+                                ? properties->maxLength : OPTION_MAX_LENGTH;
+
     assert(value != nullptr);
-    assert(number <= OPTION_MAX_NUMBER);
-    assert(length <= OPTION_MAX_LENGTH);
+    assert(properties != nullptr);
+    assert(length <= maxLength);
 
     ec.clear();
     if (value == nullptr)
@@ -278,15 +188,15 @@ void Packet::add_option(
         return;
     }
 
-    if (number > OPTION_MAX_NUMBER)
+    if (properties == nullptr)
     {
         ec = make_error_code(CoapStatus::COAP_ERR_OPTION_NUMBER);
         return;
     }
 
-    if (length > OPTION_MAX_LENGTH)
+    if (length > maxLength)
     {
-        ec = make_error_code(CoapStatus::COAP_ERR_OPTION_NUMBER);
+        ec = make_error_code(CoapStatus::COAP_ERR_OPTION_LENGTH);
         return;
     }
 
@@ -294,248 +204,223 @@ void Packet::add_option(
     opt.header_as_byte(0);
     opt.number(static_cast<std::uint8_t>(number));
 
-    const uint8_t * val = static_cast<const uint8_t *>(value);
-    for(size_t i = 0; i < length; ++i)
-    {
-        opt.value().push_back(val[i]);
-    }
+    opt.value().assign(static_cast<const uint8_t *>(value), length);
 
-    options().push_back(opt);
-    sort_options();
+    options().insert(std::move(opt));
 }
 
-size_t Packet::find_option(const std::uint16_t number, std::vector<Option *> &rOptions)
+size_t Packet::find_option(const std::uint16_t number, std::vector<const Option *> &rOptions)
 {
-    size_t index = 0 , size = options().size();
-    size_t quantity = 0;
     rOptions.clear();
 
-    sort_options();
+    OptionList::const_range found = options().equal_range(number);
 
-    while (index < size)
-    {
-        if (options()[index].number() == number)
-        {
-            // the option is found
-            do {
-                ++quantity;
-                rOptions.push_back(&options()[index]);
-            } while (++index < size && options()[index].number() == number); // search forward
+    for (OptionList::const_iterator it = found.first; it != found.second; ++it)
+        rOptions.push_back(&*it);
 
-            return quantity;
-        }
-        else
-        {
-            index++;
-        }
-    }
-    return quantity;
+    return rOptions.size();
 }
 
-size_t Packet::get_option_nibble(size_t value)
+static inline size_t get_option_nibble(size_t value)
 {
-    size_t nibble = 0;
+    if (value < MINUS_THIRTEEN_OPT_VALUE)
+        return value;
+    else if (value < MINUS_TWO_HUNDRED_SIXTY_NINE_OPT_VALUE)
+        return MINUS_THIRTEEN;
+    return MINUS_TWO_HUNDRED_SIXTY_NINE;
+}
 
+static inline size_t get_option_extended_size(size_t value)
+{
     if (value < MINUS_THIRTEEN_OPT_VALUE)
+        return 0;
+    else if (value < MINUS_TWO_HUNDRED_SIXTY_NINE_OPT_VALUE)
+        return sizeof(uint8_t);
+    return sizeof(uint16_t);
+}
+
+static inline uint8_t * make_option_extended(uint8_t * buf, size_t value)
+{
+    if (value >= MINUS_TWO_HUNDRED_SIXTY_NINE_OPT_VALUE)
     {
-        nibble = value & 0xFF;
-    }
-    else if (value <= 0xFF + MINUS_THIRTEEN_OPT_VALUE)
-    {
-        nibble = MINUS_THIRTEEN;
+        buf = store_be16(buf, static_cast<uint16_t>(value - MINUS_TWO_HUNDRED_SIXTY_NINE_OPT_VALUE));
     }
-    else if (value <= 0xFFFF + MINUS_TWO_HUNDRED_SIXTY_NINE_OPT_VALUE)
+    else if (value >= MINUS_THIRTEEN_OPT_VALUE)
     {
-        nibble = MINUS_TWO_HUNDRED_SIXTY_NINE;
+        *buf++ = static_cast<uint8_t>(value - MINUS_THIRTEEN_OPT_VALUE);
     }
-    return nibble;
+    return buf;
 }
 
-static
-void make_option(
-            uint8_t *buffer,
-            size_t size,
-            size_t & offset,
-            size_t firstParsing,
-            size_t secondParsing,
-            bool checkBufferSizeOnly,
-            error_code &ec
-        )
+size_t OptionList::encoded_size() const
 {
-    ec.clear();
+    if (m_encodedSizeValid)
+        return m_encodedSize;
 
-    if (!checkBufferSizeOnly && buffer == nullptr)
-    {
-        ec = make_system_error(EFAULT);
-        return;
-    }
+    size_t size = 0;
+    uint16_t prevNumber = 0;
 
-    if (firstParsing == MINUS_THIRTEEN)
+    for (const Option &opt : m_options)
     {
-        if (checkBufferSizeOnly)
-            offset++;
-        else
-            buffer [offset++] = secondParsing - MINUS_THIRTEEN_OPT_VALUE;
-    }
-    else if (firstParsing == MINUS_TWO_HUNDRED_SIXTY_NINE)
-    {
-        if (checkBufferSizeOnly)
-            offset += 2;
-        else
-        {
-            buffer [offset++] = (secondParsing - MINUS_TWO_HUNDRED_SIXTY_NINE_OPT_VALUE) >> 8;
-            buffer [offset++] = (secondParsing - MINUS_TWO_HUNDRED_SIXTY_NINE_OPT_VALUE) & 0xFF;
-        }
-    }
-    if (!checkBufferSizeOnly && offset >= size)
-    {
-        ec = make_error_code(CoapStatus::COAP_ERR_BUFFER_SIZE);
+        const size_t delta = opt.number() - prevNumber;
+        size += 1 + get_option_extended_size(delta)
+                  + get_option_extended_size(opt.value().size())
+                  + opt.value().size();
+        prevNumber = opt.number();
     }
+
+    m_encodedSize = size;
+    m_encodedSizeValid = true;
+    return size;
 }
 
-void Packet::serialize(
-        error_code &ec,
-        void * buffer,
-        size_t &size,
-        bool checkBufferSizeOnly
-    )
+size_t Packet::encoded_size() const
 {
-#define exit_if_buffer_overflow(o, s, e, f)\
-        if (!f && o > s)\
-        {\
-            assert(0);\
-            e = make_error_code(CoapStatus::COAP_ERR_BUFFER_SIZE);\
-            return;\
-        }
+    size_t size = PACKET_HEADER_SIZE + token_length() + options_encoded_size();
+    if (payload().size())
+        size += sizeof(PAYLOAD_MARKER) + payload().size();
+    return size;
+}
 
-    ec.clear();
+size_t Packet::header_encoded_size() const
+{
+    size_t size = PACKET_HEADER_SIZE + token_length() + options_encoded_size();
+    if (payload().size())
+        size += sizeof(PAYLOAD_MARKER);
+    return size;
+}
 
-    //set_level(level::debug);
+// Writes everything except the payload, the size has been checked by the caller
+static uint8_t * write_header(const Packet &packet, uint8_t * buf)
+{
+    *buf++ = packet.header_as_byte();
+    *buf++ = packet.code_as_byte();
+    buf = store_be16(buf, packet.identity());
 
-    if (!checkBufferSizeOnly)
+    if (packet.token_length())
     {
-        if (buffer == nullptr)
-        {
-            assert(0);
-            ec = make_system_error(EFAULT);
-            return;
-        }
-
-        if (size < static_cast<size_t>(PACKET_MIN_LENGTH + token_length()))
-        {
-            assert(0);
-            ec = make_system_error(EINVAL);
-            return;
-        }
+        memcpy(buf, packet.token().data(), packet.token_length());
+        buf += packet.token_length();
     }
 
-    uint8_t * buf = static_cast<uint8_t *>(buffer);
-
-    size_t offset = MESSAGE_ID_OFFSET;
+    uint16_t prevNumber = 0;
 
-    if (!checkBufferSizeOnly)
+    for (const Option &opt : packet.options())
     {
-        buf [HEADER_OFFSET]  = header_as_byte();
-        buf [CODE_OFFSET]    = code_as_byte();
+        const size_t delta = opt.number() - prevNumber;
+        const size_t length = opt.value().size();
 
-        if (little_endian())
+        *buf++ = static_cast<uint8_t>((get_option_nibble(delta) << 4) | get_option_nibble(length));
+        buf = make_option_extended(buf, delta);
+        buf = make_option_extended(buf, length);
+
+        if (length)
         {
-            buf [offset]     = (identity() >> 8 ) & 0xFF;
-            buf [offset + 1] = identity() & 0xFF;
-        }
-        else {
-            buf [offset]     = identity() & 0xFF;
-            buf [offset + 1] = (identity() >> 8 ) & 0xFF;
+            memcpy(buf, opt.value().data(), length);
+            buf += length;
         }
-    }
-
-    offset = TOKEN_OFFSET;
 
-    if (token_length() > TOKEN_MAX_LENGTH)
-    {
-        assert(0);
-        ec = make_error_code(CoapStatus::COAP_ERR_TOKEN_LENGTH);
-        return;
+        prevNumber = opt.number();
     }
 
-    if (token_length() != 0 && !checkBufferSizeOnly)
-        memcpy (&buf[offset], token().data(), token_length());
+    if (packet.payload().size())
+        *buf++ = PAYLOAD_MARKER;
 
-    offset += token_length();
-
-    exit_if_buffer_overflow(offset, size, ec, checkBufferSizeOnly);
+    return buf;
+}
 
-    size_t optNumDelta = 0, optDelta = 0;
+static bool check_serialize(const Packet &packet, ByteSpan buffer, size_t size, error_code &ec)
+{
+    ec.clear();
 
-    for (auto opt : options())
+    if (buffer.data() == nullptr)
     {
-        size_t lengthNibble = 0, deltaNibble = 0;
-
-        exit_if_buffer_overflow(offset, size, ec, checkBufferSizeOnly);
-
-        optDelta = opt.number() - optNumDelta;
-
-        deltaNibble = get_option_nibble(optDelta);
+        ec = make_system_error(EFAULT);
+        return false;
+    }
 
-        lengthNibble = get_option_nibble(opt.value().size());
+    if (packet.token_length() > TOKEN_MAX_LENGTH)
+    {
+        ec = make_error_code(CoapStatus::COAP_ERR_TOKEN_LENGTH);
+        return false;
+    }
 
-        if (!checkBufferSizeOnly)
-        {
-            buf [offset] = (deltaNibble << 4 | lengthNibble) & 0xFF;
-        }
+    if (size > buffer.size())
+    {
+        ec = make_error_code(CoapStatus::COAP_ERR_BUFFER_SIZE);
+        return false;
+    }
+    return true;
+}
 
-        offset++;
+size_t Packet::serialize_header(ByteSpan buffer, error_code &ec) const
+{
+    const size_t size = header_encoded_size();
 
-        exit_if_buffer_overflow(offset, size, ec, checkBufferSizeOnly);
+    if (!check_serialize(*this, buffer, size, ec))
+        return 0;
 
-        make_option(buf, size, offset, deltaNibble, optDelta, checkBufferSizeOnly, ec);
-        if (ec)
-        {
-            assert(0);
-            return;
-        }
+    write_header(*this, buffer.data());
+    return size;
+}
 
-        make_option(buf, size, offset, lengthNibble, opt.value().size(), checkBufferSizeOnly, ec);
-        if (ec)
-        {
-            assert(0);
-            return;
-        }
+size_t Packet::serialize(ByteSpan buffer, error_code &ec) const
+{
+    const size_t size = encoded_size();
 
-        if (!checkBufferSizeOnly)
-            memcpy (&buf[offset], opt.value().data(), opt.value().size());
+    // the size is checked once, so nothing below can overflow the buffer
+    if (!check_serialize(*this, buffer, size, ec))
+        return 0;
 
-        offset += opt.value().size();
+    uint8_t * buf = write_header(*this, buffer.data());
 
-        exit_if_buffer_overflow(offset, size, ec, checkBufferSizeOnly);
+    if (payload().size())
+        memcpy(buf, payload().data(), payload().size());
 
-        optNumDelta = opt.number();
-    }
+    return size;
+}
 
-    if (payload().size())
+void Packet::serialize(Buffer &buffer, error_code &ec) const
+{
+    if (buffer.offset() > buffer.length())
     {
-        exit_if_buffer_overflow(offset, size, ec, checkBufferSizeOnly);
-
-        if (!checkBufferSizeOnly)
-        {
-            buf [offset] = PAYLOAD_MARKER;
-        }
+        ec = make_error_code(CoapStatus::COAP_ERR_BUFFER_SIZE);
+        return;
+    }
 
-        offset += sizeof(PAYLOAD_MARKER);
-        exit_if_buffer_overflow(offset, size, ec, checkBufferSizeOnly);
-        exit_if_buffer_overflow(offset + payload().size(), size, ec, checkBufferSizeOnly);
+    size_t size = serialize(
+                    ByteSpan(buffer.data() + buffer.offset(), buffer.length() - buffer.offset()),
+                    ec
+                );
+    if (!ec)
+        buffer.offset(buffer.offset() + size);
+}
 
-        if (!checkBufferSizeOnly)
-        {
-            memcpy (&buf[offset], payload().data(), payload().size());
-        }
+void Packet::serialize(
+        error_code &ec,
+        void * buffer,
+        size_t &size,
+        bool checkBufferSizeOnly
+    ) const
+{
+    ec.clear();
 
-        size = offset + payload().size();
+    if (checkBufferSizeOnly)
+    {
+        size = encoded_size();
+        return;
     }
-    else
+
+    if (buffer == nullptr)
     {
-        size = offset;
+        assert(0);
+        ec = make_system_error(EFAULT);
+        return;
     }
+
+    size_t written = serialize(ByteSpan(static_cast<uint8_t *>(buffer), size), ec);
+    if (!ec)
+        size = written;
 }
 
 /* Before calling of this method you should call add_option() to create needed options.
@@ -628,14 +513,6 @@ bool is_little_endian_byte_order()
 }
 
 uint16_t generate_identity()
-{
-    static bool initialized  = false;
-    if (!initialized )
-    {
-        srand(time(nullptr));
-        initialized  = true;
-    }
-    return static_cast<uint16_t>(rand() % (USHRT_MAX+ 1));
-}
+{ return static_cast<uint16_t>(fast_random()); }
 
 } // namespace coap
@@ -0,0 +1,46 @@
+#include "packet_pool.h"
+#include "free_list.h"
+#include <cassert>
+
+using namespace std;
+
+namespace coap
+{
+
+PacketPool::PacketPool(size_t capacity, size_t options, size_t payloadSize)
+    : m_capacity{capacity},
+      m_packets{new Packet [capacity]},
+      m_next{new atomic<uint16_t> [capacity]},
+      m_head{FREE_LIST_END},
+      m_available{capacity}
+{
+    assert(capacity < FREE_LIST_END);
+
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        m_packets[i].options().reserve(options);
+        m_packets[i].payload().reserve(payloadSize);
+    }
+    free_list_init(m_head, m_next.get(), capacity);
+}
+
+PacketPool::Handle PacketPool::acquire()
+{
+    const uint32_t index = free_list_pop(m_head, m_next.get());
+    if (index == FREE_LIST_END)
+        return Handle();
+
+    m_available.fetch_sub(1, memory_order_relaxed);
+    return Handle(this, index);
+}
+
+void PacketPool::release(uint32_t index)
+{
+    assert(index < m_capacity);
+
+    m_packets[index].reset();
+    free_list_push(m_head, m_next.get(), index);
+    m_available.fetch_add(1, memory_order_relaxed);
+}
+
+} // namespace coap
@@ -0,0 +1,184 @@
+#include "packet_view.h"
+#include <cassert>
+
+using namespace std;
+
+namespace coap
+{
+
+static bool decode_extended(
+        const uint8_t * buffer,
+        size_t size,
+        size_t &offset,
+        uint16_t &value
+    )
+{
+    if (value == MINUS_THIRTEEN)
+    {
+        if (offset + 1 > size)
+            return false;
+        value = buffer[offset] + MINUS_THIRTEEN_OPT_VALUE;
+        offset += sizeof(uint8_t);
+    }
+    else if (value == MINUS_TWO_HUNDRED_SIXTY_NINE)
+    {
+        if (offset + 2 > size)
+            return false;
+        uint32_t extended = load_be16(&buffer[offset]) + MINUS_TWO_HUNDRED_SIXTY_NINE_OPT_VALUE;
+        if (extended > UINT16_MAX)
+            return false;
+        value = static_cast<uint16_t>(extended);
+        offset += sizeof(uint16_t);
+    }
+    else if (value == RESERVED_FOR_FUTURE)
+        return false;
+
+    return true;
+}
+
+CoapStatus decode_option_header(
+        const uint8_t * buffer,
+        size_t size,
+        size_t &offset,
+        uint16_t &delta,
+        uint16_t &length
+    )
+{
+    if (offset >= size)
+        return CoapStatus::COAP_ERR_OPTION_DELTA;
+
+    delta = buffer[offset] >> 4;
+    length = buffer[offset] & 0xF;
+    ++offset;
+
+    if (!decode_extended(buffer, size, offset, delta))
+        return CoapStatus::COAP_ERR_OPTION_DELTA;
+
+    if (!decode_extended(buffer, size, offset, length))
+        return CoapStatus::COAP_ERR_OPTION_LENGTH;
+
+    if (offset + length > size)
+        return CoapStatus::COAP_ERR_OPTION_LENGTH;
+
+    return CoapStatus::COAP_OK;
+}
+
+void PacketView::const_iterator::decode()
+{
+    if (m_offset >= m_end)
+    {
+        m_offset = m_end + 1;
+        return;
+    }
+
+    const uint8_t header = m_buffer[m_offset];
+    uint16_t delta = 0, length = 0;
+
+    // the options have been validated by parse(), so decoding can not fail here
+    decode_option_header(m_buffer, m_end, m_offset, delta, length);
+
+    m_number += delta;
+    m_current = OptionView(header, m_number, &m_buffer[m_offset], length);
+    m_offset += length;
+}
+
+void PacketView::parse(const void * buffer, size_t size, error_code &ec)
+{
+    assert(buffer != nullptr);
+
+    ec.clear();
+    *this = PacketView();
+
+    if (buffer == nullptr)
+    {
+        ec = make_system_error(EFAULT);
+        return;
+    }
+
+    if (size < PACKET_MIN_LENGTH)
+    {
+        ec = make_system_error(EINVAL);
+        return;
+    }
+
+    const uint8_t * buf = static_cast<const uint8_t *>(buffer);
+
+    if ((buf[HEADER_OFFSET] >> 6) != COAP_VERSION)
+    {
+        ec = make_error_code(CoapStatus::COAP_ERR_PROTOCOL_VERSION);
+        return;
+    }
+
+    const size_t tokenLength = buf[HEADER_OFFSET] & 0xF;
+
+    if (tokenLength > TOKEN_MAX_LENGTH)
+    {
+        ec = make_error_code(CoapStatus::COAP_ERR_TOKEN_LENGTH);
+        return;
+    }
+
+    if (size < PACKET_HEADER_SIZE + tokenLength)
+    {
+        ec = make_system_error(EINVAL);
+        return;
+    }
+
+    const size_t optionsOffset = PACKET_HEADER_SIZE + tokenLength;
+    size_t offset = optionsOffset;
+    size_t count = 0;
+    uint32_t number = 0;
+    uint32_t prevNumber = UINT32_MAX;
+
+    while (offset < size && buf[offset] != PAYLOAD_MARKER)
+    {
+        uint16_t delta = 0, length = 0;
+
+        CoapStatus status = decode_option_header(buf, size, offset, delta, length);
+        if (status != CoapStatus::COAP_OK)
+        {
+            ec = make_error_code(status);
+            return;
+        }
+
+        number += delta;
+        if (number > UINT16_MAX)
+        {
+            ec = make_error_code(CoapStatus::COAP_ERR_OPTION_DELTA);
+            return;
+        }
+
+        // RFC7252 5.4.1 an unrecognized critical option is an error, elective ones are left to the caller
+        if (is_critical_option(static_cast<uint16_t>(number))
+            && !is_option_acceptable(find_option_properties(static_cast<uint16_t>(number)), length, number == prevNumber))
+        {
+            ec = make_error_code(CoapStatus::COAP_ERR_BAD_OPTION);
+            return;
+        }
+        prevNumber = number;
+
+        offset += length;
+        ++count;
+    }
+
+    const size_t optionsEnd = offset;
+
+    if (offset < size)
+    {
+        offset += sizeof(PAYLOAD_MARKER);
+        // RFC7252 3. The marker followed by a zero-length payload is a message format error
+        if (offset == size)
+        {
+            ec = make_error_code(CoapStatus::COAP_ERR_NO_PAYLOAD);
+            return;
+        }
+    }
+
+    m_data = buf;
+    m_size = size;
+    m_optionsOffset = optionsOffset;
+    m_optionsEnd = optionsEnd;
+    m_optionsCount = count;
+    m_payloadOffset = offset;
+}
+
+} // namespace coap
@@ -0,0 +1,130 @@
+#include "random.h"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#if defined(__linux__) || defined(__unix__) || defined(__APPLE__)
+#include <random>
+#include <thread>
+#include <functional>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#define COAP_THREAD_LOCAL thread_local
+#else
+// the lwIP port runs the CoAP stack in a single task
+#define COAP_THREAD_LOCAL
+#endif
+
+using namespace std;
+
+namespace coap
+{
+
+static inline uint64_t splitmix64(uint64_t &state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t make_seed()
+{
+    // the threads seeded at the same moment still get different sequences
+    static atomic<uint64_t> s_sequence{0};
+    uint64_t seed = s_sequence.fetch_add(0x9E3779B97F4A7C15ULL, memory_order_relaxed);
+
+    seed ^= static_cast<uint64_t>(time(nullptr));
+#if defined(__linux__) || defined(__unix__) || defined(__APPLE__)
+    error_code ec;
+    uint64_t entropy = 0;
+    secure_random_bytes(&entropy, sizeof(entropy), ec);
+    seed ^= entropy;
+    seed ^= static_cast<uint64_t>(hash<thread::id>()(this_thread::get_id())) << 1;
+#endif
+    return seed;
+}
+
+struct FastRandomState
+{
+    FastRandomState()
+        : value{make_seed()}
+    {}
+
+    uint64_t value;
+};
+
+uint64_t fast_random()
+{
+    static COAP_THREAD_LOCAL FastRandomState s_state;
+    return splitmix64(s_state.value);
+}
+
+void fast_random_bytes(void * buffer, size_t length)
+{
+    uint8_t * buf = static_cast<uint8_t *>(buffer);
+
+    while (length)
+    {
+        const uint64_t value = fast_random();
+        const size_t chunk = length < sizeof(value) ? length : sizeof(value);
+        memcpy(buf, &value, chunk);
+        buf += chunk;
+        length -= chunk;
+    }
+}
+
+void secure_random_bytes(void * buffer, size_t length, error_code &ec)
+{
+    ec.clear();
+
+    if (buffer == nullptr)
+    {
+        ec = make_system_error(EFAULT);
+        return;
+    }
+
+#if defined(__linux__) && defined(SYS_getrandom)
+    uint8_t * buf = static_cast<uint8_t *>(buffer);
+
+    while (length)
+    {
+        long received = syscall(SYS_getrandom, buf, length, 0);
+        if (received < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            ec = make_system_error(errno);
+            return;
+        }
+        buf += received;
+        length -= static_cast<size_t>(received);
+    }
+#elif defined(__unix__) || defined(__APPLE__)
+    try
+    {
+        random_device device;
+        uint8_t * buf = static_cast<uint8_t *>(buffer);
+
+        while (length)
+        {
+            const random_device::result_type value = device();
+            const size_t chunk = length < sizeof(value) ? length : sizeof(value);
+            memcpy(buf, &value, chunk);
+            buf += chunk;
+            length -= chunk;
+        }
+    }
+    catch (const exception &)
+    {
+        ec = make_system_error(ENOSYS);
+    }
+#else
+    (void)length;
+    ec = make_error_code(CoapStatus::COAP_ERR_NOT_IMPLEMENTED);
+#endif
+}
+
+} // namespace coap
@@ -0,0 +1,279 @@
+#include "request_table.h"
+#include "random.h"
+#include "error.h"
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+using namespace std;
+
+namespace coap
+{
+
+const uint32_t RequestTable::NO_REQUEST;
+
+RequestTable::RequestTable(
+                TimerWheel &wheel,
+                size_t capacity,
+                Sender sender,
+                size_t nstart,
+                TimerWheel::Clock::duration lifetime
+            )
+    : m_wheel{wheel},
+      m_capacity{capacity},
+      m_sender{std::move(sender)},
+      m_nstart{nstart},
+      m_lifetime{lifetime},
+      m_requests{new Request[capacity]},
+      m_free{},
+      m_index{capacity},
+      m_head{NO_REQUEST},
+      m_tail{NO_REQUEST},
+      m_outstanding{0},
+      m_waiting{0},
+      m_starting{false},
+      m_statistics{0, 0, 0, 0, 0}
+{
+    assert(m_sender);
+    assert(nstart > 0);
+    assert(capacity < NO_REQUEST);
+
+    m_free.reserve(capacity);
+    for (size_t i = capacity; i > 0; --i)
+    {
+        const uint32_t slot = static_cast<uint32_t>(i - 1);
+        m_requests[slot].timer.handler([this, slot]{ expire(slot); });
+        m_free.push_back(slot);
+    }
+}
+
+RequestTable::~RequestTable()
+{
+    m_starting = true; // nothing is sent any more
+    for (size_t i = 0; i < m_capacity; ++i)
+    {
+        if (m_requests[i].state == FREE)
+            continue;
+
+        ResponseHandler handler = remove(static_cast<uint32_t>(i));
+        if (handler)
+            handler(make_system_error(ECANCELED), nullptr);
+    }
+}
+
+uint64_t RequestTable::key(const TokenType &token)
+{
+    uint64_t value;
+    static_assert(sizeof(value) == TOKEN_MAX_LENGTH, "a token must fit the key");
+    memcpy(&value, token.data(), sizeof(value));
+    return value;
+}
+
+TokenType RequestTable::make_token() const
+{
+    TokenType token;
+    do
+    {
+        fast_random_bytes(token.data(), token.size());
+    }
+    while (m_index.find(key(token)) != m_index.end());
+    return token;
+}
+
+void RequestTable::submit(const TokenType &token, BufferPool::Handle message, ResponseHandler handler, error_code &ec)
+{
+    if (!message)
+    {
+        ec = make_system_error(EINVAL);
+        return;
+    }
+    if (m_free.empty())
+    {
+        ec = make_system_error(ENOBUFS);
+        return;
+    }
+
+    const uint32_t slot = m_free.back();
+    if (!m_index.emplace(key(token), slot).second)
+    {
+        ec = make_system_error(EEXIST);
+        return;
+    }
+    m_free.pop_back();
+
+    Request &request = m_requests[slot];
+    request.token = token;
+    request.message = std::move(message);
+    request.handler = std::move(handler);
+    ++m_statistics.submitted;
+
+    if (m_outstanding < m_nstart && m_waiting == 0)
+    {
+        send(slot);
+        return;
+    }
+
+    // the order of the submissions is kept
+    request.state = WAITING;
+    request.prev = m_tail;
+    request.next = NO_REQUEST;
+    if (m_tail != NO_REQUEST)
+        m_requests[m_tail].next = slot;
+    else
+        m_head = slot;
+    m_tail = slot;
+    ++m_waiting;
+    ++m_statistics.waited;
+}
+
+void RequestTable::send(uint32_t slot)
+{
+    Request &request = m_requests[slot];
+    request.state = OUTSTANDING;
+    ++m_outstanding;
+    m_wheel.schedule(request.timer, m_lifetime);
+
+    // copied, the sender may end the request at once and the slot may be reused
+    const TokenType token = request.token;
+    BufferPool::Handle message = std::move(request.message);
+    m_sender(token, std::move(message));
+}
+
+void RequestTable::dequeue(uint32_t slot)
+{
+    Request &request = m_requests[slot];
+
+    if (request.prev != NO_REQUEST)
+        m_requests[request.prev].next = request.next;
+    else
+        m_head = request.next;
+
+    if (request.next != NO_REQUEST)
+        m_requests[request.next].prev = request.prev;
+    else
+        m_tail = request.prev;
+
+    request.prev = NO_REQUEST;
+    request.next = NO_REQUEST;
+}
+
+void RequestTable::start_waiting()
+{
+    if (m_starting) // a sender has ended a request, the loop below goes on
+        return;
+
+    m_starting = true;
+    while (m_head != NO_REQUEST && m_outstanding < m_nstart)
+    {
+        const uint32_t slot = m_head;
+        dequeue(slot);
+        --m_waiting;
+        send(slot);
+    }
+    m_starting = false;
+}
+
+RequestTable::ResponseHandler RequestTable::remove(uint32_t slot)
+{
+    Request &request = m_requests[slot];
+
+    switch (request.state)
+    {
+        case WAITING:
+            dequeue(slot);
+            --m_waiting;
+            break;
+        case OUTSTANDING:
+            --m_outstanding;
+            break;
+        default:
+            break;
+    }
+
+    m_wheel.cancel(request.timer);
+    m_index.erase(key(request.token));
+    request.message.reset();
+    request.state = FREE;
+
+    ResponseHandler handler;
+    std::swap(handler, request.handler);
+    m_free.push_back(slot);
+
+    start_waiting();
+    return handler;
+}
+
+bool RequestTable::complete(const PacketView &response)
+{
+    Index::iterator it = m_index.end();
+    if (response.token_length() == TOKEN_MAX_LENGTH)
+    {
+        TokenType token;
+        memcpy(token.data(), response.token().data(), token.size());
+        it = m_index.find(key(token));
+    }
+
+    if (it == m_index.end())
+    {
+        ++m_statistics.unmatched;
+        return false;
+    }
+
+    // a waiting request has not been sent, so it can not be answered
+    if (m_requests[it->second].state == WAITING)
+    {
+        ++m_statistics.unmatched;
+        return false;
+    }
+
+    ResponseHandler handler = remove(it->second);
+    ++m_statistics.completed;
+    if (handler)
+        handler(error_code(), &response);
+    return true;
+}
+
+bool RequestTable::release(const TokenType &token)
+{
+    Index::iterator it = m_index.find(key(token));
+    if (it == m_index.end() || m_requests[it->second].state != OUTSTANDING)
+        return false;
+
+    m_requests[it->second].state = RELEASED;
+    --m_outstanding;
+    start_waiting();
+    return true;
+}
+
+bool RequestTable::fail(const TokenType &token, const error_code &ec)
+{
+    Index::iterator it = m_index.find(key(token));
+    if (it == m_index.end())
+        return false;
+
+    ResponseHandler handler = remove(it->second);
+    ++m_statistics.failed;
+    if (handler)
+        handler(ec, nullptr);
+    return true;
+}
+
+bool RequestTable::cancel(const TokenType &token)
+{
+    Index::iterator it = m_index.find(key(token));
+    if (it == m_index.end())
+        return false;
+
+    remove(it->second);
+    return true;
+}
+
+void RequestTable::expire(uint32_t slot)
+{
+    ResponseHandler handler = remove(slot);
+    ++m_statistics.failed;
+    if (handler)
+        handler(make_error_code(CoapStatus::COAP_ERR_TIMEOUT), nullptr);
+}
+
+} // namespace coap
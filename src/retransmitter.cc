@@ -0,0 +1,163 @@
+#include "retransmitter.h"
+#include "consts.h"
+#include "random.h"
+#include "error.h"
+#include <cassert>
+#include <utility>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace coap
+{
+
+Retransmitter::Retransmitter(TimerWheel &wheel, size_t capacity, Sender sender)
+    : m_wheel{wheel},
+      m_capacity{capacity},
+      m_sender{std::move(sender)},
+      m_exchanges{new Exchange[capacity]},
+      m_free{},
+      m_index{capacity, KeyHash{fast_random()}},
+      m_statistics{0, 0, 0, 0, 0}
+{
+    assert(m_sender);
+    assert(capacity <= UINT32_MAX);
+
+    m_free.reserve(capacity);
+    // the lower slots are taken first
+    for (size_t i = capacity; i > 0; --i)
+    {
+        const uint32_t slot = static_cast<uint32_t>(i - 1);
+        m_exchanges[slot].timer.handler([this, slot]{ expire(slot); });
+        m_free.push_back(slot);
+    }
+}
+
+milliseconds Retransmitter::initial_timeout()
+{
+    const uint32_t spread = ACK_TIMEOUT * (ACK_RANDOM_FACTOR_PERCENT - 100) / 100;
+    return milliseconds(ACK_TIMEOUT + fast_random() % (spread + 1));
+}
+
+void Retransmitter::send(const PeerKey &peer, BufferPool::Handle message, Completion completion, std::error_code &ec)
+{
+    if (!message || message->offset() < PACKET_HEADER_SIZE
+        || ((message->data()[HEADER_OFFSET] >> 4) & 0x3) != CONFIRMABLE)
+    {
+        ec = make_system_error(EINVAL);
+        return;
+    }
+    if (m_free.empty())
+    {
+        ec = make_system_error(ENOBUFS);
+        return;
+    }
+
+    const uint8_t *id = message->data() + MESSAGE_ID_OFFSET;
+    const uint16_t messageId = static_cast<uint16_t>((id[0] << 8) | id[1]);
+    const uint32_t slot = m_free.back();
+
+    if (!m_index.emplace(Key{peer, messageId}, slot).second)
+    {
+        ec = make_system_error(EEXIST);
+        return;
+    }
+    m_free.pop_back();
+
+    Exchange &exchange = m_exchanges[slot];
+    exchange.peer = peer;
+    exchange.message = std::move(message);
+    exchange.completion = std::move(completion);
+    exchange.timeout = static_cast<uint32_t>(initial_timeout().count());
+    exchange.messageId = messageId;
+    exchange.retransmissions = 0;
+
+    ++m_statistics.transmitted;
+    transmit(exchange);
+}
+
+bool Retransmitter::cancel(const PeerKey &peer, uint16_t messageId)
+{
+    Index::iterator it = m_index.find(Key{peer, messageId});
+    if (it == m_index.end())
+        return false;
+
+    Exchange &exchange = m_exchanges[it->second];
+    m_wheel.cancel(exchange.timer);
+    exchange.message.reset();
+    exchange.completion = nullptr;
+    m_free.push_back(it->second);
+    m_index.erase(it);
+    return true;
+}
+
+bool Retransmitter::outstanding(const PeerKey &peer, uint16_t messageId) const
+{
+    return m_index.find(Key{peer, messageId}) != m_index.end();
+}
+
+bool Retransmitter::complete(const PeerKey &peer, uint16_t messageId, Outcome outcome)
+{
+    Index::iterator it = m_index.find(Key{peer, messageId});
+    if (it == m_index.end())
+        return false;
+
+    const uint32_t slot = it->second;
+    m_index.erase(it);
+    finish(slot, outcome);
+    return true;
+}
+
+void Retransmitter::finish(uint32_t slot, Outcome outcome)
+{
+    Exchange &exchange = m_exchanges[slot];
+    m_wheel.cancel(exchange.timer);
+    exchange.message.reset();
+
+    // the slot is free before the completion runs, so it may start the next exchange
+    Completion completion;
+    std::swap(completion, exchange.completion);
+    m_free.push_back(slot);
+
+    switch (outcome)
+    {
+        case ACKNOWLEDGED:
+            ++m_statistics.acknowledged;
+            break;
+        case REJECTED:
+            ++m_statistics.rejected;
+            break;
+        case TIMED_OUT:
+            ++m_statistics.timedOut;
+            break;
+    }
+
+    if (completion)
+        completion(outcome);
+}
+
+void Retransmitter::expire(uint32_t slot)
+{
+    Exchange &exchange = m_exchanges[slot];
+
+    if (exchange.retransmissions >= MAX_RETRANSMIT)
+    {
+        m_index.erase(Key{exchange.peer, exchange.messageId});
+        finish(slot, TIMED_OUT);
+        return;
+    }
+
+    ++exchange.retransmissions;
+    exchange.timeout <<= 1;
+    ++m_statistics.retransmitted;
+    transmit(exchange);
+}
+
+void Retransmitter::transmit(Exchange &exchange)
+{
+    // armed before the sender runs, which may acknowledge the exchange at once, as a loopback peer does
+    m_wheel.schedule(exchange.timer, milliseconds(exchange.timeout));
+    m_sender(exchange.peer, exchange.message->data(), exchange.message->offset());
+}
+
+} // namespace coap
@@ -0,0 +1,209 @@
+#include "timer_wheel.h"
+#include <cassert>
+#ifdef __linux__
+#include <ctime>
+#endif
+
+using namespace std;
+using namespace std::chrono;
+
+static const uint64_t SLOT_MASK = TimerWheel::SLOTS - 1;
+// the farthest tick the wheel can hold
+static const uint64_t TICKS_MAX = (static_cast<uint64_t>(1) << (TimerWheel::SLOT_BITS * TimerWheel::LEVELS)) - 1;
+
+TimerWheel::Timer::~Timer()
+{
+    if (m_wheel)
+        m_wheel->cancel(*this);
+}
+
+TimerWheel::TimerWheel(Clock::duration tick, Clock::time_point start)
+    : m_tick{tick},
+      m_start{start},
+      m_next{0},
+      m_size{0},
+      m_slots{}
+{
+    assert(tick.count() > 0);
+
+    for (size_t level = 0; level < LEVELS; ++level)
+    {
+        for (size_t i = 0; i < SLOTS; ++i)
+        {
+            m_slots[level][i].prev = &m_slots[level][i];
+            m_slots[level][i].next = &m_slots[level][i];
+        }
+    }
+}
+
+TimerWheel::~TimerWheel()
+{
+    for (size_t level = 0; level < LEVELS; ++level)
+    {
+        for (size_t i = 0; i < SLOTS; ++i)
+        {
+            Link &head = m_slots[level][i];
+            while (head.next != &head)
+            {
+                Timer &timer = static_cast<Timer &>(*head.next);
+                unlink(timer);
+                timer.m_wheel = nullptr;
+            }
+        }
+    }
+}
+
+TimerWheel::Clock::time_point TimerWheel::coarse_now()
+{
+#ifdef __linux__
+    // steady_clock of libstdc++ and libc++ counts CLOCK_MONOTONIC, the coarse clock shares its origin
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) == 0)
+        return Clock::time_point(duration_cast<Clock::duration>(seconds(ts.tv_sec) + nanoseconds(ts.tv_nsec)));
+#endif
+    return Clock::now();
+}
+
+void TimerWheel::link(Link &head, Link &node)
+{
+    node.prev = head.prev;
+    node.next = &head;
+    head.prev->next = &node;
+    head.prev = &node;
+}
+
+void TimerWheel::unlink(Link &node)
+{
+    node.prev->next = node.next;
+    node.next->prev = node.prev;
+    node.prev = nullptr;
+    node.next = nullptr;
+}
+
+void TimerWheel::splice(Link &from, Link &to)
+{
+    if (from.next == &from)
+        return;
+
+    to.next = from.next;
+    to.prev = from.prev;
+    to.next->prev = &to;
+    to.prev->next = &to;
+    from.next = &from;
+    from.prev = &from;
+}
+
+void TimerWheel::insert(Timer &timer)
+{
+    uint64_t expires = timer.m_expires;
+    size_t level;
+    size_t index;
+
+    if (expires < m_next) // already due, fires at the next tick
+    {
+        level = 0;
+        index = m_next & SLOT_MASK;
+    }
+    else
+    {
+        uint64_t delta = expires - m_next;
+        if (delta > TICKS_MAX)
+        {
+            delta = TICKS_MAX;
+            expires = m_next + TICKS_MAX;
+            timer.m_expires = expires;
+        }
+
+        level = 0;
+        while (level + 1 < LEVELS && delta >= (static_cast<uint64_t>(1) << (SLOT_BITS * (level + 1))))
+            ++level;
+        index = (expires >> (SLOT_BITS * level)) & SLOT_MASK;
+    }
+    link(m_slots[level][index], timer);
+}
+
+void TimerWheel::schedule(Timer &timer, Clock::duration delay)
+{
+    if (timer.m_wheel)
+        cancel(timer);
+
+    // rounded up and one more tick, since the current one has partly gone: a timer never fires early
+    const uint64_t ticks = delay.count() > 0 ? static_cast<uint64_t>((delay + m_tick - Clock::duration(1)) / m_tick) : 0;
+
+    timer.m_wheel = this;
+    timer.m_expires = m_next + ticks;
+    insert(timer);
+    ++m_size;
+}
+
+bool TimerWheel::cancel(Timer &timer)
+{
+    if (timer.m_wheel != this)
+        return false;
+
+    unlink(timer);
+    timer.m_wheel = nullptr;
+    --m_size;
+    return true;
+}
+
+void TimerWheel::cascade(size_t level, size_t index)
+{
+    Link list;
+    list.prev = &list;
+    list.next = &list;
+    splice(m_slots[level][index], list);
+
+    while (list.next != &list)
+    {
+        Timer &timer = static_cast<Timer &>(*list.next);
+        unlink(timer);
+        insert(timer);
+    }
+}
+
+size_t TimerWheel::advance(Clock::time_point now)
+{
+    if (now < m_start)
+        return 0;
+
+    const uint64_t target = static_cast<uint64_t>((now - m_start) / m_tick);
+    size_t fired = 0;
+
+    while (m_next <= target)
+    {
+        if (m_size == 0) // nothing to fire, skip the idle ticks at once
+        {
+            m_next = target + 1;
+            break;
+        }
+
+        size_t index = m_next & SLOT_MASK;
+
+        // the lower level has turned round, the next slot of the upper one comes down
+        for (size_t level = 1; index == 0 && level < LEVELS; ++level)
+        {
+            index = (m_next >> (SLOT_BITS * level)) & SLOT_MASK;
+            cascade(level, index);
+        }
+
+        Link expired;
+        expired.prev = &expired;
+        expired.next = &expired;
+        splice(m_slots[0][m_next & SLOT_MASK], expired);
+        ++m_next; // the timers armed by the handlers go to the next ticks
+
+        while (expired.next != &expired)
+        {
+            Timer &timer = static_cast<Timer &>(*expired.next);
+            unlink(timer);
+            timer.m_wheel = nullptr;
+            --m_size;
+            ++fired;
+
+            if (timer.m_handler)
+                timer.m_handler();
+        }
+    }
+    return fired;
+}
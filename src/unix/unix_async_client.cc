@@ -0,0 +1,568 @@
+#include "unix_async_client.h"
+#include "byte_order.h"
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <strings.h>
+#include <cassert>
+#include <cctype>
+#include <cstring>
+#include <utility>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/fmt.h>
+
+using namespace std;
+using namespace spdlog;
+using namespace coap;
+
+namespace Unix
+{
+
+const size_t AsyncClient::BATCH_SIZE;
+
+static const size_t URI_PART_MAX_LENGTH = 255;
+
+// coap://host[:port][/path][?query] split as RFC7252 6.4 tells, the parts are percent-decoded
+struct UriParts
+{
+    string          host;
+    bool            literal;    // the host is in brackets
+    uint16_t        port;
+    vector<string>  path;
+    vector<string>  query;
+};
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static bool split_uri_part(const char *begin, const char *end, char separator, vector<string> &parts)
+{
+    parts.push_back(string());
+    for (const char *p = begin; p < end; ++p)
+    {
+        if (*p == separator)
+        {
+            parts.push_back(string());
+            continue;
+        }
+
+        char c = *p;
+        if (c == '%')
+        {
+            const int high = p + 2 < end ? hex_digit(p[1]) : -1;
+            const int low = high >= 0 ? hex_digit(p[2]) : -1;
+            if (low < 0)
+                return false;
+            c = static_cast<char>((high << 4) | low);
+            p += 2;
+        }
+
+        if (parts.back().size() == URI_PART_MAX_LENGTH)
+            return false;
+        parts.back().push_back(c);
+    }
+    return true;
+}
+
+static void parse_uri(const char *uri, UriParts &parts, error_code &ec)
+{
+    static const char SCHEME[] = "coap://";
+    const size_t schemeLength = sizeof(SCHEME) - 1;
+
+    if (strncasecmp(uri, SCHEME, schemeLength) != 0 || strchr(uri, '#') != nullptr)
+    {
+        ec = make_error_code(CoapStatus::COAP_ERR_URI_PATH);
+        return;
+    }
+
+    const char *authority = uri + schemeLength;
+    const char *authorityEnd = authority + strcspn(authority, "/?");
+    const char *hostEnd;
+
+    parts.literal = *authority == '[';
+    if (parts.literal)
+    {
+        const char *bracket = static_cast<const char *>(memchr(authority, ']', authorityEnd - authority));
+        if (bracket == nullptr)
+        {
+            ec = make_error_code(CoapStatus::COAP_ERR_URI_PATH);
+            return;
+        }
+        parts.host.assign(authority + 1, bracket);
+        hostEnd = bracket + 1;
+    }
+    else
+    {
+        hostEnd = authority + strcspn(authority, ":/?");
+        parts.host.assign(authority, hostEnd);
+    }
+
+    if (parts.host.empty() || parts.host.size() > URI_PART_MAX_LENGTH
+        || (hostEnd < authorityEnd && *hostEnd != ':'))
+    {
+        ec = make_error_code(CoapStatus::COAP_ERR_URI_PATH);
+        return;
+    }
+
+    // an empty port is the default one
+    unsigned long port = hostEnd + 1 < authorityEnd ? 0 : COAP_DEFAULT_PORT;
+    for (const char *p = hostEnd + 1; p < authorityEnd; ++p)
+    {
+        if (!isdigit(static_cast<unsigned char>(*p)) || (port = port * 10 + (*p - '0')) > UINT16_MAX)
+        {
+            ec = make_error_code(CoapStatus::COAP_ERR_PORT_NUMBER);
+            return;
+        }
+    }
+    if (port == 0)
+    {
+        ec = make_error_code(CoapStatus::COAP_ERR_PORT_NUMBER);
+        return;
+    }
+    parts.port = static_cast<uint16_t>(port);
+
+    // "/" alone is the root, it has no Uri-Path
+    const char *pathEnd = authorityEnd + strcspn(authorityEnd, "?");
+    const char *end = pathEnd + strlen(pathEnd);
+    if ((pathEnd - authorityEnd > 1 && !split_uri_part(authorityEnd + 1, pathEnd, '/', parts.path))
+        || (end - pathEnd > 1 && !split_uri_part(pathEnd + 1, end, '&', parts.query)))
+    {
+        ec = make_error_code(CoapStatus::COAP_ERR_URI_PATH);
+    }
+}
+
+// the address of an IP literal or the first one of a host name, named tells if the host was resolved
+static PeerKey resolve(const UriParts &parts, bool &named, error_code &ec)
+{
+    struct sockaddr_in addr4;
+    struct sockaddr_in6 addr6;
+    memset(&addr4, 0, sizeof(addr4));
+    memset(&addr6, 0, sizeof(addr6));
+    named = false;
+
+    if (inet_pton(AF_INET6, parts.host.c_str(), &addr6.sin6_addr) == 1)
+    {
+        addr6.sin6_family = AF_INET6;
+        addr6.sin6_port = htons(parts.port);
+        return UnixSocketAddress(addr6).peer_key();
+    }
+    if (parts.literal)
+    {
+        ec = make_error_code(CoapStatus::COAP_ERR_URI_PATH);
+        return PeerKey();
+    }
+    if (inet_pton(AF_INET, parts.host.c_str(), &addr4.sin_addr) == 1)
+    {
+        addr4.sin_family = AF_INET;
+        addr4.sin_port = htons(parts.port);
+        return UnixSocketAddress(addr4).peer_key();
+    }
+
+    struct addrinfo hints;
+    struct addrinfo *result = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    if (getaddrinfo(parts.host.c_str(), nullptr, &hints, &result) != 0 || result == nullptr)
+    {
+        ec = make_error_code(CoapStatus::COAP_ERR_RESOLVE_ADDRESS);
+        return PeerKey();
+    }
+
+    PeerKey peer;
+    if (result->ai_family == AF_INET6)
+    {
+        memcpy(&addr6, result->ai_addr, sizeof(addr6));
+        addr6.sin6_port = htons(parts.port);
+        peer = UnixSocketAddress(addr6).peer_key();
+    }
+    else
+    {
+        memcpy(&addr4, result->ai_addr, sizeof(addr4));
+        addr4.sin_port = htons(parts.port);
+        peer = UnixSocketAddress(addr4).peer_key();
+    }
+    freeaddrinfo(result);
+
+    named = true;
+    return peer;
+}
+
+AsyncClient::Server::Server(AsyncClient &client, const PeerKey &peer)
+    : requests{
+            client.m_wheel,
+            client.m_perServer,
+            [&client, peer](const TokenType &token, BufferPool::Handle message)
+            {
+                client.transmit(peer, token, std::move(message));
+            },
+            client.m_nstart
+        },
+      ids{}
+{}
+
+AsyncClient::AsyncClient(Reactor &reactor, size_t capacity, size_t perServer, size_t nstart)
+    : m_reactor{reactor},
+      m_capacity{capacity},
+      m_perServer{perServer},
+      m_nstart{nstart},
+      m_wheel{std::chrono::milliseconds(10)},
+      m_pool{capacity, capacity, 0},
+      m_retransmitter{
+            m_wheel,
+            capacity,
+            [this](const PeerKey &peer, const uint8_t *data, size_t length)
+            {
+                send_datagram(peer, data, length);
+            }
+        },
+      m_servers{},
+      m_idle{},
+      m_size{0},
+      m_tick{0},
+      m_closing{false},
+      m_packet{},
+      m_sockets{},
+      m_receiveBuffer(BATCH_SIZE * BUFFER_SIZE),
+      m_addresses(BATCH_SIZE),
+      m_datagrams(BATCH_SIZE)
+{
+    assert(capacity > 0 && perServer > 0);
+
+    for (size_t i = 0; i < BATCH_SIZE; ++i)
+    {
+        m_datagrams[i].data = &m_receiveBuffer[i * BUFFER_SIZE];
+        m_datagrams[i].address = &m_addresses[i];
+    }
+}
+
+AsyncClient::~AsyncClient()
+{
+    m_closing = true;
+    if (m_tick)
+        m_reactor.cancel(m_tick);
+
+    error_code ec;
+    for (unique_ptr<UnixSocket> &socket : m_sockets)
+    {
+        if (socket)
+            m_reactor.remove(socket->descriptor(), ec);
+    }
+
+    // the tables call the handlers while the rest of the client is still there
+    m_servers.clear();
+}
+
+UnixSocket * AsyncClient::socket(SocketType family, error_code &ec)
+{
+    const size_t index = family == SOCKET_TYPE_IP_V6 ? 1 : 0;
+    if (m_sockets[index])
+        return m_sockets[index].get();
+
+    unique_ptr<UnixSocket> socket(new UnixSocket(index ? AF_INET6 : AF_INET, SOCK_DGRAM, 0, ec));
+    if (ec.value())
+        return nullptr;
+
+    socket->set_blocking(false, ec);
+    if (ec.value())
+        return nullptr;
+
+    m_reactor.add(socket->descriptor(), Reactor::READABLE, [this, index](uint32_t){ receive(index); }, ec);
+    if (ec.value())
+        return nullptr;
+
+    m_sockets[index] = std::move(socket);
+    return m_sockets[index].get();
+}
+
+void AsyncClient::request(
+            MessageCode method,
+            const char *uri,
+            const RequestOptions &options,
+            const void *payload,
+            size_t length,
+            ResponseHandler handler,
+            error_code &ec
+        )
+{
+    assert(uri != nullptr);
+
+    if (m_closing)
+    {
+        ec = make_system_error(ECANCELED);
+        return;
+    }
+
+    UriParts parts;
+    parse_uri(uri, parts, ec);
+    if (ec.value())
+        return;
+
+    bool named;
+    const PeerKey peer = resolve(parts, named, ec);
+    if (ec.value())
+        return;
+
+    if (m_size == m_capacity)
+    {
+        ec = make_system_error(ENOBUFS);
+        return;
+    }
+
+    socket(peer.family(), ec);
+    if (ec.value())
+        return;
+
+    m_packet.reset();
+    m_packet.make_request(
+                ec,
+                options.confirmable ? CONFIRMABLE : NON_CONFIRMABLE,
+                method,
+                0,
+                length ? payload : nullptr,
+                length
+            );
+
+    // RFC7252 6.4, the port is the destination one so Uri-Port is never needed
+    if (named && !ec.value())
+        m_packet.add_option(URI_HOST, parts.host.data(), parts.host.size(), ec);
+    for (size_t i = 0; i < parts.path.size() && !ec.value(); ++i)
+        m_packet.add_option(URI_PATH, parts.path[i].data(), parts.path[i].size(), ec);
+    for (size_t i = 0; i < parts.query.size() && !ec.value(); ++i)
+        m_packet.add_option(URI_QUERY, parts.query[i].data(), parts.query[i].size(), ec);
+    for (size_t i = 0; i < options.extras.size() && !ec.value(); ++i)
+        m_packet.add_option(options.extras[i].number, options.extras[i].value.data(), options.extras[i].value.size(), ec);
+    if (ec.value())
+        return;
+
+    if (m_packet.encoded_size() > BufferPool::MTU_BUFFER_SIZE)
+    {
+        ec = make_system_error(EMSGSIZE);
+        return;
+    }
+
+    Servers::iterator it = m_servers.find(peer);
+    if (it == m_servers.end())
+        it = m_servers.emplace(peer, unique_ptr<Server>(new Server(*this, peer))).first;
+    Server &server = *it->second;
+
+    const TokenType token = server.requests.make_token();
+    m_packet.token() = token;
+    m_packet.token_length(TOKEN_MAX_LENGTH);
+    m_packet.identity(server.ids.next());
+
+    BufferPool::Handle message = m_pool.acquire(m_packet.encoded_size());
+    if (message)
+    {
+        message->offset(0);
+        m_packet.serialize(*message, ec);
+    }
+    else
+    {
+        ec = make_system_error(ENOBUFS);
+    }
+
+    if (!ec.value())
+    {
+        // nothing has been armed for a while, the wheel catches the time up before a timer is armed
+        if (m_wheel.size() == 0)
+            m_wheel.advance();
+
+        ++m_size;
+        server.requests.submit(
+                    token,
+                    std::move(message),
+                    [this, peer, handler](const error_code &result, const PacketView *response)
+                    {
+                        --m_size;
+                        m_idle.push_back(peer);
+                        if (handler)
+                            handler(result, response);
+                    },
+                    ec
+                );
+        if (ec.value())
+            --m_size;
+    }
+
+    if (ec.value())
+        m_idle.push_back(peer);
+    arm_tick();
+}
+
+void AsyncClient::transmit(const PeerKey &peer, const TokenType &token, BufferPool::Handle message)
+{
+    if (((message->data()[0] >> 4) & 0x3) != CONFIRMABLE)
+    {
+        send_datagram(peer, message->data(), message->offset());
+        return;
+    }
+
+    error_code ec;
+    m_retransmitter.send(
+                peer,
+                std::move(message),
+                [this, peer, token](Retransmitter::Outcome outcome){ finish(peer, token, outcome); },
+                ec
+            );
+    if (ec.value())
+    {
+        debug("the request can not be transmitted: {0}", ec.message());
+        m_servers.at(peer)->requests.fail(token, ec);
+    }
+}
+
+void AsyncClient::send_datagram(const PeerKey &peer, const uint8_t *data, size_t length)
+{
+    UnixSocket *socket = m_sockets[peer.family() == SOCKET_TYPE_IP_V6 ? 1 : 0].get();
+    if (socket == nullptr)
+        return;
+
+    const UnixSocketAddress address(peer);
+    error_code ec;
+    socket->sendto(data, length, &address, ec);
+    if (ec.value())
+        debug("sendto() error: {0}", ec.message());
+}
+
+void AsyncClient::finish(const PeerKey &peer, const TokenType &token, Retransmitter::Outcome outcome)
+{
+    Servers::iterator it = m_servers.find(peer);
+    if (it == m_servers.end())
+        return;
+
+    RequestTable &requests = it->second->requests;
+    switch (outcome)
+    {
+        case Retransmitter::ACKNOWLEDGED:
+            // nothing happens after a piggybacked response, an empty ACK lets the next request go
+            requests.release(token);
+            break;
+        case Retransmitter::REJECTED:
+            requests.fail(token, make_system_error(ECONNRESET));
+            break;
+        case Retransmitter::TIMED_OUT:
+            requests.fail(token, make_error_code(CoapStatus::COAP_ERR_TIMEOUT));
+            break;
+    }
+}
+
+void AsyncClient::receive(size_t index)
+{
+    UnixSocket &socket = *m_sockets[index];
+
+    for (;;)
+    {
+        for (size_t i = 0; i < BATCH_SIZE; ++i)
+            m_datagrams[i].length = BUFFER_SIZE;
+
+        error_code ec;
+        const ssize_t count = socket.recvmmsg(m_datagrams.data(), BATCH_SIZE, ec);
+        if (ec.value())
+        {
+            if (ec.value() != EAGAIN)
+                debug("recvmmsg() error: {0}", ec.message());
+            break;
+        }
+
+        for (ssize_t i = 0; i < count; ++i)
+        {
+            if (m_datagrams[i].truncated)
+            {
+                debug("truncated datagram dropped");
+                continue;
+            }
+            const PacketView message(m_datagrams[i].data, m_datagrams[i].length, ec);
+            if (ec.value())
+            {
+                ec.clear();
+                continue;
+            }
+            dispatch(m_addresses[i].peer_key(), message);
+        }
+
+        if (static_cast<size_t>(count) < BATCH_SIZE)
+            break;
+    }
+
+    reap();
+    arm_tick();
+}
+
+void AsyncClient::dispatch(const PeerKey &peer, const PacketView &message)
+{
+    Servers::iterator it = m_servers.find(peer);
+    Server *server = it != m_servers.end() ? it->second.get() : nullptr;
+    const uint8_t codeClass = message.code_class();
+    const bool response = codeClass == (SUCCESS >> 5) || codeClass == (CLIENT_ERROR >> 5) || codeClass == (SERVER_ERROR >> 5);
+
+    switch (message.type())
+    {
+        case ACKNOWLEDGEMENT:
+            // the piggybacked response goes first, so the completion of the exchange only releases an empty ACK
+            if (server && response)
+                server->requests.complete(message);
+            m_retransmitter.acknowledge(peer, message.identity());
+            break;
+        case RESET:
+            m_retransmitter.reject(peer, message.identity());
+            break;
+        case CONFIRMABLE:
+        {
+            // a separate response is acknowledged even if its request has gone (RFC7252 5.2.2),
+            // anything else is rejected
+            uint8_t reply[PACKET_HEADER_SIZE];
+            reply[0] = static_cast<uint8_t>((COAP_VERSION << 6) | ((response ? ACKNOWLEDGEMENT : RESET) << 4));
+            reply[1] = EMPTY;
+            store_be16(&reply[MESSAGE_ID_OFFSET], message.identity());
+            send_datagram(peer, reply, sizeof(reply));
+
+            if (server && response)
+                server->requests.complete(message);
+            break;
+        }
+        case NON_CONFIRMABLE:
+            if (server && response)
+                server->requests.complete(message);
+            break;
+    }
+}
+
+void AsyncClient::arm_tick()
+{
+    if (m_tick || m_closing || (m_wheel.size() == 0 && m_idle.empty()))
+        return;
+
+    m_tick = m_reactor.schedule(m_wheel.tick(), [this]{ tick(); });
+}
+
+void AsyncClient::tick()
+{
+    m_tick = 0;
+    m_wheel.advance();
+    reap();
+    arm_tick();
+}
+
+void AsyncClient::reap()
+{
+    for (size_t i = 0; i < m_idle.size(); ++i)
+    {
+        Servers::iterator it = m_servers.find(m_idle[i]);
+        if (it != m_servers.end() && it->second->requests.size() == 0)
+            m_servers.erase(it);
+    }
+    m_idle.clear();
+}
+
+} // namespace Unix
@@ -0,0 +1,158 @@
+#ifndef _UNIX_ASYNC_CLIENT_H
+#define _UNIX_ASYNC_CLIENT_H
+#include "unix_reactor.h"
+#include "unix_socket.h"
+#include "buffer_pool.h"
+#include "packet.h"
+#include "packet_view.h"
+#include "peer_key.h"
+#include "random.h"
+#include "request_table.h"
+#include "retransmitter.h"
+#include "timer_wheel.h"
+#include "error.h"
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Unix
+{
+
+// What a request has beside its URI
+struct RequestOptions
+{
+    struct Extra
+    {
+        coap::OptionNumber  number;
+        std::string         value;
+    };
+
+    RequestOptions()
+        : confirmable{true}, extras{}
+    {}
+
+    // Adds an option such as ACCEPT or ETAG, the value is copied in the wire format
+    RequestOptions & add(coap::OptionNumber number, const void *value, std::size_t length)
+    {
+        extras.push_back(Extra{number, std::string(static_cast<const char *>(value), length)});
+        return *this;
+    }
+
+    bool                confirmable;    // a NON request is sent once and not acknowledged
+    std::vector<Extra>  extras;
+};
+
+// Asynchronous client: a request returns at once and its handler runs in the reactor thread
+// when the response comes or the request fails, so one thread keeps any quantity of requests in flight.
+// The requests to all the servers share one socket per address family, the retransmitter and the timer wheel.
+// Up to nstart requests to one server are outstanding at a time, the next ones are sent as soon as
+// the previous ones are answered, the responses are matched by their tokens in any order.
+// The methods are called in the reactor thread or before the reactor runs, the other threads pass
+// their requests through Reactor::post()
+class AsyncClient
+{
+public:
+    typedef coap::RequestTable::ResponseHandler ResponseHandler;
+
+    // maximal quantity of the datagrams taken by one receive system call
+    static const std::size_t BATCH_SIZE = 32;
+
+    // capacity is the maximal quantity of the requests in flight to all the servers,
+    // perServer the one to a single server, the outstanding and the waiting ones
+    AsyncClient(
+            Reactor &reactor,
+            std::size_t capacity = 1024,
+            std::size_t perServer = 256,
+            std::size_t nstart = coap::NSTART
+        );
+    // the requests left get ECANCELED
+    ~AsyncClient();
+
+    AsyncClient(const AsyncClient &) = delete;
+    AsyncClient & operator=(const AsyncClient &) = delete;
+
+public:
+    // Sends the request to the server of the URI, coap://host[:port][/path][?query].
+    // The handler is not called if ec is set: COAP_ERR_URI_PATH for a malformed URI,
+    // COAP_ERR_RESOLVE_ADDRESS for an unknown host and ENOBUFS if too many requests are in flight.
+    // The host names are resolved with getaddrinfo(3), which blocks, so the frequent requests
+    // should give the addresses. A failure of the transmission may call the handler before the return
+    void request(
+            coap::MessageCode method,
+            const char *uri,
+            const RequestOptions &options,
+            const void *payload,
+            std::size_t length,
+            ResponseHandler handler,
+            std::error_code &ec
+        );
+
+    void get(const char *uri, const RequestOptions &options, ResponseHandler handler, std::error_code &ec)
+    { request(coap::GET, uri, options, nullptr, 0, std::move(handler), ec); }
+
+    void get(const char *uri, ResponseHandler handler, std::error_code &ec)
+    { get(uri, RequestOptions(), std::move(handler), ec); }
+
+    // the requests in flight
+    std::size_t size() const
+    { return m_size; }
+
+    std::size_t capacity() const
+    { return m_capacity; }
+
+    // the servers with the requests in flight
+    std::size_t servers() const
+    { return m_servers.size(); }
+
+    const coap::Retransmitter::Statistics & retransmissions() const
+    { return m_retransmitter.statistics(); }
+
+private:
+    struct Server
+    {
+        Server(AsyncClient &client, const PeerKey &peer);
+
+        coap::RequestTable          requests;
+        coap::MessageIdGenerator    ids;
+    };
+
+    typedef std::unordered_map<PeerKey, std::unique_ptr<Server>, PeerKeyHash> Servers;
+
+    UnixSocket * socket(SocketType family, std::error_code &ec);
+    void transmit(const PeerKey &peer, const coap::TokenType &token, BufferPool::Handle message);
+    void send_datagram(const PeerKey &peer, const std::uint8_t *data, std::size_t length);
+    void finish(const PeerKey &peer, const coap::TokenType &token, coap::Retransmitter::Outcome outcome);
+    void receive(std::size_t index);
+    void dispatch(const PeerKey &peer, const coap::PacketView &message);
+    // the wheel is advanced by a reactor timer while something is armed
+    void arm_tick();
+    void tick();
+    // drops the servers left without requests, never called from the handlers of a table
+    void reap();
+
+private:
+    Reactor                         &m_reactor;
+    const std::size_t               m_capacity;
+    const std::size_t               m_perServer;
+    const std::size_t               m_nstart;
+    TimerWheel                      m_wheel;
+    BufferPool                      m_pool;
+    coap::Retransmitter             m_retransmitter;
+    Servers                         m_servers;
+    std::vector<PeerKey>            m_idle;         // the servers which may have no request left
+    std::size_t                     m_size;
+    Reactor::TimerId                m_tick;         // zero while the wheel is not advanced
+    bool                            m_closing;
+    coap::Packet                    m_packet;       // reused to build the requests
+    std::unique_ptr<UnixSocket>     m_sockets[2];   // IPv4 and IPv6, opened with the first request
+    std::vector<std::uint8_t>       m_receiveBuffer;
+    std::vector<UnixSocketAddress>  m_addresses;
+    std::vector<Datagram>           m_datagrams;
+};
+
+} // namespace Unix
+
+#endif
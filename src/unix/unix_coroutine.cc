@@ -0,0 +1,316 @@
+#include "unix_coroutine.h"
+#if __cplusplus >= 202002L
+#include "byte_order.h"
+#include "random.h"
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/fmt.h>
+
+using namespace std;
+using namespace spdlog;
+using namespace coap;
+
+namespace Unix
+{
+
+const size_t CoroutineServer::BATCH_SIZE;
+const size_t CoroutineServer::EXCHANGE_CACHE_CAPACITY;
+const size_t CoroutineServer::RESPONSE_CACHE_CAPACITY;
+const size_t CoroutineServer::RETRANSMIT_CAPACITY;
+
+ServerExchange::ServerExchange(
+                    CoroutineServer &server,
+                    const UnixSocketAddress &peer,
+                    const uint8_t *message,
+                    size_t length,
+                    error_code &ec
+                )
+    : m_server(server),
+      m_peer{peer},
+      m_message(message, message + length),
+      m_request{},
+      m_responded{false},
+      m_acknowledged{false}
+{
+    m_request.parse(m_message.data(), m_message.size(), ec);
+}
+
+void ServerExchange::respond(Packet &response, error_code &ec)
+{
+    if (m_responded)
+    {
+        ec = make_system_error(EALREADY);
+        return;
+    }
+
+    m_server.respond(*this, response, ec);
+    if (!ec.value())
+        m_responded = true;
+}
+
+void ServerExchange::respond(MessageCode code, const void *payload, size_t length, error_code &ec)
+{
+    Packet response;
+    response.prepare_answer(ec, ACKNOWLEDGEMENT, code, 0, length ? payload : nullptr, length);
+    if (!ec.value())
+        respond(response, ec);
+}
+
+CoroutineServer::CoroutineServer(Reactor &reactor, UdpServerConnection &connection, ResourceHandler handler, error_code &ec)
+    : m_reactor(reactor),
+      m_connection(connection),
+      m_handler{std::move(handler)},
+      m_exchanges{EXCHANGE_CACHE_CAPACITY, RESPONSE_CACHE_CAPACITY},
+      m_wheel{std::chrono::milliseconds(10)},
+      m_pool{RETRANSMIT_CAPACITY, RETRANSMIT_CAPACITY, 0},
+      m_retransmitter{
+            m_wheel,
+            RETRANSMIT_CAPACITY,
+            [this](const PeerKey &peer, const uint8_t *data, size_t length)
+            {
+                send_datagram(peer, data, length);
+            }
+        },
+      m_tick{0},
+      m_starting{nullptr},
+      m_receiveBuffer(BATCH_SIZE * BUFFER_SIZE),
+      m_addresses(BATCH_SIZE),
+      m_datagrams(BATCH_SIZE)
+{
+    if (!connection.bound())
+    {
+        ec = make_error_code(CoapStatus::COAP_ERR_SOCKET_NOT_BOUND);
+        return;
+    }
+
+    for (size_t i = 0; i < BATCH_SIZE; ++i)
+    {
+        m_datagrams[i].data = &m_receiveBuffer[i * BUFFER_SIZE];
+        m_datagrams[i].address = &m_addresses[i];
+    }
+
+    m_reactor.add(
+            static_cast<const UnixSocket *>(m_connection.socket())->event_descriptor(),
+            Reactor::READABLE,
+            [this](uint32_t){ receive(); },
+            ec
+        );
+}
+
+CoroutineServer::~CoroutineServer()
+{
+    if (m_tick)
+        m_reactor.cancel(m_tick);
+
+    error_code ec;
+    m_reactor.remove(static_cast<const UnixSocket *>(m_connection.socket())->event_descriptor(), ec);
+}
+
+Task<void> CoroutineServer::run(unique_ptr<ServerExchange> exchange)
+{
+    Task<void> task = m_handler(*exchange);
+    co_await task;
+
+    if (!exchange->responded())
+    {
+        error_code ec;
+        exchange->respond(INTERNAL_SERVER_ERROR, nullptr, 0, ec);
+    }
+    if (m_starting == exchange.get()) // it has not been suspended
+        m_starting = nullptr;
+}
+
+void CoroutineServer::respond(ServerExchange &exchange, Packet &response, error_code &ec)
+{
+    const PacketView &request = exchange.request();
+    const PeerKey peer = exchange.peer().peer_key();
+    const bool confirmable = request.type() == CONFIRMABLE;
+
+    response.version(COAP_VERSION);
+    response.token_length(request.token_length());
+    copy(request.token().begin(), request.token().end(), response.token().begin());
+
+    if (!exchange.acknowledged())
+    {
+        response.type(confirmable ? ACKNOWLEDGEMENT : NON_CONFIRMABLE);
+        response.identity(confirmable ? request.identity() : generate_identity());
+
+        send_packet(m_connection, response, &exchange.peer(), ec);
+        if (!ec.value())
+            m_exchanges.respond(peer, request.identity(), response); // the duplicates get it again
+        return;
+    }
+
+    // the duplicates of the request keep getting the empty ACK, this one is retransmitted by itself
+    response.type(CONFIRMABLE);
+    response.identity(generate_identity());
+
+    BufferPool::Handle message = m_pool.acquire(response.encoded_size());
+    if (!message)
+    {
+        ec = make_system_error(ENOBUFS);
+        return;
+    }
+    response.serialize(*message, ec);
+    if (ec.value())
+        return;
+
+    // nothing has been armed for a while, the wheel catches the time up before a timer is armed
+    if (m_wheel.size() == 0)
+        m_wheel.advance();
+
+    m_retransmitter.send(
+                peer,
+                std::move(message),
+                [](Retransmitter::Outcome outcome)
+                {
+                    if (outcome != Retransmitter::ACKNOWLEDGED)
+                        debug("a separate response has not been acknowledged: {0:d}", static_cast<int>(outcome));
+                },
+                ec
+            );
+    arm_tick();
+}
+
+void CoroutineServer::acknowledge(ServerExchange &exchange)
+{
+    uint8_t ack[PACKET_HEADER_SIZE] = {
+        static_cast<uint8_t>((COAP_VERSION << 6) | (ACKNOWLEDGEMENT << 4)),
+        EMPTY
+    };
+    store_be16(&ack[MESSAGE_ID_OFFSET], exchange.request().identity());
+
+    error_code ec;
+    m_connection.send(ack, sizeof(ack), &exchange.peer(), ec);
+    if (ec.value())
+    {
+        debug("the empty ACK can not be sent: {0}", ec.message());
+        return;
+    }
+    m_exchanges.respond(exchange.peer().peer_key(), exchange.request().identity(), ack, sizeof(ack));
+    exchange.m_acknowledged = true;
+}
+
+void CoroutineServer::send_datagram(const PeerKey &peer, const uint8_t *data, size_t length)
+{
+    const UnixSocketAddress address(peer);
+    error_code ec;
+    m_connection.send(data, length, &address, ec);
+    if (ec.value())
+        debug("send() error: {0}", ec.message());
+}
+
+void CoroutineServer::arm_tick()
+{
+    if (m_tick || m_wheel.size() == 0)
+        return;
+
+    m_tick = m_reactor.schedule(m_wheel.tick(), [this]{ tick(); });
+}
+
+void CoroutineServer::tick()
+{
+    m_tick = 0;
+    m_wheel.advance();
+    arm_tick();
+}
+
+void CoroutineServer::receive()
+{
+    // the descriptor is readable, so the first datagram is there and the batch does not wait
+    size_t count = BATCH_SIZE;
+    for (size_t i = 0; i < count; ++i)
+        m_datagrams[i].length = BUFFER_SIZE;
+
+    error_code ec;
+    m_connection.receive_batch(m_datagrams.data(), count, ec);
+    if (ec.value())
+    {
+        debug("receive_batch() error: {0}", ec.message());
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (m_datagrams[i].truncated)
+        {
+            debug("truncated datagram dropped");
+            continue;
+        }
+        const PacketView request(m_datagrams[i].data, m_datagrams[i].length, ec);
+        if (ec.value())
+        {
+            ec.clear();
+            continue;
+        }
+
+        const PeerKey peer = m_addresses[i].peer_key();
+        if (request.type() == ACKNOWLEDGEMENT || request.type() == RESET)
+        {
+            // the peer answers a separate response
+            if (request.type() == ACKNOWLEDGEMENT)
+                m_retransmitter.acknowledge(peer, request.identity());
+            else
+                m_retransmitter.reject(peer, request.identity());
+            continue;
+        }
+
+        if (request.code_class() != 0 || request.code_as_byte() == EMPTY)
+        {
+            // a ping is answered with a RST, the other messages are not for a server
+            if (request.type() == CONFIRMABLE && request.code_as_byte() == EMPTY)
+            {
+                uint8_t reset[PACKET_HEADER_SIZE] = {
+                    static_cast<uint8_t>((COAP_VERSION << 6) | (RESET << 4)),
+                    EMPTY
+                };
+                store_be16(&reset[MESSAGE_ID_OFFSET], request.identity());
+                m_connection.send(reset, sizeof(reset), &m_addresses[i], ec);
+                ec.clear();
+            }
+            continue;
+        }
+
+        BufferPool::Handle cached;
+        switch (m_exchanges.check(peer, request.identity(), cached))
+        {
+            case ExchangeCache::FIRST:
+                break;
+
+            case ExchangeCache::REPLAY:
+                m_connection.send(cached->data(), cached->offset(), &m_addresses[i], ec);
+                ec.clear();
+                continue;
+
+            case ExchangeCache::IN_PROGRESS:
+                continue;
+        }
+
+        unique_ptr<ServerExchange> exchange(new ServerExchange(
+                                                *this,
+                                                m_addresses[i],
+                                                static_cast<const uint8_t *>(m_datagrams[i].data),
+                                                m_datagrams[i].length,
+                                                ec
+                                            ));
+        if (ec.value())
+        {
+            ec.clear();
+            m_exchanges.forget(peer, request.identity());
+            continue;
+        }
+
+        m_starting = exchange.get();
+        spawn(run(std::move(exchange)));
+
+        if (m_starting) // the handler waits for something before its response
+        {
+            if (m_starting->request().type() == CONFIRMABLE && !m_starting->responded())
+                acknowledge(*m_starting);
+            m_starting = nullptr;
+        }
+    }
+}
+
+} // namespace Unix
+
+#endif // __cplusplus >= 202002L
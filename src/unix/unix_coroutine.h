@@ -0,0 +1,471 @@
+#ifndef _UNIX_COROUTINE_H
+#define _UNIX_COROUTINE_H
+// The coroutine layer needs C++20, the library is built with it by the COAPCPP_COROUTINES option.
+// Everything below runs in the reactor thread: a coroutine suspended by co_await is resumed
+// by the handler of the reactor event it waits for, so no thread is taken by a waiting exchange
+#if __cplusplus >= 202002L
+#include "unix_async_client.h"
+#include "unix_reactor.h"
+#include "unix_udp_server.h"
+#include "exchange_cache.h"
+#include "retransmitter.h"
+#include "timer_wheel.h"
+#include "packet.h"
+#include "packet_view.h"
+#include "error.h"
+#include <coroutine>
+#include <cstdint>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace Unix
+{
+
+template <typename T>
+class Task;
+
+class TaskPromiseBase
+{
+public:
+    // resumes the awaiting coroutine, a spawned one frees itself
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept
+        { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            TaskPromiseBase &promise = handle.promise();
+            if (promise.m_continuation)
+                return promise.m_continuation;
+            if (promise.m_detached)
+                handle.destroy();
+            return std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept
+        {}
+    };
+
+    // a task starts when it is awaited or spawned
+    std::suspend_always initial_suspend() const noexcept
+    { return {}; }
+
+    FinalAwaiter final_suspend() const noexcept
+    { return {}; }
+
+    // the library reports the errors with error_code, an exception ends the program
+    void unhandled_exception() const noexcept
+    { std::terminate(); }
+
+protected:
+    template <typename T>
+    friend class Task;
+    friend void spawn(Task<void> task);
+
+    std::coroutine_handle<> m_continuation;
+    bool                    m_detached = false;
+};
+
+template <typename T>
+class TaskPromise : public TaskPromiseBase
+{
+public:
+    template <typename U>
+    void return_value(U &&value)
+    { m_result.emplace(std::forward<U>(value)); }
+
+    T take()
+    { return std::move(*m_result); }
+
+private:
+    std::optional<T> m_result;
+};
+
+template <>
+class TaskPromise<void> : public TaskPromiseBase
+{
+public:
+    void return_void() const noexcept
+    {}
+
+    void take() const noexcept
+    {}
+};
+
+// Lazy coroutine: co_await runs it and resumes the caller with its result when it ends.
+// A suspended task must not be destroyed, the event it waits for would resume a freed frame
+template <typename T = void>
+class Task
+{
+public:
+    class promise_type : public TaskPromise<T>
+    {
+    public:
+        Task get_return_object()
+        { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    };
+
+    Task(Task &&other) noexcept
+        : m_handle{std::exchange(other.m_handle, nullptr)}
+    {}
+
+    Task & operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (m_handle)
+                m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        if (m_handle)
+            m_handle.destroy();
+    }
+
+    Task(const Task &) = delete;
+    Task & operator=(const Task &) = delete;
+
+public:
+    bool await_ready() const noexcept
+    { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+    {
+        m_handle.promise().m_continuation = caller;
+        return m_handle;
+    }
+
+    T await_resume()
+    { return m_handle.promise().take(); }
+
+private:
+    friend void spawn(Task<void> task);
+
+    explicit Task(std::coroutine_handle<promise_type> handle)
+        : m_handle{handle}
+    {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+// Runs the task in the calling thread until its first suspension, it frees itself at the end
+inline void spawn(Task<void> task)
+{
+    std::coroutine_handle<Task<void>::promise_type> handle = std::exchange(task.m_handle, nullptr);
+    handle.promise().m_detached = true;
+    handle.resume();
+}
+
+// co_await sleep_for(reactor, delay)
+class SleepAwaiter
+{
+public:
+    SleepAwaiter(Reactor &reactor, Reactor::Clock::duration delay)
+        : m_reactor(reactor), m_delay{delay}
+    {}
+
+    bool await_ready() const noexcept
+    { return m_delay <= Reactor::Clock::duration::zero(); }
+
+    void await_suspend(std::coroutine_handle<> caller)
+    { m_reactor.schedule(m_delay, [caller]{ caller.resume(); }); }
+
+    void await_resume() const noexcept
+    {}
+
+private:
+    Reactor                     &m_reactor;
+    Reactor::Clock::duration    m_delay;
+};
+
+inline SleepAwaiter sleep_for(Reactor &reactor, Reactor::Clock::duration delay)
+{ return SleepAwaiter(reactor, delay); }
+
+// co_await readable(reactor, fd) returns when the descriptor can be read, or the error of its watch.
+// The descriptor is watched only while a coroutine waits for it
+class ReadableAwaiter
+{
+public:
+    ReadableAwaiter(Reactor &reactor, int fd)
+        : m_reactor(reactor), m_fd{fd}, m_ec{}
+    {}
+
+    bool await_ready() const noexcept
+    { return false; }
+
+    bool await_suspend(std::coroutine_handle<> caller)
+    {
+        m_reactor.add(m_fd, Reactor::READABLE, [this, caller](std::uint32_t events)
+            {
+                if (events & Reactor::FAILED)
+                    m_ec = make_system_error(EIO);
+                m_reactor.remove(m_fd, m_ec);
+                caller.resume(); // the awaiter is gone after it
+            }, m_ec);
+        return !m_ec.value();
+    }
+
+    std::error_code await_resume() const noexcept
+    { return m_ec; }
+
+private:
+    Reactor         &m_reactor;
+    int             m_fd;
+    std::error_code m_ec;
+};
+
+inline ReadableAwaiter readable(Reactor &reactor, int fd)
+{ return ReadableAwaiter(reactor, fd); }
+
+// co_await async_receive(reactor, connection, buffer, length, &from) waits for a datagram without blocking
+// the reactor thread, length is the size of the buffer and then the size of the datagram
+inline Task<std::error_code> async_receive(
+                Reactor &reactor,
+                UdpServerConnection &connection,
+                void *buffer,
+                std::size_t &length,
+                SocketAddress *from
+            )
+{
+    std::error_code ec = co_await readable(reactor, static_cast<const UnixSocket *>(connection.socket())->event_descriptor());
+    if (!ec.value())
+        connection.receive(buffer, length, from, ec);
+    co_return ec;
+}
+
+// The outcome of a request made with co_await, the response is copied out of the receive buffer of the client
+class Response
+{
+public:
+    Response()
+        : m_ec{}, m_message{}, m_packet{}
+    {}
+
+    Response(Response &&) = default;
+    Response & operator=(Response &&) = default;
+    Response(const Response &) = delete;
+    Response & operator=(const Response &) = delete;
+
+    void assign(const std::error_code &ec, const coap::PacketView *response)
+    {
+        m_ec = ec;
+        if (response == nullptr)
+            return;
+        m_message.assign(response->data(), response->data() + response->size());
+        m_packet.parse(m_message.data(), m_message.size(), m_ec);
+    }
+
+    const std::error_code & error() const
+    { return m_ec; }
+
+    // valid if error() is not set
+    const coap::PacketView & packet() const
+    { return m_packet; }
+
+private:
+    std::error_code             m_ec;
+    std::vector<std::uint8_t>   m_message;
+    coap::PacketView            m_packet;   // points into m_message, which keeps its storage when moved
+};
+
+// co_await async_request(client, ...) sends the request and returns its Response.
+// The arguments are used before the coroutine is suspended, so temporaries may be passed
+class RequestAwaiter
+{
+public:
+    RequestAwaiter(
+            AsyncClient &client,
+            coap::MessageCode method,
+            const char *uri,
+            const RequestOptions &options,
+            const void *payload,
+            std::size_t length
+        )
+        : m_client(client),
+          m_method{method},
+          m_uri{uri},
+          m_options(options),
+          m_payload{payload},
+          m_length{length},
+          m_caller{},
+          m_response{},
+          m_done{false}
+    {}
+
+    bool await_ready() const noexcept
+    { return false; }
+
+    bool await_suspend(std::coroutine_handle<> caller)
+    {
+        std::error_code ec;
+        m_client.request(m_method, m_uri, m_options, m_payload, m_length,
+            [this](const std::error_code &result, const coap::PacketView *response)
+            {
+                m_response.assign(result, response);
+                m_done = true;
+                if (m_caller)
+                    m_caller.resume(); // the awaiter is gone after it
+            }, ec);
+
+        if (ec.value())
+            m_response.assign(ec, nullptr);
+        if (ec.value() || m_done) // the handler has run already
+            return false;
+
+        m_caller = caller;
+        return true;
+    }
+
+    Response await_resume()
+    { return std::move(m_response); }
+
+private:
+    AsyncClient             &m_client;
+    coap::MessageCode       m_method;
+    const char              *m_uri;
+    const RequestOptions    &m_options;
+    const void              *m_payload;
+    std::size_t             m_length;
+    std::coroutine_handle<> m_caller;   // set once the caller is suspended
+    Response                m_response;
+    bool                    m_done;
+};
+
+inline RequestAwaiter async_request(
+                AsyncClient &client,
+                coap::MessageCode method,
+                const char *uri,
+                const RequestOptions &options = RequestOptions(),
+                const void *payload = nullptr,
+                std::size_t length = 0
+            )
+{ return RequestAwaiter(client, method, uri, options, payload, length); }
+
+inline RequestAwaiter async_get(AsyncClient &client, const char *uri, const RequestOptions &options = RequestOptions())
+{ return RequestAwaiter(client, coap::GET, uri, options, nullptr, 0); }
+
+class CoroutineServer;
+
+// One request received by a CoroutineServer, it lives as long as the coroutine handling it
+class ServerExchange
+{
+public:
+    ServerExchange(
+            CoroutineServer &server,
+            const UnixSocketAddress &peer,
+            const std::uint8_t *message,
+            std::size_t length,
+            std::error_code &ec
+        );
+
+    ServerExchange(const ServerExchange &) = delete;
+    ServerExchange & operator=(const ServerExchange &) = delete;
+
+public:
+    const coap::PacketView & request() const
+    { return m_request; }
+
+    const UnixSocketAddress & peer() const
+    { return m_peer; }
+
+    // Sends the response with the token of the request: piggybacked on the ACK of a CON, as a NON otherwise.
+    // A CON acknowledged already by an empty ACK gets a separate response in a new CON, which is
+    // retransmitted until the peer acknowledges it. The code, the options and the payload are taken from the packet
+    void respond(coap::Packet &response, std::error_code &ec);
+    void respond(coap::MessageCode code, const void *payload, std::size_t length, std::error_code &ec);
+
+    bool responded() const
+    { return m_responded; }
+
+    // true once the CON has been acknowledged by an empty ACK, the response is a separate one then
+    bool acknowledged() const
+    { return m_acknowledged; }
+
+private:
+    friend class CoroutineServer;
+
+    CoroutineServer             &m_server;
+    UnixSocketAddress           m_peer;
+    std::vector<std::uint8_t>   m_message;
+    coap::PacketView            m_request;
+    bool                        m_responded;
+    bool                        m_acknowledged;
+};
+
+// Runs a coroutine for every request the connection receives, so a resource handler may co_await
+// other requests or timers before it responds. A handler which ends without a response answers 5.00.
+// The duplicates of a request do not start another handler (RFC7252 4.5): they get the cached response
+// again, or nothing while the handler runs. A CON whose handler suspends before its response is
+// acknowledged by an empty ACK at once, so the peer stops its retransmissions (RFC7252 5.2.2).
+// The connection is bound already, the server and the connection outlive the exchanges in progress
+class CoroutineServer
+{
+public:
+    typedef std::function<Task<void>(ServerExchange &exchange)> ResourceHandler;
+
+    // maximal quantity of the datagrams taken by one receive system call
+    static const std::size_t BATCH_SIZE = 32;
+    // exchanges remembered for the deduplication, and the cached responses of every size class
+    static const std::size_t EXCHANGE_CACHE_CAPACITY = 1024;
+    static const std::size_t RESPONSE_CACHE_CAPACITY = 256;
+    // separate responses waiting for their acknowledgement
+    static const std::size_t RETRANSMIT_CAPACITY = 256;
+
+    CoroutineServer(Reactor &reactor, UdpServerConnection &connection, ResourceHandler handler, std::error_code &ec);
+    ~CoroutineServer();
+
+    CoroutineServer(const CoroutineServer &) = delete;
+    CoroutineServer & operator=(const CoroutineServer &) = delete;
+
+public:
+    const coap::ExchangeCache::Statistics & deduplication() const
+    { return m_exchanges.statistics(); }
+
+    const coap::Retransmitter::Statistics & retransmissions() const
+    { return m_retransmitter.statistics(); }
+
+private:
+    friend class ServerExchange;
+
+    void receive();
+    Task<void> run(std::unique_ptr<ServerExchange> exchange);
+    // sends the response of the exchange and keeps it for the duplicates of the request
+    void respond(ServerExchange &exchange, coap::Packet &response, std::error_code &ec);
+    // the empty ACK of a CON whose handler has suspended
+    void acknowledge(ServerExchange &exchange);
+    void send_datagram(const PeerKey &peer, const std::uint8_t *data, std::size_t length);
+    // the wheel is advanced by a reactor timer while a separate response waits for its ACK
+    void arm_tick();
+    void tick();
+
+private:
+    Reactor                         &m_reactor;
+    UdpServerConnection             &m_connection;
+    ResourceHandler                 m_handler;
+    coap::ExchangeCache             m_exchanges;
+    TimerWheel                      m_wheel;
+    BufferPool                      m_pool;         // separate responses
+    coap::Retransmitter             m_retransmitter;
+    Reactor::TimerId                m_tick;         // zero while the wheel is not advanced
+    ServerExchange                  *m_starting;    // the exchange whose handler runs till its first suspension
+    std::vector<std::uint8_t>       m_receiveBuffer;
+    std::vector<UnixSocketAddress>  m_addresses;
+    std::vector<Datagram>           m_datagrams;
+};
+
+} // namespace Unix
+
+#endif // __cplusplus >= 202002L
+
+#endif
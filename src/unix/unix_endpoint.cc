@@ -1,5 +1,7 @@
 #include "unix_endpoint.h"
 #include "unix_udp_server.h"
+#include "byte_order.h"
+#include <cstring>
 #ifdef USE_SPDLOG
 #include "spdlog/spdlog.h"
 #endif
@@ -121,6 +123,7 @@ void ServerEndpoint::receive_request()
 {
 	debug("handler: {}",__func__);
 	m_timeout = 1;
+	m_ec.clear(); // a new request, the error of the previous one is over
 
 	m_receiving = true;
 	m_sending = false;
@@ -131,26 +134,141 @@ void ServerEndpoint::handle_request()
 {
 	debug("handler: {}",__func__);
 
-	debug("received message length: {0:d}", m_buffer.offset());
-	debug("message : {}", m_buffer.data());
+	debug("received message length: {0:d}", m_buffer->offset());
 
 	m_receiving = false;
 	m_sending = false;
-	m_nextState = COMPLETE;
+
+	if (!m_request || !m_response)
+	{
+		m_ec = make_system_error(ENOBUFS);
+		m_nextState = ERROR;
+		return;
+	}
+
+	if (!m_buffer->offset())
+	{
+		m_ec = make_system_error(EINVAL);
+		m_nextState = ERROR;
+		return;
+	}
+
+	m_request->parse(m_buffer->data(), m_buffer->offset(), m_ec);
+	if (m_ec == make_error_code(CoapStatus::COAP_ERR_BAD_OPTION))
+	{
+		reject_bad_option();
+		m_nextState = m_sending ? COMPLETE : ERROR;
+		return;
+	}
+	if (m_ec.value())
+	{
+		m_nextState = ERROR;
+		return;
+	}
+
+	if (m_request->code_class() == (METHOD >> 5) && m_request->code_as_byte() != EMPTY)
+	{
+		prepare_response();
+		m_sending = !m_ec.value();
+	}
+	else if (m_request->code_as_byte() == EMPTY && m_request->type() == CONFIRMABLE)
+	{
+		// CoAP ping
+		m_response->prepare_answer(m_ec, RESET, EMPTY, m_request->identity(), nullptr, 0);
+		m_sending = !m_ec.value();
+	}
+
+	m_nextState = m_ec.value() ? ERROR : COMPLETE;
+}
+
+void ServerEndpoint::prepare_response()
+{
+	static const char WELL_KNOWN[] = ".well-known";
+	static const char CORE[] = "core";
+
+	const bool confirmable = (m_request->type() == CONFIRMABLE);
+	const uint16_t id = confirmable ? m_request->identity() : generate_identity();
+	const MessageType type = confirmable ? ACKNOWLEDGEMENT : NON_CONFIRMABLE;
+
+	// only the resource discovery is served: GET /.well-known/core
+	OptionList::const_range path = m_request->find_options(URI_PATH);
+	const char * const segments[] = { WELL_KNOWN, CORE };
+	size_t count = 0;
+	bool discovery = (m_request->code_as_byte() == GET);
+
+	for (OptionList::const_iterator it = path.first; discovery && it != path.second; ++it, ++count)
+	{
+		discovery = count < 2 && it->value().size() == strlen(segments[count]) &&
+			!memcmp(it->value().data(), segments[count], it->value().size());
+	}
+	discovery = discovery && count == 2;
+
+	const string &payload = m_coreLink.core_link();
+	if (discovery && !payload.empty())
+	{
+		const uint8_t format = LINK_FORMAT;
+		m_response->add_option(CONTENT_FORMAT, &format, sizeof(format), m_ec);
+		if (m_ec.value())
+			return;
+		m_response->prepare_answer(m_ec, type, CONTENT, id, payload.data(), payload.size());
+	}
+	else
+		m_response->prepare_answer(m_ec, type, NOT_FOUND, id, nullptr, 0);
+
+	m_response->token_length(m_request->token_length());
+	m_response->token() = m_request->token();
+}
+
+void ServerEndpoint::reject_bad_option()
+{
+	// the parser checks the header and the token before the options, so they are valid here
+	const uint8_t *data = m_buffer->data();
+	const MessageType type = static_cast<MessageType>((data[HEADER_OFFSET] >> 4) & 0x3);
+	const uint8_t code = data[CODE_OFFSET];
+	const uint16_t id = load_be16(data + MESSAGE_ID_OFFSET);
+	const size_t tokenLength = data[HEADER_OFFSET] & 0xF;
+	error_code ec;
+
+	if (type == CONFIRMABLE && (code >> 5) == (METHOD >> 5) && code != EMPTY)
+	{
+		// a confirmable request gets the piggybacked 4.02 Bad Option
+		m_response->prepare_answer(ec, ACKNOWLEDGEMENT, BAD_OPTION, id, nullptr, 0);
+		m_response->token_length(tokenLength);
+		memcpy(m_response->token().data(), data + TOKEN_OFFSET, tokenLength);
+	}
+	else if (type == CONFIRMABLE || type == NON_CONFIRMABLE)
+		m_response->prepare_answer(ec, RESET, EMPTY, id, nullptr, 0);
+	else
+		return; // an ACK or a RST can not be rejected, it is dropped
+
+	if (ec.value())
+	{
+		m_ec = ec;
+		return;
+	}
+	debug("a message with a bad critical option is rejected");
+	m_ec.clear();
+	m_sending = true;
 }
 
 void ServerEndpoint::error()
 {
 	debug("handler: {}",__func__);
+	m_sending = false;
 	debug("Error occured: {}", m_ec.message());
-	m_buffer.clear();
+	m_buffer.reset(); // back to the pool
+	m_request.release();
+	m_response.release();
 	m_nextState = IDLE;
 }
 
 void ServerEndpoint::complete()
 {
 	debug("handler: {}",__func__);
-	m_buffer.clear();
+	m_sending = false;
+	m_buffer.reset(); // back to the pool
+	m_request.release();
+	m_response.release();
 	m_nextState = IDLE;
 }
 
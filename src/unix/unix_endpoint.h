@@ -6,7 +6,9 @@
 #include "blockwise.h"
 #include "core_link.h"
 #include "senml_json.h"
-#include "unix_safe_queue.h"
+#include "unix_ring_queue.h"
+#include "buffer_pool.h"
+#include "packet_pool.h"
 #include <memory>
 #include <atomic>
 #include <mutex>
@@ -140,13 +142,26 @@ private:
 	void error();
 	void complete();
 
+	// answers the request by the response packet
+	void prepare_response();
+	// answers a message with a bad critical option from its header and token (RFC7252 5.4.1)
+	void reject_bad_option();
+
+public:
+	// messages handed to the endpoint by the receiving thread, the buffers stay in their pool
+	typedef SpscRing<BufferPool::Handle> ReceiveQueue;
+
+	static const size_t RECEIVE_QUEUE_CAPACITY = 64;
+
 public:
 	ServerEndpoint(const char *name, ServerConnection * connection)
 	  : Endpoint(name),
 	  m_connection{connection},
-	  m_buffer{connection->bufferPtr().get()->length()},
+	  m_buffer{},
 	  m_mutex{},
-	  m_receiveQueue{},
+	  m_receiveQueue{RECEIVE_QUEUE_CAPACITY},
+	  m_request{},
+	  m_response{},
 	  m_coreLink{},
 	  m_senmlJson{},
 	  m_receiving{false},
@@ -165,9 +180,11 @@ public:
 		)
 	  : Endpoint(name),
 	  m_connection{connection},
-	  m_buffer{connection->bufferPtr().get()->length()},
+	  m_buffer{},
 	  m_mutex{},
-	  m_receiveQueue{},
+	  m_receiveQueue{RECEIVE_QUEUE_CAPACITY},
+	  m_request{},
+	  m_response{},
 	  m_coreLink{coreLink, ec},
 	  m_senmlJson{},
 	  m_receiving{false},
@@ -177,7 +194,10 @@ public:
 	  m_currentState{IDLE},
 	  m_nextState{IDLE},
 	  m_ec{}
-	{}
+	{
+		if (!ec.value())
+			m_coreLink.create_core_link(ec); // the payload of the answers to GET /.well-known/core
+	}
 
 	~ServerEndpoint() = default;
 
@@ -189,14 +209,29 @@ public:
 	{ return m_connection; }
 
 	Buffer &buffer()
+	{ return *m_buffer; }
+
+	BufferPool::Handle &bufferPtr()
 	{ return m_buffer; }
 
+	// the packets the request is parsed into and the answer is built in, handed to the endpoint
+	// with the buffer and returned to their pool when the request is over
+	PacketPool::Handle &requestPtr()
+	{ return m_request; }
+
+	PacketPool::Handle &responsePtr()
+	{ return m_response; }
+
 	std::mutex &mutex()
 	{ return m_mutex; }
 
-	SafeQueue<Buffer> &receiveQueue()
+	ReceiveQueue &receiveQueue()
 	{ return m_receiveQueue; }
 
+	// the answer to send while sending() is true
+	const Packet & response() const
+	{ return static_cast<const Packet &>(*m_response); }
+
 	State currentState() const
 	{ return m_currentState; }
 
@@ -229,9 +264,11 @@ public:
 
 private:
 	ServerConnection  *m_connection;	// pointer to the external connection
-	Buffer            m_buffer; 		// internal buffer to parse a request and prepare an answer
+	BufferPool::Handle m_buffer;		// received request; empty while idle
 	std::mutex 		  m_mutex; 			// mutex to access to the internal buffer from different threads
-	SafeQueue<Buffer> m_receiveQueue;	// incomming message queue 
+	ReceiveQueue      m_receiveQueue;	// incomming message queue 
+	PacketPool::Handle m_request;		// parsed request; empty while idle
+	PacketPool::Handle m_response;		// answer to the request; empty while idle
 	CoreLink 		  m_coreLink;		// CoRE Link payload parser
 	SenmlJson 		  m_senmlJson;		// SenML JSON payload parser
 	bool 			  m_receiving;		// need to receive a packet
@@ -0,0 +1,229 @@
+#include "unix_executor.h"
+#include <chrono>
+
+using namespace std;
+
+namespace Unix
+{
+
+// the executor and the queue of the current worker thread, nullptr outside the workers
+static thread_local const Executor * t_executor = nullptr;
+static thread_local size_t t_worker = 0;
+
+Executor::Executor(size_t workers)
+    : m_workers{},
+      m_waiter{},
+      m_pending{0},
+      m_next{0},
+      m_stopping{false},
+      m_executed{0},
+      m_stolen{0}
+{
+    const size_t count = workers ? workers : max(thread::hardware_concurrency(), 1U);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_workers.emplace_back(new Worker);
+    }
+    // the queues exist before any worker looks for a task to steal
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_workers[i]->thread = thread(&Executor::worker, this, i);
+    }
+}
+
+Executor::~Executor()
+{
+    shutdown();
+}
+
+bool Executor::post(Task task)
+{
+    const bool fromWorker = t_executor == this;
+    const size_t index = fromWorker
+                        ? t_worker
+                        : m_next.fetch_add(1, memory_order_relaxed) % m_workers.size();
+    {
+        lock_guard<mutex> lg(m_workers[index]->mutex);
+        // a stopping worker still takes the tasks posted by itself, the others may have exited already
+        if (!fromWorker && m_stopping.load(memory_order_relaxed))
+            return false;
+        m_workers[index]->tasks.push_back(move(task));
+        m_pending.fetch_add(1, memory_order_release);
+    }
+    m_waiter.notify();
+    return true;
+}
+
+void Executor::shutdown()
+{
+    {
+        // set under all the queue locks, so a task posted from outside is either rejected
+        // or counted in m_pending before a worker can see m_stopping and exit
+        vector<unique_lock<mutex>> locks;
+        locks.reserve(m_workers.size());
+        for (auto &w : m_workers)
+            locks.emplace_back(w->mutex);
+        m_stopping.store(true, memory_order_release);
+    }
+    m_waiter.notify();
+
+    for (auto &w : m_workers)
+    {
+        if (w->thread.joinable() && w->thread.get_id() != this_thread::get_id())
+            w->thread.join();
+    }
+}
+
+bool Executor::take(size_t index, Task &task)
+{
+    Worker &w = *m_workers[index];
+    lock_guard<mutex> lg(w.mutex);
+
+    if (w.tasks.empty())
+        return false;
+
+    task = move(w.tasks.front());
+    w.tasks.pop_front();
+    return true;
+}
+
+bool Executor::steal(size_t index, Task &task)
+{
+    const size_t count = m_workers.size();
+
+    for (size_t i = 1; i < count; ++i)
+    {
+        Worker &victim = *m_workers[(index + i) % count];
+        deque<Task> loot;
+        {
+            lock_guard<mutex> lg(victim.mutex);
+            if (victim.tasks.empty())
+                continue;
+
+            // the back half, the victim keeps working on the front one
+            const size_t half = (victim.tasks.size() + 1) / 2;
+            for (size_t n = 0; n < half; ++n)
+            {
+                loot.push_front(move(victim.tasks.back()));
+                victim.tasks.pop_back();
+            }
+        }
+        m_stolen.fetch_add(loot.size(), memory_order_relaxed);
+
+        task = move(loot.front());
+        loot.pop_front();
+        if (!loot.empty())
+        {
+            Worker &own = *m_workers[index];
+            lock_guard<mutex> lg(own.mutex);
+            for (auto &t : loot)
+                own.tasks.push_back(move(t));
+        }
+        return true;
+    }
+    return false;
+}
+
+void Executor::worker(size_t index)
+{
+    t_executor = this;
+    t_worker = index;
+
+    Task task;
+    while (true)
+    {
+        if (take(index, task) || steal(index, task))
+        {
+            m_pending.fetch_sub(1, memory_order_relaxed);
+            task();
+            task = nullptr; // release the captures before sleeping
+            m_executed.fetch_add(1, memory_order_relaxed);
+            continue;
+        }
+
+        if (m_stopping.load(memory_order_acquire) && m_pending.load(memory_order_acquire) == 0)
+            break;
+
+        m_waiter.wait([this]
+            {
+                return m_pending.load(memory_order_acquire) != 0 || m_stopping.load(memory_order_acquire);
+            }, chrono::milliseconds(-1));
+    }
+}
+
+SerialQueue::SerialQueue(Executor &executor)
+    : m_executor(executor),
+      m_mutex{},
+      m_tasks{},
+      m_scheduled{false}
+{}
+
+bool SerialQueue::post(Task task)
+{
+    {
+        lock_guard<mutex> lg(m_mutex);
+        m_tasks.push_back(move(task));
+        if (m_scheduled)
+            return true; // the running batch takes it
+        m_scheduled = true;
+    }
+
+    shared_ptr<SerialQueue> self = shared_from_this();
+    if (!m_executor.post([self]{ self->run(); }))
+    {
+        drop();
+        return false;
+    }
+    return true;
+}
+
+size_t SerialQueue::size() const
+{
+    lock_guard<mutex> lg(m_mutex);
+    return m_tasks.size();
+}
+
+void SerialQueue::run()
+{
+    for (size_t i = 0; i < BATCH_SIZE; ++i)
+    {
+        Task task;
+        {
+            lock_guard<mutex> lg(m_mutex);
+            if (m_tasks.empty())
+            {
+                m_scheduled = false;
+                return;
+            }
+            task = move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+
+    {
+        lock_guard<mutex> lg(m_mutex);
+        if (m_tasks.empty())
+        {
+            m_scheduled = false;
+            return;
+        }
+    }
+    // let the other queues run, the rest goes to the back of the worker queue
+    shared_ptr<SerialQueue> self = shared_from_this();
+    if (!m_executor.post([self]{ self->run(); }))
+        drop();
+}
+
+void SerialQueue::drop()
+{
+    deque<Task> dropped; // destroyed out of the lock, the captures may post again
+    {
+        lock_guard<mutex> lg(m_mutex);
+        dropped.swap(m_tasks);
+        m_scheduled = false;
+    }
+}
+
+} // namespace Unix
@@ -0,0 +1,116 @@
+#ifndef _UNIX_EXECUTOR_H
+#define _UNIX_EXECUTOR_H
+#include "unix_ring_queue.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Unix
+{
+
+// Fixed set of worker threads running short tasks.
+// Every worker has its own queue: a task posted by a worker goes to the queue of that worker,
+// a task posted by another thread goes to the queues in turn.
+// An idle worker steals half of the queue of a busy one, so a slow task does not delay the tasks queued behind it
+class Executor
+{
+public:
+    typedef std::function<void()> Task;
+
+    // workers equal to zero means one worker per CPU core
+    explicit Executor(std::size_t workers = 0);
+    // shutdown()
+    ~Executor();
+
+    Executor(const Executor &) = delete;
+    Executor & operator=(const Executor &) = delete;
+
+public:
+    // Returns false if the executor is shutting down, the task is dropped then;
+    // the workers may still post while they drain their queues
+    bool post(Task task);
+    // Runs the queued tasks, including the ones they post, and joins the workers
+    void shutdown();
+
+    std::size_t workers() const
+    { return m_workers.size(); }
+
+    // tasks queued and not taken by a worker yet
+    std::size_t pending() const
+    { return m_pending.load(std::memory_order_relaxed); }
+
+    std::uint64_t executed() const
+    { return m_executed.load(std::memory_order_relaxed); }
+
+    // tasks moved from the queue of one worker to another
+    std::uint64_t stolen() const
+    { return m_stolen.load(std::memory_order_relaxed); }
+
+private:
+    struct Worker
+    {
+        std::mutex          mutex;
+        std::deque<Task>    tasks;
+        std::thread         thread;
+    };
+
+    void worker(std::size_t index);
+    bool take(std::size_t index, Task &task);
+    bool steal(std::size_t index, Task &task);
+
+private:
+    std::vector<std::unique_ptr<Worker>>
+                                m_workers;
+    RingWaiter                  m_waiter;       // idle workers sleep here
+    std::atomic<std::size_t>    m_pending;
+    std::atomic<std::size_t>    m_next;         // queue of the next task posted from outside
+    std::atomic<bool>           m_stopping;     // set under the locks of all the queues
+    std::atomic<std::uint64_t>  m_executed;
+    std::atomic<std::uint64_t>  m_stolen;
+};
+
+// Runs its tasks one at a time in the order of post() on the workers of an executor.
+// The tasks of different queues run in parallel, so a queue per peer keeps the requests
+// of the peer in order without a thread per peer.
+// The queue must be owned by a std::shared_ptr, a scheduled run keeps it alive
+class SerialQueue : public std::enable_shared_from_this<SerialQueue>
+{
+public:
+    typedef Executor::Task Task;
+
+    // tasks run at once before the worker is given to the other queues
+    static const std::size_t BATCH_SIZE = 16;
+
+    explicit SerialQueue(Executor &executor);
+    ~SerialQueue() = default;
+
+    SerialQueue(const SerialQueue &) = delete;
+    SerialQueue & operator=(const SerialQueue &) = delete;
+
+public:
+    // Returns false if the executor has been shut down
+    bool post(Task task);
+
+    std::size_t size() const;
+
+private:
+    void run();
+    // the executor has been shut down, the tasks will never run
+    void drop();
+
+private:
+    Executor            &m_executor;
+    mutable std::mutex  m_mutex;
+    std::deque<Task>    m_tasks;
+    bool                m_scheduled;    // a run() is posted to the executor or is running
+};
+
+} // namespace Unix
+
+#endif
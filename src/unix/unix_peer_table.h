@@ -0,0 +1,251 @@
+#ifndef _UNIX_PEER_TABLE_H
+#define _UNIX_PEER_TABLE_H
+#include "peer_key.h"
+#include "random.h"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace Unix
+{
+
+// Map from the peers to their state, sized for hundreds of thousands of peers.
+// The keys are spread over the shards, each one is an open addressing table with linear probing
+// under its own mutex, so the threads looking for different peers rarely meet.
+// The hash is seeded per table: a remote side choosing its addresses and ports can not build long probe chains.
+// T is copied out of the table, a handle such as std::shared_ptr is the intended use
+template <typename T>
+class PeerTable
+{
+public:
+    static const std::size_t DEFAULT_SHARDS = 16;
+
+    // shards is rounded up to a power of two, capacity is the expected quantity of the peers
+    explicit PeerTable(std::size_t shards = DEFAULT_SHARDS, std::size_t capacity = 0)
+        : m_seed{coap::fast_random()},
+          m_shardBits{0},
+          m_shards{},
+          m_size{0}
+    {
+        while ((static_cast<std::size_t>(1) << m_shardBits) < shards)
+            ++m_shardBits;
+
+        const std::size_t count = static_cast<std::size_t>(1) << m_shardBits;
+        m_shards.reset(new Shard[count]);
+        for (std::size_t i = 0; i < count; ++i)
+            m_shards[i].rehash(capacity / count);
+    }
+
+    PeerTable(const PeerTable &) = delete;
+    PeerTable & operator=(const PeerTable &) = delete;
+
+public:
+    // Returns false if the peer is already in the table
+    bool insert(const PeerKey &key, T value)
+    {
+        const std::uint64_t hash = key.hash(m_seed);
+        Shard &shard = shard_of(hash);
+        std::lock_guard<std::mutex> lg(shard.mutex);
+
+        if (shard.lookup(key, hash) != NOT_FOUND)
+            return false;
+
+        shard.emplace(key, hash, std::move(value));
+        m_size.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Copies the value of the peer, returns false if there is none
+    bool find(const PeerKey &key, T &value) const
+    {
+        const std::uint64_t hash = key.hash(m_seed);
+        Shard &shard = shard_of(hash);
+        std::lock_guard<std::mutex> lg(shard.mutex);
+
+        const std::size_t i = shard.lookup(key, hash);
+        if (i == NOT_FOUND)
+            return false;
+        value = shard.slots[i].value;
+        return true;
+    }
+
+    bool contains(const PeerKey &key) const
+    {
+        const std::uint64_t hash = key.hash(m_seed);
+        Shard &shard = shard_of(hash);
+        std::lock_guard<std::mutex> lg(shard.mutex);
+        return shard.lookup(key, hash) != NOT_FOUND;
+    }
+
+    // Returns false if the peer is not in the table
+    bool erase(const PeerKey &key)
+    {
+        const std::uint64_t hash = key.hash(m_seed);
+        Shard &shard = shard_of(hash);
+        T removed; // destroyed out of the lock
+        {
+            std::lock_guard<std::mutex> lg(shard.mutex);
+
+            const std::size_t i = shard.lookup(key, hash);
+            if (i == NOT_FOUND)
+                return false;
+            std::swap(removed, shard.slots[i].value);
+            shard.remove(i);
+        }
+        m_size.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Calls f(key, value) for every peer, one shard is locked at a time,
+    // so f must not change the table
+    template <typename Function>
+    void for_each(Function f) const
+    {
+        for (std::size_t s = 0; s < shards(); ++s)
+        {
+            Shard &shard = m_shards[s];
+            std::lock_guard<std::mutex> lg(shard.mutex);
+
+            for (const Slot &slot : shard.slots)
+            {
+                if (slot.used)
+                    f(slot.key, slot.value);
+            }
+        }
+    }
+
+    std::size_t size() const
+    { return m_size.load(std::memory_order_relaxed); }
+
+    bool empty() const
+    { return size() == 0; }
+
+    std::size_t shards() const
+    { return static_cast<std::size_t>(1) << m_shardBits; }
+
+private:
+    static const std::size_t NOT_FOUND = static_cast<std::size_t>(-1);
+    static const std::size_t SHARD_CAPACITY_MIN = 16;
+
+    struct Slot
+    {
+        Slot()
+            : key{},
+              hash{0},
+              value{},
+              used{false}
+        {}
+
+        PeerKey         key;
+        std::uint64_t   hash;
+        T               value;
+        bool            used;
+    };
+
+    struct Shard
+    {
+        Shard()
+            : mutex{},
+              slots{},
+              size{0}
+        {}
+
+        std::size_t mask() const
+        { return slots.size() - 1; }
+
+        std::size_t lookup(const PeerKey &key, std::uint64_t hash) const
+        {
+            for (std::size_t i = hash & mask(); slots[i].used; i = (i + 1) & mask())
+            {
+                if (slots[i].hash == hash && slots[i].key == key)
+                    return i;
+            }
+            return NOT_FOUND;
+        }
+
+        void emplace(const PeerKey &key, std::uint64_t hash, T value)
+        {
+            // the load factor is kept below 3/4, so the probe chains stay short
+            if ((size + 1) * 4 > slots.size() * 3)
+                rehash(slots.size());
+
+            std::size_t i = hash & mask();
+            while (slots[i].used)
+                i = (i + 1) & mask();
+
+            slots[i].key = key;
+            slots[i].hash = hash;
+            slots[i].value = std::move(value);
+            slots[i].used = true;
+            ++size;
+        }
+
+        // backward shift deletion: the following entries of the chain move into the hole,
+        // so no tombstones are left to lengthen the lookups
+        void remove(std::size_t hole)
+        {
+            slots[hole].used = false;
+            slots[hole].value = T();
+            --size;
+
+            for (std::size_t i = (hole + 1) & mask(); slots[i].used; i = (i + 1) & mask())
+            {
+                const std::size_t home = slots[i].hash & mask();
+                // the entry may move back if its home is not within (hole, i]
+                const bool movable = hole <= i
+                                    ? (home <= hole || home > i)
+                                    : (home <= hole && home > i);
+                if (!movable)
+                    continue;
+
+                slots[hole] = std::move(slots[i]);
+                slots[i].used = false;
+                slots[i].value = T();
+                hole = i;
+            }
+        }
+
+        // makes room for the entries at least, the capacity stays a power of two
+        void rehash(std::size_t entries)
+        {
+            std::size_t capacity = SHARD_CAPACITY_MIN;
+            while (capacity * 3 < (entries + 1) * 4)
+                capacity <<= 1;
+            if (capacity <= slots.size())
+                capacity = slots.size() << 1;
+
+            std::vector<Slot> old(capacity);
+            old.swap(slots);
+            size = 0;
+            for (Slot &slot : old)
+            {
+                if (slot.used)
+                    emplace(slot.key, slot.hash, std::move(slot.value));
+            }
+        }
+
+        mutable std::mutex  mutex;
+        std::vector<Slot>   slots;
+        std::size_t         size;
+    };
+
+    Shard & shard_of(std::uint64_t hash) const
+    {
+        // the upper bits choose the shard, the lower ones the slot inside it
+        return m_shards[m_shardBits ? static_cast<std::size_t>(hash >> (64 - m_shardBits)) : 0];
+    }
+
+private:
+    const std::uint64_t         m_seed;
+    std::size_t                 m_shardBits;
+    std::unique_ptr<Shard[]>    m_shards;
+    std::atomic<std::size_t>    m_size;
+};
+
+} // namespace Unix
+
+#endif
@@ -0,0 +1,391 @@
+#include "unix_reactor.h"
+#include <cerrno>
+#include <climits>
+#include <unistd.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#else
+#include <poll.h>
+#endif
+
+using namespace std;
+using namespace std::chrono;
+
+namespace Unix
+{
+
+// quantity of the ready descriptors taken by one epoll_wait()
+static const int REACTOR_EVENTS_MAX = 64;
+
+#ifdef __linux__
+static uint32_t to_epoll_events(uint32_t events)
+{
+    return ((events & Reactor::READABLE) ? static_cast<uint32_t>(EPOLLIN) : 0)
+            | ((events & Reactor::WRITABLE) ? static_cast<uint32_t>(EPOLLOUT) : 0);
+}
+
+static uint32_t from_epoll_events(uint32_t events)
+{
+    return ((events & EPOLLIN) ? Reactor::READABLE : 0)
+            | ((events & EPOLLOUT) ? Reactor::WRITABLE : 0)
+            | ((events & (EPOLLERR | EPOLLHUP)) ? Reactor::FAILED : 0);
+}
+#else
+static short to_poll_events(uint32_t events)
+{
+    return ((events & Reactor::READABLE) ? POLLIN : 0)
+            | ((events & Reactor::WRITABLE) ? POLLOUT : 0);
+}
+
+static uint32_t from_poll_events(short events)
+{
+    return ((events & POLLIN) ? Reactor::READABLE : 0)
+            | ((events & POLLOUT) ? Reactor::WRITABLE : 0)
+            | ((events & (POLLERR | POLLHUP | POLLNVAL)) ? Reactor::FAILED : 0);
+}
+#endif
+
+Reactor::Reactor(error_code &ec)
+    : m_pollFd{-1},
+      m_wakeupFd{-1, -1},
+      m_stopped{false},
+      m_mutex{},
+      m_watches{},
+      m_timers{},
+      m_timerHandlers{},
+      m_lastTimerId{0},
+      m_posted{}
+{
+#ifdef __linux__
+    m_pollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_pollFd < 0)
+    {
+        ec = make_system_error(errno);
+        return;
+    }
+    m_wakeupFd[0] = m_wakeupFd[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeupFd[0] < 0)
+    {
+        ec = make_system_error(errno);
+        return;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = m_wakeupFd[0];
+    if (epoll_ctl(m_pollFd, EPOLL_CTL_ADD, m_wakeupFd[0], &event) < 0)
+    {
+        ec = make_system_error(errno);
+    }
+#else
+    if (pipe(m_wakeupFd) < 0)
+    {
+        ec = make_system_error(errno);
+        return;
+    }
+    for (int fd : m_wakeupFd)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+#endif
+}
+
+Reactor::~Reactor()
+{
+    if (m_wakeupFd[0] >= 0)
+        ::close(m_wakeupFd[0]);
+    if (m_wakeupFd[1] >= 0 && m_wakeupFd[1] != m_wakeupFd[0])
+        ::close(m_wakeupFd[1]);
+    if (m_pollFd >= 0)
+        ::close(m_pollFd);
+}
+
+void Reactor::add(int fd, uint32_t events, IoHandler handler, error_code &ec)
+{
+    if (fd < 0 || !handler)
+    {
+        ec = make_system_error(EINVAL);
+        return;
+    }
+
+    lock_guard<mutex> lg(m_mutex);
+    if (m_watches.count(fd))
+    {
+        ec = make_system_error(EEXIST);
+        return;
+    }
+#ifdef __linux__
+    struct epoll_event event;
+    event.events = to_epoll_events(events);
+    event.data.fd = fd;
+    if (epoll_ctl(m_pollFd, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        ec = make_system_error(errno);
+        return;
+    }
+#endif
+    m_watches[fd] = make_shared<Watch>(Watch{events, move(handler)});
+#ifndef __linux__
+    wakeup(); // poll() has to take the new descriptor
+#endif
+}
+
+void Reactor::modify(int fd, uint32_t events, error_code &ec)
+{
+    lock_guard<mutex> lg(m_mutex);
+    auto found = m_watches.find(fd);
+    if (found == m_watches.end())
+    {
+        ec = make_system_error(ENOENT);
+        return;
+    }
+#ifdef __linux__
+    struct epoll_event event;
+    event.events = to_epoll_events(events);
+    event.data.fd = fd;
+    if (epoll_ctl(m_pollFd, EPOLL_CTL_MOD, fd, &event) < 0)
+    {
+        ec = make_system_error(errno);
+        return;
+    }
+#endif
+    found->second->events = events;
+#ifndef __linux__
+    wakeup();
+#endif
+}
+
+void Reactor::remove(int fd, error_code &ec)
+{
+    lock_guard<mutex> lg(m_mutex);
+    if (!m_watches.erase(fd))
+    {
+        ec = make_system_error(ENOENT);
+        return;
+    }
+#ifdef __linux__
+    struct epoll_event event; // ignored, but required by the kernels before 2.6.9
+    if (epoll_ctl(m_pollFd, EPOLL_CTL_DEL, fd, &event) < 0 && errno != EBADF)
+    {
+        ec = make_system_error(errno);
+    }
+#endif
+}
+
+Reactor::TimerId Reactor::schedule(Clock::duration delay, Handler handler)
+{
+    const Timer timer{Clock::now() + delay, 0};
+    bool earliest;
+    TimerId id;
+    {
+        lock_guard<mutex> lg(m_mutex);
+        id = ++m_lastTimerId;
+        earliest = m_timers.empty() || timer.deadline < m_timers.top().deadline;
+        m_timers.push(Timer{timer.deadline, id});
+        m_timerHandlers.emplace(id, move(handler));
+    }
+    if (earliest)
+        wakeup(); // the reactor may be sleeping until a later deadline
+    return id;
+}
+
+bool Reactor::cancel(TimerId id)
+{
+    lock_guard<mutex> lg(m_mutex);
+    return m_timerHandlers.erase(id) != 0;
+}
+
+void Reactor::post(Handler handler)
+{
+    {
+        lock_guard<mutex> lg(m_mutex);
+        m_posted.push_back(move(handler));
+    }
+    wakeup();
+}
+
+void Reactor::run(error_code &ec)
+{
+    while (!stopped())
+    {
+        run_once(milliseconds(-1), ec);
+        if (ec.value())
+            return;
+    }
+}
+
+size_t Reactor::run_once(milliseconds timeout, error_code &ec)
+{
+    size_t handled = 0;
+    const int waitMs = wait_timeout(timeout);
+
+#ifdef __linux__
+    struct epoll_event events[REACTOR_EVENTS_MAX];
+
+    int ready = epoll_wait(m_pollFd, events, REACTOR_EVENTS_MAX, waitMs);
+    if (ready < 0)
+    {
+        if (errno != EINTR)
+        {
+            ec = make_system_error(errno);
+            return 0;
+        }
+        ready = 0;
+    }
+
+    for (int i = 0; i < ready; ++i)
+    {
+        if (events[i].data.fd == m_wakeupFd[0])
+            drain_wakeup();
+        else
+            handled += dispatch(events[i].data.fd, from_epoll_events(events[i].events));
+    }
+#else
+    vector<struct pollfd> fds;
+    {
+        lock_guard<mutex> lg(m_mutex);
+        fds.reserve(m_watches.size() + 1);
+        fds.push_back(pollfd{m_wakeupFd[0], POLLIN, 0});
+        for (const auto &watch : m_watches)
+            fds.push_back(pollfd{watch.first, to_poll_events(watch.second->events), 0});
+    }
+
+    int ready = poll(fds.data(), fds.size(), waitMs);
+    if (ready < 0)
+    {
+        if (errno != EINTR)
+        {
+            ec = make_system_error(errno);
+            return 0;
+        }
+        ready = 0;
+    }
+
+    for (size_t i = 0; ready > 0 && i < fds.size(); ++i)
+    {
+        if (!fds[i].revents)
+            continue;
+        --ready;
+        if (i == 0)
+            drain_wakeup();
+        else
+            handled += dispatch(fds[i].fd, from_poll_events(fds[i].revents));
+    }
+#endif
+
+    handled += run_timers();
+    handled += run_posted();
+    return handled;
+}
+
+void Reactor::stop()
+{
+    m_stopped.store(true, memory_order_release);
+    wakeup();
+}
+
+size_t Reactor::watches() const
+{
+    lock_guard<mutex> lg(m_mutex);
+    return m_watches.size();
+}
+
+size_t Reactor::timers() const
+{
+    lock_guard<mutex> lg(m_mutex);
+    return m_timerHandlers.size();
+}
+
+void Reactor::wakeup()
+{
+    // only write(2) here, stop() is called from the signal handlers
+    const uint64_t one = 1;
+    ssize_t written = ::write(m_wakeupFd[1], &one, m_wakeupFd[0] == m_wakeupFd[1] ? sizeof(one) : 1);
+    (void)written; // a full pipe or counter already wakes the reactor up
+}
+
+void Reactor::drain_wakeup()
+{
+    uint64_t value;
+    while (::read(m_wakeupFd[0], &value, sizeof(value)) > 0)
+        ;
+}
+
+int Reactor::wait_timeout(milliseconds timeout)
+{
+    lock_guard<mutex> lg(m_mutex);
+
+    if (!m_posted.empty() || stopped())
+        return 0;
+
+    // the cancelled timers on the top of the queue must not shorten the wait
+    while (!m_timers.empty() && !m_timerHandlers.count(m_timers.top().id))
+        m_timers.pop();
+
+    if (m_timers.empty())
+        return timeout.count() < 0 ? -1 : static_cast<int>(min<milliseconds::rep>(timeout.count(), INT_MAX));
+
+    const Clock::duration left = m_timers.top().deadline - Clock::now();
+    if (left <= Clock::duration::zero())
+        return 0;
+
+    // round up, otherwise the reactor wakes up just before the deadline and waits again
+    milliseconds until = duration_cast<milliseconds>(left + milliseconds(1) - Clock::duration(1));
+    if (timeout.count() >= 0 && timeout < until)
+        until = timeout;
+    return static_cast<int>(min<milliseconds::rep>(until.count(), INT_MAX));
+}
+
+size_t Reactor::dispatch(int fd, uint32_t events)
+{
+    shared_ptr<Watch> watch;
+    {
+        lock_guard<mutex> lg(m_mutex);
+        auto found = m_watches.find(fd);
+        if (found == m_watches.end())
+            return 0; // removed by a previous handler of this wait
+        watch = found->second;
+    }
+    // the handler may remove the watch, the shared pointer keeps it alive until the call ends
+    watch->handler(events);
+    return 1;
+}
+
+size_t Reactor::run_timers()
+{
+    vector<Handler> expired;
+    {
+        lock_guard<mutex> lg(m_mutex);
+        const Clock::time_point now = Clock::now();
+
+        while (!m_timers.empty() && m_timers.top().deadline <= now)
+        {
+            auto found = m_timerHandlers.find(m_timers.top().id);
+            if (found != m_timerHandlers.end())
+            {
+                expired.push_back(move(found->second));
+                m_timerHandlers.erase(found);
+            }
+            m_timers.pop();
+        }
+    }
+    for (auto &handler : expired)
+        handler();
+    return expired.size();
+}
+
+size_t Reactor::run_posted()
+{
+    vector<Handler> posted;
+    {
+        lock_guard<mutex> lg(m_mutex);
+        posted.swap(m_posted);
+    }
+    for (auto &handler : posted)
+        handler();
+    return posted.size();
+}
+
+} // namespace Unix
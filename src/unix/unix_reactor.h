@@ -0,0 +1,112 @@
+#ifndef _UNIX_REACTOR_H
+#define _UNIX_REACTOR_H
+#include "error.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+namespace Unix
+{
+
+// Event loop: waits for the descriptors with epoll(7) (poll(2) on the other systems),
+// fires the timers and runs the handlers posted from the other threads.
+// The methods may be called from any thread, the handlers always run in the thread of run()
+class Reactor
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::function<void(std::uint32_t events)> IoHandler;
+    typedef std::function<void()> Handler;
+    typedef std::uint64_t TimerId;
+
+    static const std::uint32_t READABLE = 1 << 0;
+    static const std::uint32_t WRITABLE = 1 << 1;
+    static const std::uint32_t FAILED   = 1 << 2; // error or hang up, reported without asking
+
+    explicit Reactor(std::error_code &ec);
+    ~Reactor();
+
+    Reactor(const Reactor &) = delete;
+    Reactor & operator=(const Reactor &) = delete;
+
+public:
+    void add(int fd, std::uint32_t events, IoHandler handler, std::error_code &ec);
+    void modify(int fd, std::uint32_t events, std::error_code &ec);
+    void remove(int fd, std::error_code &ec);
+
+    // The handler runs once after the delay. The returned ID is never zero
+    TimerId schedule(Clock::duration delay, Handler handler);
+    // Returns false if the timer has already fired or has been cancelled
+    bool cancel(TimerId id);
+
+    // Runs the handler in the reactor thread as soon as possible
+    void post(Handler handler);
+
+    // Dispatches the events until stop() is called
+    void run(std::error_code &ec);
+    // Waits for the events no longer than timeout (a negative one is infinite) and dispatches them,
+    // returns the quantity of the called handlers
+    std::size_t run_once(std::chrono::milliseconds timeout, std::error_code &ec);
+
+    // Makes run() return, async-signal-safe
+    void stop();
+
+    // Allows run() again after stop()
+    void restart()
+    { m_stopped.store(false, std::memory_order_release); }
+
+    bool stopped() const
+    { return m_stopped.load(std::memory_order_acquire); }
+
+    std::size_t watches() const;
+    std::size_t timers() const;
+
+private:
+    struct Watch
+    {
+        std::uint32_t   events;
+        IoHandler       handler;
+    };
+
+    struct Timer
+    {
+        Clock::time_point   deadline;
+        TimerId             id;
+
+        bool operator>(const Timer &other) const
+        { return deadline > other.deadline || (deadline == other.deadline && id > other.id); }
+    };
+
+    void wakeup();
+    void drain_wakeup();
+    int wait_timeout(std::chrono::milliseconds timeout);
+    std::size_t dispatch(int fd, std::uint32_t events);
+    std::size_t run_timers();
+    std::size_t run_posted();
+
+private:
+    int                 m_pollFd;       // epoll instance, -1 if poll(2) is used
+    int                 m_wakeupFd[2];  // eventfd in both the entries or a pipe
+    std::atomic<bool>   m_stopped;
+    mutable std::mutex  m_mutex;
+    std::unordered_map<int, std::shared_ptr<Watch>>
+                        m_watches;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>>
+                        m_timers;       // may keep the cancelled timers until their deadline
+    std::unordered_map<TimerId, Handler>
+                        m_timerHandlers;
+    TimerId             m_lastTimerId;
+    std::vector<Handler>
+                        m_posted;
+};
+
+} // namespace Unix
+
+#endif
@@ -0,0 +1,348 @@
+#ifndef _UNIX_RING_QUEUE_H
+#define _UNIX_RING_QUEUE_H
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#ifdef __linux__
+#include <cerrno>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <mutex>
+#include <condition_variable>
+#endif
+
+namespace Unix
+{
+
+const std::size_t CACHE_LINE_SIZE = 64;
+
+// Puts the consumer of a ring to sleep until the ring is not empty.
+// While nobody sleeps notify() costs a fence and a load, the futex(2) call is made for a sleeping consumer only
+class RingWaiter
+{
+public:
+    RingWaiter()
+        : m_epoch{0},
+          m_sleepers{0}
+#ifndef __linux__
+          , m_mutex{},
+          m_cv{}
+#endif
+    {}
+
+    // Returns ready(), a negative timeout is infinite
+    template <typename Ready>
+    bool wait(Ready ready, std::chrono::milliseconds timeout)
+    {
+        typedef std::chrono::steady_clock Clock;
+        const Clock::time_point deadline = Clock::now() + (timeout.count() < 0 ? std::chrono::milliseconds(0) : timeout);
+
+        while (!ready())
+        {
+            std::chrono::milliseconds left(-1);
+            if (timeout.count() >= 0)
+            {
+                left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+                if (left.count() <= 0)
+                    return ready();
+            }
+
+            const std::uint32_t epoch = m_epoch.load(std::memory_order_acquire);
+            m_sleepers.fetch_add(1, std::memory_order_relaxed);
+            // pairs with the fence of notify(): either the producer sees the sleeper
+            // or ready() below sees the pushed element
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!ready())
+                sleep(epoch, left);
+            m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // Called after the ring has been changed
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleepers.load(std::memory_order_relaxed) == 0)
+            return;
+        m_epoch.fetch_add(1, std::memory_order_release);
+        wake();
+    }
+
+private:
+#ifdef __linux__
+    void sleep(std::uint32_t epoch, std::chrono::milliseconds timeout)
+    {
+        struct timespec ts;
+        struct timespec *pts = nullptr;
+        if (timeout.count() >= 0)
+        {
+            ts.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+            ts.tv_nsec = static_cast<long>(timeout.count() % 1000) * 1000000L;
+            pts = &ts;
+        }
+        // returns at once if notify() has already changed the epoch
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&m_epoch), FUTEX_WAIT_PRIVATE, epoch, pts, nullptr, 0);
+    }
+
+    void wake()
+    { syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&m_epoch), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0); }
+#else
+    void sleep(std::uint32_t epoch, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> ul(m_mutex);
+        auto changed = [this, epoch]{ return m_epoch.load(std::memory_order_acquire) != epoch; };
+        if (timeout.count() < 0)
+            m_cv.wait(ul, changed);
+        else
+            m_cv.wait_for(ul, timeout, changed);
+    }
+
+    void wake()
+    {
+        std::lock_guard<std::mutex> lg(m_mutex);
+        m_cv.notify_all();
+    }
+#endif
+
+private:
+    std::atomic<std::uint32_t>  m_epoch;
+    std::atomic<std::uint32_t>  m_sleepers;
+#ifndef __linux__
+    std::mutex                  m_mutex;
+    std::condition_variable     m_cv;
+#endif
+};
+
+inline std::size_t ring_capacity(std::size_t capacity)
+{
+    std::size_t rounded = 2;
+    while (rounded < capacity)
+        rounded <<= 1;
+    return rounded;
+}
+
+// Bounded lock-free queue for one producer and one consumer thread.
+// T must be default constructible and move assignable, a handle such as std::unique_ptr is the intended use
+template <typename T>
+class SpscRing
+{
+public:
+    // the capacity is rounded up to a power of two
+    explicit SpscRing(std::size_t capacity)
+        : m_slots{new T[ring_capacity(capacity)]},
+          m_mask{ring_capacity(capacity) - 1},
+          m_closed{false},
+          m_waiter{},
+          m_head{0},
+          m_cachedTail{0},
+          m_tail{0},
+          m_cachedHead{0}
+    {}
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing & operator=(const SpscRing &) = delete;
+
+    // Producer: false if the ring is full or closed, then value is left untouched
+    bool push(T &&value)
+    {
+        if (closed())
+            return false;
+
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cachedHead > m_mask)
+        {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (tail - m_cachedHead > m_mask)
+                return false;
+        }
+        m_slots[tail & m_mask] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        m_waiter.notify();
+        return true;
+    }
+
+    // Consumer: false if the ring is empty
+    bool pop(T &value)
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cachedTail)
+        {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cachedTail)
+                return false;
+        }
+        value = std::move(m_slots[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: sleeps while the ring is empty, false on the timeout or if the ring is closed and empty
+    bool wait_pop(T &value, std::chrono::milliseconds timeout = std::chrono::milliseconds(-1))
+    {
+        if (pop(value))
+            return true;
+        m_waiter.wait([this]{ return !empty() || closed(); }, timeout);
+        return pop(value);
+    }
+
+    // Rejects the following pushes and wakes the consumer up, the queued elements may still be popped
+    void close()
+    {
+        m_closed.store(true, std::memory_order_release);
+        m_waiter.notify();
+    }
+
+    bool closed() const
+    { return m_closed.load(std::memory_order_acquire); }
+
+    bool empty() const
+    { return size() == 0; }
+
+    std::size_t size() const
+    { return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire); }
+
+    std::size_t capacity() const
+    { return m_mask + 1; }
+
+private:
+    std::unique_ptr<T[]>        m_slots;
+    const std::size_t           m_mask;
+    std::atomic<bool>           m_closed;
+    RingWaiter                  m_waiter;
+    char                        m_pad0[CACHE_LINE_SIZE];
+    std::atomic<std::size_t>    m_head;         // written by the consumer only
+    std::size_t                 m_cachedTail;
+    char                        m_pad1[CACHE_LINE_SIZE - 2 * sizeof(std::size_t)];
+    std::atomic<std::size_t>    m_tail;         // written by the producer only
+    std::size_t                 m_cachedHead;
+    char                        m_pad2[CACHE_LINE_SIZE - 2 * sizeof(std::size_t)];
+};
+
+// Bounded lock-free queue for many producers and one consumer thread (D. Vyukov's bounded queue).
+// Every slot carries a sequence number, so a producer claims a slot with one CAS
+// and the consumer sees the element only after the producer has stored it
+template <typename T>
+class MpscRing
+{
+public:
+    // the capacity is rounded up to a power of two
+    explicit MpscRing(std::size_t capacity)
+        : m_slots{new Slot[ring_capacity(capacity)]},
+          m_mask{ring_capacity(capacity) - 1},
+          m_closed{false},
+          m_waiter{},
+          m_head{0},
+          m_tail{0}
+    {
+        for (std::size_t i = 0; i <= m_mask; ++i)
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpscRing(const MpscRing &) = delete;
+    MpscRing & operator=(const MpscRing &) = delete;
+
+    // Any thread: false if the ring is full or closed, then value is left untouched
+    bool push(T &&value)
+    {
+        if (closed())
+            return false;
+
+        std::size_t pos = m_tail.load(std::memory_order_relaxed);
+        Slot *slot;
+        for (;;)
+        {
+            slot = &m_slots[pos & m_mask];
+            const std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence - pos);
+
+            if (diff == 0)
+            {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = m_tail.load(std::memory_order_relaxed);
+        }
+        slot->value = std::move(value);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        m_waiter.notify();
+        return true;
+    }
+
+    // Consumer: false if the ring is empty
+    bool pop(T &value)
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        Slot &slot = m_slots[head & m_mask];
+
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1)
+            return false;
+
+        value = std::move(slot.value);
+        slot.sequence.store(head + m_mask + 1, std::memory_order_release);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: sleeps while the ring is empty, false on the timeout or if the ring is closed and empty
+    bool wait_pop(T &value, std::chrono::milliseconds timeout = std::chrono::milliseconds(-1))
+    {
+        if (pop(value))
+            return true;
+        m_waiter.wait([this]{ return !empty() || closed(); }, timeout);
+        return pop(value);
+    }
+
+    void close()
+    {
+        m_closed.store(true, std::memory_order_release);
+        m_waiter.notify();
+    }
+
+    bool closed() const
+    { return m_closed.load(std::memory_order_acquire); }
+
+    // exact for the consumer, a hint for the other threads
+    bool empty() const
+    {
+        const std::size_t head = m_head.load(std::memory_order_acquire);
+        return m_slots[head & m_mask].sequence.load(std::memory_order_acquire) != head + 1;
+    }
+
+    std::size_t size() const
+    { return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire); }
+
+    std::size_t capacity() const
+    { return m_mask + 1; }
+
+private:
+    struct Slot
+    {
+        std::atomic<std::size_t>    sequence;
+        T                           value;
+    };
+
+    std::unique_ptr<Slot[]>     m_slots;
+    const std::size_t           m_mask;
+    std::atomic<bool>           m_closed;
+    RingWaiter                  m_waiter;
+    char                        m_pad0[CACHE_LINE_SIZE];
+    std::atomic<std::size_t>    m_head;         // written by the consumer only
+    char                        m_pad1[CACHE_LINE_SIZE - sizeof(std::size_t)];
+    std::atomic<std::size_t>    m_tail;         // claimed by the producers
+    char                        m_pad2[CACHE_LINE_SIZE - sizeof(std::size_t)];
+};
+
+} // namespace Unix
+
+#endif
@@ -0,0 +1,253 @@
+#include "unix_sharded_server.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/fmt.h>
+
+using namespace std;
+using namespace spdlog;
+
+namespace Unix
+{
+
+UdpServerShard::UdpServerShard(size_t index, int port, bool version4, error_code &ec, SocketBackend backend)
+    : m_index{index},
+      m_connection{port, version4, ec, backend},
+      m_reactor{ec},
+      m_pool{0, POOL_CAPACITY, 0},
+      m_buffers(BATCH_SIZE),
+      m_addresses(BATCH_SIZE),
+      m_datagrams(BATCH_SIZE),
+      m_dropped{0}
+{
+    if (ec.value()) return;
+
+    m_connection.reuse_port(ec);
+}
+
+size_t UdpServerShard::receive(error_code &ec)
+{
+    size_t count = BATCH_SIZE;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!m_buffers[i])
+            m_buffers[i] = m_pool.acquire(m_connection.bufferPtr()->length());
+
+        if (!m_buffers[i])
+        {
+            count = i;
+            break;
+        }
+
+        m_datagrams[i].data = m_buffers[i]->data();
+        m_datagrams[i].length = m_buffers[i]->length();
+        m_datagrams[i].address = &m_addresses[i];
+    }
+
+    if (count == 0)
+    {
+        // the handler holds all the buffers, the queued datagrams are dropped instead of keeping
+        // the socket readable
+        count = BATCH_SIZE;
+        m_connection.drop_batch(count, ec);
+        m_dropped += count;
+        return 0;
+    }
+
+    m_connection.receive_batch(m_datagrams.data(), count, ec);
+    if (ec.value())
+        return 0;
+
+    // a truncated datagram is dropped, its buffer stays for the next batch
+    size_t kept = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (m_datagrams[i].truncated)
+        {
+            debug("shard {0:d}: truncated datagram of {1:d} bytes dropped", m_index, m_datagrams[i].length);
+            continue;
+        }
+        if (kept != i)
+        {
+            swap(m_buffers[kept], m_buffers[i]);
+            swap(m_datagrams[kept], m_datagrams[i]);
+        }
+        m_buffers[kept]->offset(m_datagrams[kept].length);
+        m_buffers[kept]->timestamp(m_datagrams[kept].timestamp);
+        ++kept;
+    }
+    return kept;
+}
+
+ShardedUdpServer::ShardedUdpServer(int port, bool version4, size_t shards, bool pinned, SocketBackend backend)
+    : m_port{port},
+      m_version4{version4},
+      m_count{shards ? shards : max(thread::hardware_concurrency(), 1U)},
+      m_pinned{pinned},
+      m_backend{backend},
+      m_shards{},
+      m_workers{},
+      m_handler{}
+{}
+
+ShardedUdpServer::~ShardedUdpServer()
+{
+    stop();
+    join();
+}
+
+static int bound_port(int descriptor, error_code &ec)
+{
+    struct sockaddr_storage address;
+    socklen_t addrLen = sizeof(address);
+
+    if (getsockname(descriptor, reinterpret_cast<struct sockaddr *>(&address), &addrLen) < 0)
+    {
+        ec = make_system_error(errno);
+        return 0;
+    }
+    if (address.ss_family == AF_INET)
+        return ntohs(reinterpret_cast<const struct sockaddr_in *>(&address)->sin_port);
+    return ntohs(reinterpret_cast<const struct sockaddr_in6 *>(&address)->sin6_port);
+}
+
+void ShardedUdpServer::bind(error_code &ec)
+{
+    if (!m_shards.empty())
+    {
+        ec = make_system_error(EALREADY);
+        return;
+    }
+
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        unique_ptr<UdpServerShard> shard(new UdpServerShard(i, m_port, m_version4, ec, m_backend));
+        if (ec.value())
+            break;
+
+        shard->connection().bind(ec);
+        if (ec.value())
+            break;
+
+        if (m_port == 0)
+        {
+            m_port = bound_port(shard->descriptor(), ec);
+            if (ec.value())
+                break;
+        }
+        m_shards.push_back(move(shard));
+    }
+
+    if (ec.value())
+    {
+        debug("shard {0:d} can not be bound: {1}", m_shards.size(), ec.message());
+        m_shards.clear();
+    }
+}
+
+void ShardedUdpServer::start(BatchHandler handler, error_code &ec)
+{
+    if (m_shards.empty())
+    {
+        ec = make_error_code(CoapStatus::COAP_ERR_SOCKET_NOT_BOUND);
+        return;
+    }
+    if (!handler || !m_workers.empty())
+    {
+        ec = make_system_error(EINVAL);
+        return;
+    }
+    m_handler = move(handler);
+
+    for (auto &shard : m_shards)
+    {
+        UdpServerShard *sh = shard.get();
+
+        sh->reactor().add(sh->event_descriptor(), Reactor::READABLE, [this, sh](uint32_t events)
+            {
+                error_code rec;
+
+                if (events & Reactor::FAILED)
+                {
+                    debug("shard {0:d}: socket error, the worker is stopping", sh->index());
+                    sh->reactor().stop();
+                    return;
+                }
+
+                do // the segments left of a coalesced read do not make the socket readable again
+                {
+                    size_t count = sh->receive(rec);
+                    if (rec.value())
+                    {
+                        debug("shard {0:d}: receive error: {1}", sh->index(), rec.message());
+                        return;
+                    }
+                    m_handler(*sh, count);
+                }
+                while (sh->connection().receive_pending());
+            }, ec);
+        if (ec.value())
+            return;
+    }
+
+    for (auto &shard : m_shards)
+    {
+        m_workers.emplace_back(&ShardedUdpServer::worker, this, ref(*shard));
+    }
+}
+
+void ShardedUdpServer::stop()
+{
+    for (auto &shard : m_shards)
+    {
+        shard->reactor().stop();
+    }
+}
+
+void ShardedUdpServer::join()
+{
+    for (auto &worker : m_workers)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+    m_workers.clear();
+}
+
+void ShardedUdpServer::pin(size_t index) const
+{
+#ifdef __linux__
+    if (m_pinned)
+    {
+        const unsigned cores = max(thread::hardware_concurrency(), 1U);
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(index % cores, &set);
+
+        int status = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (status != 0)
+        {
+            debug("shard {0:d} can not be pinned: {1}", index, make_system_error(status).message());
+        }
+    }
+#else
+    (void)index;
+#endif
+}
+
+void ShardedUdpServer::worker(UdpServerShard &shard)
+{
+    pin(shard.index());
+
+    error_code ec;
+    shard.reactor().run(ec);
+    if (ec.value())
+    {
+        debug("shard {0:d}: reactor error: {1}", shard.index(), ec.message());
+    }
+}
+
+} // namespace Unix
@@ -0,0 +1,149 @@
+#ifndef _UNIX_SHARDED_SERVER_H
+#define _UNIX_SHARDED_SERVER_H
+#include "unix_udp_server.h"
+#include "unix_reactor.h"
+#include "unix_socket.h"
+#include "buffer_pool.h"
+#include "error.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace Unix
+{
+
+// One SO_REUSEPORT socket of a sharded server with everything its worker thread needs.
+// Only the worker touches a shard, so nothing here is shared between the threads
+class UdpServerShard
+{
+public:
+    // maximal quantity of the datagrams taken by one receive() call
+    static const std::size_t BATCH_SIZE = 32;
+    // maximal quantity of the buffers of the shard, including the ones the handler holds
+    static const std::size_t POOL_CAPACITY = 1024;
+
+    UdpServerShard(std::size_t index, int port, bool version4, std::error_code &ec,
+                   SocketBackend backend = SocketBackend::POLL);
+    ~UdpServerShard() = default;
+
+    UdpServerShard(const UdpServerShard &) = delete;
+    UdpServerShard & operator=(const UdpServerShard &) = delete;
+
+public:
+    // Receives a batch into the buffers of the shard, returns the quantity of the datagrams.
+    // The batch is shorter if the pool runs out of the buffers, if there is none the queued
+    // datagrams are dropped and counted in dropped()
+    std::size_t receive(std::error_code &ec);
+
+    std::size_t index() const
+    { return m_index; }
+
+    UdpServerConnection & connection()
+    { return m_connection; }
+
+    Reactor & reactor()
+    { return m_reactor; }
+
+    int descriptor() const
+    { return static_cast<const UnixSocket *>(m_connection.socket())->descriptor(); }
+
+    // the descriptor the reactor of the shard watches, the ring one with an io_uring socket
+    int event_descriptor() const
+    { return static_cast<const UnixSocket *>(m_connection.socket())->event_descriptor(); }
+
+    // the datagrams of the last batch, their data point to the buffers below
+    const Datagram * datagrams() const
+    { return m_datagrams.data(); }
+
+    // offset() of the buffer is the length of the received datagram, timestamp() its kernel
+    // receive time if the connection takes them, see UdpServerConnection::receive_timestamps().
+    // The handler may take the buffer away, receive() takes a new one from the pool into the empty slot
+    BufferPool::Handle & buffer(std::size_t i)
+    { return m_buffers[i]; }
+
+    BufferPool & pool()
+    { return m_pool; }
+
+    // datagrams dropped for the lack of a free buffer
+    std::uint64_t dropped() const
+    { return m_dropped; }
+
+private:
+    std::size_t                     m_index;
+    UdpServerConnection             m_connection;
+    Reactor                         m_reactor;
+    BufferPool                      m_pool;
+    std::vector<BufferPool::Handle> m_buffers;
+    std::vector<UnixSocketAddress>  m_addresses;
+    std::vector<Datagram>           m_datagrams;
+    std::uint64_t                   m_dropped;
+};
+
+// UDP server that spreads the load over the CPU cores.
+// Every shard has its own socket bound to the same port and its own worker thread pinned to a core.
+// The kernel keeps the datagrams of one peer on one socket, so a shard can keep its own
+// table of the peers and the receive path takes no lock shared with the other threads
+class ShardedUdpServer
+{
+public:
+    // Called in the worker thread of the shard for every received batch
+    typedef std::function<void(UdpServerShard &shard, std::size_t count)> BatchHandler;
+
+    // shards equal to zero means one shard per CPU core, the backend picks the sockets of the shards
+    ShardedUdpServer(int port, bool version4, std::size_t shards = 0, bool pinned = true,
+                     SocketBackend backend = SocketBackend::POLL);
+    ~ShardedUdpServer();
+
+    ShardedUdpServer(const ShardedUdpServer &) = delete;
+    ShardedUdpServer & operator=(const ShardedUdpServer &) = delete;
+
+public:
+    // Opens and binds the sockets. With port 0 the first socket picks a free port and the others share it
+    void bind(std::error_code &ec);
+    // Starts the workers
+    void start(BatchHandler handler, std::error_code &ec);
+    // Makes the workers return, async-signal-safe
+    void stop();
+    // Waits for the workers
+    void join();
+    // Pins the calling thread to the core of the shard if the server is pinned,
+    // so a thread working for the shard (e.g. its executor) shares the caches with it
+    void pin(std::size_t index) const;
+
+    int port() const
+    { return m_port; }
+
+    bool version4() const
+    { return m_version4; }
+
+    std::size_t shards() const
+    { return m_count; }
+
+    SocketBackend backend() const
+    { return m_backend; }
+
+    UdpServerShard & shard(std::size_t index)
+    { return *m_shards[index]; }
+
+private:
+    void worker(UdpServerShard &shard);
+
+private:
+    int                 m_port;
+    bool                m_version4;
+    std::size_t         m_count;
+    bool                m_pinned;
+    SocketBackend       m_backend;
+    std::vector<std::unique_ptr<UdpServerShard>>
+                        m_shards;
+    std::vector<std::thread>
+                        m_workers;
+    BatchHandler        m_handler;
+};
+
+} // namespace Unix
+
+#endif
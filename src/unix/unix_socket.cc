@@ -3,6 +3,7 @@
 #include <netdb.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <sys/select.h>
 #include <sys/time.h>
@@ -11,6 +12,12 @@
 #include <cstdlib>
 #include <unistd.h>
 #include <fcntl.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#ifdef __linux__
+#include <netinet/udp.h>
+#endif
 #include "spdlog/spdlog.h"
 #include <spdlog/fmt/fmt.h>
 
@@ -22,6 +29,35 @@
 using namespace std;
 using namespace spdlog;
 
+#if defined(__linux__) && defined(UDP_SEGMENT) && defined(UDP_GRO)
+#define HAVE_UDP_OFFLOAD
+// the kernel takes up to 64 segments per message (UDP_MAX_SEGMENTS)
+static const size_t SEGMENTS_MAX = 64;
+// all the segments of a message make one IP packet first, the bound of IPv4 is the stricter one
+static const size_t SEGMENTED_BYTES_MAX = 65507;
+#endif
+
+struct UnixSocket::Coalesced
+{
+    Coalesced()
+        : data(65535),  // the greatest UDP payload, a coalesced read is not longer
+          offset{0},
+          length{0},
+          segment{0},
+          address(),
+          addressLength{0},
+          timestamp{0}
+    {}
+
+    vector<uint8_t>         data;
+    size_t                  offset;     // the next segment to hand over
+    size_t                  length;
+    size_t                  segment;    // size of the segments, the last one may be shorter
+    struct sockaddr_storage address;
+    socklen_t               addressLength;
+    uint64_t                timestamp;
+};
+
 void UnixSocketAddress::address4(const void *value, size_t len, error_code &ec)
 {
     if (value == nullptr)
@@ -52,6 +88,42 @@ void UnixSocketAddress::address6(const void *value, size_t len, error_code &ec)
     memcpy(&m_address6, value, len);
 }
 
+UnixSocketAddress::UnixSocketAddress(const PeerKey & key)
+    : SocketAddress(key.family()),
+      m_address4{0},
+      m_address6{0}
+{
+    switch(m_type)
+    {
+        case SOCKET_TYPE_IP_V4:
+            m_address4.sin_family = AF_INET;
+            m_address4.sin_port = htons(key.port());
+            memcpy(&m_address4.sin_addr, key.address(), sizeof(m_address4.sin_addr));
+            break;
+        case SOCKET_TYPE_IP_V6:
+            m_address6.sin6_family = AF_INET6;
+            m_address6.sin6_port = htons(key.port());
+            memcpy(&m_address6.sin6_addr, key.address(), sizeof(m_address6.sin6_addr));
+            break;
+        default:
+            break;
+    }
+}
+
+PeerKey UnixSocketAddress::peer_key() const
+{
+    switch(m_type)
+    {
+        case SOCKET_TYPE_IP_V4:
+            return PeerKey(m_type, &m_address4.sin_addr, sizeof(m_address4.sin_addr), ntohs(m_address4.sin_port));
+        case SOCKET_TYPE_IP_V6:
+            return PeerKey(m_type, &m_address6.sin6_addr, sizeof(m_address6.sin6_addr), ntohs(m_address6.sin6_port));
+        default:
+            break;
+    }
+    return PeerKey();
+}
+
 const char * UnixSocketAddress::addr2str(const UnixSocketAddress *addr)
 {
     static char str[64];
@@ -68,6 +140,14 @@ const char * UnixSocketAddress::addr2str(const UnixSocketAddress *addr)
     return nullptr;
 }
 
+UnixSocket::UnixSocket()
+            : m_descriptor{-1},
+              m_address{nullptr},
+              m_timestamps{false},
+              m_sendOffload{false},
+              m_coalesced{}
+{}
+
 UnixSocket::UnixSocket(
                 int domain,
                 int type,
@@ -75,7 +155,10 @@ UnixSocket::UnixSocket(
                 error_code &ec
             )
             : m_descriptor{-1},
-              m_address{nullptr}
+              m_address{nullptr},
+              m_timestamps{false},
+              m_sendOffload{false},
+              m_coalesced{}
 {
     m_descriptor = ::socket(domain, type, protocol);
 
@@ -182,6 +265,50 @@ ssize_t UnixSocket::sendto(
     return sent;
 }
 
+ssize_t UnixSocket::sendmsg(
+            const IoBuffer * buffers,
+            size_t count,
+            const SocketAddress * addr,
+            error_code &ec
+        )
+{
+    if (buffers == nullptr || addr == nullptr)
+    {
+        ec = make_system_error(EFAULT);
+        return -1;
+    }
+    if (!count || count > IO_BUFFERS_MAX || !is_socket_type(addr->type()))
+    {
+        ec = make_system_error(EINVAL);
+        return -1;
+    }
+
+    struct iovec iov[IO_BUFFERS_MAX];
+    for (size_t i = 0; i < count; ++i)
+    {
+        iov[i].iov_base = const_cast<void *>(buffers[i].data);
+        iov[i].iov_len = buffers[i].length;
+    }
+
+    size_t sz;
+    const struct sockaddr * sap = extract_sockaddr(addr, sz);
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = const_cast<struct sockaddr *>(sap);
+    msg.msg_namelen = static_cast<socklen_t>(sz);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+
+    ssize_t sent = ::sendmsg (m_descriptor, &msg, MSG_CONFIRM);
+    if (sent < 0)
+    {
+        ec = make_system_error(errno);
+        return -1;
+    }
+    return sent;
+}
+
 ssize_t UnixSocket::recvfrom(
             error_code &ec,
             void * buf,
@@ -200,6 +327,11 @@ ssize_t UnixSocket::recvfrom(
         ec = make_system_error(EINVAL);
         return -1;
     }
+    if (m_coalesced) // a coalesced read must be split, and its segments may be waiting already
+    {
+        Datagram datagram = { buf, len, addr };
+        return receive_coalesced(&datagram, 1, ec) < 0 ? -1 : static_cast<ssize_t>(datagram.length);
+    }
 
     ssize_t received;
     struct sockaddr address;
@@ -244,6 +376,501 @@ ssize_t UnixSocket::recvfrom(
     return received;
 }
 
+static void store_sockaddr(
+            const struct sockaddr_storage &address,
+            socklen_t addrLen,
+            SocketAddress * addr,
+            error_code &ec
+        )
+{
+    if (addr == nullptr)
+        return;
+
+    UnixSocketAddress * _addr = static_cast<UnixSocketAddress *>(addr);
+
+    if (address.ss_family == AF_INET)
+    {
+        _addr->type(SOCKET_TYPE_IP_V4);
+        _addr->address4(&address, (size_t)addrLen, ec);
+    }
+    else if (address.ss_family == AF_INET6)
+    {
+        _addr->type(SOCKET_TYPE_IP_V6);
+        _addr->address6(&address, (size_t)addrLen, ec);
+    }
+}
+
+static bool check_datagrams(const Datagram * datagrams, size_t count, bool sending, error_code &ec)
+{
+    if (datagrams == nullptr)
+    {
+        ec = make_system_error(EFAULT);
+        return false;
+    }
+    if (!count || count > DATAGRAM_BATCH_MAX)
+    {
+        ec = make_system_error(EINVAL);
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (datagrams[i].data == nullptr || (sending && datagrams[i].address == nullptr))
+        {
+            ec = make_system_error(EFAULT);
+            return false;
+        }
+        if (!datagrams[i].length || (sending && !is_socket_type(datagrams[i].address->type())))
+        {
+            ec = make_system_error(EINVAL);
+            return false;
+        }
+    }
+    return true;
+}
+
+ssize_t UnixSocket::recvmmsg(
+            Datagram * datagrams,
+            size_t count,
+            error_code &ec
+        )
+{
+    if (!check_datagrams(datagrams, count, false, ec))
+        return -1;
+    if (m_coalesced)
+        return receive_coalesced(datagrams, count, ec);
+
+#ifdef __linux__
+    struct mmsghdr msgs[DATAGRAM_BATCH_MAX];
+    struct iovec iov[DATAGRAM_BATCH_MAX];
+    struct sockaddr_storage addresses[DATAGRAM_BATCH_MAX];
+
+    // room for one time stamp per datagram, aligned for the cmsghdr
+    union Control
+    {
+        struct cmsghdr  header;
+        char            data[CMSG_SPACE(sizeof(struct timespec))];
+    };
+    Control control[DATAGRAM_BATCH_MAX];
+
+    memset(msgs, 0, count * sizeof(msgs[0]));
+    for (size_t i = 0; i < count; ++i)
+    {
+        iov[i].iov_base = datagrams[i].data;
+        iov[i].iov_len = datagrams[i].length;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addresses[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+        if (m_timestamps)
+        {
+            msgs[i].msg_hdr.msg_control = control[i].data;
+            msgs[i].msg_hdr.msg_controllen = sizeof(control[i].data);
+        }
+    }
+
+    int received = ::recvmmsg (m_descriptor, msgs, count, MSG_WAITFORONE, nullptr);
+    if (received < 0)
+    {
+        ec = make_system_error(errno);
+        return -1;
+    }
+
+    for (int i = 0; i < received; ++i)
+    {
+        datagrams[i].length = msgs[i].msg_len;
+        datagrams[i].timestamp = m_timestamps ? control_timestamp(msgs[i].msg_hdr) : 0;
+        datagrams[i].truncated = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+        store_sockaddr(addresses[i], msgs[i].msg_hdr.msg_namelen, datagrams[i].address, ec);
+        if (ec.value())
+            return -1;
+    }
+    return received;
+#else
+    // one recvfrom() per datagram, only the first one waits
+    size_t received = 0;
+
+    while (received < count)
+    {
+        struct sockaddr_storage address;
+        socklen_t addrLen = sizeof(address);
+
+        ssize_t length = ::recvfrom (
+                            m_descriptor,
+                            datagrams[received].data,
+                            datagrams[received].length,
+                            received ? MSG_DONTWAIT : 0,
+                            reinterpret_cast<struct sockaddr *>(&address),
+                            &addrLen
+                        );
+        if (length < 0)
+        {
+            if (received)
+                break;
+            ec = make_system_error(errno);
+            return -1;
+        }
+
+        datagrams[received].length = static_cast<size_t>(length);
+        datagrams[received].timestamp = 0;
+        datagrams[received].truncated = false; // recvfrom(2) does not tell
+        store_sockaddr(address, addrLen, datagrams[received].address, ec);
+        if (ec.value())
+            return -1;
+        ++received;
+    }
+    return received;
+#endif
+}
+
+void UnixSocket::receive_timestamps(bool enable, error_code &ec)
+{
+#ifdef SO_TIMESTAMPNS
+    const int on = enable ? 1 : 0;
+    setsockoption(SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on), ec);
+    if (!ec.value())
+        m_timestamps = enable;
+#else
+    (void)enable;
+    ec = make_error_code(CoapStatus::COAP_ERR_NOT_IMPLEMENTED);
+#endif
+}
+
+uint64_t UnixSocket::timestamp_now()
+{
+    // the system clock is CLOCK_REALTIME, the one the kernel stamps the datagrams with
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+                chrono::system_clock::now().time_since_epoch()).count());
+}
+
+uint64_t UnixSocket::control_timestamp(const struct msghdr &msg)
+{
+#ifdef SCM_TIMESTAMPNS
+    struct msghdr &header = const_cast<struct msghdr &>(msg);
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&header); cmsg != nullptr; cmsg = CMSG_NXTHDR(&header, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS
+            && cmsg->cmsg_len >= CMSG_LEN(sizeof(struct timespec)))
+        {
+            struct timespec stamp;
+            memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+            return static_cast<uint64_t>(stamp.tv_sec) * 1000000000ULL + static_cast<uint64_t>(stamp.tv_nsec);
+        }
+    }
+#else
+    (void)msg;
+#endif
+    return 0;
+}
+
+ssize_t UnixSocket::sendmmsg(
+            const Datagram * datagrams,
+            size_t count,
+            error_code &ec
+        )
+{
+    if (!check_datagrams(datagrams, count, true, ec))
+        return -1;
+    if (m_sendOffload)
+        return send_segmented(datagrams, count, ec);
+    return send_separately(datagrams, count, ec);
+}
+
+ssize_t UnixSocket::send_separately(const Datagram * datagrams, size_t count, error_code &ec)
+{
+#ifdef __linux__
+    struct mmsghdr msgs[DATAGRAM_BATCH_MAX];
+    struct iovec iov[DATAGRAM_BATCH_MAX];
+
+    memset(msgs, 0, count * sizeof(msgs[0]));
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t sz = 0;
+        const struct sockaddr * sap = extract_sockaddr(datagrams[i].address, sz);
+
+        iov[i].iov_base = datagrams[i].data;
+        iov[i].iov_len = datagrams[i].length;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = const_cast<struct sockaddr *>(sap);
+        msgs[i].msg_hdr.msg_namelen = static_cast<socklen_t>(sz);
+    }
+
+    int sent = ::sendmmsg (m_descriptor, msgs, count, MSG_CONFIRM);
+    if (sent < 0)
+    {
+        ec = make_system_error(errno);
+        return -1;
+    }
+    return sent;
+#else
+    size_t sent = 0;
+
+    while (sent < count)
+    {
+        size_t sz = 0;
+        const struct sockaddr * sap = extract_sockaddr(datagrams[sent].address, sz);
+
+        if (::sendto (m_descriptor, datagrams[sent].data, datagrams[sent].length, MSG_CONFIRM, sap, sz) < 0)
+        {
+            if (sent)
+                break;
+            ec = make_system_error(errno);
+            return -1;
+        }
+        ++sent;
+    }
+    return sent;
+#endif
+}
+
+void UnixSocket::send_offload(bool enable, error_code &ec)
+{
+#ifdef HAVE_UDP_OFFLOAD
+    if (enable)
+    {
+        // a zero size keeps the datagrams without the control message as they are,
+        // the call only tells whether the kernel knows the option
+        const int size = 0;
+        setsockoption(SOL_UDP, UDP_SEGMENT, &size, sizeof(size), ec);
+        if (ec.value())
+            return;
+    }
+    m_sendOffload = enable;
+#else
+    (void)enable;
+    ec = make_error_code(CoapStatus::COAP_ERR_NOT_IMPLEMENTED);
+#endif
+}
+
+void UnixSocket::receive_offload(bool enable, error_code &ec)
+{
+#ifdef HAVE_UDP_OFFLOAD
+    if (!enable && receive_pending())
+    {
+        ec = make_system_error(EBUSY);
+        return;
+    }
+
+    const int on = enable ? 1 : 0;
+    setsockoption(SOL_UDP, UDP_GRO, &on, sizeof(on), ec);
+    if (ec.value())
+        return;
+
+    if (!enable)
+        m_coalesced.reset();
+    else if (!m_coalesced)
+        m_coalesced.reset(new Coalesced);
+#else
+    (void)enable;
+    ec = make_error_code(CoapStatus::COAP_ERR_NOT_IMPLEMENTED);
+#endif
+}
+
+bool UnixSocket::receive_pending() const
+{
+    return m_coalesced && m_coalesced->offset < m_coalesced->length;
+}
+
+#ifdef HAVE_UDP_OFFLOAD
+static bool same_destination(const SocketAddress * first, const SocketAddress * second)
+{
+    if (first == second)
+        return true;
+    if (first->type() != second->type())
+        return false;
+    return static_cast<const UnixSocketAddress *>(first)->peer_key() == static_cast<const UnixSocketAddress *>(second)->peer_key();
+}
+
+// the segment size of a coalesced read, zero for a single datagram
+static size_t gro_segment(const struct msghdr &msg)
+{
+    struct msghdr &header = const_cast<struct msghdr &>(msg);
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&header); cmsg != nullptr; cmsg = CMSG_NXTHDR(&header, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO && cmsg->cmsg_len >= CMSG_LEN(sizeof(int)))
+        {
+            int size;
+            memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+            return size > 0 ? static_cast<size_t>(size) : 0;
+        }
+    }
+    return 0;
+}
+#endif
+
+ssize_t UnixSocket::send_segmented(const Datagram * datagrams, size_t count, error_code &ec)
+{
+#ifdef HAVE_UDP_OFFLOAD
+    union Control
+    {
+        struct cmsghdr  header;
+        char            data[CMSG_SPACE(sizeof(uint16_t))];
+    };
+    struct mmsghdr msgs[DATAGRAM_BATCH_MAX];
+    struct iovec iov[DATAGRAM_BATCH_MAX];
+    Control control[DATAGRAM_BATCH_MAX];
+    size_t runs[DATAGRAM_BATCH_MAX];    // quantity of the datagrams of every message
+    size_t messages = 0;
+
+    memset(msgs, 0, count * sizeof(msgs[0]));
+    for (size_t first = 0; first < count; ++messages)
+    {
+        const size_t segment = datagrams[first].length;
+        size_t next = first;
+        size_t total = 0;
+
+        // the run ends at another destination, at a longer datagram or after a shorter one
+        do
+        {
+            iov[next].iov_base = datagrams[next].data;
+            iov[next].iov_len = datagrams[next].length;
+            total += datagrams[next].length;
+            ++next;
+        }
+        while (next < count && next - first < SEGMENTS_MAX
+                && datagrams[next - 1].length == segment && datagrams[next].length <= segment
+                && total + datagrams[next].length <= SEGMENTED_BYTES_MAX
+                && same_destination(datagrams[first].address, datagrams[next].address));
+
+        size_t sz = 0;
+        const struct sockaddr * sap = extract_sockaddr(datagrams[first].address, sz);
+        struct msghdr &msg = msgs[messages].msg_hdr;
+
+        msg.msg_iov = &iov[first];
+        msg.msg_iovlen = next - first;
+        msg.msg_name = const_cast<struct sockaddr *>(sap);
+        msg.msg_namelen = static_cast<socklen_t>(sz);
+        if (next - first > 1)
+        {
+            memset(&control[messages], 0, sizeof(control[messages]));
+            msg.msg_control = control[messages].data;
+            msg.msg_controllen = sizeof(control[messages].data);
+
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+            const uint16_t size = static_cast<uint16_t>(segment);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(size));
+            memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+        }
+        runs[messages] = next - first;
+        first = next;
+    }
+
+    int sent = ::sendmmsg (m_descriptor, msgs, messages, MSG_CONFIRM);
+    if (sent < 0)
+    {
+        if (errno == EIO) // the device can not checksum the segments
+        {
+            debug("UDP segmentation offload is not supported by the device, it is turned off");
+            m_sendOffload = false;
+            return send_separately(datagrams, count, ec);
+        }
+        if (errno == EINVAL) // the segment is larger than the path MTU, this batch goes without the offload
+        {
+            debug("the segments can not be sent to the destination, the datagrams are sent one by one");
+            return send_separately(datagrams, count, ec);
+        }
+        ec = make_system_error(errno);
+        return -1;
+    }
+
+    size_t datagramsSent = 0;
+    for (int i = 0; i < sent; ++i)
+        datagramsSent += runs[i];
+    return static_cast<ssize_t>(datagramsSent);
+#else
+    (void)datagrams;
+    (void)count;
+    ec = make_error_code(CoapStatus::COAP_ERR_NOT_IMPLEMENTED);
+    return -1;
+#endif
+}
+
+ssize_t UnixSocket::receive_coalesced(Datagram * datagrams, size_t count, error_code &ec)
+{
+#ifdef HAVE_UDP_OFFLOAD
+    union Control
+    {
+        struct cmsghdr  header;
+        char            data[CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(int))];
+    };
+    Coalesced &read = *m_coalesced;
+    size_t received = 0;
+
+    while (received < count)
+    {
+        if (read.offset < read.length)
+        {
+            Datagram &datagram = datagrams[received];
+            const size_t length = min(read.segment, read.length - read.offset);
+
+            datagram.truncated = length > datagram.length;
+            datagram.length = min(datagram.length, length);
+            memcpy(datagram.data, &read.data[read.offset], datagram.length);
+            datagram.timestamp = read.timestamp;
+            store_sockaddr(read.address, read.addressLength, datagram.address, ec);
+            if (ec.value())
+                return -1;
+            read.offset += length;
+            ++received;
+            continue;
+        }
+
+        struct iovec iov;
+        struct msghdr msg;
+        Control control;
+
+        iov.iov_base = read.data.data();
+        iov.iov_len = read.data.size();
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_name = &read.address;
+        msg.msg_namelen = sizeof(read.address);
+        msg.msg_control = control.data;
+        msg.msg_controllen = sizeof(control.data);
+
+        // only the first read waits, as with recvmmsg(2)
+        ssize_t length = ::recvmsg (m_descriptor, &msg, received ? MSG_DONTWAIT : 0);
+        if (length < 0)
+        {
+            if (received)
+                break;
+            ec = make_system_error(errno);
+            return -1;
+        }
+
+        read.offset = 0;
+        read.length = static_cast<size_t>(length);
+        read.segment = gro_segment(msg);
+        if (!read.segment)
+            read.segment = read.length;
+        read.addressLength = msg.msg_namelen;
+        read.timestamp = m_timestamps ? control_timestamp(msg) : 0;
+
+        if (!read.length) // an empty datagram has no segment to hand over
+        {
+            datagrams[received].length = 0;
+            datagrams[received].timestamp = read.timestamp;
+            datagrams[received].truncated = false;
+            store_sockaddr(read.address, read.addressLength, datagrams[received].address, ec);
+            if (ec.value())
+                return -1;
+            ++received;
+        }
+    }
+    return static_cast<ssize_t>(received);
+#else
+    (void)datagrams;
+    (void)count;
+    ec = make_error_code(CoapStatus::COAP_ERR_NOT_IMPLEMENTED);
+    return -1;
+#endif
+}
+
 void UnixSocket::bind(const SocketAddress * addr, error_code &ec)
 {
     if (addr == nullptr)
@@ -348,7 +975,7 @@ void UnixSocket::set_blocking(bool blocking, error_code &ec)
         status |= O_NONBLOCK;
     }
 
-    if (fcntl(m_descriptor, F_GETFL, status) < 0)
+    if (fcntl(m_descriptor, F_SETFL, status) < 0)
     {
         ec = make_system_error(errno);
     }
@@ -1,8 +1,11 @@
 #ifndef _UNIX_SOCKET_H
 #define _UNIX_SOCKET_H
 #include "socket.h"
+#include "peer_key.h"
 #include "error.h"
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <cstdint>
 #include <memory>
 #include <typeinfo>
 #include <iostream>
@@ -41,6 +44,11 @@ public:
           m_address6{addr}
     {}
 
+    // the address of the peer the key has been made of, see peer_key()
+    explicit UnixSocketAddress(
+            const PeerKey & key
+        );
+
     ~UnixSocketAddress() override = default;
 
 public:
@@ -59,6 +67,9 @@ public:
     void address4(const void *value, size_t len, std::error_code &ec);
     void address6(const void *value, size_t len, std::error_code &ec);
 
+    // family, address and port of the peer, the key of the per-peer tables
+    PeerKey peer_key() const;
+
 public:
     static const char * addr2str(const UnixSocketAddress *addr);
 
@@ -70,9 +81,7 @@ private:
 class UnixSocket : public Socket
 {
 public:
-    UnixSocket()
-    : m_descriptor{-1}, m_address{nullptr}
-    {}
+    UnixSocket();
 
     UnixSocket(int domain, int type, int protocol, std::error_code &ec);
 
@@ -83,6 +92,7 @@ public:
     void connect(const SocketAddress * addr, std::error_code &ec) override;
     ssize_t sendto(const void * buf, std::size_t len, const SocketAddress * addr, std::error_code &ec) override;
     ssize_t recvfrom(std::error_code &ec, void * buf, std::size_t len, SocketAddress * addr = nullptr) override;
+    ssize_t sendmsg(const IoBuffer * buffers, std::size_t count, const SocketAddress * addr, std::error_code &ec) override;
     void bind(const SocketAddress * addr, std::error_code &ec) override;
     Socket * accept(std::error_code * ec = nullptr) override;
     void listen(std::error_code &ec, int max_connections_in_queue = 1) override;
@@ -91,6 +101,50 @@ public:
     void setsockoption(int level, int option_name, const void *option_value, std::size_t option_len, std::error_code &ec) override;
     void getsockoption(int level, int option_name, void *option_value, std::size_t *option_len, std::error_code &ec) override;
 
+public:
+    // Receives up to count datagrams with one recvmmsg(2) call.
+    // Waits for the first datagram only, then takes the ones already queued.
+    // Returns the quantity of the received datagrams, the ones cut to the buffer have Datagram::truncated set
+    virtual ssize_t recvmmsg(Datagram * datagrams, std::size_t count, std::error_code &ec);
+    // Sends the datagrams with one sendmmsg(2) call, returns the quantity of the sent ones
+    virtual ssize_t sendmmsg(const Datagram * datagrams, std::size_t count, std::error_code &ec);
+
+    // Makes the kernel stamp every received datagram with its arrival time (SO_TIMESTAMPNS),
+    // recvmmsg() hands the stamps over in Datagram::timestamp
+    void receive_timestamps(bool enable, std::error_code &ec);
+
+    bool receive_timestamps() const
+    { return m_timestamps; }
+
+    // the current time on the clock of the receive time stamps, in nanoseconds since the epoch
+    static std::uint64_t timestamp_now();
+
+    // Segmentation offload (UDP_SEGMENT): sendmmsg() coalesces every run of datagrams to one
+    // destination, all of the size of the first one but the last which may be shorter, into one
+    // message the kernel or the NIC splits again. A block-wise transfer or a burst of notifications
+    // to one peer costs one trip through the stack then. Falls back to one message per datagram
+    // by itself if the device can not segment, and for a batch whose segments exceed the path MTU
+    virtual void send_offload(bool enable, std::error_code &ec);
+
+    bool send_offload() const
+    { return m_sendOffload; }
+
+    // Receive offload (UDP_GRO): the kernel may hand over several datagrams of one peer in one read,
+    // recvmmsg() and recvfrom() split it into the datagrams again. The segments which do not fit
+    // into the batch are kept for the next call, see receive_pending()
+    virtual void receive_offload(bool enable, std::error_code &ec);
+
+    bool receive_offload() const
+    { return m_coalesced != nullptr; }
+
+    // true if segments of a coalesced read are left, the next receive returns them without waiting.
+    // The descriptor does not get readable for them, a reactor handler receives until this is false
+    bool receive_pending() const;
+
+    // the descriptor which gets readable when a datagram can be received, the one a reactor watches
+    virtual int event_descriptor() const
+    { return m_descriptor; }
+
 public:
     void descriptor(int value)
     { m_descriptor = value; }
@@ -101,9 +155,24 @@ public:
     std::shared_ptr<UnixSocketAddress> & address()
     { return m_address; }
 
+protected:
+    // the receive time stamp among the control messages, zero if there is none
+    static std::uint64_t control_timestamp(const struct msghdr &msg);
+
+private:
+    // a coalesced read and the part of it handed over so far
+    struct Coalesced;
+
+    ssize_t send_segmented(const Datagram * datagrams, std::size_t count, std::error_code &ec);
+    ssize_t send_separately(const Datagram * datagrams, std::size_t count, std::error_code &ec);
+    ssize_t receive_coalesced(Datagram * datagrams, std::size_t count, std::error_code &ec);
+
 private:
     int m_descriptor;
     std::shared_ptr<UnixSocketAddress> m_address;
+    bool m_timestamps;
+    bool m_sendOffload;
+    std::unique_ptr<Coalesced> m_coalesced;     // allocated by receive_offload()
 };
 
 #endif
\ No newline at end of file
@@ -68,6 +68,26 @@ void UdpClientConnection::send(const void * buffer, size_t length, const SocketA
     }
 }
 
+void UdpClientConnection::sendmsg(const IoBuffer * buffers, size_t count, const SocketAddress *destAddr, std::error_code &ec)
+{
+    if (m_socket == nullptr)
+    {
+        ec = make_error_code(CoapStatus::COAP_ERR_NOT_CONNECTED);
+        return;
+    }
+    ssize_t sent = m_socket->sendmsg(buffers, count, destAddr, ec);
+    if (!ec.value())
+    {
+        size_t length = 0;
+        for (size_t i = 0; i < count; ++i)
+            length += buffers[i].length;
+        if (static_cast<size_t>(sent) != length)
+        {
+            ec = make_error_code(CoapStatus::COAP_ERR_INCOMPLETE_SEND);
+        }
+    }
+}
+
 void UdpClientConnection::receive(void * buffer, size_t &length, SocketAddress *srcAddr, std::error_code &ec, size_t seconds)
 {
     if (m_socket == nullptr)
@@ -60,6 +60,7 @@ public:
     void connect(std::error_code &ec) override;
     void close(std::error_code &ec) override;
     void send(const void * buffer, size_t length, const SocketAddress *destAddr, std::error_code &ec) override;
+    void sendmsg(const IoBuffer * buffers, size_t count, const SocketAddress *destAddr, std::error_code &ec) override;
     void receive(void * buffer, size_t &length, SocketAddress * srcAddr, std::error_code &ec, size_t seconds = 0) override;
     void send(const void * buffer, size_t length, std::error_code &ec) override;
     void receive(void * buffer, size_t &length, std::error_code &ec, size_t seconds = 0) override;
@@ -1,16 +1,18 @@
 #include "unix_udp_server.h"
 #include <spdlog/spdlog.h>
 #include <spdlog/fmt/fmt.h>
+#include <algorithm>
 
 using namespace spdlog;
 
 namespace Unix
 {
 
-UdpServerConnection::UdpServerConnection(int port, bool version4, std::shared_ptr<Buffer> bufferPtr, std::error_code &ec)
+UdpServerConnection::UdpServerConnection(int port, bool version4, std::shared_ptr<Buffer> bufferPtr, std::error_code &ec,
+                                         SocketBackend backend)
     : ServerConnection(UDP, port, version4, std::move(bufferPtr), ec),
       m_bound{false},
-      m_socket{new UnixSocket(version4 ? AF_INET : AF_INET6, SOCK_DGRAM, 0, ec)},
+      m_socket{open_datagram_socket(version4 ? AF_INET : AF_INET6, backend, ec).release()},
       m_address{new UnixSocketAddress()},
       m_mutex{}
 {
@@ -79,6 +81,27 @@ void UdpServerConnection::send(const void * buffer, size_t length, const SocketA
     }
 }
 
+void UdpServerConnection::sendmsg(const IoBuffer * buffers, size_t count, const SocketAddress *destAddr, std::error_code &ec)
+{
+    std::lock_guard<std::mutex> lg(m_mutex);
+    if (!m_bound)
+    {
+        ec = make_error_code(CoapStatus::COAP_ERR_SOCKET_NOT_BOUND);
+        return;
+    }
+    ssize_t sent = m_socket->sendmsg(buffers, count, destAddr, ec);
+    if (!ec.value())
+    {
+        size_t length = 0;
+        for (size_t i = 0; i < count; ++i)
+            length += buffers[i].length;
+        if (static_cast<size_t>(sent) != length)
+        {
+            ec = make_error_code(CoapStatus::COAP_ERR_INCOMPLETE_SEND);
+        }
+    }
+}
+
 void UdpServerConnection::receive(void * buffer, size_t &length, SocketAddress * srcAddr, std::error_code &ec, size_t seconds)
 {
     std::lock_guard<std::mutex> lg(m_mutex);
@@ -100,6 +123,56 @@ void UdpServerConnection::receive(void * buffer, size_t &length, SocketAddress *
     }
 }
 
+void UdpServerConnection::receive_batch(Datagram * datagrams, size_t &count, std::error_code &ec, size_t seconds)
+{
+    std::lock_guard<std::mutex> lg(m_mutex);
+    if (!m_bound)
+    {
+        ec = make_error_code(CoapStatus::COAP_ERR_SOCKET_NOT_BOUND);
+        return;
+    }
+    if (seconds)
+    {
+        m_socket->set_timeout(seconds, ec);
+        if(ec.value())
+            return;
+    }
+    ssize_t received = static_cast<UnixSocket *>(m_socket)->recvmmsg(datagrams, count, ec);
+    count = ec.value() ? 0 : static_cast<size_t>(received);
+}
+
+void UdpServerConnection::drop_batch(size_t &count, std::error_code &ec)
+{
+    uint8_t scratch[BUFFER_SIZE];
+    Datagram datagrams[DATAGRAM_BATCH_MAX];
+
+    count = std::min(count, DATAGRAM_BATCH_MAX);
+    for (size_t i = 0; i < count; ++i)
+        datagrams[i] = Datagram{ scratch, sizeof(scratch), nullptr };
+
+    receive_batch(datagrams, count, ec);
+}
+
+void UdpServerConnection::send_batch(const Datagram * datagrams, size_t &count, std::error_code &ec)
+{
+    std::lock_guard<std::mutex> lg(m_mutex);
+    if (!m_bound)
+    {
+        ec = make_error_code(CoapStatus::COAP_ERR_SOCKET_NOT_BOUND);
+        return;
+    }
+    size_t sent = 0;
+    while (sent < count)
+    {
+        const size_t batch = std::min(count - sent, DATAGRAM_BATCH_MAX);
+        ssize_t result = static_cast<UnixSocket *>(m_socket)->sendmmsg(datagrams + sent, batch, ec);
+        if (ec.value())
+            break;
+        sent += static_cast<size_t>(result);
+    }
+    count = sent;
+}
+
 void UdpServerConnection::send(const void * buffer, size_t length, std::error_code &ec)
 {
     if (!m_bound)
@@ -137,6 +210,41 @@ void UdpServerConnection::receive(void * buffer, size_t &length, std::error_code
     }
 }
 
+void UdpServerConnection::reuse_port(std::error_code &ec)
+{
+    std::lock_guard<std::mutex> lg(m_mutex);
+#ifdef SO_REUSEPORT
+    const int on = 1;
+    m_socket->setsockoption(SOL_SOCKET, SO_REUSEPORT, &on, sizeof(int), ec);
+#else
+    ec = make_error_code(CoapStatus::COAP_ERR_NOT_IMPLEMENTED);
+#endif
+}
+
+void UdpServerConnection::receive_timestamps(std::error_code &ec)
+{
+    std::lock_guard<std::mutex> lg(m_mutex);
+    static_cast<UnixSocket *>(m_socket)->receive_timestamps(true, ec);
+}
+
+void UdpServerConnection::send_offload(std::error_code &ec)
+{
+    std::lock_guard<std::mutex> lg(m_mutex);
+    static_cast<UnixSocket *>(m_socket)->send_offload(true, ec);
+}
+
+void UdpServerConnection::receive_offload(std::error_code &ec)
+{
+    std::lock_guard<std::mutex> lg(m_mutex);
+    static_cast<UnixSocket *>(m_socket)->receive_offload(true, ec);
+}
+
+bool UdpServerConnection::receive_pending()
+{
+    std::lock_guard<std::mutex> lg(m_mutex);
+    return static_cast<UnixSocket *>(m_socket)->receive_pending();
+}
+
 void UdpServerConnection::bind(std::error_code &ec)
 {
     std::lock_guard<std::mutex> lg(m_mutex);
@@ -2,6 +2,7 @@
 #define _UNIX_UDP_SERVER_H
 #include "connection.h"
 #include "unix_socket.h"
+#include "unix_uring_socket.h"
 #include "utils.h"
 #include "error.h"
 #include <mutex>
@@ -12,9 +13,12 @@ namespace Unix
 class UdpServerConnection : public ServerConnection
 {
 public:
-    UdpServerConnection(int port, bool version4, std::shared_ptr<Buffer> bufferPtr, std::error_code &ec);
-    UdpServerConnection(int port, bool version4, std::error_code &ec)
-     : UdpServerConnection(port, version4, std::move(std::make_shared<Buffer>(BUFFER_SIZE)), ec)
+    // The backend picks the socket implementation, see open_datagram_socket().
+    // With an io_uring socket a reactor watches socket()->event_descriptor()
+    UdpServerConnection(int port, bool version4, std::shared_ptr<Buffer> bufferPtr, std::error_code &ec,
+                        SocketBackend backend = SocketBackend::POLL);
+    UdpServerConnection(int port, bool version4, std::error_code &ec, SocketBackend backend = SocketBackend::POLL)
+     : UdpServerConnection(port, version4, std::move(std::make_shared<Buffer>(BUFFER_SIZE)), ec, backend)
     {}
     ~UdpServerConnection()
     {
@@ -25,11 +29,33 @@ public:
 public:
     void close(std::error_code &ec) override;
     void send(const void * buffer, size_t length, const SocketAddress *destAddr, std::error_code &ec) override;
+    void sendmsg(const IoBuffer * buffers, size_t count, const SocketAddress *destAddr, std::error_code &ec) override;
     void receive(void * buffer, size_t &length, SocketAddress * srcAddr, std::error_code &ec, size_t seconds = 0) override;
     void bind(std::error_code &ec) override;
     void send(const void * buffer, size_t length, std::error_code &ec) override;
+    // Lets several sockets bind the same port (SO_REUSEPORT), must be called before bind().
+    // The kernel spreads the peers over the sockets by hashing their addresses
+    void reuse_port(std::error_code &ec);
+    // Makes the socket stamp the received datagrams with their kernel arrival time,
+    // receive_batch() fills Datagram::timestamp then, see UnixSocket::receive_timestamps()
+    void receive_timestamps(std::error_code &ec);
+    // Turns on the UDP segmentation offload of send_batch() and the receive offload of the receive
+    // calls, see UnixSocket::send_offload() and UnixSocket::receive_offload()
+    void send_offload(std::error_code &ec);
+    void receive_offload(std::error_code &ec);
+    // true if a coalesced read has segments left, receive_batch() takes them without waiting
+    bool receive_pending();
     void receive(void * buffer, size_t &length, std::error_code &ec, size_t seconds = 0) override;
 
+    // Receives up to count datagrams per call, count is set to the quantity of the received ones
+    void receive_batch(Datagram * datagrams, size_t &count, std::error_code &ec, size_t seconds = 0);
+    // Receives up to count datagrams into a scratch buffer and discards them, count is set to the quantity
+    // of the dropped ones. With no buffer to receive into, the queue is drained this way, so the level-triggered
+    // readiness of the socket does not fire again and again
+    void drop_batch(size_t &count, std::error_code &ec);
+    // Sends all the datagrams, count is set to the quantity of the sent ones
+    void send_batch(const Datagram * datagrams, size_t &count, std::error_code &ec);
+
     void listen(std::error_code &ec, int max_connections_in_queue = 1) override
     { 
         (void)max_connections_in_queue;
@@ -0,0 +1,697 @@
+#include "unix_uring_socket.h"
+#include "buffer.h"
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/fmt.h>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#endif
+
+using namespace std;
+using namespace spdlog;
+
+#ifdef __linux__
+
+const size_t UringSocket::BUFFER_COUNT;
+
+// the submission queue takes a whole send batch
+static const unsigned SQ_ENTRIES = DATAGRAM_BATCH_MAX;
+// room for the completions of all the provided buffers and of a send batch, twice
+static const unsigned CQ_ENTRIES = 2 * (UringSocket::BUFFER_COUNT + DATAGRAM_BATCH_MAX);
+static const uint16_t BUFFER_GROUP = 0;
+// room for the receive time stamp, the only control message the socket asks for
+static const size_t CONTROL_SIZE = CMSG_SPACE(sizeof(struct timespec));
+// every provided buffer starts with the header, the source address and the control messages the kernel writes
+static const size_t SLOT_SIZE = sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_storage) + CONTROL_SIZE + BUFFER_SIZE;
+
+// the sends of a batch are tagged with their index, the other requests with these
+static const uint64_t RECEIVE_TAG = ~0ULL;
+static const uint64_t NOP_TAG = RECEIVE_TAG - 1;
+static const uint64_t CANCEL_TAG = RECEIVE_TAG - 2;
+
+// there is no wrapper of the io_uring system calls in the C library
+static int uring_setup(unsigned entries, struct io_uring_params *params)
+{ return static_cast<int>(syscall(__NR_io_uring_setup, entries, params)); }
+
+static int uring_enter(int ring, unsigned toSubmit, unsigned minComplete, unsigned flags, const void *arg = nullptr, size_t size = 0)
+{ return static_cast<int>(syscall(__NR_io_uring_enter, ring, toSubmit, minComplete, flags, arg, size)); }
+
+static int uring_register(int ring, unsigned opcode, const void *arg, unsigned count)
+{ return static_cast<int>(syscall(__NR_io_uring_register, ring, opcode, arg, count)); }
+
+static bool probe()
+{
+    // multishot recvmsg has come with 6.0, the provided buffer rings with 5.19
+    struct utsname name;
+    unsigned major = 0;
+    unsigned minor = 0;
+    if (uname(&name) < 0 || sscanf(name.release, "%u.%u", &major, &minor) != 2 || major < 6)
+        return false;
+
+    // io_uring may still be disabled by kernel.io_uring_disabled or a seccomp filter
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const int ring = uring_setup(2, &params);
+    if (ring < 0)
+        return false;
+    ::close(ring);
+    return (params.features & IORING_FEAT_EXT_ARG) != 0;
+}
+
+bool UringSocket::supported()
+{
+    static const bool value = probe();
+    return value;
+}
+
+static const struct sockaddr * sockaddr_of(const SocketAddress *addr, socklen_t &size)
+{
+    const UnixSocketAddress *_addr = static_cast<const UnixSocketAddress *>(addr);
+    if (addr->type() == SOCKET_TYPE_IP_V4)
+    {
+        size = sizeof(_addr->address4());
+        return reinterpret_cast<const struct sockaddr *>(&_addr->address4());
+    }
+    size = sizeof(_addr->address6());
+    return reinterpret_cast<const struct sockaddr *>(&_addr->address6());
+}
+
+UringSocket::UringSocket(int domain, int type, int protocol, error_code &ec)
+    : UnixSocket(domain, type, protocol, ec),
+      m_ring{-1},
+      m_armed{false},
+      m_blocking{true},
+      m_timeout{0},
+      m_sqRing{nullptr},
+      m_sqRingSize{0},
+      m_cqRing{nullptr},
+      m_cqRingSize{0},
+      m_sqes{nullptr},
+      m_sqesSize{0},
+      m_sqHead{nullptr},
+      m_sqTail{nullptr},
+      m_sqMask{0},
+      m_cqHead{nullptr},
+      m_cqTail{nullptr},
+      m_cqMask{0},
+      m_cqes{nullptr},
+      m_bufRing{nullptr},
+      m_buffers{nullptr},
+      m_bufTail{0},
+      m_completions{},
+      m_next{0},
+      m_receiveMsg{},
+      m_sendMsgs{},
+      m_sendIov{},
+      m_sendResults{},
+      m_sendsPending{0}
+{
+    if (ec.value())
+        return;
+    if (!supported())
+    {
+        ec = make_system_error(ENOSYS);
+        return;
+    }
+    setup(ec);
+}
+
+UringSocket::~UringSocket()
+{
+    error_code ec;
+    close(ec);
+}
+
+void UringSocket::setup(error_code &ec)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = CQ_ENTRIES;
+
+    m_ring = uring_setup(SQ_ENTRIES, &params);
+    if (m_ring < 0)
+    {
+        ec = make_system_error(errno);
+        return;
+    }
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single)
+        m_sqRingSize = m_cqRingSize = max(m_sqRingSize, m_cqRingSize);
+
+    void *sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED)
+    {
+        ec = make_system_error(errno);
+        return;
+    }
+    m_sqRing = sqRing;
+
+    void *cqRing = single ? m_sqRing
+                 : mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_CQ_RING);
+    if (cqRing == MAP_FAILED)
+    {
+        ec = make_system_error(errno);
+        return;
+    }
+    m_cqRing = cqRing;
+
+    m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        ec = make_system_error(errno);
+        return;
+    }
+    m_sqes = static_cast<struct io_uring_sqe *>(sqes);
+
+    uint8_t *sq = static_cast<uint8_t *>(m_sqRing);
+    uint8_t *cq = static_cast<uint8_t *>(m_cqRing);
+    m_sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    m_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    m_sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    m_cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    // the entries are always submitted in place, the array maps every slot to itself
+    unsigned *array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < params.sq_entries; ++i)
+        array[i] = i;
+
+    void *bufRing = mmap(nullptr, BUFFER_COUNT * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bufRing == MAP_FAILED)
+    {
+        ec = make_system_error(errno);
+        return;
+    }
+    m_bufRing = static_cast<struct io_uring_buf_ring *>(bufRing);
+
+    void *buffers = mmap(nullptr, BUFFER_COUNT * SLOT_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers == MAP_FAILED)
+    {
+        ec = make_system_error(errno);
+        return;
+    }
+    m_buffers = static_cast<uint8_t *>(buffers);
+
+    struct io_uring_buf_reg registration;
+    memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = reinterpret_cast<uint64_t>(m_bufRing);
+    registration.ring_entries = BUFFER_COUNT;
+    registration.bgid = BUFFER_GROUP;
+    if (uring_register(m_ring, IORING_REGISTER_PBUF_RING, &registration, 1) < 0)
+    {
+        ec = make_system_error(errno);
+        return;
+    }
+    for (size_t i = 0; i < BUFFER_COUNT; ++i)
+        recycle(static_cast<uint16_t>(i));
+
+    // the kernel lays out every buffer as the header, the address, the control messages and the payload
+    memset(&m_receiveMsg, 0, sizeof(m_receiveMsg));
+    m_receiveMsg.msg_namelen = sizeof(struct sockaddr_storage);
+    m_receiveMsg.msg_controllen = CONTROL_SIZE;
+    m_completions.reserve(CQ_ENTRIES);
+}
+
+void UringSocket::teardown()
+{
+    if (m_armed && m_sqes != nullptr)
+    {
+        // the kernel writes to the buffers until the request has ended
+        error_code ec;
+        struct io_uring_sqe *sqe = prepare(IORING_OP_ASYNC_CANCEL, CANCEL_TAG);
+        sqe->addr = RECEIVE_TAG;
+        if (submit(1, ec))
+        {
+            while (m_armed)
+            {
+                reap();
+                if (m_armed && uring_enter(m_ring, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+                    break;
+            }
+        }
+        m_armed = false;
+    }
+
+    if (m_buffers != nullptr)
+        munmap(m_buffers, BUFFER_COUNT * SLOT_SIZE);
+    if (m_bufRing != nullptr)
+        munmap(m_bufRing, BUFFER_COUNT * sizeof(struct io_uring_buf));
+    if (m_sqes != nullptr)
+        munmap(m_sqes, m_sqesSize);
+    if (m_cqRing != nullptr && m_cqRing != m_sqRing)
+        munmap(m_cqRing, m_cqRingSize);
+    if (m_sqRing != nullptr)
+        munmap(m_sqRing, m_sqRingSize);
+    if (m_ring >= 0)
+        ::close(m_ring);
+
+    m_buffers = nullptr;
+    m_bufRing = nullptr;
+    m_sqes = nullptr;
+    m_cqRing = nullptr;
+    m_sqRing = nullptr;
+    m_ring = -1;
+    m_completions.clear();
+    m_next = 0;
+}
+
+void UringSocket::close(error_code &ec)
+{
+    teardown();
+    UnixSocket::close(ec);
+}
+
+struct io_uring_sqe * UringSocket::prepare(uint8_t opcode, uint64_t tag)
+{
+    // the entries are submitted at once, so the queue is never full here
+    struct io_uring_sqe *sqe = &m_sqes[*m_sqTail & m_sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->user_data = tag;
+    __atomic_store_n(m_sqTail, *m_sqTail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+unsigned UringSocket::submit(unsigned count, error_code &ec)
+{
+    int submitted = uring_enter(m_ring, count, 0, 0);
+    if (submitted < 0)
+    {
+        ec = make_system_error(errno);
+        submitted = 0;
+    }
+    // the kernel has not taken the rest, they are dropped
+    if (static_cast<unsigned>(submitted) < count)
+        __atomic_store_n(m_sqTail, __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    return static_cast<unsigned>(submitted);
+}
+
+void UringSocket::arm(error_code &ec)
+{
+    struct io_uring_sqe *sqe = prepare(IORING_OP_RECVMSG, RECEIVE_TAG);
+    sqe->fd = descriptor();
+    sqe->addr = reinterpret_cast<uint64_t>(&m_receiveMsg);
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    if (submit(1, ec))
+        m_armed = true;
+}
+
+void UringSocket::bind(const SocketAddress * addr, error_code &ec)
+{
+    UnixSocket::bind(addr, ec);
+    if (!ec.value() && m_ring >= 0 && !m_armed)
+        arm(ec);
+}
+
+void UringSocket::set_blocking(bool blocking, error_code &ec)
+{
+    UnixSocket::set_blocking(blocking, ec);
+    if (!ec.value())
+        m_blocking = blocking;
+}
+
+void UringSocket::set_timeout(size_t seconds, error_code &ec)
+{
+    UnixSocket::set_timeout(seconds, ec);
+    if (!ec.value())
+        m_timeout = seconds;
+}
+
+void UringSocket::send_offload(bool enable, error_code &ec)
+{
+    // the chain of sends keeps one request per datagram
+    if (enable)
+        ec = make_error_code(CoapStatus::COAP_ERR_NOT_IMPLEMENTED);
+}
+
+void UringSocket::receive_offload(bool enable, error_code &ec)
+{
+    // a coalesced read would not fit into a provided buffer
+    if (enable)
+        ec = make_error_code(CoapStatus::COAP_ERR_NOT_IMPLEMENTED);
+}
+
+void UringSocket::reap()
+{
+    unsigned head = *m_cqHead;
+    const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; ++head)
+    {
+        const struct io_uring_cqe &cqe = m_cqes[head & m_cqMask];
+        if (cqe.user_data == RECEIVE_TAG)
+        {
+            if (!(cqe.flags & IORING_CQE_F_MORE))
+                m_armed = false;
+            m_completions.push_back(Completion{cqe.res, cqe.flags});
+        }
+        else if (cqe.user_data < DATAGRAM_BATCH_MAX)
+        {
+            m_sendResults[cqe.user_data] = cqe.res;
+            --m_sendsPending;
+        }
+    }
+    __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+}
+
+bool UringSocket::wait(error_code &ec)
+{
+    if (!m_blocking)
+    {
+        ec = make_system_error(EAGAIN);
+        return false;
+    }
+
+    int result;
+    if (m_timeout)
+    {
+        struct __kernel_timespec timeout;
+        timeout.tv_sec = static_cast<long long>(m_timeout);
+        timeout.tv_nsec = 0;
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = reinterpret_cast<uint64_t>(&timeout);
+        result = uring_enter(m_ring, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    }
+    else
+    {
+        result = uring_enter(m_ring, 0, 1, IORING_ENTER_GETEVENTS);
+    }
+
+    if (result < 0)
+    {
+        // as SO_RCVTIMEO reports the timeout
+        ec = make_system_error(errno == ETIME ? EAGAIN : errno);
+        return false;
+    }
+    return true;
+}
+
+static void store_address(const uint8_t *name, socklen_t length, SocketAddress *addr, error_code &ec)
+{
+    if (addr == nullptr)
+        return;
+
+    struct sockaddr_storage address;
+    memset(&address, 0, sizeof(address));
+    memcpy(&address, name, min<size_t>(length, sizeof(address)));
+
+    UnixSocketAddress *_addr = static_cast<UnixSocketAddress *>(addr);
+    if (address.ss_family == AF_INET)
+    {
+        _addr->type(SOCKET_TYPE_IP_V4);
+        _addr->address4(&address, sizeof(struct sockaddr_in), ec);
+    }
+    else if (address.ss_family == AF_INET6)
+    {
+        _addr->type(SOCKET_TYPE_IP_V6);
+        _addr->address6(&address, sizeof(struct sockaddr_in6), ec);
+    }
+}
+
+static bool failed(int32_t result, uint32_t flags)
+{
+    // running out of the buffers only ends the request, it is armed again
+    return !(flags & IORING_CQE_F_BUFFER) && result < 0 && result != -ENOBUFS;
+}
+
+bool UringSocket::take(const Completion &completion, Datagram &datagram, error_code &ec)
+{
+    if (!(completion.flags & IORING_CQE_F_BUFFER))
+    {
+        if (failed(completion.result, completion.flags))
+            ec = make_system_error(-completion.result);
+        return false;
+    }
+
+    const uint16_t id = static_cast<uint16_t>(completion.flags >> IORING_CQE_BUFFER_SHIFT);
+    const uint8_t *slot = m_buffers + id * SLOT_SIZE;
+    const struct io_uring_recvmsg_out *out = reinterpret_cast<const struct io_uring_recvmsg_out *>(slot);
+    const uint8_t *name = slot + sizeof(*out);
+    const uint8_t *control = name + m_receiveMsg.msg_namelen;
+    const uint8_t *payload = control + m_receiveMsg.msg_controllen;
+
+    datagram.timestamp = 0;
+    if (receive_timestamps())
+    {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = const_cast<uint8_t *>(control);
+        msg.msg_controllen = out->controllen;
+        datagram.timestamp = control_timestamp(msg);
+    }
+    // payloadlen is the length of the datagram, the slot holds BUFFER_SIZE bytes of it at most
+    const size_t length = min<size_t>(out->payloadlen, BUFFER_SIZE);
+    datagram.truncated = (out->flags & MSG_TRUNC) || out->payloadlen > datagram.length;
+    datagram.length = min(datagram.length, length);
+    memcpy(datagram.data, payload, datagram.length);
+    store_address(name, out->namelen, datagram.address, ec);
+    recycle(id);
+    return !ec.value();
+}
+
+void UringSocket::recycle(uint16_t id)
+{
+    // the entries are indexed by hand, bufs is not at the start of the ring in C++
+    struct io_uring_buf &buffer = reinterpret_cast<struct io_uring_buf *>(m_bufRing)[m_bufTail & (BUFFER_COUNT - 1)];
+    buffer.addr = reinterpret_cast<uint64_t>(m_buffers + id * SLOT_SIZE);
+    buffer.len = SLOT_SIZE;
+    buffer.bid = id;
+    ++m_bufTail;
+    __atomic_store_n(&m_bufRing->tail, m_bufTail, __ATOMIC_RELEASE);
+}
+
+ssize_t UringSocket::recvmmsg(Datagram * datagrams, size_t count, error_code &ec)
+{
+    if (datagrams == nullptr)
+    {
+        ec = make_system_error(EFAULT);
+        return -1;
+    }
+    if (!count || count > DATAGRAM_BATCH_MAX)
+    {
+        ec = make_system_error(EINVAL);
+        return -1;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (datagrams[i].data == nullptr)
+        {
+            ec = make_system_error(EFAULT);
+            return -1;
+        }
+        if (!datagrams[i].length)
+        {
+            ec = make_system_error(EINVAL);
+            return -1;
+        }
+    }
+    if (m_ring < 0)
+    {
+        ec = make_system_error(EBADF);
+        return -1;
+    }
+
+    size_t received = 0;
+    for (;;)
+    {
+        // the completions put aside by a send batch come first
+        while (received < count && m_next < m_completions.size())
+        {
+            const Completion &completion = m_completions[m_next];
+            if (received && failed(completion.result, completion.flags))
+                break;
+            ++m_next;
+            if (take(completion, datagrams[received], ec))
+                ++received;
+            if (ec.value())
+                return -1;
+        }
+        if (m_next == m_completions.size())
+        {
+            m_completions.clear();
+            m_next = 0;
+        }
+
+        // then the ones in the queue, the rest stays there and keeps the ring descriptor readable
+        unsigned head = *m_cqHead;
+        const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        while (received < count && m_next == m_completions.size() && head != tail)
+        {
+            const struct io_uring_cqe &cqe = m_cqes[head & m_cqMask];
+            if (cqe.user_data != RECEIVE_TAG)
+            {
+                ++head;
+                continue;
+            }
+            if (received && failed(cqe.res, cqe.flags))
+                break;
+
+            const Completion completion{cqe.res, cqe.flags};
+            ++head;
+            if (!(completion.flags & IORING_CQE_F_MORE))
+                m_armed = false;
+            if (take(completion, datagrams[received], ec))
+                ++received;
+            if (ec.value())
+                break;
+        }
+        __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+        if (ec.value())
+            return -1;
+
+        if (!m_armed)
+        {
+            arm(ec);
+            if (ec.value())
+                return -1;
+        }
+        if (received)
+            return static_cast<ssize_t>(received);
+        if (!wait(ec))
+            return -1;
+    }
+}
+
+ssize_t UringSocket::recvfrom(error_code &ec, void * buf, size_t len, SocketAddress * addr)
+{
+    Datagram datagram = { buf, len, addr };
+    if (recvmmsg(&datagram, 1, ec) < 0)
+        return -1;
+    return static_cast<ssize_t>(datagram.length);
+}
+
+ssize_t UringSocket::sendmmsg(const Datagram * datagrams, size_t count, error_code &ec)
+{
+    if (datagrams == nullptr)
+    {
+        ec = make_system_error(EFAULT);
+        return -1;
+    }
+    if (!count || count > DATAGRAM_BATCH_MAX)
+    {
+        ec = make_system_error(EINVAL);
+        return -1;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (datagrams[i].data == nullptr || datagrams[i].address == nullptr)
+        {
+            ec = make_system_error(EFAULT);
+            return -1;
+        }
+        if (!datagrams[i].length || !is_socket_type(datagrams[i].address->type()))
+        {
+            ec = make_system_error(EINVAL);
+            return -1;
+        }
+    }
+    if (m_ring < 0)
+    {
+        ec = make_system_error(EBADF);
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        socklen_t size;
+        const struct sockaddr *sap = sockaddr_of(datagrams[i].address, size);
+
+        m_sendIov[i].iov_base = datagrams[i].data;
+        m_sendIov[i].iov_len = datagrams[i].length;
+        memset(&m_sendMsgs[i], 0, sizeof(m_sendMsgs[i]));
+        m_sendMsgs[i].msg_name = const_cast<struct sockaddr *>(sap);
+        m_sendMsgs[i].msg_namelen = size;
+        m_sendMsgs[i].msg_iov = &m_sendIov[i];
+        m_sendMsgs[i].msg_iovlen = 1;
+
+        struct io_uring_sqe *sqe = prepare(IORING_OP_SENDMSG, i);
+        sqe->fd = descriptor();
+        sqe->addr = reinterpret_cast<uint64_t>(&m_sendMsgs[i]);
+        sqe->len = 1;
+        sqe->msg_flags = MSG_CONFIRM;
+        // a failed send cancels the ones after it
+        if (i + 1 < count)
+            sqe->flags = IOSQE_IO_LINK;
+        m_sendResults[i] = -ECANCELED;
+    }
+
+    const unsigned submitted = submit(static_cast<unsigned>(count), ec);
+    if (ec.value())
+    {
+        // the part of the chain the kernel has taken goes out
+        if (!submitted)
+            return -1;
+        ec.clear();
+    }
+
+    // the kernel reads the datagrams until their sends complete
+    m_sendsPending = submitted;
+    while (m_sendsPending)
+    {
+        reap();
+        if (m_sendsPending && uring_enter(m_ring, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+            debug("io_uring_enter() error: {0}", errno);
+    }
+
+    // the received datagrams taken out of the queue with the sends are not seen by
+    // a reactor watching the ring, a no-op completion keeps the descriptor readable
+    if (m_next < m_completions.size())
+    {
+        error_code nop;
+        prepare(IORING_OP_NOP, NOP_TAG);
+        submit(1, nop);
+    }
+
+    size_t sent = 0;
+    while (sent < submitted && m_sendResults[sent] >= 0)
+        ++sent;
+    if (!sent)
+    {
+        ec = make_system_error(-m_sendResults[0]);
+        return -1;
+    }
+    return static_cast<ssize_t>(sent);
+}
+
+#endif // __linux__
+
+unique_ptr<UnixSocket> open_datagram_socket(int domain, SocketBackend backend, error_code &ec)
+{
+#ifdef __linux__
+    if (backend == SocketBackend::URING || (backend == SocketBackend::AUTO && UringSocket::supported()))
+    {
+        error_code uringEc;
+        unique_ptr<UnixSocket> socket(new UringSocket(domain, SOCK_DGRAM, 0, uringEc));
+        if (!uringEc.value() || backend == SocketBackend::URING)
+        {
+            ec = uringEc;
+            return socket;
+        }
+        debug("io_uring socket can not be used: {0}", uringEc.message());
+    }
+#else
+    if (backend == SocketBackend::URING)
+    {
+        ec = make_system_error(ENOSYS);
+        return unique_ptr<UnixSocket>(new UnixSocket());
+    }
+#endif
+    return unique_ptr<UnixSocket>(new UnixSocket(domain, SOCK_DGRAM, 0, ec));
+}
@@ -0,0 +1,132 @@
+#ifndef _UNIX_URING_SOCKET_H
+#define _UNIX_URING_SOCKET_H
+#include "unix_socket.h"
+#include "error.h"
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+#endif
+
+// The implementation of the datagram sockets made by open_datagram_socket()
+enum class SocketBackend
+{
+    POLL,   // UnixSocket: a system call per receive or send batch, readiness from epoll(7)
+    URING,  // UringSocket, fails where io_uring can not be used
+    AUTO    // UringSocket if the kernel supports it, UnixSocket otherwise
+};
+
+#ifdef __linux__
+// UDP socket on io_uring(7).
+// One multishot recvmsg request stays armed on the socket: the kernel puts the datagrams into
+// a ring of provided buffers as they come, and a receive call only takes the completions out of
+// the shared memory, without a system call while some are there. A batch of sends is submitted
+// with one io_uring_enter(2) as a linked chain, so the datagrams leave in order and the first
+// failure stops the rest, as with sendmmsg(2). A single datagram is sent with sendto(2).
+//
+// The ring descriptor gets readable when a datagram has been received, a reactor has to watch
+// event_descriptor() instead of descriptor(). The request is armed by bind() or by the first
+// receive, the kernel does its work in the context of the arming thread, so the socket is
+// best bound by the thread that receives. The socket is not thread-safe.
+// Needs Linux 6.0 or newer, see supported()
+class UringSocket : public UnixSocket
+{
+public:
+    // quantity of the provided buffers, a power of two. A datagram longer than BUFFER_SIZE is truncated
+    static const std::size_t BUFFER_COUNT = 64;
+
+    UringSocket(int domain, int type, int protocol, std::error_code &ec);
+    ~UringSocket() override;
+
+    UringSocket(const UringSocket &) = delete;
+    UringSocket & operator=(const UringSocket &) = delete;
+
+public:
+    void close(std::error_code &ec) override;
+    void bind(const SocketAddress * addr, std::error_code &ec) override;
+    ssize_t recvfrom(std::error_code &ec, void * buf, std::size_t len, SocketAddress * addr = nullptr) override;
+    void set_blocking(bool blocking, std::error_code &ec) override;
+    void set_timeout(size_t timeout, std::error_code &ec) override;
+
+    ssize_t recvmmsg(Datagram * datagrams, std::size_t count, std::error_code &ec) override;
+    ssize_t sendmmsg(const Datagram * datagrams, std::size_t count, std::error_code &ec) override;
+    // neither offload is supported, the calls enabling one fail with COAP_ERR_NOT_IMPLEMENTED
+    void send_offload(bool enable, std::error_code &ec) override;
+    void receive_offload(bool enable, std::error_code &ec) override;
+
+    int event_descriptor() const override
+    { return m_ring; }
+
+public:
+    // true if the running kernel provides everything the socket needs, probed once
+    static bool supported();
+
+private:
+    struct Completion
+    {
+        std::int32_t    result;
+        std::uint32_t   flags;
+    };
+
+    void setup(std::error_code &ec);
+    void teardown();
+    // a zeroed entry at the tail of the submission queue
+    struct io_uring_sqe * prepare(std::uint8_t opcode, std::uint64_t tag);
+    // submits the prepared entries, drops the ones the kernel has not taken
+    unsigned submit(unsigned count, std::error_code &ec);
+    void arm(std::error_code &ec);
+    // moves the completions out of the queue, the receive ones go to m_completions
+    void reap();
+    bool wait(std::error_code &ec);
+    // copies the datagram out of its buffer and gives the buffer back to the kernel
+    bool take(const Completion &completion, Datagram &datagram, std::error_code &ec);
+    void recycle(std::uint16_t id);
+
+private:
+    int                         m_ring;
+    bool                        m_armed;
+    bool                        m_blocking;
+    size_t                      m_timeout;      // seconds, zero waits forever
+    // submission and completion queues shared with the kernel
+    void                        *m_sqRing;
+    std::size_t                 m_sqRingSize;
+    void                        *m_cqRing;
+    std::size_t                 m_cqRingSize;
+    struct io_uring_sqe         *m_sqes;
+    std::size_t                 m_sqesSize;
+    unsigned                    *m_sqHead;
+    unsigned                    *m_sqTail;
+    unsigned                    m_sqMask;
+    unsigned                    *m_cqHead;
+    unsigned                    *m_cqTail;
+    unsigned                    m_cqMask;
+    struct io_uring_cqe         *m_cqes;
+    // provided buffers and the ring the kernel takes them from
+    struct io_uring_buf_ring    *m_bufRing;
+    std::uint8_t                *m_buffers;
+    std::uint16_t               m_bufTail;
+    // the receive completions not taken yet, in arrival order
+    std::vector<Completion>     m_completions;
+    std::size_t                 m_next;
+    struct msghdr               m_receiveMsg;
+    // a batch of sends in flight
+    struct msghdr               m_sendMsgs[DATAGRAM_BATCH_MAX];
+    struct iovec                m_sendIov[DATAGRAM_BATCH_MAX];
+    std::int32_t                m_sendResults[DATAGRAM_BATCH_MAX];
+    std::size_t                 m_sendsPending;
+};
+#endif
+
+// Opens a datagram socket of the domain with the backend. AUTO falls back to UnixSocket
+// if io_uring is not supported or its setup fails, e.g. for the locked memory limit.
+// Never returns nullptr, ec tells whether the socket is usable
+std::unique_ptr<UnixSocket> open_datagram_socket(int domain, SocketBackend backend, std::error_code &ec);
+
+#endif
@@ -0,0 +1,317 @@
+#include "unix_async_client.h"
+#include "byte_order.h"
+#include "error.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+using namespace std;
+using namespace std::chrono;
+using namespace coap;
+using namespace Unix;
+
+// A server on the loopback interface driven by the reactor of the client
+struct LoopbackServer
+{
+    // gets a request, returns the messages to send back
+    typedef function<vector<vector<uint8_t>>(const PacketView &message)> Handler;
+
+    LoopbackServer(Reactor &loop, Handler answer)
+        : reactor(loop), socket(AF_INET, SOCK_DGRAM, 0, ec), client{}, port{0}, handler(std::move(answer))
+    {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        UnixSocketAddress address(addr);
+        socket.bind(&address, ec);
+        EXPECT_FALSE(ec.value());
+
+        socklen_t length = sizeof(addr);
+        getsockname(socket.descriptor(), reinterpret_cast<struct sockaddr *>(&addr), &length);
+        port = ntohs(addr.sin_port);
+
+        reactor.add(socket.descriptor(), Reactor::READABLE, [this](uint32_t){ receive(); }, ec);
+        EXPECT_FALSE(ec.value());
+    }
+
+    ~LoopbackServer()
+    { reactor.remove(socket.descriptor(), ec); }
+
+    void receive()
+    {
+        uint8_t buffer[BUFFER_SIZE];
+        const ssize_t length = socket.recvfrom(ec, buffer, sizeof(buffer), &client);
+        ASSERT_GT(length, 0);
+
+        PacketView message(buffer, static_cast<size_t>(length), ec);
+        ASSERT_FALSE(ec.value());
+        for (const vector<uint8_t> &reply : handler(message))
+            send(reply);
+    }
+
+    void send(const vector<uint8_t> &reply)
+    {
+        socket.sendto(reply.data(), reply.size(), &client, ec);
+        EXPECT_FALSE(ec.value());
+    }
+
+    string uri(const char *path) const
+    { return "coap://127.0.0.1:" + to_string(port) + path; }
+
+    Reactor             &reactor;
+    error_code          ec;
+    UnixSocket          socket;
+    UnixSocketAddress   client;
+    uint16_t            port;
+    Handler             handler;
+};
+
+static vector<uint8_t> reply(
+            MessageType type,
+            MessageCode code,
+            uint16_t messageId,
+            ConstByteSpan token,
+            const string &payload = string()
+        )
+{
+    vector<uint8_t> bytes(PACKET_HEADER_SIZE);
+    bytes[0] = static_cast<uint8_t>((COAP_VERSION << 6) | (type << 4) | token.size());
+    bytes[1] = static_cast<uint8_t>(code);
+    store_be16(&bytes[MESSAGE_ID_OFFSET], messageId);
+    bytes.insert(bytes.end(), token.begin(), token.end());
+    if (!payload.empty())
+    {
+        bytes.push_back(PAYLOAD_MARKER);
+        bytes.insert(bytes.end(), payload.begin(), payload.end());
+    }
+    return bytes;
+}
+
+static string uri_path(const PacketView &message)
+{
+    string path;
+    for (const OptionView &option : message)
+    {
+        if (option.number() == URI_PATH)
+            path += "/" + string(option.value().begin(), option.value().end());
+    }
+    return path;
+}
+
+static void run_until(Reactor &reactor, const function<bool()> &done)
+{
+    error_code ec;
+    const steady_clock::time_point deadline = steady_clock::now() + seconds(5);
+    while (!done() && steady_clock::now() < deadline)
+    {
+        reactor.run_once(milliseconds(10), ec);
+        ASSERT_FALSE(ec.value());
+    }
+}
+
+TEST(testAsyncClient, pipelined)
+{
+    error_code ec;
+    Reactor reactor(ec);
+    ASSERT_FALSE(ec.value());
+
+    // both answer with the path of the request at once
+    vector<unique_ptr<LoopbackServer>> servers;
+    for (int i = 0; i < 2; ++i)
+    {
+        servers.emplace_back(new LoopbackServer(reactor, [](const PacketView &request)
+            {
+                EXPECT_EQ(request.type(), CONFIRMABLE);
+                EXPECT_EQ(request.code_as_byte(), GET);
+                return vector<vector<uint8_t>>{
+                    reply(ACKNOWLEDGEMENT, CONTENT, request.identity(), request.token(), uri_path(request))
+                };
+            }));
+    }
+
+    AsyncClient client(reactor, 1024, 256, 8);
+    const size_t count = 200;
+    size_t answered = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const string path = "/sensors/" + to_string(i);
+        client.get(servers[i % 2]->uri(path.c_str()).c_str(), [&answered, path](const error_code &rec, const PacketView *response)
+            {
+                EXPECT_FALSE(rec.value());
+                ASSERT_NE(response, nullptr);
+                EXPECT_EQ(response->code_as_byte(), CONTENT);
+                EXPECT_EQ(string(response->payload().begin(), response->payload().end()), path);
+                ++answered;
+            }, ec);
+        ASSERT_FALSE(ec.value());
+    }
+    // nothing has been answered yet, the calls have returned at once
+    EXPECT_EQ(answered, 0U);
+    EXPECT_EQ(client.size(), count);
+    EXPECT_EQ(client.servers(), 2U);
+
+    run_until(reactor, [&]{ return answered == count && client.servers() == 0; });
+    EXPECT_EQ(answered, count);
+    EXPECT_EQ(client.size(), 0U);
+    EXPECT_EQ(client.servers(), 0U);
+    EXPECT_EQ(client.retransmissions().transmitted, count);
+    EXPECT_EQ(client.retransmissions().acknowledged, count);
+}
+
+TEST(testAsyncClient, nstart)
+{
+    error_code ec;
+    Reactor reactor(ec);
+    ASSERT_FALSE(ec.value());
+
+    // keeps the requests until four of them have come and answers them in the reverse order
+    vector<vector<uint8_t>> held;
+    LoopbackServer server(reactor, [&held](const PacketView &request)
+        {
+            held.push_back(reply(ACKNOWLEDGEMENT, CONTENT, request.identity(), request.token(), uri_path(request)));
+            EXPECT_LE(held.size(), 4U);
+            vector<vector<uint8_t>> replies;
+            if (held.size() == 4)
+                replies.assign(held.rbegin(), held.rend()), held.clear();
+            return replies;
+        });
+
+    AsyncClient client(reactor, 64, 64, 4);
+    vector<string> answers;
+    for (int i = 0; i < 8; ++i)
+    {
+        const string path = "/" + to_string(i);
+        client.get(server.uri(path.c_str()).c_str(), [&answers](const error_code &rec, const PacketView *response)
+            {
+                ASSERT_FALSE(rec.value());
+                answers.push_back(string(response->payload().begin(), response->payload().end()));
+            }, ec);
+        ASSERT_FALSE(ec.value());
+    }
+
+    run_until(reactor, [&]{ return answers.size() == 8; });
+    EXPECT_EQ(answers, (vector<string>{"/3", "/2", "/1", "/0", "/7", "/6", "/5", "/4"}));
+}
+
+TEST(testAsyncClient, separateResponse)
+{
+    error_code ec;
+    Reactor reactor(ec);
+    ASSERT_FALSE(ec.value());
+
+    uint16_t responseId = 0x1234;
+    bool acknowledged = false;
+    LoopbackServer server(reactor, [&](const PacketView &message)
+        {
+            vector<vector<uint8_t>> replies;
+            if (message.type() == ACKNOWLEDGEMENT)
+            {
+                // the client has acknowledged the separate response
+                EXPECT_EQ(message.identity(), responseId);
+                EXPECT_EQ(message.code_as_byte(), EMPTY);
+                acknowledged = true;
+            }
+            else if (message.type() == CONFIRMABLE)
+            {
+                replies.push_back(reply(ACKNOWLEDGEMENT, EMPTY, message.identity(), ConstByteSpan()));
+                replies.push_back(reply(CONFIRMABLE, CONTENT, responseId, message.token(), "later"));
+            }
+            else
+            {
+                replies.push_back(reply(NON_CONFIRMABLE, CONTENT, message.identity(), message.token(), "non"));
+            }
+            return replies;
+        });
+
+    AsyncClient client(reactor);
+    vector<string> answers;
+    auto handler = [&answers](const error_code &rec, const PacketView *response)
+        {
+            ASSERT_FALSE(rec.value());
+            answers.push_back(string(response->payload().begin(), response->payload().end()));
+        };
+
+    client.get(server.uri("/slow").c_str(), handler, ec);
+    ASSERT_FALSE(ec.value());
+    run_until(reactor, [&]{ return acknowledged; });
+    EXPECT_TRUE(acknowledged);
+
+    RequestOptions options;
+    options.confirmable = false;
+    client.get(server.uri("").c_str(), options, handler, ec);
+    ASSERT_FALSE(ec.value());
+    run_until(reactor, [&]{ return answers.size() == 2; });
+
+    EXPECT_EQ(answers, (vector<string>{"later", "non"}));
+    EXPECT_EQ(client.retransmissions().transmitted, 1U); // the NON is not retransmitted
+}
+
+TEST(testAsyncClient, failures)
+{
+    error_code ec;
+    Reactor reactor(ec);
+    ASSERT_FALSE(ec.value());
+
+    LoopbackServer rejecting(reactor, [](const PacketView &request)
+        {
+            return vector<vector<uint8_t>>{ reply(RESET, EMPTY, request.identity(), ConstByteSpan()) };
+        });
+    LoopbackServer silent(reactor, [](const PacketView &)
+        {
+            return vector<vector<uint8_t>>();
+        });
+
+    vector<error_code> errors;
+    auto handler = [&errors](const error_code &rec, const PacketView *response)
+        {
+            EXPECT_EQ(response, nullptr);
+            errors.push_back(rec);
+        };
+
+    {
+        AsyncClient client(reactor, 2);
+        client.get(rejecting.uri("/a").c_str(), handler, ec);
+        ASSERT_FALSE(ec.value());
+        run_until(reactor, [&]{ return errors.size() == 1; });
+        ASSERT_EQ(errors.size(), 1U);
+        EXPECT_EQ(errors[0], make_system_error(ECONNRESET));
+
+        const char *malformed[] = {
+            "http://127.0.0.1/a",
+            "coap://[::1/a",
+            "coap://[127.0.0.1]/a",
+            "coap://127.0.0.1/a#fragment",
+            "coap://127.0.0.1/%zz",
+            "coap:///a"
+        };
+        for (const char *uri : malformed)
+        {
+            client.get(uri, handler, ec);
+            EXPECT_EQ(ec, make_error_code(CoapStatus::COAP_ERR_URI_PATH)) << uri;
+            ec.clear();
+        }
+        client.get("coap://127.0.0.1:65536/a", handler, ec);
+        EXPECT_EQ(ec, make_error_code(CoapStatus::COAP_ERR_PORT_NUMBER));
+        ec.clear();
+
+        client.get(silent.uri("/a").c_str(), handler, ec);
+        client.get(silent.uri("/b").c_str(), handler, ec);
+        ASSERT_FALSE(ec.value());
+        client.get(silent.uri("/c").c_str(), handler, ec);
+        EXPECT_EQ(ec, make_system_error(ENOBUFS));
+        reactor.run_once(milliseconds(10), ec);
+    }
+
+    // the client has gone with the requests the silent server has not answered
+    ASSERT_EQ(errors.size(), 3U);
+    EXPECT_EQ(errors[1], make_system_error(ECANCELED));
+    EXPECT_EQ(errors[2], make_system_error(ECANCELED));
+}
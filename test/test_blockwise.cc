@@ -170,4 +170,50 @@ TEST(testBlockwise, decodeBlockOption)
 #endif
     ASSERT_EQ(block1.total(), 50);
 
-}
\ No newline at end of file
+}
+TEST(testBlockwise, blockOptionRoundTrip)
+{
+    const uint32_t numbers[] = { 0, 15, 16, 300, 4095, 4096, 70000, 1048575 };
+
+    for (uint32_t number : numbers)
+    {
+        Block2 encoder;
+        encoder.number(number);
+        encoder.size(512);
+        encoder.more(number % 2 != 0);
+
+        Option opt;
+        opt.number(BLOCK_2);
+        ASSERT_TRUE(encoder.encode_block_option(opt));
+
+        Packet packet;
+        error_code ec;
+        packet.add_option(BLOCK_2, opt.value().data(), opt.value().size(), ec);
+        ASSERT_TRUE(!ec.value());
+
+        Block2 decoder;
+        ASSERT_TRUE(decoder.get_header(packet));
+        EXPECT_EQ(decoder.number(), number);
+        EXPECT_EQ(decoder.size(), 512);
+        EXPECT_EQ(decoder.more(), number % 2 != 0);
+    }
+
+    Block2 block;
+    block.number(1048576);
+    block.size(512);
+    Option opt;
+    opt.number(BLOCK_2);
+    EXPECT_FALSE(block.encode_block_option(opt));
+}
+
+TEST(testBlockwise, decodeSizeOption)
+{
+    Option opt;
+    opt.number(SIZE_2);
+    const uint8_t value[] = { 0x01, 0x02, 0x03 };
+    opt.value().assign(value, sizeof(value));
+
+    Block2 block2;
+    ASSERT_TRUE(block2.decode_size_option(opt));
+    EXPECT_EQ(block2.total(), 0x010203U);
+}
@@ -0,0 +1,120 @@
+#include "buffer_pool.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+TEST(testBufferPool, sizeClasses)
+{
+    BufferPool pool(1, 1, 1);
+
+    BufferPool::Handle small = pool.acquire(static_cast<size_t>(4));
+    ASSERT_TRUE(small);
+    EXPECT_EQ(small->length(), BufferPool::SMALL_BUFFER_SIZE);
+    EXPECT_EQ(small->offset(), 0UL);
+
+    // the small class is exhausted, a larger one serves the request
+    BufferPool::Handle next = pool.acquire(static_cast<size_t>(4));
+    ASSERT_TRUE(next);
+    EXPECT_EQ(next->length(), BufferPool::MTU_BUFFER_SIZE);
+
+    BufferPool::Handle large = pool.acquire(BufferPool::MTU_BUFFER_SIZE + 1);
+    ASSERT_TRUE(large);
+    EXPECT_EQ(large->length(), BufferPool::LARGE_BUFFER_SIZE);
+
+    EXPECT_FALSE(pool.acquire(static_cast<size_t>(1)));
+    EXPECT_FALSE(pool.acquire(BufferPool::LARGE_BUFFER_SIZE + 1));
+    EXPECT_FALSE(pool.acquire(BufferPool::SMALL_BUFFER));
+
+    EXPECT_EQ(pool.statistics(BufferPool::SMALL_BUFFER).exhausted, 3UL);
+    EXPECT_EQ(pool.statistics(BufferPool::MTU_BUFFER).exhausted, 1UL);
+}
+
+TEST(testBufferPool, references)
+{
+    BufferPool pool(2, 0, 0);
+
+    BufferPool::Handle first = pool.acquire(BufferPool::SMALL_BUFFER);
+    ASSERT_TRUE(first);
+    EXPECT_EQ(first.use_count(), 1U);
+    memcpy(first->data(), "ping", 4);
+    first->offset(4);
+
+    BufferPool::Handle copy = first;
+    EXPECT_EQ(first.use_count(), 2U);
+    EXPECT_EQ(copy.get(), first.get());
+
+    BufferPool::Handle moved = move(copy);
+    EXPECT_FALSE(copy);
+    EXPECT_EQ(moved.use_count(), 2U);
+
+    first.reset();
+    EXPECT_FALSE(first);
+    EXPECT_EQ(pool.statistics(BufferPool::SMALL_BUFFER).inUse, 1UL); // still held by moved
+    EXPECT_EQ(memcmp(moved->data(), "ping", 4), 0);
+
+    Buffer * buffer = moved.get();
+    moved = BufferPool::Handle();
+    EXPECT_EQ(pool.statistics(BufferPool::SMALL_BUFFER).inUse, 0UL);
+
+    // the last released buffer is taken at first, its content is kept but the offset is reset
+    BufferPool::Handle again = pool.acquire(BufferPool::SMALL_BUFFER);
+    ASSERT_TRUE(again);
+    EXPECT_EQ(again.get(), buffer);
+    EXPECT_EQ(again->offset(), 0UL);
+}
+
+TEST(testBufferPool, reuse)
+{
+    BufferPool pool(0, 8, 0);
+    vector<BufferPool::Handle> handles;
+
+    for (size_t round = 0; round < 100; ++round)
+    {
+        for (size_t i = 0; i < 4; ++i)
+            handles.push_back(pool.acquire(BufferPool::MTU_BUFFER));
+        handles.clear();
+    }
+
+    BufferPool::Statistics stats = pool.statistics(BufferPool::MTU_BUFFER);
+    EXPECT_EQ(stats.capacity, 8UL);
+    EXPECT_EQ(stats.allocated, 4UL); // nothing is allocated once the working set is reached
+    EXPECT_EQ(stats.inUse, 0UL);
+    EXPECT_EQ(stats.highWater, 4UL);
+    EXPECT_EQ(stats.exhausted, 0UL);
+}
+
+TEST(testBufferPool, threads)
+{
+    const size_t workers = 4;
+    const size_t rounds = 20000;
+    BufferPool pool(workers * 2, 0, 0);
+
+    vector<thread> threads;
+    for (size_t t = 0; t < workers; ++t)
+    {
+        threads.emplace_back([&pool, t]
+            {
+                for (size_t i = 0; i < rounds; ++i)
+                {
+                    BufferPool::Handle handle = pool.acquire(BufferPool::SMALL_BUFFER);
+                    ASSERT_TRUE(handle);
+                    handle->data()[0] = static_cast<uint8_t>(t);
+                    BufferPool::Handle shared = handle; // released from the other handle
+                    handle.reset();
+                    ASSERT_EQ(shared->data()[0], static_cast<uint8_t>(t)); // nobody else owns the buffer
+                }
+            });
+    }
+    for (auto &t : threads)
+        t.join();
+
+    BufferPool::Statistics stats = pool.statistics(BufferPool::SMALL_BUFFER);
+    EXPECT_EQ(stats.inUse, 0UL);
+    EXPECT_LE(stats.highWater, workers);
+    EXPECT_LE(stats.allocated, workers);
+    EXPECT_EQ(stats.exhausted, 0UL);
+}
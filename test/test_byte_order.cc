@@ -0,0 +1,54 @@
+#include "byte_order.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+using namespace coap;
+
+static_assert(uint_encoded_size(0) == 0, "zero is encoded as an empty value");
+static_assert(uint_encoded_size(0x1234) == 2, "two bytes");
+static_assert(uint_encoded_size(0x01000000) == 4, "four bytes");
+
+TEST(testByteOrder, loadStore)
+{
+    uint8_t buf[4];
+
+    EXPECT_EQ(store_be16(buf, 0x1234), buf + 2);
+    EXPECT_EQ(buf[0], 0x12);
+    EXPECT_EQ(buf[1], 0x34);
+    EXPECT_EQ(load_be16(buf), 0x1234);
+
+    EXPECT_EQ(store_be32(buf, 0xA1B2C3D4), buf + 4);
+    const uint8_t expected[] = { 0xA1, 0xB2, 0xC3, 0xD4 };
+    EXPECT_EQ(memcmp(buf, expected, sizeof(expected)), 0);
+    EXPECT_EQ(load_be32(buf), 0xA1B2C3D4U);
+}
+
+TEST(testByteOrder, uintOption)
+{
+    uint8_t buf[4];
+    uint32_t value = 0xFFFFFFFF;
+
+    EXPECT_EQ(encode_uint(0, buf), 0UL);
+    ASSERT_TRUE(decode_uint(buf, 0, value));
+    EXPECT_EQ(value, 0U);
+
+    EXPECT_EQ(encode_uint(5683, buf), 2UL);
+    EXPECT_EQ(buf[0], 0x16);
+    EXPECT_EQ(buf[1], 0x33);
+    ASSERT_TRUE(decode_uint(buf, 2, value));
+    EXPECT_EQ(value, 5683U);
+
+    EXPECT_EQ(encode_uint(0x10000, buf), 3UL);
+    ASSERT_TRUE(decode_uint(buf, 3, value));
+    EXPECT_EQ(value, 0x10000U);
+
+    // leading zeros are allowed on receive
+    const uint8_t padded[] = { 0x00, 0x00, 0x01 };
+    ASSERT_TRUE(decode_uint(padded, sizeof(padded), value));
+    EXPECT_EQ(value, 1U);
+
+    const uint8_t tooLong[] = { 1, 2, 3, 4, 5 };
+    EXPECT_FALSE(decode_uint(tooLong, sizeof(tooLong), value));
+}
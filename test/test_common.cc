@@ -1,13 +1,37 @@
 #include "packet.h"
+#include "test_common.h"
 #include <spdlog/spdlog.h>
 #include <spdlog/fmt/fmt.h>
 #include <cstdint>
 #include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <new>
 
 using namespace std;
 using namespace coap;
 using namespace spdlog;
 
+static atomic<size_t> g_allocationCount{0};
+
+void * operator new(size_t size)
+{
+    ++g_allocationCount;
+    void * ptr = malloc(size ? size : 1);
+    if (ptr == nullptr)
+        throw bad_alloc();
+    return ptr;
+}
+
+void operator delete(void * ptr) noexcept
+{ free(ptr); }
+
+void operator delete(void * ptr, size_t) noexcept
+{ free(ptr); }
+
+size_t allocation_count()
+{ return g_allocationCount; }
+
 #ifdef PRINT_TESTED_VALUES
 void print_options(const Packet & packet)
 {
@@ -21,7 +45,7 @@ void print_options(const Packet & packet)
     }
 }
 
-void print_option_from_list(vector<Option *> options)
+void print_option_from_list(vector<const Option *> options)
 {
     int index = 0;
     for (auto &opt : options)
@@ -1,12 +1,16 @@
 #ifndef _TEST_COMMON_H
 #define _TEST_COMMON_H
+#include <cstddef>
+
+// quantity of the heap allocations made by the test executable so far
+std::size_t allocation_count();
 
 #ifdef PRINT_TESTED_VALUES
 #include "packet.h"
 void print_options(const coap::Packet & packet);
 void print_packet(const coap::Packet & packet);
 void print_serialized_packet(const void *data, size_t size);
-void print_option_from_list(std::vector<coap::Option *> options);
+void print_option_from_list(std::vector<const coap::Option *> options);
 #endif
 
 #endif
@@ -0,0 +1,251 @@
+#include "connection.h"
+#include "packet.h"
+#include "unix_udp_server.h"
+#include "unix_endpoint.h"
+#include "buffer_pool.h"
+#include "packet_pool.h"
+#include "error.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+
+using namespace std;
+using namespace coap;
+using namespace Unix;
+
+static UnixSocketAddress bind_loopback(UnixSocket &socket, error_code &ec)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    UnixSocketAddress local(addr);
+    socket.bind(&local, ec);
+
+    socklen_t addrLen = sizeof(addr);
+    getsockname(socket.descriptor(), reinterpret_cast<struct sockaddr *>(&addr), &addrLen);
+    return UnixSocketAddress(addr);
+}
+
+// sends the packet from the connection and returns the datagram the peer has received
+static vector<uint8_t> send_and_receive(UdpServerConnection &connection, const Packet &packet, error_code &ec)
+{
+    UnixSocket receiver(AF_INET, SOCK_DGRAM, 0, ec);
+    if (ec.value())
+        return vector<uint8_t>();
+    UnixSocketAddress dest = bind_loopback(receiver, ec);
+    if (ec.value())
+        return vector<uint8_t>();
+
+    send_packet(connection, packet, &dest, ec);
+    if (ec.value())
+        return vector<uint8_t>();
+
+    vector<uint8_t> datagram(BUFFER_SIZE);
+    ssize_t received = receiver.recvfrom(ec, datagram.data(), datagram.size());
+    datagram.resize(received > 0 ? received : 0);
+    return datagram;
+}
+
+static vector<uint8_t> serialized(const Packet &packet)
+{
+    error_code ec;
+    vector<uint8_t> bytes(packet.encoded_size());
+    packet.serialize(ByteSpan(bytes.data(), bytes.size()), ec);
+    EXPECT_FALSE(ec.value());
+    return bytes;
+}
+
+TEST(testConnection, sendPacket)
+{
+    error_code ec;
+    UdpServerConnection connection(0, true, ec);
+    connection.bind(ec);
+    ASSERT_FALSE(ec.value());
+
+    const char path[] = "sensors";
+    const char payload[] = "22.5 Cel";
+    Packet packet;
+    packet.add_option(URI_PATH, path, sizeof(path) - 1, ec);
+    ASSERT_FALSE(ec.value());
+    packet.prepare_answer(ec, NON_CONFIRMABLE, CONTENT, 0x1234, payload, sizeof(payload) - 1);
+    ASSERT_FALSE(ec.value());
+    ASSERT_TRUE(packet.generate_token(4));
+
+    vector<uint8_t> datagram = send_and_receive(connection, packet, ec);
+    ASSERT_FALSE(ec.value());
+    EXPECT_EQ(datagram, serialized(packet));
+
+    // no payload, no marker
+    packet.payload().clear();
+    datagram = send_and_receive(connection, packet, ec);
+    ASSERT_FALSE(ec.value());
+    EXPECT_EQ(datagram, serialized(packet));
+    EXPECT_EQ(datagram.size(), packet.header_encoded_size());
+}
+
+TEST(testConnection, sendPacketLargeHeader)
+{
+    error_code ec;
+    UdpServerConnection connection(0, true, ec);
+    connection.bind(ec);
+    ASSERT_FALSE(ec.value());
+
+    // the options do not fit the header buffer on the stack
+    const string segment(200, 's');
+    const char payload[] = "payload";
+    Packet packet;
+    packet.add_option(URI_PATH, segment.data(), segment.size(), ec);
+    packet.add_option(URI_PATH, segment.data(), segment.size(), ec);
+    ASSERT_FALSE(ec.value());
+    packet.prepare_answer(ec, CONFIRMABLE, CONTENT, 0x4321, payload, sizeof(payload) - 1);
+    ASSERT_FALSE(ec.value());
+    ASSERT_GT(packet.header_encoded_size(), 256u);
+
+    vector<uint8_t> datagram = send_and_receive(connection, packet, ec);
+    ASSERT_FALSE(ec.value());
+    EXPECT_EQ(datagram, serialized(packet));
+}
+
+TEST(testConnection, serverEndpointResponse)
+{
+    error_code ec;
+    UdpServerConnection connection(0, true, ec);
+    connection.bind(ec);
+    ASSERT_FALSE(ec.value());
+
+    const char coreLink[] = "</sensors/temp>;rt=\"temperature\";if=\"sensor\"";
+    ServerEndpoint endpoint("test", coreLink, &connection, ec);
+    ASSERT_FALSE(ec.value());
+
+    // GET /.well-known/core
+    Packet request;
+    request.add_option(URI_PATH, ".well-known", 11, ec);
+    request.add_option(URI_PATH, "core", 4, ec);
+    request.prepare_answer(ec, CONFIRMABLE, GET, 0x0a0b, nullptr, 0);
+    ASSERT_TRUE(request.generate_token(2));
+
+    BufferPool pool(1, 1, 1);
+    PacketPool packets(2);
+    endpoint.bufferPtr() = pool.acquire(request.encoded_size());
+    ASSERT_TRUE(endpoint.bufferPtr());
+    request.serialize(endpoint.buffer(), ec);
+    ASSERT_FALSE(ec.value());
+    endpoint.requestPtr() = packets.acquire();
+    endpoint.responsePtr() = packets.acquire();
+
+    endpoint.start();
+    bool sent = false;
+    do
+    {
+        endpoint.transaction_step(ec);
+        ASSERT_FALSE(ec.value());
+        if (endpoint.sending())
+        {
+            ASSERT_FALSE(sent);
+            vector<uint8_t> datagram = send_and_receive(connection, endpoint.response(), ec);
+            ASSERT_FALSE(ec.value());
+            EXPECT_EQ(datagram, serialized(endpoint.response()));
+
+            Packet response;
+            response.parse(datagram.data(), datagram.size(), ec);
+            ASSERT_FALSE(ec.value());
+            EXPECT_EQ(response.type(), ACKNOWLEDGEMENT);
+            EXPECT_EQ(response.code_as_byte(), CONTENT);
+            EXPECT_EQ(response.identity(), 0x0a0b);
+            EXPECT_EQ(response.token_length(), 2u);
+            EXPECT_EQ(response.token(), request.token());
+            uint32_t format = 0;
+            EXPECT_TRUE(response.get<CONTENT_FORMAT>(format));
+            EXPECT_EQ(format, static_cast<uint32_t>(LINK_FORMAT));
+            CoreLink expected(coreLink, ec);
+            expected.create_core_link(ec);
+            ASSERT_FALSE(ec.value());
+            EXPECT_EQ(string(response.payload().begin(), response.payload().end()), expected.core_link());
+            sent = true;
+        }
+    }
+    while (endpoint.nextState() != ServerEndpoint::IDLE);
+    EXPECT_TRUE(sent);
+    EXPECT_FALSE(endpoint.bufferPtr());
+    EXPECT_EQ(packets.available(), 2u); // the packets are back in the pool
+
+    // without the packets the request is dropped
+    endpoint.bufferPtr() = pool.acquire(request.encoded_size());
+    request.serialize(endpoint.buffer(), ec);
+    endpoint.start();
+    endpoint.transaction_step(ec);
+    endpoint.transaction_step(ec);
+    EXPECT_EQ(ec, make_system_error(ENOBUFS));
+    EXPECT_FALSE(endpoint.sending());
+}
+
+// runs one message through the endpoint, returns the serialized answer, empty if nothing is sent
+static vector<uint8_t> run_endpoint(ServerEndpoint &endpoint, BufferPool &pool, PacketPool &packets,
+                                    const vector<uint8_t> &message, error_code &ec)
+{
+    vector<uint8_t> answer;
+
+    endpoint.bufferPtr() = pool.acquire(message.size());
+    memcpy(endpoint.buffer().data(), message.data(), message.size());
+    endpoint.buffer().offset(message.size());
+    endpoint.requestPtr() = packets.acquire();
+    endpoint.responsePtr() = packets.acquire();
+
+    endpoint.start();
+    do
+    {
+        endpoint.transaction_step(ec);
+        if (endpoint.sending())
+            answer = serialized(endpoint.response());
+    }
+    while (endpoint.nextState() != ServerEndpoint::IDLE);
+    return answer;
+}
+
+TEST(testConnection, serverEndpointBadOption)
+{
+    error_code ec;
+    UdpServerConnection connection(0, true, ec);
+    ASSERT_FALSE(ec.value());
+    ServerEndpoint endpoint("test", "</sensors/temp>", &connection, ec);
+    ASSERT_FALSE(ec.value());
+
+    BufferPool pool(1, 1, 1);
+    PacketPool packets(2);
+
+    // CON GET, message ID 0x1234, token 0xab 0xcd, the unknown critical option 9
+    const vector<uint8_t> confirmable = { 0x42, GET, 0x12, 0x34, 0xab, 0xcd, 0x91, 0x00 };
+    vector<uint8_t> answer = run_endpoint(endpoint, pool, packets, confirmable, ec);
+    EXPECT_FALSE(ec.value());
+    Packet response;
+    ASSERT_FALSE(answer.empty());
+    response.parse(answer.data(), answer.size(), ec);
+    ASSERT_FALSE(ec.value());
+    EXPECT_EQ(response.type(), ACKNOWLEDGEMENT);
+    EXPECT_EQ(response.code_as_byte(), BAD_OPTION);
+    EXPECT_EQ(response.identity(), 0x1234);
+    ASSERT_EQ(response.token_length(), 2u);
+    EXPECT_EQ(response.token()[0], 0xab);
+    EXPECT_EQ(response.token()[1], 0xcd);
+    EXPECT_EQ(packets.available(), 2u);
+
+    // the same as NON is rejected with a RST
+    const vector<uint8_t> nonConfirmable = { 0x52, GET, 0x43, 0x21, 0xab, 0xcd, 0x91, 0x00 };
+    answer = run_endpoint(endpoint, pool, packets, nonConfirmable, ec);
+    EXPECT_FALSE(ec.value());
+    ASSERT_EQ(answer.size(), PACKET_HEADER_SIZE);
+    response.parse(answer.data(), answer.size(), ec);
+    ASSERT_FALSE(ec.value());
+    EXPECT_EQ(response.type(), RESET);
+    EXPECT_EQ(response.code_as_byte(), EMPTY);
+    EXPECT_EQ(response.identity(), 0x4321);
+
+    // an ACK is dropped
+    const vector<uint8_t> acknowledgement = { 0x62, CONTENT, 0x11, 0x11, 0xab, 0xcd, 0x91, 0x00 };
+    answer = run_endpoint(endpoint, pool, packets, acknowledgement, ec);
+    EXPECT_EQ(ec, make_error_code(CoapStatus::COAP_ERR_BAD_OPTION));
+    EXPECT_TRUE(answer.empty());
+}
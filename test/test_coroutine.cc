@@ -0,0 +1,264 @@
+#include "unix_coroutine.h"
+#if __cplusplus >= 202002L
+#include "error.h"
+#include "byte_order.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+using namespace std;
+using namespace std::chrono;
+using namespace coap;
+using namespace Unix;
+
+static uint16_t bound_port(const UdpServerConnection &connection)
+{
+    struct sockaddr_in addr;
+    socklen_t length = sizeof(addr);
+    getsockname(static_cast<const UnixSocket *>(connection.socket())->descriptor(),
+                reinterpret_cast<struct sockaddr *>(&addr), &length);
+    return ntohs(addr.sin_port);
+}
+
+static string option_values(const PacketView &message, uint16_t number, const char *separator)
+{
+    string values;
+    for (const OptionView &option : message)
+    {
+        if (option.number() == number)
+            values += separator + string(option.value().begin(), option.value().end());
+    }
+    return values;
+}
+
+static void run_until(Reactor &reactor, const bool &done)
+{
+    error_code ec;
+    const steady_clock::time_point deadline = steady_clock::now() + seconds(5);
+    while (!done && steady_clock::now() < deadline)
+    {
+        reactor.run_once(milliseconds(10), ec);
+        ASSERT_FALSE(ec.value());
+    }
+}
+
+TEST(testCoroutine, sequentialRequests)
+{
+    error_code ec;
+    Reactor reactor(ec);
+    ASSERT_FALSE(ec.value());
+
+    UdpServerConnection connection(0, true, ec);
+    connection.bind(ec);
+    ASSERT_FALSE(ec.value());
+
+    // every handler waits a little before its answer, the reactor serves the others meanwhile
+    CoroutineServer server(reactor, connection, [&reactor](ServerExchange &exchange) -> Task<>
+        {
+            co_await sleep_for(reactor, milliseconds(1));
+            const string answer = option_values(exchange.request(), URI_PATH, "/")
+                                + option_values(exchange.request(), URI_QUERY, "?");
+            if (answer == "/missing")
+                co_return; // answered with 5.00
+
+            error_code rec;
+            exchange.respond(CONTENT, answer.data(), answer.size(), rec);
+            EXPECT_FALSE(rec.value());
+        }, ec);
+    ASSERT_FALSE(ec.value());
+
+    AsyncClient client(reactor);
+    const string base = "coap://127.0.0.1:" + to_string(bound_port(connection));
+    vector<string> answers;
+    uint8_t missing = 0;
+    bool done = false;
+
+    // a block-wise like download: every request depends on the previous response.
+    // The lambda keeps the captures of the coroutine, so it lives as long as the coroutine
+    auto download = [&]() -> Task<>
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                const string uri = base + "/firmware?num=" + to_string(i);
+                Response response = co_await async_get(client, uri.c_str());
+                EXPECT_FALSE(response.error().value());
+                answers.push_back(string(response.packet().payload().begin(), response.packet().payload().end()));
+            }
+
+            Response response = co_await async_get(client, (base + "/missing").c_str());
+            missing = response.packet().code_as_byte();
+
+            response = co_await async_get(client, "coap://127.0.0.1:0/");
+            EXPECT_EQ(response.error(), make_error_code(CoapStatus::COAP_ERR_PORT_NUMBER));
+            done = true;
+        };
+    spawn(download());
+
+    EXPECT_FALSE(done); // suspended at the first request
+    run_until(reactor, done);
+    ASSERT_TRUE(done);
+    EXPECT_EQ(answers, (vector<string>{
+        "/firmware?num=0", "/firmware?num=1", "/firmware?num=2", "/firmware?num=3"
+    }));
+    EXPECT_EQ(missing, INTERNAL_SERVER_ERROR);
+}
+
+TEST(testCoroutine, receive)
+{
+    error_code ec;
+    Reactor reactor(ec);
+    ASSERT_FALSE(ec.value());
+
+    UdpServerConnection connection(0, true, ec);
+    connection.bind(ec);
+    ASSERT_FALSE(ec.value());
+
+    vector<string> received;
+    bool done = false;
+    auto receiver = [&]() -> Task<>
+        {
+            for (int i = 0; i < 2; ++i)
+            {
+                char buffer[64];
+                size_t length = sizeof(buffer);
+                UnixSocketAddress from;
+                const error_code rec = co_await async_receive(reactor, connection, buffer, length, &from);
+                EXPECT_FALSE(rec.value());
+                received.push_back(string(buffer, length));
+            }
+            done = true;
+        };
+    spawn(receiver());
+    EXPECT_TRUE(received.empty());
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(bound_port(connection));
+    UnixSocketAddress destination(addr);
+    UnixSocket sender(AF_INET, SOCK_DGRAM, 0, ec);
+    sender.sendto("first", 5, &destination, ec);
+    sender.sendto("second", 6, &destination, ec);
+    ASSERT_FALSE(ec.value());
+
+    run_until(reactor, done);
+    EXPECT_EQ(received, (vector<string>{"first", "second"}));
+}
+
+static vector<uint8_t> request_bytes(MessageType type, uint16_t id, const char *path)
+{
+    error_code ec;
+    Packet request;
+    request.add_option(URI_PATH, path, strlen(path), ec);
+    request.prepare_answer(ec, type, GET, id, nullptr, 0);
+    request.token_length(2);
+    request.token()[0] = 0x5a;
+    request.token()[1] = static_cast<uint8_t>(id);
+    vector<uint8_t> bytes(request.encoded_size());
+    request.serialize(ByteSpan(bytes.data(), bytes.size()), ec);
+    EXPECT_FALSE(ec.value());
+    return bytes;
+}
+
+// runs the reactor for a while and returns the datagrams the socket has got meanwhile
+static vector<vector<uint8_t>> run_and_receive(Reactor &reactor, UnixSocket &socket, milliseconds duration)
+{
+    error_code ec;
+    const steady_clock::time_point deadline = steady_clock::now() + duration;
+    while (steady_clock::now() < deadline)
+        reactor.run_once(milliseconds(1), ec);
+
+    vector<vector<uint8_t>> datagrams;
+    uint8_t buffer[BUFFER_SIZE];
+    ssize_t length;
+    while ((length = recv(socket.descriptor(), buffer, sizeof(buffer), MSG_DONTWAIT)) > 0)
+        datagrams.emplace_back(buffer, buffer + length);
+    return datagrams;
+}
+
+TEST(testCoroutine, duplicatesAndSeparateResponse)
+{
+    error_code ec;
+    Reactor reactor(ec);
+    ASSERT_FALSE(ec.value());
+
+    UdpServerConnection connection(0, true, ec);
+    connection.bind(ec);
+    ASSERT_FALSE(ec.value());
+
+    size_t handled = 0;
+    CoroutineServer server(reactor, connection, [&reactor, &handled](ServerExchange &exchange) -> Task<>
+        {
+            ++handled;
+            const string path = option_values(exchange.request(), URI_PATH, "/");
+            if (path == "/slow")
+                co_await sleep_for(reactor, milliseconds(50));
+
+            error_code rec;
+            exchange.respond(CONTENT, path.data(), path.size(), rec);
+            EXPECT_FALSE(rec.value());
+        }, ec);
+    ASSERT_FALSE(ec.value());
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(bound_port(connection));
+    UnixSocketAddress destination(addr);
+    UnixSocket client(AF_INET, SOCK_DGRAM, 0, ec);
+    ASSERT_FALSE(ec.value());
+
+    // a retransmitted CON answered at once gets the same piggybacked response, the handler runs once
+    const vector<uint8_t> fast = request_bytes(CONFIRMABLE, 0x100, "fast");
+    client.sendto(fast.data(), fast.size(), &destination, ec);
+    client.sendto(fast.data(), fast.size(), &destination, ec);
+    vector<vector<uint8_t>> received = run_and_receive(reactor, client, milliseconds(20));
+    ASSERT_EQ(received.size(), 2u);
+    EXPECT_EQ(received[0], received[1]);
+    PacketView response(received[0].data(), received[0].size(), ec);
+    ASSERT_FALSE(ec.value());
+    EXPECT_EQ(response.type(), ACKNOWLEDGEMENT);
+    EXPECT_EQ(response.identity(), 0x100);
+    EXPECT_EQ(response.code_as_byte(), CONTENT);
+    EXPECT_EQ(handled, 1u);
+
+    // a CON whose handler suspends is acknowledged by an empty ACK, so are its duplicates
+    const vector<uint8_t> slow = request_bytes(CONFIRMABLE, 0x200, "slow");
+    client.sendto(slow.data(), slow.size(), &destination, ec);
+    received = run_and_receive(reactor, client, milliseconds(10));
+    ASSERT_EQ(received.size(), 1u);
+    const vector<uint8_t> emptyAck = { (COAP_VERSION << 6) | (ACKNOWLEDGEMENT << 4), EMPTY, 0x02, 0x00 };
+    EXPECT_EQ(received[0], emptyAck);
+
+    client.sendto(slow.data(), slow.size(), &destination, ec);
+    received = run_and_receive(reactor, client, milliseconds(10));
+    ASSERT_EQ(received.size(), 1u);
+    EXPECT_EQ(received[0], emptyAck);
+
+    // the separate response comes in a new CON with the token of the request
+    received = run_and_receive(reactor, client, milliseconds(80));
+    ASSERT_EQ(received.size(), 1u);
+    response = PacketView(received[0].data(), received[0].size(), ec);
+    ASSERT_FALSE(ec.value());
+    EXPECT_EQ(response.type(), CONFIRMABLE);
+    EXPECT_EQ(response.code_as_byte(), CONTENT);
+    ASSERT_EQ(response.token_length(), 2u);
+    EXPECT_EQ(response.token()[1], 0x00);
+    EXPECT_EQ(string(response.payload().begin(), response.payload().end()), "/slow");
+    EXPECT_EQ(handled, 2u);
+
+    uint8_t ack[PACKET_HEADER_SIZE] = { (COAP_VERSION << 6) | (ACKNOWLEDGEMENT << 4), EMPTY };
+    store_be16(&ack[MESSAGE_ID_OFFSET], response.identity());
+    client.sendto(ack, sizeof(ack), &destination, ec);
+    run_and_receive(reactor, client, milliseconds(10));
+    EXPECT_EQ(server.retransmissions().acknowledged, 1u);
+    EXPECT_EQ(server.deduplication().replays, 2u);
+}
+
+#endif // __cplusplus >= 202002L
@@ -0,0 +1,172 @@
+#include "exchange_cache.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+using namespace coap;
+
+typedef ExchangeCache::Clock Clock;
+
+static PeerKey peer_key(uint32_t address, uint16_t port = 5683)
+{
+    return PeerKey(SOCKET_TYPE_IP_V4, &address, sizeof(address), port);
+}
+
+TEST(testExchangeCache, replay)
+{
+    const Clock::time_point now = Clock::now();
+    ExchangeCache cache(16, 4);
+    BufferPool::Handle response;
+
+    EXPECT_EQ(cache.check(peer_key(1), 100, response, now), ExchangeCache::FIRST);
+    EXPECT_EQ(cache.check(peer_key(1), 100, response, now), ExchangeCache::IN_PROGRESS);
+    EXPECT_FALSE(response);
+    EXPECT_EQ(cache.check(peer_key(2), 100, response, now), ExchangeCache::FIRST); // another peer
+    EXPECT_EQ(cache.check(peer_key(1, 5684), 100, response, now), ExchangeCache::FIRST); // another port
+
+    const string ack = "\x60\x45\x00\x64hello";
+    EXPECT_TRUE(cache.respond(peer_key(1), 100, ack.data(), ack.size()));
+    EXPECT_FALSE(cache.respond(peer_key(1), 101, ack.data(), ack.size())); // unknown exchange
+
+    ASSERT_EQ(cache.check(peer_key(1), 100, response, now), ExchangeCache::REPLAY);
+    ASSERT_TRUE(response);
+    EXPECT_EQ(string(reinterpret_cast<const char *>(response->data()), response->offset()), ack);
+
+    EXPECT_EQ(cache.size(), 3U);
+    EXPECT_EQ(cache.statistics().misses, 3U);
+    EXPECT_EQ(cache.statistics().hits, 2U);
+    EXPECT_EQ(cache.statistics().replays, 1U);
+
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0U);
+    EXPECT_EQ(cache.check(peer_key(1), 100, response, now), ExchangeCache::FIRST);
+}
+
+TEST(testExchangeCache, lifetime)
+{
+    const Clock::time_point start = Clock::now();
+    ExchangeCache cache(16, 4, seconds(1));
+    BufferPool::Handle response;
+
+    EXPECT_EQ(cache.check(peer_key(1), 1, response, start), ExchangeCache::FIRST);
+    EXPECT_EQ(cache.check(peer_key(1), 2, response, start + milliseconds(500)), ExchangeCache::FIRST);
+    EXPECT_EQ(cache.check(peer_key(1), 1, response, start + milliseconds(999)), ExchangeCache::IN_PROGRESS);
+
+    // the first exchange is over, the same message ID starts a new one
+    EXPECT_EQ(cache.check(peer_key(1), 1, response, start + seconds(1)), ExchangeCache::FIRST);
+    EXPECT_EQ(cache.check(peer_key(1), 2, response, start + seconds(1)), ExchangeCache::IN_PROGRESS);
+    EXPECT_EQ(cache.statistics().expired, 1U);
+    EXPECT_EQ(cache.size(), 2U);
+}
+
+TEST(testExchangeCache, eviction)
+{
+    const Clock::time_point now = Clock::now();
+    BufferPool::Handle response;
+
+    ExchangeCache evicting(2, 4, seconds(10), ExchangeCache::EVICT_OLDEST);
+    for (uint16_t id = 1; id <= 3; ++id)
+        EXPECT_EQ(evicting.check(peer_key(1), id, response, now), ExchangeCache::FIRST);
+    EXPECT_EQ(evicting.check(peer_key(1), 3, response, now), ExchangeCache::IN_PROGRESS);
+    EXPECT_EQ(evicting.check(peer_key(1), 1, response, now), ExchangeCache::FIRST); // forgotten
+    EXPECT_EQ(evicting.statistics().evicted, 2U);
+    EXPECT_EQ(evicting.size(), 2U);
+
+    ExchangeCache rejecting(2, 4, seconds(10), ExchangeCache::REJECT_NEW);
+    for (uint16_t id = 1; id <= 3; ++id)
+        EXPECT_EQ(rejecting.check(peer_key(1), id, response, now), ExchangeCache::FIRST);
+    EXPECT_EQ(rejecting.check(peer_key(1), 1, response, now), ExchangeCache::IN_PROGRESS);
+    EXPECT_EQ(rejecting.check(peer_key(1), 3, response, now), ExchangeCache::FIRST); // never remembered
+    EXPECT_EQ(rejecting.statistics().rejected, 2U);
+    EXPECT_EQ(rejecting.statistics().evicted, 0U);
+}
+
+TEST(testExchangeCache, responseMemory)
+{
+    const Clock::time_point now = Clock::now();
+    const uint8_t data[16] = { 0x60, 0x45 };
+    const vector<uint8_t> tooLarge(ExchangeCache::RESPONSE_SIZE_MAX + 1, 0);
+    BufferPool::Handle response;
+
+    // one small and one MTU buffer for the responses
+    ExchangeCache evicting(8, 1, seconds(10), ExchangeCache::EVICT_OLDEST);
+    for (uint16_t id = 1; id <= 3; ++id)
+        ASSERT_EQ(evicting.check(peer_key(1), id, response, now), ExchangeCache::FIRST);
+    EXPECT_TRUE(evicting.respond(peer_key(1), 1, data, sizeof(data)));
+    EXPECT_TRUE(evicting.respond(peer_key(1), 2, data, sizeof(data)));
+    EXPECT_TRUE(evicting.respond(peer_key(1), 3, data, sizeof(data))); // takes the buffer of the oldest one
+    EXPECT_FALSE(evicting.respond(peer_key(1), 3, tooLarge.data(), tooLarge.size()));
+    EXPECT_EQ(evicting.statistics().evicted, 1U);
+    EXPECT_EQ(evicting.check(peer_key(1), 2, response, now), ExchangeCache::REPLAY);
+    response.reset();
+
+    ExchangeCache rejecting(8, 1, seconds(10), ExchangeCache::REJECT_NEW);
+    for (uint16_t id = 1; id <= 3; ++id)
+        ASSERT_EQ(rejecting.check(peer_key(1), id, response, now), ExchangeCache::FIRST);
+    EXPECT_TRUE(rejecting.respond(peer_key(1), 1, data, sizeof(data)));
+    EXPECT_TRUE(rejecting.respond(peer_key(1), 2, data, sizeof(data)));
+    EXPECT_FALSE(rejecting.respond(peer_key(1), 3, data, sizeof(data)));
+    EXPECT_EQ(rejecting.check(peer_key(1), 3, response, now), ExchangeCache::IN_PROGRESS);
+    EXPECT_EQ(rejecting.check(peer_key(1), 1, response, now), ExchangeCache::REPLAY);
+    response.reset(); // the buffer belongs to the pool of the cache, it goes back before the cache is destroyed
+}
+
+TEST(testExchangeCache, forget)
+{
+    const Clock::time_point now = Clock::now();
+    ExchangeCache cache(4, 4, seconds(10));
+    BufferPool::Handle response;
+
+    EXPECT_EQ(cache.check(peer_key(1), 1, response, now), ExchangeCache::FIRST);
+    EXPECT_EQ(cache.check(peer_key(1), 2, response, now), ExchangeCache::FIRST);
+    EXPECT_EQ(cache.check(peer_key(1), 3, response, now), ExchangeCache::FIRST);
+
+    // the newest exchange gives its place back
+    EXPECT_TRUE(cache.forget(peer_key(1), 3));
+    EXPECT_FALSE(cache.forget(peer_key(1), 3));
+    EXPECT_EQ(cache.size(), 2U);
+    EXPECT_EQ(cache.check(peer_key(1), 3, response, now), ExchangeCache::FIRST);
+
+    // an older one is not found any longer but keeps its place until it expires
+    const uint8_t data[8] = { 0x60, 0x45 };
+    EXPECT_TRUE(cache.respond(peer_key(1), 1, data, sizeof(data)));
+    EXPECT_TRUE(cache.forget(peer_key(1), 1));
+    EXPECT_FALSE(cache.respond(peer_key(1), 1, data, sizeof(data)));
+    EXPECT_EQ(cache.size(), 3U);
+    EXPECT_EQ(cache.check(peer_key(1), 1, response, now), ExchangeCache::FIRST);
+    EXPECT_FALSE(response);
+    EXPECT_EQ(cache.check(peer_key(1), 2, response, now), ExchangeCache::IN_PROGRESS);
+
+    // the forgotten exchange is evicted first, without touching the index
+    EXPECT_EQ(cache.check(peer_key(1), 4, response, now), ExchangeCache::FIRST);
+    EXPECT_EQ(cache.statistics().evicted, 1U);
+    EXPECT_EQ(cache.check(peer_key(1), 2, response, now), ExchangeCache::IN_PROGRESS);
+    EXPECT_EQ(cache.check(peer_key(1), 3, response, now), ExchangeCache::IN_PROGRESS);
+    EXPECT_EQ(cache.check(peer_key(1), 1, response, now), ExchangeCache::IN_PROGRESS);
+
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0U);
+}
+
+TEST(testExchangeCache, manyExchanges)
+{
+    const uint32_t capacity = 50000;
+    const uint32_t count = 200000;
+    const Clock::time_point now = Clock::now();
+    ExchangeCache cache(capacity, 1, seconds(10));
+    BufferPool::Handle response;
+
+    for (uint32_t i = 0; i < count; ++i)
+        ASSERT_EQ(cache.check(peer_key(i / 4), static_cast<uint16_t>(i), response, now), ExchangeCache::FIRST);
+    EXPECT_EQ(cache.size(), capacity);
+
+    // the evictions have moved the probe chains around, the newest exchanges must all be found
+    for (uint32_t i = count - capacity; i < count; ++i)
+        ASSERT_EQ(cache.check(peer_key(i / 4), static_cast<uint16_t>(i), response, now), ExchangeCache::IN_PROGRESS) << i;
+    EXPECT_EQ(cache.statistics().evicted, count - capacity);
+    EXPECT_EQ(cache.statistics().hits, capacity);
+}
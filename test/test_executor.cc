@@ -0,0 +1,125 @@
+#include "unix_executor.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace Unix;
+
+TEST(testExecutor, runAll)
+{
+    const size_t count = 10000;
+    atomic<size_t> done{0};
+    {
+        Executor executor(4);
+        EXPECT_EQ(executor.workers(), 4U);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            EXPECT_TRUE(executor.post([&done]{ ++done; }));
+        }
+        executor.shutdown(); // runs the queued tasks before joining
+        EXPECT_EQ(executor.executed(), count);
+        EXPECT_EQ(executor.pending(), 0U);
+        EXPECT_FALSE(executor.post([&done]{ ++done; }));
+    }
+    EXPECT_EQ(done, count);
+}
+
+TEST(testExecutor, postDuringShutdown)
+{
+    // a task accepted by post() runs, even if the workers are exiting at the time
+    for (int round = 0; round < 50; ++round)
+    {
+        atomic<size_t> accepted{0};
+        atomic<size_t> done{0};
+        {
+            Executor executor(2);
+            atomic<bool> started{false};
+
+            thread poster([&]
+                {
+                    started = true;
+                    while (executor.post([&done]{ ++done; }))
+                        ++accepted;
+                });
+
+            while (!started)
+                this_thread::yield();
+            executor.shutdown();
+            poster.join();
+        }
+        EXPECT_EQ(done, accepted);
+    }
+}
+
+TEST(testExecutor, steal)
+{
+    Executor executor(4);
+    atomic<bool> release{false};
+    atomic<size_t> done{0};
+
+    // the tasks posted by a worker go to its own queue, the others have to steal them
+    executor.post([&]
+        {
+            for (size_t i = 0; i < 100; ++i)
+                executor.post([&done]{ ++done; });
+
+            while (!release)
+                this_thread::sleep_for(chrono::milliseconds(1));
+        });
+
+    const auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+    while (done < 100 && chrono::steady_clock::now() < deadline)
+        this_thread::sleep_for(chrono::milliseconds(1));
+
+    EXPECT_EQ(done, 100U); // done while the posting worker is still busy
+    EXPECT_GT(executor.stolen(), 0U);
+    release = true;
+}
+
+TEST(testExecutor, serialQueues)
+{
+    const size_t queues = 16;
+    const size_t perQueue = 2000;
+    Executor executor(4);
+
+    vector<shared_ptr<SerialQueue>> serial;
+    vector<vector<size_t>> order(queues);
+    vector<unique_ptr<atomic<int>>> running;
+    atomic<bool> overlapped{false};
+
+    for (size_t q = 0; q < queues; ++q)
+    {
+        serial.push_back(make_shared<SerialQueue>(executor));
+        running.emplace_back(new atomic<int>(0));
+    }
+
+    for (size_t i = 0; i < perQueue; ++i)
+    {
+        for (size_t q = 0; q < queues; ++q)
+        {
+            serial[q]->post([&, q, i]
+                {
+                    if (running[q]->fetch_add(1) != 0)
+                        overlapped = true;
+                    order[q].push_back(i); // no lock, the tasks of one queue never overlap
+                    running[q]->fetch_sub(1);
+                });
+        }
+    }
+    executor.shutdown();
+
+    EXPECT_FALSE(overlapped);
+    for (size_t q = 0; q < queues; ++q)
+    {
+        ASSERT_EQ(order[q].size(), perQueue);
+        for (size_t i = 0; i < perQueue; ++i)
+            ASSERT_EQ(order[q][i], i);
+        EXPECT_EQ(serial[q]->size(), 0U);
+    }
+}
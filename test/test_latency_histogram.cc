@@ -0,0 +1,102 @@
+#include "latency_histogram.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace coap;
+
+TEST(testLatencyHistogram, buckets)
+{
+    // exact below SUB_BUCKETS, then every bucket holds the values up to its upper bound
+    for (uint64_t value = 0; value < 4096; ++value)
+    {
+        const size_t index = LatencyHistogram::bucket(value);
+        EXPECT_LE(value, LatencyHistogram::upper_bound(index));
+        if (index)
+        {
+            EXPECT_GT(value, LatencyHistogram::upper_bound(index - 1));
+        }
+    }
+    EXPECT_EQ(LatencyHistogram::bucket(7), 7u);
+    EXPECT_EQ(LatencyHistogram::bucket(8), 8u);
+    EXPECT_EQ(LatencyHistogram::upper_bound(LatencyHistogram::bucket(1000)), 1023u);
+
+    const uint64_t greatest = numeric_limits<uint64_t>::max();
+    EXPECT_EQ(LatencyHistogram::bucket(greatest), LatencyHistogram::BUCKETS - 1);
+    EXPECT_EQ(LatencyHistogram::upper_bound(LatencyHistogram::BUCKETS - 1), greatest);
+
+    // the relative error is bounded by the sub-buckets
+    for (uint64_t value = 8; value < (1ULL << 40); value = value * 3 + 1)
+    {
+        const uint64_t bound = LatencyHistogram::upper_bound(LatencyHistogram::bucket(value));
+        EXPECT_LE(bound - value, value / LatencyHistogram::SUB_BUCKETS);
+    }
+}
+
+TEST(testLatencyHistogram, percentiles)
+{
+    LatencyHistogram histogram;
+    EXPECT_EQ(histogram.count(), 0u);
+    EXPECT_EQ(histogram.min(), 0u);
+    EXPECT_EQ(histogram.percentile(99), 0u);
+
+    for (uint64_t value = 1; value <= 1000; ++value)
+        histogram.record(value * 1000);
+
+    EXPECT_EQ(histogram.count(), 1000u);
+    EXPECT_EQ(histogram.min(), 1000u);
+    EXPECT_EQ(histogram.max(), 1000000u);
+    EXPECT_EQ(histogram.mean(), 500500u);
+
+    const double expected[][2] = { {50, 500000}, {90, 900000}, {99, 990000}, {100, 1000000} };
+    for (const auto &p : expected)
+    {
+        const uint64_t value = histogram.percentile(p[0]);
+        EXPECT_GE(value, static_cast<uint64_t>(p[1]));
+        EXPECT_LE(value, static_cast<uint64_t>(p[1] * (1 + 1.0 / LatencyHistogram::SUB_BUCKETS)));
+    }
+    EXPECT_EQ(histogram.percentile(0), LatencyHistogram::upper_bound(LatencyHistogram::bucket(1000)));
+
+    histogram.reset();
+    EXPECT_EQ(histogram.count(), 0u);
+    EXPECT_EQ(histogram.max(), 0u);
+}
+
+TEST(testLatencyHistogram, merge)
+{
+    LatencyHistogram first, second;
+    first.record(100);
+    second.record(50);
+    second.record(5000);
+
+    first.merge(second);
+    EXPECT_EQ(first.count(), 3u);
+    EXPECT_EQ(first.min(), 50u);
+    EXPECT_EQ(first.max(), 5000u);
+    EXPECT_EQ(first.mean(), 1716u);
+    EXPECT_EQ(second.count(), 2u);
+}
+
+TEST(testLatencyHistogram, concurrentRecord)
+{
+    const size_t threads = 4;
+    const uint64_t samples = 10000;
+    LatencyHistogram histogram;
+
+    vector<thread> recorders;
+    for (size_t t = 0; t < threads; ++t)
+        recorders.emplace_back([&histogram, t]
+            {
+                for (uint64_t i = 1; i <= samples; ++i)
+                    histogram.record(i + t);
+            });
+    for (auto &recorder : recorders)
+        recorder.join();
+
+    EXPECT_EQ(histogram.count(), threads * samples);
+    EXPECT_EQ(histogram.min(), 1u);
+    EXPECT_EQ(histogram.max(), samples + threads - 1);
+}
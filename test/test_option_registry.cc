@@ -0,0 +1,128 @@
+#include "option_registry.h"
+#include "packet_view.h"
+#include "packet.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+using namespace std;
+using namespace coap;
+
+static_assert(OptionTraits<CONTENT_FORMAT>::format == OptionFormat::UINT, "Content-Format is uint");
+static_assert(!OptionTraits<CONTENT_FORMAT>::critical, "Content-Format is elective");
+static_assert(OptionTraits<URI_PATH>::repeatable, "Uri-Path is repeatable");
+static_assert(OptionTraits<PROXY_URI>::maxLength == 1034, "Proxy-Uri is up to 1034 bytes");
+static_assert(is_same<OptionTraits<SIZE_1>::value_type, uint32_t>::value, "uint options decode to an integer");
+static_assert(is_same<OptionTraits<ETAG>::value_type, ConstByteSpan>::value, "opaque options are not decoded");
+
+TEST(testOptionRegistry, lookup)
+{
+    for (const OptionProperties &properties : OPTION_PROPERTIES)
+    {
+        const OptionProperties * found = find_option_properties(properties.number);
+        ASSERT_TRUE(found != nullptr);
+        EXPECT_EQ(found->number, properties.number);
+    }
+
+    EXPECT_TRUE(find_option_properties(0) == nullptr);
+    EXPECT_TRUE(find_option_properties(2) == nullptr);
+    EXPECT_TRUE(find_option_properties(61) == nullptr);
+    EXPECT_TRUE(find_option_properties(2048) == nullptr);
+
+    EXPECT_TRUE(is_critical_option(URI_PATH));
+    EXPECT_FALSE(is_critical_option(CONTENT_FORMAT));
+    EXPECT_TRUE(is_unsafe_option(URI_HOST));
+    EXPECT_TRUE(is_no_cache_key_option(SIZE_1));
+}
+
+TEST(testOptionRegistry, typedAccessors)
+{
+    error_code ec;
+    Packet packet;
+
+    const uint8_t format[] = { 0x2d, 0x16 }; // LWM2M_TLV
+    const uint8_t path[] = { 'f', 'w' };
+    const uint8_t block[] = { 0x01, 0x2e };  // NUM 18, M 1, SZX 6
+    packet.add_option(CONTENT_FORMAT, format, sizeof(format), ec);
+    packet.add_option(URI_PATH, path, sizeof(path), ec);
+    packet.add_option(BLOCK_2, block, sizeof(block), ec);
+    ASSERT_TRUE(!ec.value());
+
+    uint32_t value = 0;
+    ASSERT_TRUE(packet.get<CONTENT_FORMAT>(value));
+    EXPECT_EQ(value, static_cast<uint32_t>(LWM2M_TLV));
+
+    ASSERT_TRUE(packet.get<BLOCK_2>(value));
+    EXPECT_EQ(value, 0x12eU);
+
+    ConstByteSpan span;
+    ASSERT_TRUE(packet.get<URI_PATH>(span));
+    ASSERT_EQ(span.size(), 2UL);
+    EXPECT_EQ(memcmp(span.data(), "fw", 2), 0);
+
+    EXPECT_FALSE(packet.get<ACCEPT>(value));
+
+    packet.make_request(ec, CONFIRMABLE, GET, 1, nullptr, 0);
+    ASSERT_TRUE(!ec.value());
+
+    uint8_t buffer[64];
+    size_t size = packet.serialize(ByteSpan(buffer, sizeof(buffer)), ec);
+    ASSERT_TRUE(!ec.value());
+
+    PacketView view(buffer, size, ec);
+    ASSERT_TRUE(!ec.value());
+    ASSERT_TRUE(view.get<BLOCK_2>(value));
+    EXPECT_EQ(value, 0x12eU);
+    EXPECT_FALSE(view.get<SIZE_2>(value));
+}
+
+TEST(testOptionRegistry, badOptionLength)
+{
+    error_code ec;
+    Packet packet;
+
+    const uint8_t format[] = { 0x00, 0x00, 0x00 };
+    packet.add_option(CONTENT_FORMAT, format, sizeof(format), ec);
+    ASSERT_TRUE(!ec.value());
+
+    uint32_t value;
+    EXPECT_FALSE(packet.get<CONTENT_FORMAT>(value));
+
+    // Proxy-Uri may be longer than the generic limit
+    const string uri(300, 'a');
+    packet.add_option(PROXY_URI, uri.data(), uri.size(), ec);
+    EXPECT_TRUE(!ec.value());
+}
+
+TEST(testOptionRegistry, parserRejectsCriticalOptions)
+{
+    error_code ec;
+    PacketView view;
+
+    // option 9 is critical and unregistered
+    const uint8_t unknownCritical[] = { 0x40, 0x01, 0x00, 0x01, 0x91, 0x00 };
+    view.parse(unknownCritical, sizeof(unknownCritical), ec);
+    EXPECT_EQ(ec, make_error_code(CoapStatus::COAP_ERR_BAD_OPTION));
+
+    // option 10 is elective, so it is just passed to the caller
+    const uint8_t unknownElective[] = { 0x40, 0x01, 0x00, 0x01, 0xa1, 0x00 };
+    view.parse(unknownElective, sizeof(unknownElective), ec);
+    EXPECT_TRUE(!ec.value());
+    EXPECT_EQ(view.options_count(), 1UL);
+
+    // Uri-Host is critical and can not be repeated
+    const uint8_t repeatedHost[] = { 0x40, 0x01, 0x00, 0x01, 0x31, 0x61, 0x01, 0x62 };
+    view.parse(repeatedHost, sizeof(repeatedHost), ec);
+    EXPECT_EQ(ec, make_error_code(CoapStatus::COAP_ERR_BAD_OPTION));
+
+    // Uri-Port is critical and up to 2 bytes
+    const uint8_t longPort[] = { 0x40, 0x01, 0x00, 0x01, 0x73, 0x00, 0x16, 0x33 };
+    view.parse(longPort, sizeof(longPort), ec);
+    EXPECT_EQ(ec, make_error_code(CoapStatus::COAP_ERR_BAD_OPTION));
+
+    // the same through Packet
+    Packet packet;
+    packet.parse(unknownCritical, sizeof(unknownCritical), ec);
+    EXPECT_EQ(ec, make_error_code(CoapStatus::COAP_ERR_BAD_OPTION));
+}
@@ -127,7 +127,7 @@ TEST(testPacket, findOption)
     packet.parse(testCoapPacket, sizeof(testCoapPacket), ec);
     ASSERT_TRUE(!ec.value());
 
-    vector<Option *> optList;
+    vector<const Option *> optList;
     size_t quantity;
 
     for(auto o : testOptionSet)
@@ -429,6 +429,320 @@ TEST(testPacket, serialize)
     delete [] buffer;
 }
 
+TEST(testPacket, optionInlineValue)
+{
+    uint8_t value[OPTION_INLINE_LENGTH];
+    memset(value, 0x5A, sizeof(value));
+
+    size_t allocations = allocation_count();
+
+    Option opt;
+    opt.value().assign(value, sizeof(value));
+    Option copy(opt);
+    Option moved(std::move(copy));
+
+    EXPECT_EQ(allocation_count() - allocations, 0UL);
+    EXPECT_TRUE(moved.value().inlined());
+    EXPECT_TRUE(moved.value() == opt.value());
+    EXPECT_TRUE(copy.value().empty());
+}
+
+TEST(testPacket, optionHeapValue)
+{
+    uint8_t value[OPTION_INLINE_LENGTH * 4];
+    memset(value, 0xA5, sizeof(value));
+
+    size_t allocations = allocation_count();
+
+    Option opt;
+    opt.value().assign(value, sizeof(value));
+    EXPECT_EQ(allocation_count() - allocations, 1UL);
+    EXPECT_FALSE(opt.value().inlined());
+
+    Option moved(std::move(opt));
+    EXPECT_EQ(allocation_count() - allocations, 1UL);
+    EXPECT_FALSE(moved.value().inlined());
+    EXPECT_EQ(moved.value().size(), sizeof(value));
+    EXPECT_EQ(memcmp(moved.value().data(), value, sizeof(value)), 0);
+    EXPECT_TRUE(opt.value().empty());
+
+    // the heap storage is reused
+    moved.clear();
+    moved.value().assign(value, sizeof(value) / 2);
+    EXPECT_EQ(allocation_count() - allocations, 1UL);
+}
+
+TEST(testPacket, addOptionAllocations)
+{
+    error_code ec;
+    Packet packet;
+    packet.options().reserve(4);
+
+    const uint8_t port[] = { 0x16, 0x33 };
+    const char path[] = "sensors";
+    const uint8_t format[] = { SENML_JSON };
+    const uint8_t block[] = { 0x06 };
+
+    size_t allocations = allocation_count();
+
+    packet.add_option(URI_PORT, port, sizeof(port), ec);
+    ASSERT_TRUE(!ec.value());
+    packet.add_option(URI_PATH, path, strlen(path), ec);
+    ASSERT_TRUE(!ec.value());
+    packet.add_option(CONTENT_FORMAT, format, sizeof(format), ec);
+    ASSERT_TRUE(!ec.value());
+    packet.add_option(BLOCK_2, block, sizeof(block), ec);
+    ASSERT_TRUE(!ec.value());
+
+    EXPECT_EQ(allocation_count() - allocations, 0UL);
+}
+
+TEST(testPacket, parseAllocations)
+{
+    error_code ec;
+    Packet packet;
+
+    size_t allocations = allocation_count();
+
+    packet.parse(testCoapPacket, sizeof(testCoapPacket), ec);
+    ASSERT_TRUE(!ec.value());
+
+    // the option list, the payload and the only option value longer than OPTION_INLINE_LENGTH
+    EXPECT_EQ(allocation_count() - allocations, 3UL);
+}
+
+TEST(testPacket, serializeSinglePass)
+{
+    error_code ec;
+    Packet packet;
+
+    packet.parse(testCoapPacket, sizeof(testCoapPacket), ec);
+    ASSERT_TRUE(!ec.value());
+
+    EXPECT_EQ(packet.encoded_size(), sizeof(testCoapPacket));
+
+    uint8_t buffer[sizeof(testCoapPacket)];
+
+    size_t allocations = allocation_count();
+
+    size_t size = packet.serialize(ByteSpan(buffer), ec);
+
+    EXPECT_EQ(allocation_count() - allocations, 0UL);
+    ASSERT_TRUE(!ec.value());
+    ASSERT_EQ(size, sizeof(testCoapPacket));
+    EXPECT_EQ(memcmp(buffer, testCoapPacket, size), 0);
+
+    size = packet.serialize(ByteSpan(buffer, sizeof(buffer) - 1), ec);
+    EXPECT_EQ(ec, make_error_code(CoapStatus::COAP_ERR_BUFFER_SIZE));
+    EXPECT_EQ(size, 0UL);
+}
+
+TEST(testPacket, encodedSizeInvalidation)
+{
+    error_code ec;
+    Packet packet;
+
+    packet.make_request(ec, CONFIRMABLE, GET, 0x1234, nullptr, 0, 2);
+    ASSERT_TRUE(!ec.value());
+
+    EXPECT_EQ(packet.encoded_size(), PACKET_HEADER_SIZE + 2UL);
+
+    const char path[] = "temperature";
+    packet.add_option(URI_PATH, path, strlen(path), ec);
+    ASSERT_TRUE(!ec.value());
+
+    EXPECT_EQ(packet.encoded_size(), PACKET_HEADER_SIZE + 2UL + 1 + strlen(path));
+
+    packet.options().clear();
+
+    EXPECT_EQ(packet.encoded_size(), PACKET_HEADER_SIZE + 2UL);
+
+    // the list is changed through a reference taken before the size was cached
+    OptionList &options = packet.options();
+    EXPECT_EQ(packet.encoded_size(), PACKET_HEADER_SIZE + 2UL);
+
+    Option opt;
+    opt.number(URI_PATH);
+    opt.value().assign(reinterpret_cast<const uint8_t *>(path), strlen(path));
+    options.insert(opt);
+
+    const size_t size = PACKET_HEADER_SIZE + 2UL + 1 + strlen(path);
+    EXPECT_EQ(packet.encoded_size(), size);
+
+    uint8_t buffer[PACKET_HEADER_SIZE + 2 + 1 + sizeof(path)] = {0};
+    EXPECT_EQ(packet.serialize(ByteSpan(buffer, size), ec), size);
+    EXPECT_TRUE(!ec.value());
+
+    options.erase(options.find(URI_PATH));
+    EXPECT_EQ(packet.encoded_size(), PACKET_HEADER_SIZE + 2UL);
+}
+
+TEST(testPacket, serializeToBuffer)
+{
+    error_code ec;
+    Packet packet;
+
+    const uint8_t format[] = { TEXT_PLAIN };
+    packet.add_option(CONTENT_FORMAT, format, sizeof(format), ec);
+    ASSERT_TRUE(!ec.value());
+
+    packet.prepare_answer(ec, ACKNOWLEDGEMENT, CONTENT, 0x4321, "23.5", 4);
+    ASSERT_TRUE(!ec.value());
+
+    Buffer buffer(BUFFER_SIZE);
+    buffer.offset(2);
+
+    packet.serialize(buffer, ec);
+    ASSERT_TRUE(!ec.value());
+    EXPECT_EQ(buffer.offset(), 2 + packet.encoded_size());
+
+    Packet parsed;
+    parsed.parse(buffer.data() + 2, buffer.offset() - 2, ec);
+    ASSERT_TRUE(!ec.value());
+
+    EXPECT_EQ(parsed.identity(), 0x4321);
+    EXPECT_EQ(parsed.code_as_byte(), CONTENT);
+    ASSERT_EQ(parsed.options().size(), 1UL);
+    EXPECT_EQ(parsed.options()[0].number(), CONTENT_FORMAT);
+    ASSERT_EQ(parsed.payload().size(), 4UL);
+    EXPECT_EQ(memcmp(parsed.payload().data(), "23.5", 4), 0);
+}
+
+TEST(testPacket, serializeHeader)
+{
+    error_code ec;
+    Packet packet;
+
+    const uint8_t format[] = { TEXT_PLAIN };
+    packet.add_option(CONTENT_FORMAT, format, sizeof(format), ec);
+    ASSERT_TRUE(!ec.value());
+
+    packet.prepare_answer(ec, ACKNOWLEDGEMENT, CONTENT, 0x4321, "23.5", 4);
+    ASSERT_TRUE(!ec.value());
+
+    uint8_t whole[64];
+    size_t size = packet.serialize(ByteSpan(whole, sizeof(whole)), ec);
+    ASSERT_TRUE(!ec.value());
+
+    uint8_t header[64];
+    size_t headerSize = packet.serialize_header(ByteSpan(header, sizeof(header)), ec);
+    ASSERT_TRUE(!ec.value());
+    EXPECT_EQ(headerSize, packet.header_encoded_size());
+    EXPECT_EQ(headerSize + packet.payload().size(), size);
+    // the header ends with the payload marker, the payload follows it only in the whole message
+    EXPECT_EQ(header[headerSize - 1], PAYLOAD_MARKER);
+    EXPECT_EQ(memcmp(header, whole, headerSize), 0);
+
+    packet.serialize_header(ByteSpan(header, headerSize - 1), ec);
+    EXPECT_EQ(ec, make_error_code(CoapStatus::COAP_ERR_BUFFER_SIZE));
+}
+
+static Option make_test_option(uint16_t number, uint8_t value)
+{
+    Option opt;
+    opt.number(number);
+    opt.value().push_back(value);
+    return opt;
+}
+
+TEST(testPacket, optionListOrder)
+{
+    OptionList options;
+
+    options.insert(make_test_option(URI_QUERY, 1));
+    options.insert(make_test_option(URI_PATH, 2));
+    options.insert(make_test_option(URI_QUERY, 3));
+    options.insert(make_test_option(IF_MATCH, 4));
+    options.insert(make_test_option(SIZE_1, 5));
+    options.insert(make_test_option(URI_QUERY, 6));
+    options.insert(make_test_option(URI_PATH, 7));
+
+    const uint16_t numbers[] = { IF_MATCH, URI_PATH, URI_PATH, URI_QUERY, URI_QUERY, URI_QUERY, SIZE_1 };
+    const uint8_t values[] = { 4, 2, 7, 1, 3, 6, 5 };
+
+    ASSERT_EQ(options.size(), sizeof(numbers)/sizeof(numbers[0]));
+    for (size_t i = 0; i < options.size(); ++i)
+    {
+        EXPECT_EQ(options[i].number(), numbers[i]);
+        EXPECT_EQ(options[i].value()[0], values[i]);
+    }
+}
+
+TEST(testPacket, optionListLookup)
+{
+    OptionList options;
+
+    options.insert(make_test_option(URI_QUERY, 1));
+    options.insert(make_test_option(URI_QUERY, 2));
+    options.insert(make_test_option(BLOCK_2, 3));
+    options.insert(make_test_option(2048, 4)); // out of the bitmap
+
+    EXPECT_TRUE(options.contains(URI_QUERY));
+    EXPECT_TRUE(options.contains(BLOCK_2));
+    EXPECT_TRUE(options.contains(2048));
+    EXPECT_FALSE(options.contains(BLOCK_1));
+    EXPECT_FALSE(options.contains(2049));
+
+    OptionList::const_range r = static_cast<const OptionList &>(options).equal_range(URI_QUERY);
+    ASSERT_EQ(r.second - r.first, 2);
+    EXPECT_EQ(r.first->value()[0], 1);
+    EXPECT_EQ((r.first + 1)->value()[0], 2);
+
+    EXPECT_EQ(options.count(BLOCK_1), 0UL);
+    EXPECT_TRUE(options.find(BLOCK_1) == options.end());
+    EXPECT_EQ(options.find(2048)->value()[0], 4);
+
+    EXPECT_EQ(options.erase(URI_QUERY), 2UL);
+    EXPECT_FALSE(options.contains(URI_QUERY));
+    EXPECT_TRUE(options.contains(BLOCK_2));
+
+    options.erase(options.find(BLOCK_2));
+    EXPECT_FALSE(options.contains(BLOCK_2));
+    EXPECT_EQ(options.size(), 1UL);
+
+    options.clear();
+    EXPECT_FALSE(options.contains(2048));
+}
+
+TEST(testPacket, optionListFindAbsent)
+{
+    OptionList options;
+
+    // the numbers out of the bitmap are looked up in the list, an absent one falls between two present ones
+    options.insert(make_test_option(BLOCK_2, 1));
+    options.insert(make_test_option(300, 2));
+
+    const OptionList &constOptions = options;
+
+    EXPECT_FALSE(options.contains(258));
+    EXPECT_TRUE(options.find(258) == options.end());
+    EXPECT_TRUE(constOptions.find(258) == constOptions.end());
+    EXPECT_TRUE(options.find(2048) == options.end());
+    EXPECT_TRUE(options.find(BLOCK_1) == options.end());
+    EXPECT_EQ(options.find(300)->value()[0], 2);
+}
+
+TEST(testPacket, findOptions)
+{
+    error_code ec;
+    Packet packet;
+
+    packet.parse(testCoapPacket, sizeof(testCoapPacket), ec);
+    ASSERT_TRUE(!ec.value());
+
+    EXPECT_TRUE(packet.has_option(URI_QUERY));
+    EXPECT_FALSE(packet.has_option(BLOCK_2));
+
+    size_t allocations = allocation_count();
+
+    OptionList::const_range r = packet.find_options(URI_QUERY);
+
+    EXPECT_EQ(allocation_count() - allocations, 0UL);
+    ASSERT_EQ(r.second - r.first, 4);
+    for (OptionList::const_iterator it = r.first; it != r.second; ++it)
+        EXPECT_EQ(it->number(), URI_QUERY);
+}
+
 TEST(testPacket, DataType)
 {
     const char * testString = "This is a test string";
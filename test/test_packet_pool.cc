@@ -0,0 +1,124 @@
+#include "packet_pool.h"
+#include "test_common.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace coap;
+
+TEST(testPacketPool, reset)
+{
+    error_code ec;
+    Packet packet;
+
+    const uint8_t path[] = { 't', 'e', 'm', 'p' };
+    packet.add_option(URI_PATH, path, sizeof(path), ec);
+    ASSERT_TRUE(!ec.value());
+    packet.prepare_answer(ec, ACKNOWLEDGEMENT, CONTENT, 0x1234, "23.5", 4);
+    ASSERT_TRUE(!ec.value());
+
+    const size_t payloadCapacity = packet.payload().capacity();
+
+    packet.reset();
+
+    EXPECT_EQ(packet.header_as_byte(), 0);
+    EXPECT_EQ(packet.code_as_byte(), 0);
+    EXPECT_EQ(packet.identity(), 0);
+    EXPECT_EQ(packet.token_length(), 0UL);
+    EXPECT_EQ(packet.options().size(), 0UL);
+    EXPECT_FALSE(packet.has_option(URI_PATH));
+    EXPECT_EQ(packet.payload().size(), 0UL);
+    EXPECT_EQ(packet.payload().capacity(), payloadCapacity);
+    EXPECT_EQ(packet.encoded_size(), PACKET_HEADER_SIZE);
+}
+
+TEST(testPacketPool, acquire)
+{
+    PacketPool pool(2, 4, 64);
+    EXPECT_EQ(pool.capacity(), 2UL);
+    EXPECT_EQ(pool.available(), 2UL);
+
+    PacketPool::Handle first = pool.acquire();
+    PacketPool::Handle second = pool.acquire();
+    ASSERT_TRUE(static_cast<bool>(first));
+    ASSERT_TRUE(static_cast<bool>(second));
+    EXPECT_NE(first.get(), second.get());
+    EXPECT_EQ(pool.available(), 0UL);
+
+    PacketPool::Handle third = pool.acquire();
+    EXPECT_FALSE(static_cast<bool>(third));
+
+    first->identity(0x55);
+    Packet * packet = first.get();
+    third = std::move(first);
+    EXPECT_FALSE(static_cast<bool>(first));
+    EXPECT_EQ(third.get(), packet);
+
+    third.release();
+    EXPECT_EQ(pool.available(), 1UL);
+
+    // the returned packet comes back empty
+    PacketPool::Handle again = pool.acquire();
+    ASSERT_TRUE(static_cast<bool>(again));
+    EXPECT_EQ(again.get(), packet);
+    EXPECT_EQ(again->identity(), 0);
+}
+
+TEST(testPacketPool, noAllocations)
+{
+    PacketPool pool(1, 4, 64);
+    error_code ec;
+    const uint8_t path[] = { 't', 'e', 'm', 'p' };
+
+    {
+        PacketPool::Handle handle = pool.acquire();
+        handle->add_option(URI_PATH, path, sizeof(path), ec);
+        ASSERT_TRUE(!ec.value());
+    }
+
+    const size_t before = allocation_count();
+    for (int i = 0; i < 100; ++i)
+    {
+        PacketPool::Handle handle = pool.acquire();
+        ASSERT_TRUE(static_cast<bool>(handle));
+        handle->add_option(URI_PATH, path, sizeof(path), ec);
+        handle->payload().assign(path, path + sizeof(path));
+    }
+    EXPECT_EQ(allocation_count() - before, 0UL);
+}
+
+TEST(testPacketPool, threads)
+{
+    const size_t THREADS = 4;
+    const int ITERATIONS = 10000;
+    PacketPool pool(THREADS / 2);
+    atomic<int> failures{0};
+    vector<thread> threads;
+
+    for (size_t t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([&pool, &failures, t]() {
+            for (int i = 0; i < ITERATIONS; ++i)
+            {
+                PacketPool::Handle handle = pool.acquire();
+                if (!handle)
+                    continue;
+                // nobody else may use the packet while the handle is held
+                if (handle->identity() != 0)
+                    ++failures;
+                handle->identity(static_cast<uint16_t>(t + 1));
+                this_thread::yield();
+                if (handle->identity() != t + 1)
+                    ++failures;
+            }
+        });
+    }
+    for (thread &th : threads)
+        th.join();
+
+    EXPECT_EQ(failures.load(), 0);
+    EXPECT_EQ(pool.available(), pool.capacity());
+}
@@ -0,0 +1,128 @@
+#include "packet_view.h"
+#include "packet.h"
+#include <gtest/gtest.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/fmt.h>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+using namespace coap;
+using namespace spdlog;
+
+static const uint8_t testRequest[] = {// CON GET, MID 0x1234, token 0xAB 0xCD
+    0x42, 0x01, 0x12, 0x34, 0xab, 0xcd,
+    0xb4, 0x74, 0x65, 0x6d, 0x70,       // URI_PATH "temp"
+    0x11, 0x32,                         // CONTENT_FORMAT 50
+    0x33, 0x61, 0x3d, 0x31,             // URI_QUERY "a=1"
+    0x03, 0x62, 0x3d, 0x32,             // URI_QUERY "b=2"
+    0xd1, 0x20, 0x06,                   // SIZE_1 6 (extended delta 13 + 32)
+    0xff, 0x31, 0x32, 0x33              // payload "123"
+};
+
+TEST(testPacketView, parse)
+{
+    error_code ec;
+    PacketView view(testRequest, sizeof(testRequest), ec);
+    ASSERT_TRUE(!ec.value());
+    ASSERT_TRUE(view.valid());
+
+    EXPECT_EQ(view.version(), COAP_VERSION);
+    EXPECT_EQ(view.type(), CONFIRMABLE);
+    EXPECT_EQ(view.code_as_byte(), GET);
+    EXPECT_EQ(view.identity(), 0x1234);
+    EXPECT_EQ(view.token_length(), 2UL);
+    EXPECT_EQ(view.token()[0], 0xab);
+    EXPECT_EQ(view.token()[1], 0xcd);
+    EXPECT_EQ(view.options_count(), 5UL);
+
+    const uint16_t numbers[] = { URI_PATH, CONTENT_FORMAT, URI_QUERY, URI_QUERY, SIZE_1 };
+    const size_t lengths[] = { 4, 1, 3, 3, 1 };
+    size_t index = 0;
+
+    for (const OptionView &opt : view)
+    {
+        ASSERT_LT(index, sizeof(numbers)/sizeof(numbers[0]));
+        EXPECT_EQ(opt.number(), numbers[index]);
+        EXPECT_EQ(opt.length(), lengths[index]);
+        // the values point into the parsed buffer
+        EXPECT_GE(opt.value().data(), testRequest);
+        EXPECT_LT(opt.value().data(), testRequest + sizeof(testRequest));
+        ++index;
+    }
+    EXPECT_EQ(index, view.options_count());
+
+    EXPECT_EQ(view.payload().size(), 3UL);
+    EXPECT_EQ(view.payload().data(), &testRequest[sizeof(testRequest) - 3]);
+    EXPECT_EQ(memcmp(view.payload().data(), "123", 3), 0);
+}
+
+TEST(testPacketView, noOptionsNoPayload)
+{
+    const uint8_t ack[] = { 0x60, 0x00, 0x00, 0x01 };
+    error_code ec;
+    PacketView view(ack, sizeof(ack), ec);
+    ASSERT_TRUE(!ec.value());
+
+    EXPECT_EQ(view.type(), ACKNOWLEDGEMENT);
+    EXPECT_EQ(view.options_count(), 0UL);
+    EXPECT_TRUE(view.begin() == view.end());
+    EXPECT_TRUE(view.payload().empty());
+}
+
+TEST(testPacketView, malformed)
+{
+    error_code ec;
+    PacketView view;
+
+    const uint8_t wrongVersion[] = { 0x82, 0x01, 0x00, 0x01 };
+    view.parse(wrongVersion, sizeof(wrongVersion), ec);
+    EXPECT_EQ(ec, make_error_code(CoapStatus::COAP_ERR_PROTOCOL_VERSION));
+    EXPECT_FALSE(view.valid());
+
+    const uint8_t longToken[] = { 0x49, 0x01, 0x00, 0x01, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    view.parse(longToken, sizeof(longToken), ec);
+    EXPECT_EQ(ec, make_error_code(CoapStatus::COAP_ERR_TOKEN_LENGTH));
+
+    const uint8_t truncatedToken[] = { 0x44, 0x01, 0x00, 0x01, 0xaa };
+    view.parse(truncatedToken, sizeof(truncatedToken), ec);
+    EXPECT_EQ(ec, make_system_error(EINVAL));
+
+    const uint8_t reservedDelta[] = { 0x40, 0x01, 0x00, 0x01, 0xf1, 0x00 };
+    view.parse(reservedDelta, sizeof(reservedDelta), ec);
+    EXPECT_EQ(ec, make_error_code(CoapStatus::COAP_ERR_OPTION_DELTA));
+
+    const uint8_t truncatedExtended[] = { 0x40, 0x01, 0x00, 0x01, 0xe0, 0x01 };
+    view.parse(truncatedExtended, sizeof(truncatedExtended), ec);
+    EXPECT_EQ(ec, make_error_code(CoapStatus::COAP_ERR_OPTION_DELTA));
+
+    const uint8_t truncatedValue[] = { 0x40, 0x01, 0x00, 0x01, 0xb4, 0x74, 0x65 };
+    view.parse(truncatedValue, sizeof(truncatedValue), ec);
+    EXPECT_EQ(ec, make_error_code(CoapStatus::COAP_ERR_OPTION_LENGTH));
+
+    const uint8_t emptyPayload[] = { 0x40, 0x01, 0x00, 0x01, 0xff };
+    view.parse(emptyPayload, sizeof(emptyPayload), ec);
+    EXPECT_EQ(ec, make_error_code(CoapStatus::COAP_ERR_NO_PAYLOAD));
+}
+
+TEST(testPacketView, packetParse)
+{
+    error_code ec;
+    Packet packet;
+
+    packet.parse(testRequest, sizeof(testRequest), ec);
+    ASSERT_TRUE(!ec.value());
+
+    EXPECT_EQ(packet.identity(), 0x1234);
+    EXPECT_EQ(packet.options().size(), 5UL);
+    EXPECT_EQ(packet.payload().size(), 3UL);
+
+    vector<const Option *> optList;
+    EXPECT_EQ(packet.find_option(URI_QUERY, optList), 2UL);
+    EXPECT_EQ(memcmp(optList[1]->value().data(), "b=2", 3), 0);
+
+    // parsing again must not accumulate the payload
+    packet.parse(testRequest, sizeof(testRequest), ec);
+    ASSERT_TRUE(!ec.value());
+    EXPECT_EQ(packet.payload().size(), 3UL);
+}
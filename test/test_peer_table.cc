@@ -0,0 +1,133 @@
+#include "unix_peer_table.h"
+#include "unix_socket.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+
+using namespace std;
+using namespace Unix;
+
+static PeerKey ipv4_key(uint32_t address, uint16_t port)
+{
+    const uint32_t value = htonl(address);
+    return PeerKey(SOCKET_TYPE_IP_V4, &value, sizeof(value), port);
+}
+
+TEST(testPeerTable, peerKey)
+{
+    struct sockaddr_in addr4;
+    memset(&addr4, 0, sizeof(addr4));
+    addr4.sin_family = AF_INET;
+    addr4.sin_addr.s_addr = htonl(0x0A000001);
+    addr4.sin_port = htons(5683);
+
+    const PeerKey key = UnixSocketAddress(addr4).peer_key();
+    EXPECT_EQ(key.family(), SOCKET_TYPE_IP_V4);
+    EXPECT_EQ(key.port(), 5683);
+    EXPECT_EQ(key, ipv4_key(0x0A000001, 5683));
+    EXPECT_NE(key, ipv4_key(0x0A000001, 5684)); // the same host, another port
+    EXPECT_NE(key, ipv4_key(0x0A000002, 5683));
+
+    struct sockaddr_in6 addr6;
+    memset(&addr6, 0, sizeof(addr6));
+    addr6.sin6_family = AF_INET6;
+    addr6.sin6_addr = in6addr_loopback;
+    addr6.sin6_port = htons(5683);
+    const PeerKey key6 = UnixSocketAddress(addr6).peer_key();
+
+    struct sockaddr_in6 other6 = addr6;
+    other6.sin6_addr.s6_addr[0] = 0xFE;
+    EXPECT_NE(key6, UnixSocketAddress(other6).peer_key()); // the whole IPv6 address counts
+    EXPECT_EQ(key6, UnixSocketAddress(addr6).peer_key());
+    EXPECT_NE(key6.hash(1), key6.hash(2));
+}
+
+TEST(testPeerTable, insertFindErase)
+{
+    PeerTable<shared_ptr<int>> table(4);
+    EXPECT_EQ(table.shards(), 4U);
+
+    EXPECT_TRUE(table.insert(ipv4_key(1, 1), make_shared<int>(1)));
+    EXPECT_TRUE(table.insert(ipv4_key(1, 2), make_shared<int>(2)));
+    EXPECT_FALSE(table.insert(ipv4_key(1, 1), make_shared<int>(3)));
+    EXPECT_EQ(table.size(), 2U);
+
+    shared_ptr<int> value;
+    ASSERT_TRUE(table.find(ipv4_key(1, 2), value));
+    EXPECT_EQ(*value, 2);
+    EXPECT_FALSE(table.find(ipv4_key(2, 1), value));
+
+    EXPECT_TRUE(table.erase(ipv4_key(1, 1)));
+    EXPECT_FALSE(table.erase(ipv4_key(1, 1)));
+    EXPECT_FALSE(table.contains(ipv4_key(1, 1)));
+    EXPECT_TRUE(table.contains(ipv4_key(1, 2)));
+    EXPECT_EQ(table.size(), 1U);
+}
+
+TEST(testPeerTable, manyPeers)
+{
+    const uint32_t count = 200000;
+    PeerTable<uint32_t> table;
+
+    for (uint32_t i = 0; i < count; ++i)
+        ASSERT_TRUE(table.insert(ipv4_key(0x0A000000 + i / 8, static_cast<uint16_t>(5683 + i % 8)), i));
+    EXPECT_EQ(table.size(), count);
+
+    // erasing a half moves the rest of the probe chains back, all of them must still be found
+    for (uint32_t i = 0; i < count; i += 2)
+        ASSERT_TRUE(table.erase(ipv4_key(0x0A000000 + i / 8, static_cast<uint16_t>(5683 + i % 8))));
+
+    uint32_t value;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const bool found = table.find(ipv4_key(0x0A000000 + i / 8, static_cast<uint16_t>(5683 + i % 8)), value);
+        ASSERT_EQ(found, i % 2 == 1);
+        if (found)
+        {
+            ASSERT_EQ(value, i);
+        }
+    }
+
+    size_t visited = 0;
+    table.for_each([&visited](const PeerKey &, const uint32_t &v)
+        {
+            EXPECT_EQ(v % 2, 1U);
+            ++visited;
+        });
+    EXPECT_EQ(visited, count / 2);
+}
+
+TEST(testPeerTable, threads)
+{
+    const uint32_t workers = 4;
+    const uint32_t perWorker = 20000;
+    PeerTable<uint32_t> table;
+
+    vector<thread> threads;
+    for (uint32_t t = 0; t < workers; ++t)
+    {
+        threads.emplace_back([&table, t]
+            {
+                uint32_t value;
+                for (uint32_t i = 0; i < perWorker; ++i)
+                {
+                    const PeerKey key = ipv4_key(t, static_cast<uint16_t>(i));
+                    ASSERT_TRUE(table.insert(key, i));
+                    ASSERT_TRUE(table.find(key, value));
+                    ASSERT_EQ(value, i);
+                    if (i % 4 == 0)
+                    {
+                        ASSERT_TRUE(table.erase(key));
+                    }
+                }
+            });
+    }
+    for (auto &t : threads)
+        t.join();
+
+    EXPECT_EQ(table.size(), workers * perWorker * 3 / 4);
+}
@@ -0,0 +1,87 @@
+#include "random.h"
+#include "packet.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace coap;
+
+TEST(testRandom, fastRandom)
+{
+    set<uint64_t> values;
+    for (int i = 0; i < 1000; ++i)
+        values.insert(fast_random());
+    EXPECT_EQ(values.size(), 1000UL);
+
+    uint8_t first[13] = {0}, second[13] = {0};
+    fast_random_bytes(first, sizeof(first));
+    fast_random_bytes(second, sizeof(second));
+    EXPECT_NE(memcmp(first, second, sizeof(first)), 0);
+}
+
+TEST(testRandom, threadsDiffer)
+{
+    uint64_t values[2] = {0, 0};
+    thread first([&values]() { values[0] = fast_random(); });
+    thread second([&values]() { values[1] = fast_random(); });
+    first.join();
+    second.join();
+    EXPECT_NE(values[0], values[1]);
+}
+
+TEST(testRandom, secureRandom)
+{
+    error_code ec;
+    uint8_t first[16] = {0}, second[16] = {0};
+
+    secure_random_bytes(first, sizeof(first), ec);
+    ASSERT_TRUE(!ec.value());
+    secure_random_bytes(second, sizeof(second), ec);
+    ASSERT_TRUE(!ec.value());
+    EXPECT_NE(memcmp(first, second, sizeof(first)), 0);
+
+    secure_random_bytes(nullptr, 1, ec);
+    EXPECT_EQ(ec, make_system_error(EFAULT));
+
+    Packet packet;
+    ASSERT_TRUE(packet.generate_token(TOKEN_MAX_LENGTH, true));
+    EXPECT_EQ(packet.token_length(), TOKEN_MAX_LENGTH);
+}
+
+TEST(testRandom, messageIdGenerator)
+{
+    MessageIdGenerator generator(0xFFFE);
+    EXPECT_EQ(generator.next(), 0xFFFE);
+    EXPECT_EQ(generator.next(), 0xFFFF);
+    EXPECT_EQ(generator.next(), 0x0000);
+    EXPECT_EQ(generator.peek(), 0x0001);
+}
+
+TEST(testRandom, messageIdGeneratorThreads)
+{
+    const size_t THREADS = 4;
+    const size_t IDS = 8000; // per thread, the total stays below 2**16
+    MessageIdGenerator generator;
+    vector<vector<uint16_t>> ids(THREADS);
+    vector<thread> threads;
+
+    for (size_t t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([&generator, &ids, t]() {
+            ids[t].reserve(IDS);
+            for (size_t i = 0; i < IDS; ++i)
+                ids[t].push_back(generator.next());
+        });
+    }
+    for (thread &th : threads)
+        th.join();
+
+    set<uint16_t> unique;
+    for (const vector<uint16_t> &v : ids)
+        unique.insert(v.begin(), v.end());
+    EXPECT_EQ(unique.size(), THREADS * IDS);
+}
@@ -0,0 +1,111 @@
+#include "unix_reactor.h"
+#include "error.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+using namespace Unix;
+
+TEST(testReactor, timers)
+{
+    error_code ec;
+    Reactor reactor(ec);
+    ASSERT_TRUE(!ec.value());
+
+    vector<int> fired;
+    reactor.schedule(milliseconds(20), [&]{ fired.push_back(2); });
+    reactor.schedule(milliseconds(5), [&]{ fired.push_back(1); });
+    Reactor::TimerId cancelled = reactor.schedule(milliseconds(10), [&]{ fired.push_back(3); });
+    EXPECT_EQ(reactor.timers(), 3U);
+
+    EXPECT_TRUE(reactor.cancel(cancelled));
+    EXPECT_FALSE(reactor.cancel(cancelled));
+
+    const Reactor::Clock::time_point start = Reactor::Clock::now();
+    while (fired.size() < 2)
+    {
+        reactor.run_once(milliseconds(-1), ec);
+        ASSERT_TRUE(!ec.value());
+    }
+    EXPECT_GE(Reactor::Clock::now() - start, milliseconds(20));
+    EXPECT_EQ(fired, (vector<int>{1, 2}));
+    EXPECT_EQ(reactor.timers(), 0U);
+
+    // nothing left, so the wait is bounded by the timeout only
+    EXPECT_EQ(reactor.run_once(milliseconds(0), ec), 0U);
+}
+
+TEST(testReactor, descriptors)
+{
+    error_code ec;
+    Reactor reactor(ec);
+    ASSERT_TRUE(!ec.value());
+
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+
+    size_t readable = 0;
+    reactor.add(fds[0], Reactor::READABLE, [&](uint32_t events)
+        {
+            EXPECT_TRUE(events & Reactor::READABLE);
+            char byte;
+            EXPECT_EQ(::read(fds[0], &byte, 1), 1);
+            ++readable;
+        }, ec);
+    ASSERT_TRUE(!ec.value());
+    EXPECT_EQ(reactor.watches(), 1U);
+
+    reactor.add(fds[0], Reactor::READABLE, [](uint32_t){}, ec);
+    EXPECT_EQ(ec, make_system_error(EEXIST));
+    ec.clear();
+
+    EXPECT_EQ(reactor.run_once(milliseconds(0), ec), 0U);
+    ASSERT_EQ(::write(fds[1], "x", 1), 1);
+    EXPECT_EQ(reactor.run_once(milliseconds(1000), ec), 1U);
+    EXPECT_EQ(readable, 1U);
+
+    reactor.remove(fds[0], ec);
+    ASSERT_TRUE(!ec.value());
+    ASSERT_EQ(::write(fds[1], "x", 1), 1);
+    EXPECT_EQ(reactor.run_once(milliseconds(10), ec), 0U);
+    EXPECT_EQ(readable, 1U);
+
+    reactor.remove(fds[0], ec);
+    EXPECT_EQ(ec, make_system_error(ENOENT));
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST(testReactor, postAndStop)
+{
+    error_code ec;
+    Reactor reactor(ec);
+    ASSERT_TRUE(!ec.value());
+
+    thread::id handlerThread;
+    thread poster([&]
+        {
+            this_thread::sleep_for(milliseconds(10));
+            reactor.post([&]
+                {
+                    handlerThread = this_thread::get_id();
+                    reactor.stop();
+                });
+        });
+
+    // blocks without a timeout, only post() can wake it up
+    reactor.run(ec);
+    poster.join();
+    ASSERT_TRUE(!ec.value());
+    EXPECT_TRUE(reactor.stopped());
+    EXPECT_EQ(handlerThread, this_thread::get_id());
+
+    reactor.restart();
+    EXPECT_FALSE(reactor.stopped());
+}
@@ -0,0 +1,214 @@
+#include "request_table.h"
+#include "error.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+using namespace coap;
+
+typedef TimerWheel::Clock Clock;
+
+static BufferPool::Handle request(BufferPool &pool)
+{
+    BufferPool::Handle buffer = pool.acquire(BufferPool::SMALL_BUFFER);
+    if (buffer)
+        buffer->offset(PACKET_HEADER_SIZE + TOKEN_MAX_LENGTH);
+    return buffer;
+}
+
+// a piggybacked 2.05 Content with the token
+struct Response
+{
+    explicit Response(const TokenType &token, size_t tokenLength = TOKEN_MAX_LENGTH)
+        : bytes{}
+    {
+        bytes.push_back(static_cast<uint8_t>((COAP_VERSION << 6) | (ACKNOWLEDGEMENT << 4) | tokenLength));
+        bytes.push_back(CONTENT);
+        bytes.push_back(0x12);
+        bytes.push_back(0x34);
+        bytes.insert(bytes.end(), token.begin(), token.begin() + tokenLength);
+    }
+
+    PacketView view() const
+    {
+        error_code ec;
+        PacketView packet(bytes.data(), bytes.size(), ec);
+        EXPECT_FALSE(ec.value());
+        return packet;
+    }
+
+    vector<uint8_t> bytes;
+};
+
+TEST(testRequestTable, match)
+{
+    const Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(10), start);
+    BufferPool pool(16, 0, 0);
+    vector<TokenType> sent;
+    vector<TokenType> answered;
+
+    RequestTable table(wheel, 16, [&](const TokenType &token, BufferPool::Handle){ sent.push_back(token); }, 16);
+
+    vector<TokenType> tokens;
+    error_code ec;
+    for (int i = 0; i < 4; ++i)
+    {
+        tokens.push_back(table.make_token());
+        table.submit(tokens.back(), request(pool), [&answered, i, &tokens](const error_code &rec, const PacketView *response)
+            {
+                EXPECT_FALSE(rec.value());
+                ASSERT_NE(response, nullptr);
+                EXPECT_EQ(response->code_as_byte(), CONTENT);
+                answered.push_back(tokens[i]);
+            }, ec);
+        ASSERT_FALSE(ec.value());
+    }
+    EXPECT_EQ(sent, tokens); // all of them in flight at once
+    EXPECT_EQ(table.outstanding(), 4U);
+
+    table.submit(tokens[0], request(pool), nullptr, ec);
+    EXPECT_EQ(ec, make_system_error(EEXIST));
+    ec.clear();
+
+    // the responses come in any order
+    EXPECT_TRUE(table.complete(Response(tokens[2]).view()));
+    EXPECT_TRUE(table.complete(Response(tokens[0]).view()));
+    EXPECT_FALSE(table.complete(Response(tokens[0]).view())); // a duplicate
+    EXPECT_FALSE(table.complete(Response(tokens[1], 4).view())); // a shorter token
+    EXPECT_EQ(answered, (vector<TokenType>{tokens[2], tokens[0]}));
+    EXPECT_EQ(table.size(), 2U);
+    EXPECT_EQ(table.statistics().completed, 2U);
+    EXPECT_EQ(table.statistics().unmatched, 2U);
+    EXPECT_EQ(pool.statistics(BufferPool::SMALL_BUFFER).inUse, 0U); // the sender has dropped the messages
+
+    // the cancelled requests are forgotten without their handlers
+    EXPECT_TRUE(table.cancel(tokens[1]));
+    EXPECT_FALSE(table.cancel(tokens[1]));
+    EXPECT_TRUE(table.cancel(tokens[3]));
+    EXPECT_EQ(table.size(), 0U);
+}
+
+TEST(testRequestTable, nstart)
+{
+    const Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(10), start);
+    BufferPool pool(16, 0, 0);
+    vector<TokenType> sent;
+
+    RequestTable table(wheel, 8, [&](const TokenType &token, BufferPool::Handle){ sent.push_back(token); }, 2);
+    EXPECT_EQ(table.nstart(), 2U);
+
+    vector<TokenType> tokens;
+    error_code ec;
+    for (int i = 0; i < 5; ++i)
+    {
+        tokens.push_back(table.make_token());
+        table.submit(tokens.back(), request(pool), nullptr, ec);
+        ASSERT_FALSE(ec.value());
+    }
+    EXPECT_EQ(sent.size(), 2U);
+    EXPECT_EQ(table.outstanding(), 2U);
+    EXPECT_EQ(table.waiting(), 3U);
+    EXPECT_EQ(table.statistics().waited, 3U);
+
+    // a waiting request is not sent, so its token does not match
+    EXPECT_FALSE(table.complete(Response(tokens[4]).view()));
+
+    // a response lets the next one go
+    EXPECT_TRUE(table.complete(Response(tokens[0]).view()));
+    EXPECT_EQ(sent, (vector<TokenType>{tokens[0], tokens[1], tokens[2]}));
+
+    // an empty ACK too, the released request still waits for its separate response
+    EXPECT_TRUE(table.release(tokens[1]));
+    EXPECT_FALSE(table.release(tokens[1]));
+    EXPECT_EQ(sent.size(), 4U);
+    EXPECT_EQ(table.outstanding(), 2U);
+
+    // a cancelled waiting request leaves the queue
+    EXPECT_TRUE(table.cancel(tokens[4]));
+    EXPECT_EQ(table.waiting(), 0U);
+
+    EXPECT_TRUE(table.complete(Response(tokens[1]).view()));
+    EXPECT_EQ(sent, (vector<TokenType>{tokens[0], tokens[1], tokens[2], tokens[3]}));
+    EXPECT_EQ(table.size(), 2U);
+}
+
+TEST(testRequestTable, failures)
+{
+    const Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(10), start);
+    BufferPool pool(16, 0, 0);
+    vector<error_code> errors;
+    auto handler = [&errors](const error_code &ec, const PacketView *response)
+        {
+            EXPECT_EQ(response, nullptr);
+            errors.push_back(ec);
+        };
+
+    {
+        RequestTable table(wheel, 3, [](const TokenType &, BufferPool::Handle){}, 1, seconds(1));
+        const TokenType first = table.make_token();
+        const TokenType second = table.make_token();
+        const TokenType third = table.make_token();
+
+        error_code ec;
+        table.submit(first, request(pool), handler, ec);
+        table.submit(second, request(pool), handler, ec);
+        table.submit(third, request(pool), handler, ec);
+        ASSERT_FALSE(ec.value());
+        table.submit(table.make_token(), request(pool), handler, ec);
+        EXPECT_EQ(ec, make_system_error(ENOBUFS));
+
+        // the retransmitter has given the first request up
+        EXPECT_TRUE(table.fail(first, make_error_code(CoapStatus::COAP_ERR_TIMEOUT)));
+        EXPECT_FALSE(table.fail(first, make_error_code(CoapStatus::COAP_ERR_TIMEOUT)));
+
+        // the second one has gone and no response comes during its lifetime
+        wheel.advance(start + milliseconds(1010));
+        EXPECT_EQ(table.statistics().failed, 2U);
+        EXPECT_EQ(table.size(), 1U);
+        EXPECT_EQ(table.outstanding(), 1U);
+    }
+
+    ASSERT_EQ(errors.size(), 3U);
+    EXPECT_EQ(errors[0], make_error_code(CoapStatus::COAP_ERR_TIMEOUT));
+    EXPECT_EQ(errors[1], make_error_code(CoapStatus::COAP_ERR_TIMEOUT));
+    EXPECT_EQ(errors[2], make_system_error(ECANCELED)); // the table has gone with it
+    EXPECT_EQ(wheel.size(), 0U);
+}
+
+TEST(testRequestTable, manyRequests)
+{
+    const size_t count = 100000;
+    const Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(100), start);
+    BufferPool pool(1, 0, 0);
+    const BufferPool::Handle message = request(pool);
+    size_t sent = 0;
+    size_t answered = 0;
+
+    RequestTable table(wheel, count, [&sent](const TokenType &, BufferPool::Handle){ ++sent; }, 256);
+
+    vector<TokenType> tokens;
+    error_code ec;
+    for (size_t i = 0; i < count; ++i)
+    {
+        tokens.push_back(table.make_token());
+        table.submit(tokens.back(), message, [&answered](const error_code &, const PacketView *){ ++answered; }, ec);
+        ASSERT_FALSE(ec.value());
+    }
+    EXPECT_EQ(sent, 256U);
+
+    // every response lets one more request go until all of them are answered
+    for (size_t i = 0; i < count; ++i)
+        ASSERT_TRUE(table.complete(Response(tokens[i]).view())) << i;
+
+    EXPECT_EQ(sent, count);
+    EXPECT_EQ(answered, count);
+    EXPECT_EQ(table.size(), 0U);
+    EXPECT_EQ(wheel.size(), 0U);
+}
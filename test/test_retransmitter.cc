@@ -0,0 +1,235 @@
+#include "retransmitter.h"
+#include "consts.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+using namespace coap;
+
+typedef TimerWheel::Clock Clock;
+
+static PeerKey peer_key(uint32_t address, uint16_t port = 5683)
+{
+    return PeerKey(SOCKET_TYPE_IP_V4, &address, sizeof(address), port);
+}
+
+// an empty message of the type, enough for the retransmitter
+static BufferPool::Handle message(BufferPool &pool, MessageType type, uint16_t messageId)
+{
+    BufferPool::Handle buffer = pool.acquire(BufferPool::SMALL_BUFFER);
+    if (buffer)
+    {
+        const uint8_t header[PACKET_HEADER_SIZE] = {
+            static_cast<uint8_t>((COAP_VERSION << 6) | (type << 4)),
+            EMPTY,
+            static_cast<uint8_t>(messageId >> 8),
+            static_cast<uint8_t>(messageId)
+        };
+        memcpy(buffer->data(), header, sizeof(header));
+        buffer->offset(sizeof(header));
+    }
+    return buffer;
+}
+
+TEST(testRetransmitter, initialTimeout)
+{
+    const milliseconds longest(ACK_TIMEOUT * ACK_RANDOM_FACTOR_PERCENT / 100);
+    for (int i = 0; i < 1000; ++i)
+    {
+        const milliseconds timeout = Retransmitter::initial_timeout();
+        ASSERT_GE(timeout, milliseconds(ACK_TIMEOUT));
+        ASSERT_LE(timeout, longest);
+    }
+}
+
+TEST(testRetransmitter, backoff)
+{
+    const Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(10), start);
+    BufferPool pool(4, 0, 0);
+    Clock::time_point now = start;
+    vector<milliseconds> sent;
+    vector<Retransmitter::Outcome> outcomes;
+    milliseconds completedAt(0);
+
+    Retransmitter retransmitter(wheel, 4,
+        [&](const PeerKey &, const uint8_t *data, size_t length)
+        {
+            EXPECT_EQ(length, PACKET_HEADER_SIZE);
+            EXPECT_EQ(data[MESSAGE_ID_OFFSET + 1], 0x34);
+            sent.push_back(duration_cast<milliseconds>(now - start));
+        });
+
+    error_code ec;
+    retransmitter.send(peer_key(1), message(pool, CONFIRMABLE, 0x1234),
+        [&](Retransmitter::Outcome outcome)
+        {
+            outcomes.push_back(outcome);
+            completedAt = duration_cast<milliseconds>(now - start);
+        }, ec);
+    ASSERT_FALSE(ec.value());
+    EXPECT_TRUE(retransmitter.outstanding(peer_key(1), 0x1234));
+
+    for (now = start; now < start + seconds(MAX_TRANSMIT_WAIT / 1000 + 1); now += milliseconds(10))
+        wheel.advance(now);
+
+    // the first transmission and MAX_RETRANSMIT retransmissions, each timeout twice the previous one
+    ASSERT_EQ(sent.size(), MAX_RETRANSMIT + 1U);
+    const milliseconds first = sent[1] - sent[0];
+    EXPECT_GE(first, milliseconds(ACK_TIMEOUT));
+    EXPECT_LE(first, milliseconds(MAX_TRANSMIT_SPAN / ((1 << MAX_RETRANSMIT) - 1) + 10));
+    // the measured timeouts are rounded up to the ticks, the error doubles with them
+    for (size_t i = 2; i < sent.size(); ++i)
+        EXPECT_NEAR((sent[i] - sent[i - 1]).count(), first.count() << (i - 1), 10 << (i - 1)) << i;
+
+    // the exchange times out after the last timeout has gone
+    ASSERT_EQ(outcomes, vector<Retransmitter::Outcome>{Retransmitter::TIMED_OUT});
+    EXPECT_NEAR((completedAt - sent.back()).count(), first.count() << MAX_RETRANSMIT, 10 << MAX_RETRANSMIT);
+    EXPECT_LE(completedAt, milliseconds(MAX_TRANSMIT_WAIT + 10 * (MAX_RETRANSMIT + 1)));
+
+    EXPECT_EQ(retransmitter.size(), 0U);
+    EXPECT_EQ(retransmitter.statistics().transmitted, 1U);
+    EXPECT_EQ(retransmitter.statistics().retransmitted, MAX_RETRANSMIT);
+    EXPECT_EQ(retransmitter.statistics().timedOut, 1U);
+    EXPECT_EQ(pool.statistics(BufferPool::SMALL_BUFFER).inUse, 0U); // the message has gone back
+}
+
+TEST(testRetransmitter, acknowledge)
+{
+    const Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(10), start);
+    BufferPool pool(4, 0, 0);
+    size_t transmissions = 0;
+    vector<Retransmitter::Outcome> outcomes;
+
+    Retransmitter retransmitter(wheel, 4,
+        [&](const PeerKey &, const uint8_t *, size_t){ ++transmissions; });
+    auto completion = [&](Retransmitter::Outcome outcome){ outcomes.push_back(outcome); };
+
+    error_code ec;
+    // the same message ID from two peers is two exchanges
+    retransmitter.send(peer_key(1), message(pool, CONFIRMABLE, 7), completion, ec);
+    ASSERT_FALSE(ec.value());
+    retransmitter.send(peer_key(2), message(pool, CONFIRMABLE, 7), completion, ec);
+    ASSERT_FALSE(ec.value());
+    retransmitter.send(peer_key(1), message(pool, CONFIRMABLE, 7), completion, ec);
+    EXPECT_EQ(ec, make_system_error(EEXIST));
+    ec.clear();
+    EXPECT_EQ(retransmitter.size(), 2U);
+
+    EXPECT_FALSE(retransmitter.acknowledge(peer_key(1), 8));
+    EXPECT_FALSE(retransmitter.acknowledge(peer_key(1, 5684), 7));
+    EXPECT_TRUE(retransmitter.acknowledge(peer_key(1), 7));
+    EXPECT_FALSE(retransmitter.acknowledge(peer_key(1), 7)); // a duplicated ACK
+    EXPECT_TRUE(retransmitter.reject(peer_key(2), 7));
+    EXPECT_EQ(outcomes, (vector<Retransmitter::Outcome>{Retransmitter::ACKNOWLEDGED, Retransmitter::REJECTED}));
+
+    wheel.advance(start + seconds(100));
+    EXPECT_EQ(transmissions, 2U); // nothing is retransmitted after the answers
+    EXPECT_EQ(retransmitter.size(), 0U);
+    EXPECT_EQ(pool.statistics(BufferPool::SMALL_BUFFER).inUse, 0U);
+}
+
+TEST(testRetransmitter, limits)
+{
+    const Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(10), start);
+    BufferPool pool(4, 0, 0);
+    size_t completions = 0;
+
+    Retransmitter retransmitter(wheel, 2, [](const PeerKey &, const uint8_t *, size_t){});
+    auto completion = [&](Retransmitter::Outcome){ ++completions; };
+
+    error_code ec;
+    retransmitter.send(peer_key(1), message(pool, NON_CONFIRMABLE, 1), completion, ec);
+    EXPECT_EQ(ec, make_system_error(EINVAL));
+    ec.clear();
+    retransmitter.send(peer_key(1), BufferPool::Handle(), completion, ec);
+    EXPECT_EQ(ec, make_system_error(EINVAL));
+    ec.clear();
+
+    retransmitter.send(peer_key(1), message(pool, CONFIRMABLE, 1), completion, ec);
+    retransmitter.send(peer_key(1), message(pool, CONFIRMABLE, 2), completion, ec);
+    ASSERT_FALSE(ec.value());
+    retransmitter.send(peer_key(1), message(pool, CONFIRMABLE, 3), completion, ec);
+    EXPECT_EQ(ec, make_system_error(ENOBUFS));
+    ec.clear();
+
+    // a cancelled exchange frees its slot silently
+    EXPECT_TRUE(retransmitter.cancel(peer_key(1), 1));
+    EXPECT_FALSE(retransmitter.cancel(peer_key(1), 1));
+    retransmitter.send(peer_key(1), message(pool, CONFIRMABLE, 3), completion, ec);
+    EXPECT_FALSE(ec.value());
+    EXPECT_EQ(completions, 0U);
+    EXPECT_EQ(wheel.size(), 2U);
+}
+
+TEST(testRetransmitter, completionSendsNext)
+{
+    const Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(10), start);
+    BufferPool pool(4, 0, 0);
+    vector<uint16_t> sent;
+
+    Retransmitter retransmitter(wheel, 1,
+        [&](const PeerKey &, const uint8_t *data, size_t)
+        { sent.push_back(static_cast<uint16_t>((data[MESSAGE_ID_OFFSET] << 8) | data[MESSAGE_ID_OFFSET + 1])); });
+
+    error_code ec;
+    retransmitter.send(peer_key(1), message(pool, CONFIRMABLE, 1),
+        [&](Retransmitter::Outcome)
+        {
+            error_code nextEc;
+            // the only slot is already free
+            retransmitter.send(peer_key(1), message(pool, CONFIRMABLE, 2), nullptr, nextEc);
+            EXPECT_FALSE(nextEc.value());
+        }, ec);
+    ASSERT_FALSE(ec.value());
+
+    EXPECT_TRUE(retransmitter.acknowledge(peer_key(1), 1));
+    EXPECT_EQ(sent, (vector<uint16_t>{1, 2}));
+    EXPECT_TRUE(retransmitter.outstanding(peer_key(1), 2));
+}
+
+TEST(testRetransmitter, manyExchanges)
+{
+    const uint32_t count = 100000;
+    const Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(100), start);
+    BufferPool pool(1, 0, 0);
+    size_t transmissions = 0;
+    size_t timedOut = 0;
+
+    Retransmitter retransmitter(wheel, count, [&](const PeerKey &, const uint8_t *, size_t){ ++transmissions; });
+
+    // one message shared by all the peers, the handles are refcounted
+    const BufferPool::Handle shared = message(pool, CONFIRMABLE, 42);
+    error_code ec;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        retransmitter.send(peer_key(i), shared, [&timedOut](Retransmitter::Outcome outcome)
+            {
+                if (outcome == Retransmitter::TIMED_OUT)
+                    ++timedOut;
+            }, ec);
+        ASSERT_FALSE(ec.value());
+    }
+    EXPECT_EQ(retransmitter.size(), count);
+    EXPECT_EQ(wheel.size(), count);
+
+    for (uint32_t i = 0; i < count; i += 2)
+        ASSERT_TRUE(retransmitter.acknowledge(peer_key(i), 42));
+
+    // the unanswered half goes through all the retransmissions, every one of them may be late by a tick
+    for (Clock::time_point now = start; now < start + seconds(MAX_TRANSMIT_WAIT / 1000 + 5); now += seconds(1))
+        wheel.advance(now);
+
+    EXPECT_EQ(transmissions, count + count / 2 * MAX_RETRANSMIT);
+    EXPECT_EQ(timedOut, count / 2);
+    EXPECT_EQ(retransmitter.size(), 0U);
+    EXPECT_EQ(wheel.size(), 0U);
+    EXPECT_EQ(shared.use_count(), 1U);
+}
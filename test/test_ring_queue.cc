@@ -0,0 +1,125 @@
+#include "unix_ring_queue.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace Unix;
+
+TEST(testRingQueue, spscOrder)
+{
+    SpscRing<unique_ptr<int>> ring(3);
+    EXPECT_EQ(ring.capacity(), 4U);
+    EXPECT_TRUE(ring.empty());
+
+    for (int i = 0; i < 4; ++i)
+        EXPECT_TRUE(ring.push(unique_ptr<int>(new int(i))));
+
+    unique_ptr<int> rejected(new int(4));
+    EXPECT_FALSE(ring.push(move(rejected)));
+    ASSERT_TRUE(rejected != nullptr); // left untouched when full
+    EXPECT_EQ(ring.size(), 4U);
+
+    unique_ptr<int> value;
+    for (int i = 0; i < 4; ++i)
+    {
+        ASSERT_TRUE(ring.pop(value));
+        EXPECT_EQ(*value, i);
+    }
+    EXPECT_FALSE(ring.pop(value));
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(testRingQueue, spscThreads)
+{
+    const size_t count = 100000;
+    SpscRing<size_t> ring(64);
+
+    thread producer([&]
+        {
+            for (size_t i = 1; i <= count; ++i)
+            {
+                size_t value = i;
+                while (!ring.push(move(value)))
+                    this_thread::yield();
+            }
+        });
+
+    size_t expected = 1;
+    size_t value;
+    while (expected <= count && ring.wait_pop(value, chrono::milliseconds(5000)))
+    {
+        ASSERT_EQ(value, expected);
+        ++expected;
+    }
+    producer.join();
+    EXPECT_EQ(expected, count + 1);
+}
+
+TEST(testRingQueue, mpscThreads)
+{
+    const size_t producers = 4;
+    const size_t perProducer = 20000;
+    MpscRing<size_t> ring(128);
+
+    vector<thread> threads;
+    for (size_t p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&ring, p]
+            {
+                for (size_t i = 0; i < perProducer; ++i)
+                {
+                    size_t value = p * perProducer + i;
+                    while (!ring.push(move(value)))
+                        this_thread::yield();
+                }
+            });
+    }
+
+    vector<size_t> last(producers, 0);
+    vector<size_t> received(producers, 0);
+    size_t value;
+    for (size_t total = 0; total < producers * perProducer; ++total)
+    {
+        ASSERT_TRUE(ring.wait_pop(value, chrono::milliseconds(5000)));
+        const size_t p = value / perProducer;
+        const size_t i = value % perProducer;
+        if (received[p])
+        {
+            EXPECT_GT(i, last[p]); // the order of one producer is kept
+        }
+        last[p] = i;
+        ++received[p];
+    }
+    for (auto &t : threads)
+        t.join();
+    for (size_t p = 0; p < producers; ++p)
+        EXPECT_EQ(received[p], perProducer);
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(testRingQueue, waitAndClose)
+{
+    MpscRing<unique_ptr<int>> ring(8);
+    unique_ptr<int> value;
+
+    EXPECT_FALSE(ring.wait_pop(value, chrono::milliseconds(10)));
+
+    thread closer([&]
+        {
+            this_thread::sleep_for(chrono::milliseconds(20));
+            ring.push(unique_ptr<int>(new int(7)));
+            ring.close();
+        });
+
+    // sleeps until the push, then the close wakes the second wait up
+    ASSERT_TRUE(ring.wait_pop(value));
+    EXPECT_EQ(*value, 7);
+    EXPECT_FALSE(ring.wait_pop(value));
+    closer.join();
+
+    EXPECT_TRUE(ring.closed());
+    EXPECT_FALSE(ring.push(unique_ptr<int>(new int(8))));
+}
@@ -0,0 +1,211 @@
+#include "unix_sharded_server.h"
+#include "unix_socket.h"
+#include "unix_uring_socket.h"
+#include "error.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <map>
+#include <set>
+#include <thread>
+#include <arpa/inet.h>
+
+using namespace std;
+using namespace Unix;
+
+TEST(testShardedServer, bindAndReceive)
+{
+    error_code ec;
+    const size_t shards = 4;
+    const size_t peers = 8;
+    const size_t datagramsPerPeer = 16;
+
+    ShardedUdpServer server(0, true, shards, false);
+    EXPECT_EQ(server.shards(), shards);
+
+    server.start([](UdpServerShard &, size_t){}, ec);
+    EXPECT_EQ(ec, make_error_code(CoapStatus::COAP_ERR_SOCKET_NOT_BOUND));
+    ec.clear();
+
+    server.bind(ec);
+    ASSERT_TRUE(!ec.value());
+    ASSERT_NE(server.port(), 0);
+
+    mutex lock;
+    map<uint16_t, set<size_t>> shardsOfPeer; // source port -> shards which received its datagrams
+    atomic<size_t> received{0};
+
+    server.start([&](UdpServerShard &shard, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                const UnixSocketAddress * source = static_cast<const UnixSocketAddress *>(shard.datagrams()[i].address);
+                EXPECT_EQ(shard.buffer(i)->offset(), shard.datagrams()[i].length);
+                EXPECT_EQ(memcmp(shard.buffer(i)->data(), "ping", 4), 0);
+
+                lock_guard<mutex> lg(lock);
+                shardsOfPeer[ntohs(source->address4().sin_port)].insert(shard.index());
+            }
+            received += count;
+        }, ec);
+    ASSERT_TRUE(!ec.value());
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(server.port()));
+    UnixSocketAddress dest(addr);
+
+    vector<unique_ptr<UnixSocket>> clients;
+    for (size_t p = 0; p < peers; ++p)
+    {
+        clients.emplace_back(new UnixSocket(AF_INET, SOCK_DGRAM, 0, ec));
+        ASSERT_TRUE(!ec.value());
+        for (size_t i = 0; i < datagramsPerPeer; ++i)
+        {
+            clients.back()->sendto("ping", 4, &dest, ec);
+            ASSERT_TRUE(!ec.value());
+        }
+    }
+
+    const auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+    while (received < peers * datagramsPerPeer && chrono::steady_clock::now() < deadline)
+        this_thread::sleep_for(chrono::milliseconds(1));
+
+    server.stop();
+    server.join();
+
+    EXPECT_EQ(received, peers * datagramsPerPeer);
+    EXPECT_EQ(shardsOfPeer.size(), peers);
+    for (const auto &peer : shardsOfPeer)
+    {
+        EXPECT_EQ(peer.second.size(), 1U); // one peer is always served by the same shard
+    }
+}
+
+TEST(testShardedServer, dropWithoutBuffers)
+{
+    error_code ec;
+    UdpServerShard shard(0, 0, true, ec);
+    ASSERT_TRUE(!ec.value());
+    shard.connection().bind(ec);
+    ASSERT_TRUE(!ec.value());
+
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    ASSERT_EQ(getsockname(shard.descriptor(), reinterpret_cast<struct sockaddr *>(&addr), &addrLen), 0);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    UnixSocketAddress dest(addr);
+    UnixSocket client(AF_INET, SOCK_DGRAM, 0, ec);
+    ASSERT_TRUE(!ec.value());
+
+    // the handler holds all the buffers of the shard
+    vector<BufferPool::Handle> held;
+    for (;;)
+    {
+        BufferPool::Handle handle = shard.pool().acquire(shard.connection().bufferPtr()->length());
+        if (!handle)
+            break;
+        held.push_back(move(handle));
+    }
+    const size_t capacity = UdpServerShard::POOL_CAPACITY;
+    EXPECT_EQ(held.size(), capacity);
+
+    for (size_t i = 0; i < 3; ++i)
+        client.sendto("ping", 4, &dest, ec);
+    ASSERT_TRUE(!ec.value());
+    this_thread::sleep_for(chrono::milliseconds(10));
+
+    // the datagrams are dropped, nothing is left to make the socket readable again
+    EXPECT_EQ(shard.receive(ec), 0u);
+    EXPECT_FALSE(ec.value());
+    EXPECT_EQ(shard.dropped(), 3u);
+    char byte;
+    EXPECT_LT(recv(shard.descriptor(), &byte, 1, MSG_DONTWAIT), 0);
+    EXPECT_EQ(errno, EAGAIN);
+
+    held.clear();
+    client.sendto("ping", 4, &dest, ec);
+    ASSERT_TRUE(!ec.value());
+    ASSERT_EQ(shard.receive(ec), 1u);
+    EXPECT_FALSE(ec.value());
+    EXPECT_EQ(memcmp(shard.buffer(0)->data(), "ping", 4), 0);
+    EXPECT_EQ(shard.dropped(), 3u);
+}
+
+#ifdef __linux__
+TEST(testShardedServer, uringBackend)
+{
+    if (!UringSocket::supported())
+        GTEST_SKIP() << "io_uring is not supported";
+
+    error_code ec;
+    const size_t peers = 4;
+    const size_t datagramsPerPeer = 8;
+
+    ShardedUdpServer server(0, true, 2, false, SocketBackend::URING);
+    EXPECT_EQ(server.backend(), SocketBackend::URING);
+    server.bind(ec);
+    ASSERT_TRUE(!ec.value());
+    EXPECT_NE(server.shard(0).event_descriptor(), server.shard(0).descriptor());
+
+    // the multishot receive takes the datagrams out of the socket, only the ring gets readable
+    atomic<size_t> received{0};
+    server.start([&](UdpServerShard &, size_t count){ received += count; }, ec);
+    ASSERT_TRUE(!ec.value());
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(server.port()));
+    UnixSocketAddress dest(addr);
+
+    vector<unique_ptr<UnixSocket>> clients;
+    for (size_t p = 0; p < peers; ++p)
+    {
+        clients.emplace_back(new UnixSocket(AF_INET, SOCK_DGRAM, 0, ec));
+        ASSERT_TRUE(!ec.value());
+        for (size_t i = 0; i < datagramsPerPeer; ++i)
+        {
+            clients.back()->sendto("ping", 4, &dest, ec);
+            ASSERT_TRUE(!ec.value());
+        }
+    }
+
+    const auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+    while (received < peers * datagramsPerPeer && chrono::steady_clock::now() < deadline)
+        this_thread::sleep_for(chrono::milliseconds(1));
+
+    server.stop();
+    server.join();
+
+    EXPECT_EQ(received, peers * datagramsPerPeer);
+}
+
+TEST(testShardedServer, pin)
+{
+    const unsigned cores = max(thread::hardware_concurrency(), 1U);
+    ShardedUdpServer pinned(0, true, 2, true);
+    ShardedUdpServer unpinned(0, true, 2, false);
+
+    cpu_set_t set;
+    thread([&]{
+        pinned.pin(1);
+        ASSERT_EQ(pthread_getaffinity_np(pthread_self(), sizeof(set), &set), 0);
+    }).join();
+    EXPECT_EQ(CPU_COUNT(&set), 1);
+    EXPECT_TRUE(CPU_ISSET(1 % cores, &set));
+
+    cpu_set_t before;
+    thread([&]{
+        ASSERT_EQ(pthread_getaffinity_np(pthread_self(), sizeof(before), &before), 0);
+        unpinned.pin(1);
+        ASSERT_EQ(pthread_getaffinity_np(pthread_self(), sizeof(set), &set), 0);
+    }).join();
+    EXPECT_TRUE(CPU_EQUAL(&set, &before));
+}
+#endif // __linux__
@@ -5,6 +5,9 @@
 #include <spdlog/fmt/fmt.h>
 #include <cstdint>
 #include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
 
 using namespace std;
 using namespace spdlog;
@@ -15,4 +18,372 @@ TEST(testSocket, socket)
     Socket * sock = new UnixSocket(AF_INET, SOCK_DGRAM, 0, ec);
     delete sock;
     ASSERT_TRUE(!ec.value());
-}
\ No newline at end of file
+}
+TEST(testSocket, sendmsg)
+{
+    error_code ec;
+    UnixSocket receiver(AF_INET, SOCK_DGRAM, 0, ec);
+    ASSERT_TRUE(!ec.value());
+    UnixSocket sender(AF_INET, SOCK_DGRAM, 0, ec);
+    ASSERT_TRUE(!ec.value());
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    UnixSocketAddress local(addr);
+    receiver.bind(&local, ec);
+    ASSERT_TRUE(!ec.value());
+
+    socklen_t addrLen = sizeof(addr);
+    ASSERT_EQ(getsockname(receiver.descriptor(), reinterpret_cast<struct sockaddr *>(&addr), &addrLen), 0);
+    UnixSocketAddress dest(addr);
+
+    const char header[] = "header";
+    const char payload[] = "payload";
+    const IoBuffer parts[] = {
+        { header, sizeof(header) - 1 },
+        { payload, sizeof(payload) - 1 }
+    };
+
+    ssize_t sent = sender.sendmsg(parts, 2, &dest, ec);
+    ASSERT_TRUE(!ec.value());
+    EXPECT_EQ(sent, 13);
+
+    char datagram[32];
+    ssize_t received = receiver.recvfrom(ec, datagram, sizeof(datagram));
+    ASSERT_TRUE(!ec.value());
+    ASSERT_EQ(received, 13);
+    EXPECT_EQ(memcmp(datagram, "headerpayload", 13), 0);
+
+    sender.sendmsg(parts, 0, &dest, ec);
+    EXPECT_EQ(ec, make_system_error(EINVAL));
+}
+
+TEST(testSocket, batch)
+{
+    error_code ec;
+    UnixSocket receiver(AF_INET, SOCK_DGRAM, 0, ec);
+    ASSERT_TRUE(!ec.value());
+    UnixSocket sender(AF_INET, SOCK_DGRAM, 0, ec);
+    ASSERT_TRUE(!ec.value());
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    UnixSocketAddress local(addr);
+    receiver.bind(&local, ec);
+    ASSERT_TRUE(!ec.value());
+
+    socklen_t addrLen = sizeof(addr);
+    ASSERT_EQ(getsockname(receiver.descriptor(), reinterpret_cast<struct sockaddr *>(&addr), &addrLen), 0);
+    UnixSocketAddress dest(addr);
+
+    const size_t count = 8;
+    char outgoing[count][16];
+    Datagram batch[count];
+    for (size_t i = 0; i < count; ++i)
+    {
+        batch[i].data = outgoing[i];
+        batch[i].length = snprintf(outgoing[i], sizeof(outgoing[i]), "datagram %zu", i);
+        batch[i].address = &dest;
+    }
+
+    ssize_t sent = sender.sendmmsg(batch, count, ec);
+    ASSERT_TRUE(!ec.value());
+    ASSERT_EQ(sent, (ssize_t)count);
+
+    char incoming[count][32];
+    UnixSocketAddress sources[count];
+    size_t received = 0;
+    while (received < count)
+    {
+        Datagram *next = batch + received;
+        for (size_t i = received; i < count; ++i)
+        {
+            batch[i].data = incoming[i];
+            batch[i].length = sizeof(incoming[i]);
+            batch[i].address = &sources[i];
+        }
+        ssize_t result = receiver.recvmmsg(next, count - received, ec);
+        ASSERT_TRUE(!ec.value());
+        ASSERT_GT(result, 0);
+        received += result;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(batch[i].length, strlen(outgoing[i]));
+        EXPECT_EQ(memcmp(incoming[i], outgoing[i], batch[i].length), 0);
+        EXPECT_EQ(sources[i].type(), SOCKET_TYPE_IP_V4);
+        EXPECT_EQ(sources[i].address4().sin_addr.s_addr, htonl(INADDR_LOOPBACK));
+    }
+
+    receiver.recvmmsg(batch, 0, ec);
+    EXPECT_EQ(ec, make_system_error(EINVAL));
+    ec.clear();
+    receiver.recvmmsg(nullptr, 1, ec);
+    EXPECT_EQ(ec, make_system_error(EFAULT));
+}
+
+TEST(testSocket, timestamps)
+{
+    error_code ec;
+    UnixSocket receiver(AF_INET, SOCK_DGRAM, 0, ec);
+    UnixSocket sender(AF_INET, SOCK_DGRAM, 0, ec);
+    ASSERT_TRUE(!ec.value());
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    UnixSocketAddress local(addr);
+    receiver.bind(&local, ec);
+    ASSERT_TRUE(!ec.value());
+    socklen_t addrLen = sizeof(addr);
+    ASSERT_EQ(getsockname(receiver.descriptor(), reinterpret_cast<struct sockaddr *>(&addr), &addrLen), 0);
+    UnixSocketAddress dest(addr);
+
+    char buffer[32];
+    Datagram datagram = { buffer, sizeof(buffer), nullptr, 42 };
+
+    // not stamped unless asked for
+    sender.sendto("plain", 5, &dest, ec);
+    ASSERT_EQ(receiver.recvmmsg(&datagram, 1, ec), 1);
+    EXPECT_EQ(datagram.timestamp, 0u);
+    EXPECT_FALSE(receiver.receive_timestamps());
+
+    receiver.receive_timestamps(true, ec);
+#ifdef __linux__
+    ASSERT_TRUE(!ec.value());
+    EXPECT_TRUE(receiver.receive_timestamps());
+
+    const uint64_t before = UnixSocket::timestamp_now();
+    sender.sendto("stamped", 7, &dest, ec);
+    datagram.length = sizeof(buffer);
+    ASSERT_EQ(receiver.recvmmsg(&datagram, 1, ec), 1);
+    const uint64_t after = UnixSocket::timestamp_now();
+    EXPECT_EQ(string(buffer, datagram.length), "stamped");
+    EXPECT_GE(datagram.timestamp, before);
+    EXPECT_LE(datagram.timestamp, after);
+
+    receiver.receive_timestamps(false, ec);
+    ASSERT_TRUE(!ec.value());
+    sender.sendto("plain", 5, &dest, ec);
+    datagram.length = sizeof(buffer);
+    ASSERT_EQ(receiver.recvmmsg(&datagram, 1, ec), 1);
+    EXPECT_EQ(datagram.timestamp, 0u);
+#endif
+}
+
+#ifdef __linux__
+TEST(testSocket, truncated)
+{
+    error_code ec;
+    UnixSocket receiver(AF_INET, SOCK_DGRAM, 0, ec);
+    UnixSocket sender(AF_INET, SOCK_DGRAM, 0, ec);
+    ASSERT_TRUE(!ec.value());
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    UnixSocketAddress local(addr);
+    receiver.bind(&local, ec);
+    ASSERT_TRUE(!ec.value());
+    socklen_t addrLen = sizeof(addr);
+    ASSERT_EQ(getsockname(receiver.descriptor(), reinterpret_cast<struct sockaddr *>(&addr), &addrLen), 0);
+    UnixSocketAddress dest(addr);
+
+    char buffers[2][8];
+    Datagram batch[2] = {
+        { buffers[0], sizeof(buffers[0]), nullptr },
+        { buffers[1], sizeof(buffers[1]), nullptr }
+    };
+
+    sender.sendto("truncated", 9, &dest, ec);
+    sender.sendto("whole", 5, &dest, ec);
+    ASSERT_TRUE(!ec.value());
+
+    ssize_t received = 0;
+    while (received < 2)
+    {
+        const ssize_t count = receiver.recvmmsg(batch + received, 2 - received, ec);
+        ASSERT_TRUE(!ec.value());
+        received += count;
+    }
+    EXPECT_TRUE(batch[0].truncated);
+    EXPECT_EQ(string(buffers[0], batch[0].length), "truncate");
+    EXPECT_FALSE(batch[1].truncated);
+    EXPECT_EQ(string(buffers[1], batch[1].length), "whole");
+}
+#endif
+
+#ifdef __linux__
+static UnixSocketAddress bind_loopback(UnixSocket &socket, error_code &ec)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    UnixSocketAddress local(addr);
+    socket.bind(&local, ec);
+
+    socklen_t addrLen = sizeof(addr);
+    getsockname(socket.descriptor(), reinterpret_cast<struct sockaddr *>(&addr), &addrLen);
+    return UnixSocketAddress(addr);
+}
+
+TEST(testSocket, sendOffload)
+{
+    error_code ec;
+    UnixSocket sender(AF_INET, SOCK_DGRAM, 0, ec);
+    sender.send_offload(true, ec);
+    if (ec.value())
+        GTEST_SKIP() << "UDP_SEGMENT is not supported: " << ec.message();
+
+    UnixSocket first(AF_INET, SOCK_DGRAM, 0, ec);
+    UnixSocket second(AF_INET, SOCK_DGRAM, 0, ec);
+    const UnixSocketAddress firstAddress = bind_loopback(first, ec);
+    const UnixSocketAddress secondAddress = bind_loopback(second, ec);
+    UnixSocketAddress firstCopy(firstAddress.address4()); // another object of the same destination
+    ASSERT_TRUE(!ec.value());
+
+    // a run of blocks ended by a shorter one, another peer, then the first one again
+    struct Outgoing
+    {
+        size_t                  length;
+        const UnixSocketAddress *address;
+    };
+    const Outgoing outgoing[] = {
+        {100, &firstAddress}, {100, &firstAddress}, {100, &firstCopy}, {100, &firstAddress}, {40, &firstAddress},
+        {100, &firstAddress}, {100, &secondAddress}, {100, &secondAddress}, {200, &firstAddress}
+    };
+    const size_t count = sizeof(outgoing) / sizeof(outgoing[0]);
+
+    vector<string> payloads;
+    Datagram batch[count];
+    for (size_t i = 0; i < count; ++i)
+    {
+        payloads.push_back(string(outgoing[i].length, static_cast<char>('a' + i)));
+        batch[i] = Datagram{ &payloads[i][0], payloads[i].size(), const_cast<UnixSocketAddress *>(outgoing[i].address) };
+    }
+    ASSERT_EQ(sender.sendmmsg(batch, count, ec), static_cast<ssize_t>(count));
+    ASSERT_TRUE(!ec.value());
+    EXPECT_TRUE(sender.send_offload());
+
+    // the receivers get the datagrams one by one, in order
+    for (size_t i = 0; i < count; ++i)
+    {
+        UnixSocket &receiver = outgoing[i].address == &secondAddress ? second : first;
+        char buffer[256];
+        const ssize_t length = receiver.recvfrom(ec, buffer, sizeof(buffer));
+        ASSERT_TRUE(!ec.value());
+        EXPECT_EQ(string(buffer, static_cast<size_t>(length)), payloads[i]);
+    }
+}
+
+TEST(testSocket, sendOffloadFallback)
+{
+    error_code ec;
+    UnixSocket sender(AF_INET, SOCK_DGRAM, 0, ec);
+    sender.send_offload(true, ec);
+    if (ec.value())
+        GTEST_SKIP() << "UDP_SEGMENT is not supported: " << ec.message();
+
+    // the kernel refuses to segment without the checksums with EINVAL, as for a segment over the path MTU
+    const int on = 1;
+    sender.setsockoption(SOL_SOCKET, SO_NO_CHECK, &on, sizeof(on), ec);
+    ASSERT_TRUE(!ec.value());
+
+    UnixSocket receiver(AF_INET, SOCK_DGRAM, 0, ec);
+    const UnixSocketAddress destination = bind_loopback(receiver, ec);
+    ASSERT_TRUE(!ec.value());
+
+    const size_t count = 3;
+    vector<string> payloads;
+    Datagram batch[count];
+    for (size_t i = 0; i < count; ++i)
+    {
+        payloads.push_back(string(100, static_cast<char>('a' + i)));
+        batch[i] = Datagram{ &payloads[i][0], payloads[i].size(), const_cast<UnixSocketAddress *>(&destination) };
+    }
+    ASSERT_EQ(sender.sendmmsg(batch, count, ec), static_cast<ssize_t>(count));
+    ASSERT_TRUE(!ec.value());
+    EXPECT_TRUE(sender.send_offload()); // the next batch may go to another destination
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        char buffer[256];
+        const ssize_t length = receiver.recvfrom(ec, buffer, sizeof(buffer));
+        ASSERT_TRUE(!ec.value());
+        EXPECT_EQ(string(buffer, static_cast<size_t>(length)), payloads[i]);
+    }
+}
+
+TEST(testSocket, receiveOffload)
+{
+    error_code ec;
+    UnixSocket receiver(AF_INET, SOCK_DGRAM, 0, ec);
+    receiver.receive_offload(true, ec);
+    if (ec.value())
+        GTEST_SKIP() << "UDP_GRO is not supported: " << ec.message();
+    receiver.receive_timestamps(true, ec);
+    const UnixSocketAddress destination = bind_loopback(receiver, ec);
+    UnixSocket sender(AF_INET, SOCK_DGRAM, 0, ec);
+    const UnixSocketAddress source = bind_loopback(sender, ec);
+    sender.send_offload(true, ec);
+    ASSERT_TRUE(!ec.value());
+
+    // one segmented send arrives as one coalesced read
+    const size_t count = 10;
+    vector<string> payloads;
+    Datagram outgoing[count];
+    for (size_t i = 0; i < count; ++i)
+    {
+        payloads.push_back(string(i + 1 < count ? 64 : 10, static_cast<char>('a' + i)));
+        outgoing[i] = Datagram{ &payloads[i][0], payloads[i].size(), const_cast<UnixSocketAddress *>(&destination) };
+    }
+    ASSERT_EQ(sender.sendmmsg(outgoing, count, ec), static_cast<ssize_t>(count));
+
+    vector<string> received;
+    char buffers[4][128];
+    UnixSocketAddress sources[4];
+    Datagram incoming[4];
+    for (size_t i = 0; i < 4; ++i)
+        incoming[i] = Datagram{ buffers[i], sizeof(buffers[i]), &sources[i] };
+
+    ASSERT_EQ(receiver.recvmmsg(incoming, 4, ec), 4);
+    EXPECT_TRUE(receiver.receive_pending());
+    for (size_t i = 0; i < 4; ++i)
+    {
+        received.push_back(string(buffers[i], incoming[i].length));
+        EXPECT_EQ(sources[i].peer_key(), source.peer_key());
+        EXPECT_GT(incoming[i].timestamp, 0u);
+        EXPECT_EQ(incoming[i].timestamp, incoming[0].timestamp);
+    }
+
+    // the rest comes without a read, a single receive takes one segment too
+    char buffer[128];
+    const ssize_t length = receiver.recvfrom(ec, buffer, sizeof(buffer));
+    ASSERT_TRUE(!ec.value());
+    received.push_back(string(buffer, static_cast<size_t>(length)));
+    while (receiver.receive_pending())
+    {
+        for (size_t i = 0; i < 4; ++i)
+            incoming[i].length = sizeof(buffers[i]);
+        const ssize_t taken = receiver.recvmmsg(incoming, 4, ec);
+        ASSERT_GT(taken, 0);
+        for (ssize_t i = 0; i < taken; ++i)
+            received.push_back(string(buffers[i], incoming[i].length));
+    }
+    EXPECT_EQ(received, payloads);
+
+    receiver.receive_offload(false, ec);
+    EXPECT_TRUE(!ec.value());
+    EXPECT_FALSE(receiver.receive_offload());
+}
+#endif // __linux__
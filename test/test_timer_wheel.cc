@@ -0,0 +1,138 @@
+#include "timer_wheel.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+typedef TimerWheel::Clock Clock;
+
+TEST(testTimerWheel, fireInOrder)
+{
+    const Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(10), start);
+    vector<int> fired;
+
+    TimerWheel::Timer first([&]{ fired.push_back(1); });
+    TimerWheel::Timer second([&]{ fired.push_back(2); });
+    TimerWheel::Timer cancelled([&]{ fired.push_back(3); });
+
+    wheel.schedule(second, milliseconds(50));
+    wheel.schedule(first, milliseconds(20));
+    wheel.schedule(cancelled, milliseconds(30));
+    EXPECT_EQ(wheel.size(), 3U);
+    EXPECT_TRUE(first.armed());
+
+    EXPECT_TRUE(wheel.cancel(cancelled));
+    EXPECT_FALSE(wheel.cancel(cancelled));
+    EXPECT_FALSE(cancelled.armed());
+
+    EXPECT_EQ(wheel.advance(start + milliseconds(19)), 0U); // never early
+    EXPECT_EQ(wheel.advance(start + milliseconds(30)), 1U);
+    EXPECT_EQ(wheel.advance(start + milliseconds(100)), 1U);
+    EXPECT_EQ(fired, (vector<int>{1, 2}));
+    EXPECT_EQ(wheel.size(), 0U);
+    EXPECT_FALSE(first.armed());
+}
+
+TEST(testTimerWheel, cascade)
+{
+    const Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(1), start);
+
+    // every level of the wheel, the last delay is beyond its range and is cut down
+    const vector<uint64_t> delays = { 1, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 300000, 20000000 };
+    vector<unique_ptr<TimerWheel::Timer>> timers;
+    vector<uint64_t> firedAt(delays.size(), 0);
+    uint64_t now = 0;
+
+    for (size_t i = 0; i < delays.size(); ++i)
+    {
+        timers.emplace_back(new TimerWheel::Timer([&firedAt, &now, i]{ firedAt[i] = now; }));
+        wheel.schedule(*timers.back(), milliseconds(delays[i]));
+    }
+
+    // step through the interesting ticks only, the wheel processes the ones in between on its own
+    const uint64_t steps[] = { 0, 1, 62, 63, 64, 65, 4094, 4095, 4096, 4097, 262142, 262143, 262144, 299999, 300000, 16777214, 16777215, 20000000 };
+    for (uint64_t step : steps)
+    {
+        now = step;
+        wheel.advance(start + milliseconds(step));
+    }
+
+    const uint64_t cutDown = (static_cast<uint64_t>(1) << 24) - 1;
+    for (size_t i = 0; i < delays.size(); ++i)
+    {
+        const uint64_t expected = delays[i] > cutDown ? cutDown : delays[i];
+        EXPECT_EQ(firedAt[i], expected) << "delay " << delays[i];
+    }
+    EXPECT_EQ(wheel.size(), 0U);
+}
+
+TEST(testTimerWheel, rearmFromHandler)
+{
+    const Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(10), start);
+    size_t count = 0;
+
+    TimerWheel::Timer other;
+    TimerWheel::Timer periodic;
+    periodic.handler([&]
+        {
+            ++count;
+            wheel.cancel(other); // due at the same tick, cancelled before it fires
+            if (count < 5)
+                wheel.schedule(periodic, milliseconds(10));
+        });
+    other.handler([]{ FAIL() << "cancelled timer fired"; });
+
+    wheel.schedule(periodic, milliseconds(10));
+    wheel.schedule(other, milliseconds(10));
+
+    // one advance fires every due period
+    EXPECT_EQ(wheel.advance(start + milliseconds(1000)), 5U);
+    EXPECT_EQ(count, 5U);
+    EXPECT_EQ(wheel.size(), 0U);
+}
+
+TEST(testTimerWheel, destroy)
+{
+    const Clock::time_point start = Clock::now();
+    unique_ptr<TimerWheel::Timer> timer(new TimerWheel::Timer([]{ FAIL() << "destroyed timer fired"; }));
+    TimerWheel::Timer survivor;
+    {
+        TimerWheel wheel(milliseconds(10), start);
+
+        wheel.schedule(*timer, milliseconds(10));
+        timer.reset(); // a destroyed timer leaves the wheel
+        EXPECT_EQ(wheel.size(), 0U);
+        EXPECT_EQ(wheel.advance(start + milliseconds(100)), 0U);
+
+        wheel.schedule(survivor, seconds(10));
+    }
+    EXPECT_FALSE(survivor.armed()); // the destroyed wheel disarms its timers
+}
+
+TEST(testTimerWheel, manyTimers)
+{
+    const size_t count = 100000;
+    const Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(100), start);
+    vector<unique_ptr<TimerWheel::Timer>> timers;
+    size_t fired = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        timers.emplace_back(new TimerWheel::Timer([&fired]{ ++fired; }));
+        wheel.schedule(*timers.back(), milliseconds(100 * (1 + i % 600)));
+    }
+    // a half is cancelled, as the acknowledged exchanges are
+    for (size_t i = 0; i < count; i += 2)
+        wheel.cancel(*timers[i]);
+    EXPECT_EQ(wheel.size(), count / 2);
+
+    EXPECT_EQ(wheel.advance(start + seconds(61)), count / 2);
+    EXPECT_EQ(fired, count / 2);
+}
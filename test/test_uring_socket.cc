@@ -0,0 +1,267 @@
+#include "unix_uring_socket.h"
+#include "unix_reactor.h"
+#include "unix_udp_server.h"
+#include "error.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#ifdef __linux__
+using namespace std;
+using namespace std::chrono;
+using namespace Unix;
+
+static UnixSocketAddress bind_loopback(UnixSocket &socket, error_code &ec)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    UnixSocketAddress local(addr);
+    socket.bind(&local, ec);
+
+    socklen_t length = sizeof(addr);
+    getsockname(socket.descriptor(), reinterpret_cast<struct sockaddr *>(&addr), &length);
+    return UnixSocketAddress(addr);
+}
+
+static void send_all(UnixSocket &sender, const UnixSocketAddress &destination, const vector<string> &messages)
+{
+    error_code ec;
+    for (const string &message : messages)
+    {
+        sender.sendto(message.data(), message.size(), &destination, ec);
+        ASSERT_FALSE(ec.value());
+    }
+}
+
+static vector<string> numbered(const char *prefix, size_t count)
+{
+    vector<string> messages;
+    for (size_t i = 0; i < count; ++i)
+        messages.push_back(prefix + to_string(i));
+    return messages;
+}
+
+TEST(testUringSocket, receive)
+{
+    if (!UringSocket::supported())
+        GTEST_SKIP() << "io_uring is not supported";
+
+    error_code ec;
+    UringSocket receiver(AF_INET, SOCK_DGRAM, 0, ec);
+    ASSERT_FALSE(ec.value());
+    const UnixSocketAddress destination = bind_loopback(receiver, ec);
+    ASSERT_FALSE(ec.value());
+
+    UnixSocket sender(AF_INET, SOCK_DGRAM, 0, ec);
+    const UnixSocketAddress source = bind_loopback(sender, ec);
+    ASSERT_FALSE(ec.value());
+
+    // more than the provided buffers: the request ends without them and is armed again
+    const vector<string> messages = numbered("datagram ", 3 * UringSocket::BUFFER_COUNT);
+    send_all(sender, destination, messages);
+
+    vector<string> received;
+    vector<char> buffers(DATAGRAM_BATCH_MAX * 64);
+    vector<UnixSocketAddress> addresses(DATAGRAM_BATCH_MAX);
+    vector<Datagram> datagrams(DATAGRAM_BATCH_MAX);
+    while (received.size() < messages.size())
+    {
+        for (size_t i = 0; i < DATAGRAM_BATCH_MAX; ++i)
+            datagrams[i] = Datagram{ &buffers[i * 64], 64, &addresses[i] };
+
+        const ssize_t count = receiver.recvmmsg(datagrams.data(), DATAGRAM_BATCH_MAX, ec);
+        ASSERT_FALSE(ec.value());
+        ASSERT_GT(count, 0);
+        for (ssize_t i = 0; i < count; ++i)
+        {
+            received.push_back(string(static_cast<char *>(datagrams[i].data), datagrams[i].length));
+            EXPECT_EQ(addresses[i].peer_key(), source.peer_key());
+        }
+    }
+    EXPECT_EQ(received, messages);
+
+    // a short buffer truncates the datagram
+    send_all(sender, destination, {"truncated"});
+    char shortBuffer[5];
+    EXPECT_EQ(receiver.recvfrom(ec, shortBuffer, sizeof(shortBuffer)), 5);
+    EXPECT_EQ(string(shortBuffer, 5), "trunc");
+
+    // and recvmmsg() flags it
+    send_all(sender, destination, {"truncated"});
+    Datagram cut{ shortBuffer, sizeof(shortBuffer), nullptr };
+    ASSERT_EQ(receiver.recvmmsg(&cut, 1, ec), 1);
+    EXPECT_TRUE(cut.truncated);
+    EXPECT_EQ(string(shortBuffer, cut.length), "trunc");
+
+    receiver.set_blocking(false, ec);
+    ASSERT_FALSE(ec.value());
+    receiver.recvfrom(ec, shortBuffer, sizeof(shortBuffer));
+    EXPECT_EQ(ec, make_system_error(EAGAIN));
+}
+
+TEST(testUringSocket, sendBatch)
+{
+    if (!UringSocket::supported())
+        GTEST_SKIP() << "io_uring is not supported";
+
+    error_code ec;
+    UnixSocket receiver(AF_INET, SOCK_DGRAM, 0, ec);
+    const UnixSocketAddress destination = bind_loopback(receiver, ec);
+    ASSERT_FALSE(ec.value());
+
+    UringSocket sender(AF_INET, SOCK_DGRAM, 0, ec);
+    ASSERT_FALSE(ec.value());
+
+    const vector<string> messages = numbered("batch ", DATAGRAM_BATCH_MAX);
+    vector<Datagram> datagrams;
+    for (const string &message : messages)
+        datagrams.push_back(Datagram{ const_cast<char *>(message.data()), message.size(), const_cast<UnixSocketAddress *>(&destination) });
+
+    EXPECT_EQ(sender.sendmmsg(datagrams.data(), datagrams.size(), ec), static_cast<ssize_t>(datagrams.size()));
+    ASSERT_FALSE(ec.value());
+
+    // the chain keeps the order
+    for (const string &message : messages)
+    {
+        char buffer[64];
+        const ssize_t length = receiver.recvfrom(ec, buffer, sizeof(buffer));
+        ASSERT_FALSE(ec.value());
+        EXPECT_EQ(string(buffer, static_cast<size_t>(length)), message);
+    }
+
+    // the first datagram fails, the others are cancelled
+    struct sockaddr_in6 addr6;
+    memset(&addr6, 0, sizeof(addr6));
+    addr6.sin6_family = AF_INET6;
+    addr6.sin6_addr = in6addr_loopback;
+    addr6.sin6_port = htons(5683);
+    UnixSocketAddress unreachable(addr6);
+    datagrams[0].address = &unreachable;
+    EXPECT_EQ(sender.sendmmsg(datagrams.data(), 2, ec), -1);
+    EXPECT_TRUE(ec.value());
+}
+
+TEST(testUringSocket, reactor)
+{
+    if (!UringSocket::supported())
+        GTEST_SKIP() << "io_uring is not supported";
+
+    error_code ec;
+    Reactor reactor(ec);
+    ASSERT_FALSE(ec.value());
+
+    UringSocket receiver(AF_INET, SOCK_DGRAM, 0, ec);
+    const UnixSocketAddress destination = bind_loopback(receiver, ec);
+    receiver.set_blocking(false, ec);
+    ASSERT_FALSE(ec.value());
+
+    vector<string> received;
+    reactor.add(receiver.event_descriptor(), Reactor::READABLE, [&](uint32_t)
+        {
+            // one at a time, the ones left keep the descriptor readable
+            char buffer[64];
+            error_code rec;
+            const ssize_t length = receiver.recvfrom(rec, buffer, sizeof(buffer));
+            ASSERT_FALSE(rec.value());
+            received.push_back(string(buffer, static_cast<size_t>(length)));
+        }, ec);
+    ASSERT_FALSE(ec.value());
+
+    UnixSocket sender(AF_INET, SOCK_DGRAM, 0, ec);
+    const vector<string> messages = numbered("event ", 4);
+    send_all(sender, destination, messages);
+
+    const steady_clock::time_point deadline = steady_clock::now() + seconds(5);
+    while (received.size() < messages.size() && steady_clock::now() < deadline)
+    {
+        reactor.run_once(milliseconds(10), ec);
+        ASSERT_FALSE(ec.value());
+    }
+    EXPECT_EQ(received, messages);
+    reactor.remove(receiver.event_descriptor(), ec);
+}
+
+TEST(testUringSocket, timestamps)
+{
+    if (!UringSocket::supported())
+        GTEST_SKIP() << "io_uring is not supported";
+
+    error_code ec;
+    UringSocket receiver(AF_INET, SOCK_DGRAM, 0, ec);
+    ASSERT_FALSE(ec.value());
+    receiver.receive_timestamps(true, ec);
+    ASSERT_FALSE(ec.value());
+    const UnixSocketAddress destination = bind_loopback(receiver, ec);
+    ASSERT_FALSE(ec.value());
+
+    UnixSocket sender(AF_INET, SOCK_DGRAM, 0, ec);
+    const uint64_t before = UnixSocket::timestamp_now();
+    const vector<string> messages = numbered("stamped ", 4);
+    send_all(sender, destination, messages);
+
+    size_t received = 0;
+    char buffers[4][64];
+    vector<Datagram> datagrams(messages.size());
+    while (received < messages.size())
+    {
+        for (size_t i = received; i < messages.size(); ++i)
+            datagrams[i] = Datagram{ buffers[i], sizeof(buffers[i]), nullptr };
+        const ssize_t count = receiver.recvmmsg(&datagrams[received], messages.size() - received, ec);
+        ASSERT_FALSE(ec.value());
+        received += static_cast<size_t>(count);
+    }
+    const uint64_t after = UnixSocket::timestamp_now();
+
+    // the control messages do not shift the payload
+    for (size_t i = 0; i < messages.size(); ++i)
+    {
+        EXPECT_EQ(string(buffers[i], datagrams[i].length), messages[i]);
+        EXPECT_GE(datagrams[i].timestamp, before);
+        EXPECT_LE(datagrams[i].timestamp, after);
+    }
+}
+
+TEST(testUringSocket, backend)
+{
+    error_code ec;
+    unique_ptr<UnixSocket> socket = open_datagram_socket(AF_INET, SocketBackend::POLL, ec);
+    ASSERT_FALSE(ec.value());
+    EXPECT_EQ(dynamic_cast<UringSocket *>(socket.get()), nullptr);
+    EXPECT_EQ(socket->event_descriptor(), socket->descriptor());
+
+    socket = open_datagram_socket(AF_INET, SocketBackend::AUTO, ec);
+    ASSERT_FALSE(ec.value());
+    EXPECT_EQ(dynamic_cast<UringSocket *>(socket.get()) != nullptr, UringSocket::supported());
+
+    socket = open_datagram_socket(AF_INET, SocketBackend::URING, ec);
+    EXPECT_EQ(ec.value() == 0, UringSocket::supported());
+    ec.clear();
+
+    // the server connection picks the socket at run time
+    UdpServerConnection connection(0, true, ec, SocketBackend::AUTO);
+    connection.bind(ec);
+    ASSERT_FALSE(ec.value());
+    const UnixSocket *bound = static_cast<const UnixSocket *>(connection.socket());
+    struct sockaddr_in addr;
+    socklen_t length = sizeof(addr);
+    getsockname(bound->descriptor(), reinterpret_cast<struct sockaddr *>(&addr), &length);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    UnixSocketAddress destination(addr);
+
+    UnixSocket sender(AF_INET, SOCK_DGRAM, 0, ec);
+    send_all(sender, destination, {"connection"});
+    char buffer[64];
+    size_t received = sizeof(buffer);
+    UnixSocketAddress from;
+    connection.receive(buffer, received, &from, ec, 5);
+    ASSERT_FALSE(ec.value());
+    EXPECT_EQ(string(buffer, received), "connection");
+}
+
+#endif // __linux__